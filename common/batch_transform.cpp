@@ -0,0 +1,233 @@
+/* batch_transform.cpp
+ Scalar and SSE2 lanes for the batch transform kernel, and the runtime dispatch
+ between them and the AVX2 kernel in batch_transform_avx2.cpp.
+*/
+
+#include "batch_transform.h"
+#include "batch_transform_kernel.h"
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+
+#if (GLM_ARCH & GLM_ARCH_SSE2_BIT)
+#define BATCH_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+/* Both kernels write straight into ObjectTransforms so check the offsets they assume */
+static_assert(offsetof(ObjectTransforms, modelview) == BATCH_MODELVIEW_OFFSET, "ObjectTransforms layout");
+static_assert(offsetof(ObjectTransforms, mvp) == BATCH_MVP_OFFSET, "ObjectTransforms layout");
+static_assert(offsetof(ObjectTransforms, normalmatrix) == BATCH_NORMAL_OFFSET, "ObjectTransforms layout");
+
+namespace
+{
+	/* One instance at a time, used for the fallback and for the instances left over after the SIMD groups */
+	struct LaneScalar
+	{
+		static const int width = 1;
+		typedef bool Mask;
+		float v;
+
+		static LaneScalar set1(float x) { LaneScalar r; r.v = x; return r; }
+		static LaneScalar load(const float *p) { return set1(*p); }
+		LaneScalar operator+(LaneScalar b) const { return set1(v + b.v); }
+		LaneScalar operator-(LaneScalar b) const { return set1(v - b.v); }
+		LaneScalar operator*(LaneScalar b) const { return set1(v * b.v); }
+		LaneScalar operator-() const { return set1(-v); }
+
+		static LaneScalar roundNearest(LaneScalar x) { return set1((float)(int)(x.v + (x.v >= 0.f ? 0.5f : -0.5f))); }
+		static void quadrantMasks(LaneScalar q, Mask &swap, Mask &negateSin, Mask &negateCos)
+		{
+			int quadrant = (int)q.v;
+			swap = (quadrant & 1) != 0;
+			negateSin = (quadrant & 2) != 0;
+			negateCos = ((quadrant + 1) & 2) != 0;
+		}
+		static LaneScalar select(Mask m, LaneScalar a, LaneScalar b) { return m ? a : b; }
+		static LaneScalar negateIf(Mask m, LaneScalar a) { return m ? -a : a; }
+		static LaneScalar reciprocalOrOne(LaneScalar x) { return set1(x.v != 0.f ? 1.f / x.v : 1.f); }
+
+		static void storeColumn(const LaneScalar column[4], unsigned char *out, size_t, size_t offset)
+		{
+			float values[4] = { column[0].v, column[1].v, column[2].v, column[3].v };
+			memcpy(out + offset, values, sizeof(values));
+		}
+	};
+
+#ifdef BATCH_HAS_SSE2
+	/* Four instances per SSE2 register */
+	struct LaneSSE2
+	{
+		static const int width = 4;
+		typedef __m128 Mask;
+		__m128 v;
+
+		static LaneSSE2 wrap(__m128 x) { LaneSSE2 r; r.v = x; return r; }
+		static LaneSSE2 set1(float x) { return wrap(_mm_set1_ps(x)); }
+		static LaneSSE2 load(const float *p) { return wrap(_mm_loadu_ps(p)); }
+		LaneSSE2 operator+(LaneSSE2 b) const { return wrap(_mm_add_ps(v, b.v)); }
+		LaneSSE2 operator-(LaneSSE2 b) const { return wrap(_mm_sub_ps(v, b.v)); }
+		LaneSSE2 operator*(LaneSSE2 b) const { return wrap(_mm_mul_ps(v, b.v)); }
+		LaneSSE2 operator-() const { return wrap(_mm_xor_ps(v, _mm_set1_ps(-0.f))); }
+
+		static LaneSSE2 roundNearest(LaneSSE2 x) { return wrap(_mm_cvtepi32_ps(_mm_cvtps_epi32(x.v))); }
+		static void quadrantMasks(LaneSSE2 q, Mask &swap, Mask &negateSin, Mask &negateCos)
+		{
+			__m128i quadrant = _mm_cvtps_epi32(q.v);
+			__m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+			swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+			negateSin = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, two), two));
+			negateCos = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), two));
+		}
+		static LaneSSE2 select(Mask m, LaneSSE2 a, LaneSSE2 b) { return wrap(_mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v))); }
+		static LaneSSE2 negateIf(Mask m, LaneSSE2 a) { return wrap(_mm_xor_ps(a.v, _mm_and_ps(m, _mm_set1_ps(-0.f)))); }
+		static LaneSSE2 reciprocalOrOne(LaneSSE2 x)
+		{
+			__m128 nonZero = _mm_cmpneq_ps(x.v, _mm_setzero_ps());
+			return select(nonZero, wrap(_mm_div_ps(_mm_set1_ps(1.f), x.v)), set1(1.f));
+		}
+
+		/* The lanes are separate instances, so transpose to get one column per instance */
+		static void storeColumn(const LaneSSE2 column[4], unsigned char *out, size_t stride, size_t offset)
+		{
+			__m128 r0 = column[0].v, r1 = column[1].v, r2 = column[2].v, r3 = column[3].v;
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps((float*)(out + offset), r0);
+			_mm_storeu_ps((float*)(out + stride + offset), r1);
+			_mm_storeu_ps((float*)(out + 2 * stride + offset), r2);
+			_mm_storeu_ps((float*)(out + 3 * stride + offset), r3);
+		}
+	};
+#endif
+}
+
+void TransformBatch::add(vec3 position, vec3 rotation, vec3 scale)
+{
+	resize(size() + 1);
+	set(size() - 1, position, rotation, scale);
+}
+
+void TransformBatch::set(size_t i, vec3 position, vec3 rotation, vec3 scale)
+{
+	px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+	rx[i] = rotation.x; ry[i] = rotation.y; rz[i] = rotation.z;
+	sx[i] = scale.x; sy[i] = scale.y; sz[i] = scale.z;
+}
+
+void TransformBatch::resize(size_t count)
+{
+	px.resize(count); py.resize(count); pz.resize(count);
+	rx.resize(count); ry.resize(count); rz.resize(count);
+	sx.resize(count, 1.f); sy.resize(count, 1.f); sz.resize(count, 1.f);
+}
+
+/* Does the CPU, and the OS, support AVX2? */
+static bool cpuSupportsAVX2()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	// AVX and OSXSAVE, then check that the OS saves the YMM registers
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+/* The fastest kernel this machine can run, worked out once */
+BatchTransformPath batchTransformBestPath()
+{
+	static BatchTransformPath best = cpuSupportsAVX2() ? BATCH_AVX2 :
+#ifdef BATCH_HAS_SSE2
+		BATCH_SSE2;
+#else
+		BATCH_SCALAR;
+#endif
+	return best;
+}
+
+const char* batchTransformPathName(BatchTransformPath path)
+{
+	switch (path)
+	{
+	case BATCH_AVX2: return "AVX2";
+	case BATCH_SSE2: return "SSE2";
+	default: return "scalar";
+	}
+}
+
+/* The transforms of a single object, without the kernels. The normal matrix is the inverse-transpose
+   of the upper 3x3 of the model-view matrix, built from the cofactors so that a singular matrix
+   (e.g. a projected shadow) gives a finite result */
+ObjectTransforms objectTransforms(const mat4 &model, const mat4 &view, const mat4 &viewProjection)
+{
+	ObjectTransforms transforms;
+	transforms.model = model;
+	transforms.modelview = view * model;
+	transforms.mvp = viewProjection * model;
+
+	vec3 c0 = vec3(transforms.modelview[0]);
+	vec3 c1 = vec3(transforms.modelview[1]);
+	vec3 c2 = vec3(transforms.modelview[2]);
+
+	mat3 cofactors(cross(c1, c2), cross(c2, c0), cross(c0, c1));
+	float det = dot(c0, cofactors[0]);
+	if (det != 0.f) cofactors *= 1.f / det;
+	for (int c = 0; c < 3; c++) transforms.normalmatrix[c] = vec4(cofactors[c], 0);
+	return transforms;
+}
+
+/* Transform every instance in the batch with the best kernel */
+void batchTransform(const TransformBatch &batch, const mat4 &view, const mat4 &projection, ObjectTransforms *out, size_t stride)
+{
+	batchTransform(batch, 0, batch.size(), view, projection, out, stride, batchTransformBestPath());
+}
+
+/* Transform instances [first, first + count) of the batch into out[0 .. count-1], which are
+   stride bytes apart. A path the CPU can't run falls back to one that it can */
+void batchTransform(const TransformBatch &batch, size_t first, size_t count, const mat4 &view, const mat4 &projection,
+	ObjectTransforms *out, size_t stride, BatchTransformPath path)
+{
+	if (count == 0) return;
+	if (path > batchTransformBestPath()) path = batchTransformBestPath();
+
+	BatchKernelArgs args;
+	args.px = &batch.px[first]; args.py = &batch.py[first]; args.pz = &batch.pz[first];
+	args.rx = &batch.rx[first]; args.ry = &batch.ry[first]; args.rz = &batch.rz[first];
+	args.sx = &batch.sx[first]; args.sy = &batch.sy[first]; args.sz = &batch.sz[first];
+	mat4 viewProjection = projection * view;
+	memcpy(args.view, value_ptr(view), sizeof(args.view));
+	memcpy(args.viewProjection, value_ptr(viewProjection), sizeof(args.viewProjection));
+	args.out = (unsigned char*)out;
+	args.stride = stride;
+	args.count = count;
+
+	size_t done = 0;
+	if (path == BATCH_AVX2) done = batchTransformAVX2(args);
+#ifdef BATCH_HAS_SSE2
+	else if (path == BATCH_SSE2) done = runBatchKernel<LaneSSE2>(args);
+#endif
+
+	// Finish off whatever didn't fill a whole SIMD group
+	args.px += done; args.py += done; args.pz += done;
+	args.rx += done; args.ry += done; args.rz += done;
+	args.sx += done; args.sy += done; args.sz += done;
+	args.out += done * stride;
+	args.count -= done;
+	runBatchKernel<LaneScalar>(args);
+}
@@ -0,0 +1,55 @@
+/* batch_transform.h
+ Batch computation of per-instance transforms. Positions, rotations and scales are
+ held as structure-of-arrays so that SSE2 and AVX2 kernels can work on 4 or 8
+ instances at once. The kernel is picked at runtime from what the CPU supports,
+ with a scalar fallback.
+ Each instance gets model, model-view, model-view-projection and normal matrices,
+ written out in the layout that TransformPipeline streams to the shaders.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/* Layout of one object's matrices in the uniform block (std140) */
+struct ObjectTransforms
+{
+	glm::mat4 model;
+	glm::mat4 modelview;
+	glm::mat4 mvp;
+	glm::vec4 normalmatrix[3];		// std140 stores each mat3 column padded to a vec4
+};
+
+/* Instance placements as structure-of-arrays. Rotations are in degrees and are applied
+   like the examples do it: rotate(-radians(x)) about X, then Y, then Z. The model matrix
+   is translate * rotate * scale */
+struct TransformBatch
+{
+	std::vector<float> px, py, pz;
+	std::vector<float> rx, ry, rz;
+	std::vector<float> sx, sy, sz;
+
+	void add(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
+	void set(size_t i, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
+	void resize(size_t count);
+	size_t size() const { return px.size(); }
+};
+
+enum BatchTransformPath
+{
+	BATCH_SCALAR,
+	BATCH_SSE2,
+	BATCH_AVX2
+};
+
+BatchTransformPath batchTransformBestPath();
+const char* batchTransformPathName(BatchTransformPath path);
+
+ObjectTransforms objectTransforms(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &viewProjection);
+
+void batchTransform(const TransformBatch &batch, const glm::mat4 &view, const glm::mat4 &projection,
+	ObjectTransforms *out, size_t stride = sizeof(ObjectTransforms));
+void batchTransform(const TransformBatch &batch, size_t first, size_t count, const glm::mat4 &view, const glm::mat4 &projection,
+	ObjectTransforms *out, size_t stride, BatchTransformPath path);
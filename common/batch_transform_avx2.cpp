@@ -0,0 +1,85 @@
+/* batch_transform_avx2.cpp
+ AVX2 lanes for the batch transform kernel, eight instances per register.
+ This file is compiled with AVX2 enabled (/arch:AVX2 in the project settings for this file only)
+ and is only called after batchTransformBestPath() has checked that the CPU supports it.
+ Don't include glm or other shared inline code here, see batch_transform_kernel.h.
+*/
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#pragma GCC target("avx2")
+#endif
+
+#include "batch_transform_kernel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+namespace
+{
+	struct LaneAVX2
+	{
+		static const int width = 8;
+		typedef __m256 Mask;
+		__m256 v;
+
+		static LaneAVX2 wrap(__m256 x) { LaneAVX2 r; r.v = x; return r; }
+		static LaneAVX2 set1(float x) { return wrap(_mm256_set1_ps(x)); }
+		static LaneAVX2 load(const float *p) { return wrap(_mm256_loadu_ps(p)); }
+		LaneAVX2 operator+(LaneAVX2 b) const { return wrap(_mm256_add_ps(v, b.v)); }
+		LaneAVX2 operator-(LaneAVX2 b) const { return wrap(_mm256_sub_ps(v, b.v)); }
+		LaneAVX2 operator*(LaneAVX2 b) const { return wrap(_mm256_mul_ps(v, b.v)); }
+		LaneAVX2 operator-() const { return wrap(_mm256_xor_ps(v, _mm256_set1_ps(-0.f))); }
+
+		static LaneAVX2 roundNearest(LaneAVX2 x) { return wrap(_mm256_round_ps(x.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+		static void quadrantMasks(LaneAVX2 q, Mask &swap, Mask &negateSin, Mask &negateCos)
+		{
+			__m256i quadrant = _mm256_cvtps_epi32(q.v);
+			__m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+			swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+			negateSin = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, two), two));
+			negateCos = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), two));
+		}
+		static LaneAVX2 select(Mask m, LaneAVX2 a, LaneAVX2 b) { return wrap(_mm256_blendv_ps(b.v, a.v, m)); }
+		static LaneAVX2 negateIf(Mask m, LaneAVX2 a) { return wrap(_mm256_xor_ps(a.v, _mm256_and_ps(m, _mm256_set1_ps(-0.f)))); }
+		static LaneAVX2 reciprocalOrOne(LaneAVX2 x)
+		{
+			__m256 nonZero = _mm256_cmp_ps(x.v, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+			return select(nonZero, wrap(_mm256_div_ps(_mm256_set1_ps(1.f), x.v)), set1(1.f));
+		}
+
+		/* Transpose each half as a 4x4 block to get one column per instance */
+		static void storeColumn(const LaneAVX2 column[4], unsigned char *out, size_t stride, size_t offset)
+		{
+			for (int half = 0; half < 2; half++)
+			{
+				__m128 r0 = half ? _mm256_extractf128_ps(column[0].v, 1) : _mm256_castps256_ps128(column[0].v);
+				__m128 r1 = half ? _mm256_extractf128_ps(column[1].v, 1) : _mm256_castps256_ps128(column[1].v);
+				__m128 r2 = half ? _mm256_extractf128_ps(column[2].v, 1) : _mm256_castps256_ps128(column[2].v);
+				__m128 r3 = half ? _mm256_extractf128_ps(column[3].v, 1) : _mm256_castps256_ps128(column[3].v);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+				unsigned char *lane = out + half * 4 * stride + offset;
+				_mm_storeu_ps((float*)lane, r0);
+				_mm_storeu_ps((float*)(lane + stride), r1);
+				_mm_storeu_ps((float*)(lane + 2 * stride), r2);
+				_mm_storeu_ps((float*)(lane + 3 * stride), r3);
+			}
+		}
+	};
+}
+
+size_t batchTransformAVX2(const BatchKernelArgs &args)
+{
+	return runBatchKernel<LaneAVX2>(args);
+}
+
+#else
+
+/* No AVX2 on this architecture, batchTransformBestPath() never picks it */
+size_t batchTransformAVX2(const BatchKernelArgs &args)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,155 @@
+/* batch_transform_kernel.h
+ The batch transform kernel, written once over a "lane" type that holds one, four or
+ eight floats. It is included by batch_transform.cpp for the scalar and SSE2 lanes and
+ by batch_transform_avx2.cpp, which is compiled for AVX2.
+ Everything in here has internal linkage and nothing uses glm, so code built for AVX2
+ can't be picked up by the linker for the other paths.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+/* Plain pointers into a TransformBatch and the output buffer */
+struct BatchKernelArgs
+{
+	const float *px, *py, *pz;
+	const float *rx, *ry, *rz;
+	const float *sx, *sy, *sz;
+	float view[16];				// column-major, like glm
+	float viewProjection[16];
+	unsigned char *out;			// first ObjectTransforms to write
+	size_t stride;				// bytes between consecutive ObjectTransforms
+	size_t count;
+};
+
+/* Byte offsets of the matrices in ObjectTransforms */
+#define BATCH_MODEL_OFFSET 0
+#define BATCH_MODELVIEW_OFFSET 64
+#define BATCH_MVP_OFFSET 128
+#define BATCH_NORMAL_OFFSET 192
+
+/* Runs the AVX2 kernel over as many whole groups of 8 as fit and returns how many instances it did */
+size_t batchTransformAVX2(const BatchKernelArgs &args);
+
+namespace
+{
+	/* Sine and cosine of an angle in degrees. The range reduction is done in degrees, where
+	   multiples of 90 are exact, so large accumulated angles keep their accuracy.
+	   The polynomials are the Cephes single precision ones for [-pi/4, pi/4]. */
+	template <class F>
+	inline void sinCosDegrees(F degrees, F &s, F &c)
+	{
+		F q = F::roundNearest(degrees * F::set1(1.f / 90.f));
+		F r = (degrees - q * F::set1(90.f)) * F::set1(3.14159265358979f / 180.f);
+		F z = r * r;
+
+		F sinr = ((F::set1(-1.9515295891e-4f) * z + F::set1(8.3321608736e-3f)) * z + F::set1(-1.6666654611e-1f)) * z * r + r;
+		F cosr = ((F::set1(2.443315711809948e-5f) * z + F::set1(-1.388731625493765e-3f)) * z + F::set1(4.166664568298827e-2f)) * z * z
+			- F::set1(0.5f) * z + F::set1(1.f);
+
+		// sin(r + q * 90) and cos(r + q * 90) from the quadrant
+		typename F::Mask swap, negateSin, negateCos;
+		F::quadrantMasks(q, swap, negateSin, negateCos);
+		s = F::negateIf(negateSin, F::select(swap, cosr, sinr));
+		c = F::negateIf(negateCos, F::select(swap, sinr, cosr));
+	}
+
+	/* Transform F::width instances starting at index i */
+	template <class F>
+	inline void transformLanes(const BatchKernelArgs &a, size_t i, const F view[16], const F viewProjection[16])
+	{
+		// Rotation, negated like rotate(-radians(angle)) in the examples
+		F sX, cX, sY, cY, sZ, cZ;
+		sinCosDegrees(-F::load(a.rx + i), sX, cX);
+		sinCosDegrees(-F::load(a.ry + i), sY, cY);
+		sinCosDegrees(-F::load(a.rz + i), sZ, cZ);
+
+		// Model matrix: columns of Rx * Ry * Rz scaled by the scale, then the translation
+		F scaleX = F::load(a.sx + i), scaleY = F::load(a.sy + i), scaleZ = F::load(a.sz + i);
+		F m[12];
+		m[0] = cY * cZ * scaleX;
+		m[1] = (cX * sZ + sX * sY * cZ) * scaleX;
+		m[2] = (sX * sZ - cX * sY * cZ) * scaleX;
+		m[3] = -(cY * sZ) * scaleY;
+		m[4] = (cX * cZ - sX * sY * sZ) * scaleY;
+		m[5] = (sX * cZ + cX * sY * sZ) * scaleY;
+		m[6] = sY * scaleZ;
+		m[7] = -(sX * cY) * scaleZ;
+		m[8] = cX * cY * scaleZ;
+		m[9] = F::load(a.px + i);
+		m[10] = F::load(a.py + i);
+		m[11] = F::load(a.pz + i);
+
+		F zero = F::set1(0.f), one = F::set1(1.f);
+		F column[4];
+		unsigned char *out = a.out + i * a.stride;
+
+		// Model
+		for (int c = 0; c < 4; c++)
+		{
+			column[0] = m[c * 3]; column[1] = m[c * 3 + 1]; column[2] = m[c * 3 + 2];
+			column[3] = (c == 3) ? one : zero;
+			F::storeColumn(column, out, a.stride, BATCH_MODEL_OFFSET + c * 16);
+		}
+
+		// Model-view and model-view-projection. The model's bottom row is (0, 0, 0, 1)
+		F mv[12];
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				column[r] = view[r] * m[c * 3] + view[4 + r] * m[c * 3 + 1] + view[8 + r] * m[c * 3 + 2];
+				if (c == 3) column[r] = column[r] + view[12 + r];
+				if (r < 3) mv[c * 3 + r] = column[r];
+			}
+			F::storeColumn(column, out, a.stride, BATCH_MODELVIEW_OFFSET + c * 16);
+
+			for (int r = 0; r < 4; r++)
+			{
+				column[r] = viewProjection[r] * m[c * 3] + viewProjection[4 + r] * m[c * 3 + 1] + viewProjection[8 + r] * m[c * 3 + 2];
+				if (c == 3) column[r] = column[r] + viewProjection[12 + r];
+			}
+			F::storeColumn(column, out, a.stride, BATCH_MVP_OFFSET + c * 16);
+		}
+
+		// Normal matrix: cofactors of the model-view 3x3 divided by its determinant
+		F n[9];
+		n[0] = mv[4] * mv[8] - mv[5] * mv[7];
+		n[1] = mv[5] * mv[6] - mv[3] * mv[8];
+		n[2] = mv[3] * mv[7] - mv[4] * mv[6];
+		n[3] = mv[7] * mv[2] - mv[8] * mv[1];
+		n[4] = mv[8] * mv[0] - mv[6] * mv[2];
+		n[5] = mv[6] * mv[1] - mv[7] * mv[0];
+		n[6] = mv[1] * mv[5] - mv[2] * mv[4];
+		n[7] = mv[2] * mv[3] - mv[0] * mv[5];
+		n[8] = mv[0] * mv[4] - mv[1] * mv[3];
+		F inverseDet = F::reciprocalOrOne(mv[0] * n[0] + mv[1] * n[1] + mv[2] * n[2]);
+
+		for (int c = 0; c < 3; c++)
+		{
+			column[0] = n[c * 3] * inverseDet; column[1] = n[c * 3 + 1] * inverseDet; column[2] = n[c * 3 + 2] * inverseDet;
+			column[3] = zero;
+			F::storeColumn(column, out, a.stride, BATCH_NORMAL_OFFSET + c * 16);
+		}
+	}
+
+	/* Run the kernel over whole groups of F::width instances and return how many were done */
+	template <class F>
+	inline size_t runBatchKernel(const BatchKernelArgs &a)
+	{
+		F view[16], viewProjection[16];
+		for (int i = 0; i < 16; i++)
+		{
+			view[i] = F::set1(a.view[i]);
+			viewProjection[i] = F::set1(a.viewProjection[i]);
+		}
+
+		size_t whole = a.count / F::width * F::width;
+		for (size_t i = 0; i < whole; i += F::width)
+		{
+			transformLanes<F>(a, i, view, viewProjection);
+		}
+		return whole;
+	}
+}
@@ -0,0 +1,101 @@
+/* clustered_lights.cpp
+ Uploads the clustered light lists into texture buffers for the fragment shaders.
+*/
+
+#include "clustered_lights.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+ClusteredLights::ClusteredLights()
+{
+	for (int b = 0; b < BUFFERS; b++)
+	{
+		buffers[b] = 0;
+		textures[b] = 0;
+		capacity[b] = 0;
+	}
+	firstUnit = 1;
+}
+
+ClusteredLights::~ClusteredLights()
+{
+}
+
+/* Create the buffers and the texture views of them, on texture units firstTextureUnit onwards.
+   The clusters are built on threads threads, 0 for one per hardware thread */
+void ClusteredLights::makeClusters(GLuint firstTextureUnit, unsigned int tilesX, unsigned int tilesY, unsigned int slices,
+	unsigned int threads)
+{
+	firstUnit = firstTextureUnit;
+	grid.makeGrid(tilesX, tilesY, slices);
+	pool.makePool(threads);
+
+	// Each light is two RGBA float texels, each cluster one pair of unsigned ints and each index one
+	const GLenum formats[BUFFERS] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	glGenBuffers(BUFFERS, buffers);
+	glGenTextures(BUFFERS, textures);
+	for (int b = 0; b < BUFFERS; b++)
+	{
+		upload(b, NULL, 16);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[b]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[b], buffers[b]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+/* Replace a buffer's contents, growing it if they don't fit. Orphaning the old storage means
+   this never waits for draws that are still reading it */
+void ClusteredLights::upload(int buffer, const void *data, GLsizeiptr bytes)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+	if (bytes > capacity[buffer])
+	{
+		capacity[buffer] = std::max(bytes, capacity[buffer] * 2);
+	}
+	glBufferData(GL_TEXTURE_BUFFER, capacity[buffer], NULL, GL_STREAM_DRAW);
+	if (data && bytes > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/* Sort this frame's lights into the clusters and upload them */
+void ClusteredLights::update(const vector<PointLight> &lights, const mat4 &view, const mat4 &projection)
+{
+	grid.build(lights.empty() ? NULL : &lights[0], lights.size(), view, projection, &pool);
+
+	upload(LIGHTS, grid.lightData.empty() ? NULL : &grid.lightData[0], grid.lightData.size() * sizeof(float));
+	upload(CELLS, &grid.cells[0], grid.cells.size() * sizeof(GLuint));
+	upload(INDICES, grid.indices.empty() ? NULL : &grid.indices[0], grid.indices.size() * sizeof(GLuint));
+}
+
+/* Bind the three texture buffers to their units, leaving texture unit 0 active */
+void ClusteredLights::bindTextures()
+{
+	for (int b = 0; b < BUFFERS; b++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + b);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[b]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/* Send the cluster layout to the program, which must be current. Call it whenever the
+   program, the grid or the viewport changes */
+void ClusteredLights::setUniforms(GLuint program)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glUniform1i(glGetUniformLocation(program, "clusterLights"), firstUnit + LIGHTS);
+	glUniform1i(glGetUniformLocation(program, "clusterCells"), firstUnit + CELLS);
+	glUniform1i(glGetUniformLocation(program, "clusterIndices"), firstUnit + INDICES);
+	glUniform3ui(glGetUniformLocation(program, "clusterCount"), grid.tilesX, grid.tilesY, grid.slices);
+	glUniform2f(glGetUniformLocation(program, "clusterScreenScale"),
+		(float)grid.tilesX / std::max(viewport[2], 1), (float)grid.tilesY / std::max(viewport[3], 1));
+
+	// slice = log(depth / near) * slices / log(far / near)
+	float sliceScale = grid.slices / log(grid.farPlane / grid.nearPlane);
+	glUniform2f(glGetUniformLocation(program, "clusterDepthScale"), sliceScale, -log(grid.nearPlane) * sliceScale);
+}
@@ -0,0 +1,41 @@
+/* clustered_lights.h
+ Clustered forward lighting for many point lights. Each frame the lights are sorted into
+ the clusters of the view frustum on the CPU (see light_clusters.h) and uploaded into three
+ texture buffers: the lights, each cluster's first index and count, and the index lists.
+ A fragment shader that includes shaders/clustered_lights.glsl finds its cluster from its
+ window position and depth and only loops over that cluster's lights.
+ Texture buffers are used rather than shader storage buffers so that this runs on OpenGL 4.0.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include "light_clusters.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+class ClusteredLights
+{
+public:
+	ClusteredLights();
+	~ClusteredLights();
+
+	void makeClusters(GLuint firstTextureUnit = 1, unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24,
+		unsigned int threads = 0);
+	void update(const std::vector<PointLight> &lights, const glm::mat4 &view, const glm::mat4 &projection);
+	void bindTextures();
+	void setUniforms(GLuint program);
+
+	LightClusterGrid grid;
+
+private:
+	enum { LIGHTS, CELLS, INDICES, BUFFERS };
+
+	void upload(int buffer, const void *data, GLsizeiptr bytes);
+
+	GLuint buffers[BUFFERS];
+	GLuint textures[BUFFERS];
+	GLsizeiptr capacity[BUFFERS];		// bytes allocated for each buffer
+	GLuint firstUnit;
+	JobPool pool;
+};
@@ -1,11 +1,13 @@
 /* cube.h
 Example class to to show a cube implementation
 Iain Martin November 2018
+The geometry comes from MeshBuilder::addCube and is drawn from one buffer object by a MeshBatch.
 */
 
 #pragma once
 
 #include "wrapper_glfw.h"
+#include "mesh_batch.h"
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -18,15 +20,11 @@ public:
 	void makeCube();
 	void drawCube(int drawmode);
 
-	// Define vertex buffer object names (e.g as globals)
-	GLuint positionBufferObject;
-	GLuint colourObject;
-	GLuint normalsBufferObject;
-
 	GLuint attribute_v_coord;
 	GLuint attribute_v_normal;
 	GLuint attribute_v_colours;
 
-	int numvertices;
-
+private:
+	MeshBatch batch;
+	GLuint mesh;
 };
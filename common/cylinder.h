@@ -4,30 +4,28 @@
  * by Iain Martin in November 2017.
  * Provided to the AC41001/AC51008 Graphics class to help debug their own cylinder objects or to
  * used in their assignment to provide another flexible 
+ * The geometry comes from MeshBuilder::addCylinder and is drawn from one buffer object by a MeshBatch.
  */
 
 #ifndef CYLINDER_H
 #define CYLINDER_H
 
 #include "wrapper_glfw.h"
+#include "mesh_batch.h"
 #include <glm/glm.hpp>
 
 class Cylinder
 {
 private:
 	glm::vec3 colour;
-	GLfloat radius, length;
 	GLuint definition;
-	GLuint cylinderBufferObject, cylinderNormals, cylinderColours, cylinderElementbuffer;
-	GLuint num_pvertices;
-	GLuint isize;
-	GLuint numberOfvertices;
 
 	GLuint attribute_v_coord;
 	GLuint attribute_v_normal;
 	GLuint attribute_v_colours;
 
-	void defineVertices();
+	MeshBatch batch;
+	GLuint mesh;
 
 public:
 	Cylinder();
@@ -0,0 +1,158 @@
+/* draw_lists.cpp
+ Per-thread draw lists, merged and sorted for the render thread.
+*/
+
+#include "draw_lists.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace glm;
+
+unsigned long long drawSortKey(unsigned int program, unsigned int texture, unsigned int mesh, float viewDepth)
+{
+	// A positive float's bits sort the same way as its value, so behind the camera counts as 0
+	unsigned int depth = 0;
+	if (viewDepth > 0.f) memcpy(&depth, &viewDepth, sizeof(depth));
+
+	return ((unsigned long long)(program & 0xff) << 56) | ((unsigned long long)(texture & 0xfff) << 44)
+		| ((unsigned long long)(mesh & 0xfff) << 32) | depth;
+}
+
+void frontToBackOrder(const vector<DrawPacket> &packets, vector<unsigned int> &order)
+{
+	order.resize(packets.size());
+	for (size_t p = 0; p < packets.size(); p++) order[p] = (unsigned int)p;
+
+	// The depth is the low 32 bits of the key, and packets at the same depth stay in key order
+	stable_sort(order.begin(), order.end(), [&packets](unsigned int a, unsigned int b)
+	{
+		return (unsigned int)packets[a].key < (unsigned int)packets[b].key;
+	});
+}
+
+void DrawView::set(const mat4 &view, const mat4 &projection)
+{
+	this->view = view;
+	this->projection = projection;
+	viewProjection = projection * view;
+
+	// left, right, bottom, top, near, far: row 3 plus or minus rows 0, 1 and 2
+	for (int p = 0; p < 6; p++)
+	{
+		int row = p / 2;
+		float sign = (p & 1) ? -1.f : 1.f;
+		for (int c = 0; c < 4; c++) planes[p][c] = viewProjection[c][3] + sign * viewProjection[c][row];
+
+		float scale = length(vec3(planes[p]));
+		if (scale > 0.f) planes[p] /= scale;
+	}
+}
+
+/* Whether a bounding sphere (centre and radius in the model's space) may be in view once placed by model */
+bool DrawView::visible(const mat4 &model, const vec4 &sphere) const
+{
+	vec4 centre = model * vec4(vec3(sphere), 1.f);
+	float scale = std::max(length(vec3(model[0])), std::max(length(vec3(model[1])), length(vec3(model[2]))));
+	float radius = sphere.w * scale;
+
+	for (int p = 0; p < 6; p++)
+	{
+		if (dot(vec3(planes[p]), vec3(centre)) + planes[p].w < -radius) return false;
+	}
+	return true;
+}
+
+void DrawList::clear()
+{
+	packets.clear();
+	transforms.clear();
+}
+
+/* Add a draw with transforms that have already been computed, e.g. by the batch kernels */
+void DrawList::add(unsigned int item, unsigned int mesh, unsigned int program, unsigned int texture,
+	const ObjectTransforms &objectTransforms)
+{
+	DrawPacket packet;
+	packet.key = drawSortKey(program, texture, mesh, -objectTransforms.modelview[3].z);
+	packet.item = item;
+	packet.mesh = mesh;
+	packet.program = program;
+	packet.texture = texture;
+	packet.transform = (unsigned int)transforms.size();
+	packets.push_back(packet);
+	transforms.push_back(objectTransforms);
+}
+
+void DrawList::add(unsigned int item, unsigned int mesh, unsigned int program, unsigned int texture, const mat4 &model,
+	const DrawView &view)
+{
+	add(item, mesh, program, texture, objectTransforms(model, view.view, view.viewProjection));
+}
+
+DrawRecorder::DrawRecorder()
+{
+}
+
+DrawRecorder::~DrawRecorder()
+{
+}
+
+/* Start the worker threads, threads = 0 for one per hardware thread */
+void DrawRecorder::makeRecorder(unsigned int threads)
+{
+	pool.makePool(threads);
+	lists.resize(pool.size());
+}
+
+void DrawRecorder::record(size_t items, size_t grain, const Visit &visit)
+{
+	if (lists.empty()) lists.resize(1);
+	for (size_t l = 0; l < lists.size(); l++) lists[l].clear();
+
+	pool.run(items, grain, [this, &visit](size_t first, size_t last, unsigned int worker)
+	{
+		visit(first, last, lists[worker]);
+	});
+	merge();
+}
+
+static bool packetOrder(const DrawPacket &a, const DrawPacket &b)
+{
+	if (a.key != b.key) return a.key < b.key;
+	return a.item < b.item;
+}
+
+/* Sort each list on the pool, then merge them into one sorted array, pointing each packet at
+   its transforms in the merged array. The sorts are stable so an item's packets with the same
+   key stay in the order it added them, and an item's packets are all in one list */
+void DrawRecorder::merge()
+{
+	pool.run(lists.size(), 1, [this](size_t first, size_t last, unsigned int)
+	{
+		for (size_t l = first; l < last; l++) stable_sort(lists[l].packets.begin(), lists[l].packets.end(), packetOrder);
+	});
+
+	size_t count = 0;
+	for (size_t l = 0; l < lists.size(); l++) count += lists[l].packets.size();
+	packets.resize(count);
+	transforms.resize(count);
+
+	// There is a list for each thread, few enough to look at the front of each one for every packet
+	vector<size_t> next(lists.size(), 0);
+	for (size_t out = 0; out < count; out++)
+	{
+		size_t best = lists.size();
+		for (size_t l = 0; l < lists.size(); l++)
+		{
+			if (next[l] == lists[l].packets.size()) continue;
+			if (best == lists.size() || packetOrder(lists[l].packets[next[l]], lists[best].packets[next[best]])) best = l;
+		}
+
+		const DrawList &list = lists[best];
+		const DrawPacket &packet = list.packets[next[best]++];
+		packets[out] = packet;
+		packets[out].transform = (unsigned int)out;
+		transforms[out] = list.transforms[packet.transform];
+	}
+}
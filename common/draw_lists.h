@@ -0,0 +1,85 @@
+/* draw_lists.h
+ Records a frame's draws on worker threads and hands them to the render thread, so that only
+ the render thread touches the OpenGL context.
+ A DrawRecorder runs the application's visit function over the scene's items on a JobPool.
+ Each worker culls its items, computes their transforms and writes small DrawPackets into its
+ own DrawList, so the workers never share anything they write. Each list is then sorted on the
+ pool and the lists are merged by key: program, then texture, then mesh, then front to back,
+ so that the render thread changes as little state as it can when it replays them. Equal keys
+ keep the order of the items that recorded them, so a frame is the same however the work
+ was shared out.
+ What a packet's mesh, program and texture numbers mean is up to the application that replays
+ them. Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include "job_pool.h"
+#include "batch_transform.h"
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+struct DrawPacket
+{
+	unsigned long long key;		// see drawSortKey
+	unsigned int item;			// the scene item that recorded it
+	unsigned int mesh;
+	unsigned int program;
+	unsigned int texture;
+	unsigned int transform;		// index of its ObjectTransforms, in its DrawList and then in the DrawRecorder
+};
+
+/* 8 bits of program, 12 of texture and 12 of mesh, then the view depth, nearest first */
+unsigned long long drawSortKey(unsigned int program, unsigned int texture, unsigned int mesh, float viewDepth);
+
+/* The indices of the packets from nearest to furthest, for passes like a depth pre-pass where only depth matters */
+void frontToBackOrder(const std::vector<DrawPacket> &packets, std::vector<unsigned int> &order);
+
+/* The camera the draws are recorded for */
+struct DrawView
+{
+	glm::mat4 view, projection, viewProjection;
+	glm::vec4 planes[6];		// of the view frustum, in world space, pointing in
+
+	void set(const glm::mat4 &view, const glm::mat4 &projection);
+	bool visible(const glm::mat4 &model, const glm::vec4 &sphere) const;
+};
+
+class DrawList
+{
+public:
+	void clear();
+	void add(unsigned int item, unsigned int mesh, unsigned int program, unsigned int texture, const ObjectTransforms &transforms);
+	void add(unsigned int item, unsigned int mesh, unsigned int program, unsigned int texture, const glm::mat4 &model,
+		const DrawView &view);
+
+	std::vector<DrawPacket> packets;
+	std::vector<ObjectTransforms> transforms;
+	std::vector<ObjectTransforms> scratch;		// for the visit function to use as it likes
+};
+
+class DrawRecorder
+{
+public:
+	DrawRecorder();
+	~DrawRecorder();
+
+	void makeRecorder(unsigned int threads = 0);
+	unsigned int threads() const { return pool.size(); }
+	JobPool &jobs() { return pool; }		// for other work between record()s, like culling
+
+	/* Call visit(first, last, list) over [0, items) on the pool, then merge */
+	typedef std::function<void(size_t first, size_t last, DrawList &list)> Visit;
+	void record(size_t items, size_t grain, const Visit &visit);
+
+	// The sorted packets of the last record(), and the transforms they refer to
+	std::vector<DrawPacket> packets;
+	std::vector<ObjectTransforms> transforms;
+
+private:
+	void merge();
+
+	JobPool pool;
+	std::vector<DrawList> lists;
+};
@@ -0,0 +1,313 @@
+/* frame_capture.cpp
+ Frame read back through a ring of pixel buffer objects, and the thread that writes the frames out.
+*/
+
+#include "frame_capture.h"
+#include "png_writer.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+
+using namespace std;
+
+FrameCapture::FrameCapture()
+{
+	slotIndex = 0;
+	width = height = 0;
+	sequence = raw = false;
+	frameNumber = 0;
+	written = 0;
+	stalled = 0;
+	queueLength = 8;
+	busy = 0;
+	stopping = false;
+}
+
+/* Needs the context that made the capture to be current, to delete the buffers */
+FrameCapture::~FrameCapture()
+{
+	if (slots.empty()) return;
+	stopSequence();
+	finish();
+	stop();
+	for (size_t s = 0; s < slots.size(); s++) glDeleteBuffers(1, &slots[s].buffer);
+}
+
+void FrameCapture::makeCapture(GLuint depth, size_t queueLength)
+{
+	if (!slots.empty()) return;
+
+	slots.resize(depth > 1 ? depth : 2);
+	for (size_t s = 0; s < slots.size(); s++)
+	{
+		glGenBuffers(1, &slots[s].buffer);
+		slots[s].fence = 0;
+		slots[s].width = slots[s].height = 0;
+	}
+	this->queueLength = queueLength > 0 ? queueLength : 1;
+	stopping = false;
+	encoder = thread(&FrameCapture::worker, this);
+}
+
+void FrameCapture::screenshot(const string &file)
+{
+	pendingScreenshot = file;
+}
+
+void FrameCapture::startSequence(const string &prefix, bool raw)
+{
+	stopSequence();
+	this->prefix = prefix;
+	this->raw = raw;
+	frameNumber = 0;
+	sequence = true;
+}
+
+/* The frames still in the ring are the end of the sequence, so they are read before the raw file is closed */
+void FrameCapture::stopSequence()
+{
+	if (!sequence) return;
+	sequence = false;
+	if (!raw || slots.empty()) return;
+
+	retireAll(true);
+	Job close;
+	close.width = close.height = 0;
+	close.target.file = prefix + ".rgb";
+	close.target.raw = true;
+
+	unique_lock<mutex> guard(lock);
+	jobDone.wait(guard, [this] { return busy < queueLength; });
+	jobs.push_back(close);
+	busy++;
+	jobReady.notify_one();
+}
+
+void FrameCapture::captureFrame(GLint width, GLint height)
+{
+	if (slots.empty()) return;
+
+	// Hand on the frames that the GPU has finished copying since the last one
+	retireAll(false);
+	if (!sequence && pendingScreenshot.empty()) return;
+	if (width <= 0 || height <= 0) return;
+	if (width != this->width || height != this->height) resize(width, height);
+
+	// The ring has come round to a frame whose copy hasn't finished, so it has to be waited for
+	Slot &slot = slots[slotIndex];
+	if (slot.fence)
+	{
+		stalled++;
+		retire(slot);
+	}
+
+	// A screenshot taken while recording is written as well as the frame of the sequence
+	slot.target.screenshot.swap(pendingScreenshot);
+	pendingScreenshot.clear();
+	slot.target.file.clear();
+	slot.target.raw = sequence && raw;
+	if (sequence && raw) slot.target.file = prefix + ".rgb";
+	else if (sequence)
+	{
+		ostringstream name;
+		name << prefix << setw(6) << setfill('0') << frameNumber << ".png";
+		slot.target.file = name.str();
+	}
+	if (sequence) frameNumber++;
+
+	// Read the back buffer into the pixel buffer. This returns straight away and the copy runs on the GPU
+	GLint readFramebuffer, packBuffer;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+
+	slotIndex = (slotIndex + 1) % slots.size();
+}
+
+/* Hand the frames in the ring on to the worker, oldest first. Without wait, stop at the first one
+   whose copy is still running */
+void FrameCapture::retireAll(bool wait)
+{
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		Slot &slot = slots[(slotIndex + i) % slots.size()];
+		if (!slot.fence) continue;
+		if (!wait)
+		{
+			GLenum status = glClientWaitSync(slot.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		}
+		retire(slot);
+	}
+}
+
+/* Wait for a slot's copy, map it and queue its pixels for the worker */
+void FrameCapture::retire(Slot &slot)
+{
+	GLenum status;
+	do
+	{
+		status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	} while (status == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+	if (status == GL_WAIT_FAILED) return;
+
+	Job job;
+	job.width = slot.width;
+	job.height = slot.height;
+	job.target = slot.target;
+	size_t bytes = (size_t)slot.width * slot.height * 4;
+	{
+		// Wait for room in the queue rather than drop the frame
+		unique_lock<mutex> guard(lock);
+		if (busy >= queueLength)
+		{
+			stalled++;
+			jobDone.wait(guard, [this] { return busy < queueLength; });
+		}
+		if (!spare.empty())
+		{
+			job.pixels.swap(spare.back());
+			spare.pop_back();
+		}
+	}
+	job.pixels.resize(bytes);
+
+	GLint packBuffer;
+	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+	if (mapped)
+	{
+		memcpy(&job.pixels[0], mapped, bytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+	if (!mapped)
+	{
+		cerr << "Could not map a captured frame" << endl;
+		return;
+	}
+
+	lock_guard<mutex> guard(lock);
+	jobs.push_back(std::move(job));
+	busy++;
+	jobReady.notify_one();
+}
+
+/* The pixel buffers are the size of the framebuffer, so they are remade when the window is */
+void FrameCapture::resize(GLint width, GLint height)
+{
+	retireAll(true);
+	this->width = width;
+	this->height = height;
+
+	GLint packBuffer;
+	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+	for (size_t s = 0; s < slots.size(); s++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[s].buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+}
+
+void FrameCapture::finish()
+{
+	if (slots.empty()) return;
+	retireAll(true);
+	unique_lock<mutex> guard(lock);
+	jobDone.wait(guard, [this] { return busy == 0; });
+}
+
+/* The worker thread: turn each frame the right way up, drop its alpha and write it */
+void FrameCapture::worker()
+{
+	vector<unsigned char> rgb;
+	for (;;)
+	{
+		Job job;
+		{
+			unique_lock<mutex> guard(lock);
+			jobReady.wait(guard, [this] { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		bool ok = true;
+		if (job.pixels.empty())
+		{
+			if (rawFile.is_open()) rawFile.close();
+		}
+		else
+		{
+			size_t row = (size_t)job.width * 3;
+			rgb.resize(row * job.height);
+			for (GLint y = 0; y < job.height; y++)
+			{
+				const unsigned char *in = &job.pixels[(size_t)(job.height - 1 - y) * job.width * 4];
+				unsigned char *out = &rgb[y * row];
+				for (GLint x = 0; x < job.width; x++, in += 4, out += 3)
+				{
+					out[0] = in[0];
+					out[1] = in[1];
+					out[2] = in[2];
+				}
+			}
+
+			if (job.target.raw)
+			{
+				if (!rawFile.is_open()) rawFile.open(job.target.file.c_str(), ios::binary);
+				rawFile.write((const char*)&rgb[0], rgb.size());
+				if (!rawFile.good())
+				{
+					cerr << "Could not write " << job.target.file << endl;
+					ok = false;
+				}
+			}
+			else if (!job.target.file.empty() && !writePNG(job.target.file, job.width, job.height, 3, &rgb[0]))
+			{
+				cerr << "Could not write " << job.target.file << endl;
+				ok = false;
+			}
+
+			if (!job.target.screenshot.empty())
+			{
+				if (writePNG(job.target.screenshot, job.width, job.height, 3, &rgb[0])) cout << "Wrote " << job.target.screenshot << endl;
+				else cerr << "Could not write " << job.target.screenshot << endl;
+			}
+		}
+
+		lock_guard<mutex> guard(lock);
+		if (!job.pixels.empty())
+		{
+			if (ok) written++;
+			spare.push_back(std::move(job.pixels));
+		}
+		busy--;
+		jobDone.notify_all();
+	}
+}
+
+void FrameCapture::stop()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+		jobReady.notify_all();
+	}
+	if (encoder.joinable()) encoder.join();
+	if (rawFile.is_open()) rawFile.close();
+}
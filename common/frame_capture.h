@@ -0,0 +1,106 @@
+/* frame_capture.h
+ Captures frames of a window without stalling it. Each frame is read into one of a ring of pixel
+ buffer objects, which glReadPixels fills on the GPU while the CPU moves on, and a fence marks
+ when it is done. The buffer is only mapped when the ring comes back round to it, several frames
+ later, by which time the copy has almost always finished. The pixels are then handed to a worker
+ thread that turns them the right way up and writes them as a PNG, or appends them to a raw RGB
+ video file, so the render thread never encodes or touches the disk.
+ Nothing is ever dropped: if the GPU falls behind, the render thread waits for the oldest buffer,
+ and if the disk falls behind, it waits for room in the worker's queue. stalls() counts the
+ frames that had to wait, so a recording that couldn't keep up shows it.
+ A raw file can be played or encoded with
+   ffmpeg -f rawvideo -pixel_format rgb24 -video_size WIDTHxHEIGHT -framerate 60 -i file.rgb
+ GLWrapper owns one of these; see screenshot() and startCapture() there.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class FrameCapture
+{
+public:
+	FrameCapture();
+	~FrameCapture();
+
+	/* depth is the number of pixel buffers, the frames between a read and its map, and queueLength
+	   the frames that can wait to be written before the render thread has to */
+	void makeCapture(GLuint depth = 3, size_t queueLength = 8);
+
+	/* Write the next frame to file as a PNG */
+	void screenshot(const std::string &file);
+
+	/* Write every frame from the next on, as prefix000000.png, prefix000001.png and so on, or with raw
+	   set into the one file prefix.rgb, until stopSequence() */
+	void startSequence(const std::string &prefix, bool raw = false);
+	void stopSequence();
+	bool recording() const { return sequence; }
+
+	/* Call once a frame, after drawing it and before swapping, with the framebuffer size */
+	void captureFrame(GLint width, GLint height);
+
+	/* Wait for every frame that has been read to be written */
+	void finish();
+
+	unsigned int framesWritten() const { return written; }
+	unsigned int stalls() const { return stalled; }
+
+private:
+	// Where a read frame goes
+	struct Target
+	{
+		std::string file;			// the frame of a sequence, or empty
+		bool raw;					// append to file rather than write a PNG
+		std::string screenshot;		// a PNG of the same frame, or empty
+	};
+
+	struct Slot
+	{
+		GLuint buffer;
+		GLsync fence;
+		GLint width, height;
+		Target target;
+	};
+
+	struct Job
+	{
+		std::vector<unsigned char> pixels;		// RGBA, rows from the bottom as GL reads them, or none to close the raw file
+		GLint width, height;
+		Target target;
+	};
+
+	void retire(Slot &slot);
+	void retireAll(bool wait);
+	void resize(GLint width, GLint height);
+	void worker();
+	void stop();
+
+	std::vector<Slot> slots;
+	GLuint slotIndex;
+	GLint width, height;
+
+	std::string pendingScreenshot;
+	std::string prefix;
+	bool sequence, raw;
+	unsigned int frameNumber;
+	std::atomic<unsigned int> written;
+	unsigned int stalled;
+
+	std::thread encoder;
+	std::mutex lock;
+	std::condition_variable jobReady, jobDone;
+	std::deque<Job> jobs;
+	std::vector<std::vector<unsigned char>> spare;		// pixel buffers to use again
+	size_t queueLength;
+	size_t busy;			// jobs queued or being written
+	bool stopping;
+	std::ofstream rawFile;		// used by the worker alone
+};
@@ -0,0 +1,105 @@
+/* gbuffer.cpp
+ The framebuffer and textures of the deferred shading geometry buffer.
+*/
+
+#include "gbuffer.h"
+#include <iostream>
+
+using namespace std;
+
+GBuffer::GBuffer()
+{
+	width = height = 0;
+	framebuffer = 0;
+	emptyVertexArray = 0;
+	for (int t = 0; t < TARGETS; t++) textures[t] = 0;
+}
+
+GBuffer::~GBuffer()
+{
+}
+
+/* Create the framebuffer and its targets at the size of the window */
+void GBuffer::makeGBuffer(GLsizei width, GLsizei height)
+{
+	glGenFramebuffers(1, &framebuffer);
+	glGenTextures(TARGETS, textures);
+	glGenVertexArrays(1, &emptyVertexArray);
+
+	this->width = width;
+	this->height = height;
+	allocate();
+}
+
+/* Reallocate the targets when the window changes size */
+void GBuffer::resize(GLsizei width, GLsizei height)
+{
+	if (width == this->width && height == this->height) return;
+	this->width = width;
+	this->height = height;
+	if (framebuffer) allocate();
+}
+
+void GBuffer::allocate()
+{
+	const GLint internalFormats[TARGETS] = { GL_RGBA8, GL_RG16F, GL_DEPTH_COMPONENT24 };
+	const GLenum formats[TARGETS] = { GL_RGBA, GL_RG, GL_DEPTH_COMPONENT };
+	const GLenum types[TARGETS] = { GL_UNSIGNED_BYTE, GL_FLOAT, GL_UNSIGNED_INT };
+	const GLenum attachments[TARGETS] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_DEPTH_ATTACHMENT };
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	for (int t = 0; t < TARGETS; t++)
+	{
+		// The lighting pass reads exactly one texel for each pixel, so there is nothing to filter
+		glBindTexture(GL_TEXTURE_2D, textures[t]);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[t], width > 0 ? width : 1, height > 0 ? height : 1, 0,
+			formats[t], types[t], NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[t], GL_TEXTURE_2D, textures[t], 0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		cout << "G-buffer framebuffer is incomplete" << endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* Draw into the albedo and normal targets and the depth. The caller clears them */
+void GBuffer::bindForWriting()
+{
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glDrawBuffers(2, drawBuffers);
+}
+
+/* Go back to drawing into the window */
+void GBuffer::unbind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* Bind the albedo, normal and depth textures to units firstUnit onwards, leaving texture unit 0 active */
+void GBuffer::bindTextures(GLuint firstUnit)
+{
+	for (int t = 0; t < TARGETS; t++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + t);
+		glBindTexture(GL_TEXTURE_2D, textures[t]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/* Draw one triangle that covers the viewport, putting the caller's vertex array back afterwards */
+void GBuffer::drawFullScreen()
+{
+	GLint previous;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+	glBindVertexArray(emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(previous);
+}
@@ -0,0 +1,41 @@
+/* gbuffer.h
+ The geometry buffer of deferred shading. The scene is drawn into it once, writing each
+ pixel's albedo and shininess, its eye space normal and its depth, and the lighting is then
+ worked out once per pixel in a full-screen pass that reads them back. Hidden fragments
+ only cost the writes, so the lighting scales with the pixels on screen rather than with
+ the overdraw.
+ The targets are 12 bytes a pixel:
+   0: GL_RGBA8    albedo, and the shininess / 255 in alpha (0 for no specular)
+   1: GL_RG16F    the normal, octahedral encoded (see shaders/octahedral.glsl)
+   depth: GL_DEPTH_COMPONENT24, from which the lighting pass rebuilds the eye space position
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+
+class GBuffer
+{
+public:
+	GBuffer();
+	~GBuffer();
+
+	void makeGBuffer(GLsizei width, GLsizei height);
+	void resize(GLsizei width, GLsizei height);
+
+	void bindForWriting();
+	void unbind();
+	void bindTextures(GLuint firstUnit);
+	void drawFullScreen();
+
+	GLsizei width, height;
+
+private:
+	enum { ALBEDO, NORMAL, DEPTH, TARGETS };
+
+	void allocate();
+
+	GLuint framebuffer;
+	GLuint textures[TARGETS];
+	GLuint emptyVertexArray;		// the full-screen triangle is made from gl_VertexID
+};
@@ -0,0 +1,766 @@
+/* gl_accounting.cpp
+ OpenGL call counting and object tracking, by swapping glload's function pointers.
+ The calls that only need counting are wrapped by a template made from the type of their
+ pointer, so they are just listed here. The calls that make, delete, bind or fill objects have
+ their own wrappers that keep the object records up to date.
+*/
+
+#include "gl_accounting.h"
+#include <map>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <iomanip>
+
+using namespace std;
+
+/* The calls that are only counted */
+#define COUNTED_CALLS(X) \
+	X(glClear, GL_CALLS_DRAW) \
+	X(glUniformMatrix4fv, GL_CALLS_UNIFORM) \
+	X(glUniform1i, GL_CALLS_UNIFORM) \
+	X(glUniform1ui, GL_CALLS_UNIFORM) \
+	X(glUniform1f, GL_CALLS_UNIFORM) \
+	X(glUniform2f, GL_CALLS_UNIFORM) \
+	X(glUniform3f, GL_CALLS_UNIFORM) \
+	X(glUniform3fv, GL_CALLS_UNIFORM) \
+	X(glUniform3ui, GL_CALLS_UNIFORM) \
+	X(glUniform4fv, GL_CALLS_UNIFORM) \
+	X(glUniformBlockBinding, GL_CALLS_UNIFORM) \
+	X(glUseProgram, GL_CALLS_BIND) \
+	X(glBindFramebuffer, GL_CALLS_BIND) \
+	X(glVertexAttribPointer, GL_CALLS_STATE) \
+	X(glEnableVertexAttribArray, GL_CALLS_STATE) \
+	X(glDisableVertexAttribArray, GL_CALLS_STATE) \
+	X(glVertexAttrib4fv, GL_CALLS_STATE) \
+	X(glPolygonMode, GL_CALLS_STATE) \
+	X(glTexParameteri, GL_CALLS_STATE) \
+	X(glTexParameteriv, GL_CALLS_STATE) \
+	X(glClearColor, GL_CALLS_STATE) \
+	X(glViewport, GL_CALLS_STATE) \
+	X(glPointSize, GL_CALLS_STATE) \
+	X(glEnable, GL_CALLS_STATE) \
+	X(glDisable, GL_CALLS_STATE) \
+	X(glDepthFunc, GL_CALLS_STATE) \
+	X(glDepthMask, GL_CALLS_STATE) \
+	X(glColorMask, GL_CALLS_STATE) \
+	X(glBlendFunc, GL_CALLS_STATE) \
+	X(glFrontFace, GL_CALLS_STATE) \
+	X(glPixelStorei, GL_CALLS_STATE) \
+	X(glDrawBuffers, GL_CALLS_STATE) \
+	X(glReadBuffer, GL_CALLS_STATE) \
+	X(glBeginQuery, GL_CALLS_STATE) \
+	X(glEndQuery, GL_CALLS_STATE) \
+	X(glBufferSubData, GL_CALLS_UPLOAD) \
+	X(glMapBufferRange, GL_CALLS_UPLOAD) \
+	X(glUnmapBuffer, GL_CALLS_UPLOAD) \
+	X(glTexBuffer, GL_CALLS_UPLOAD) \
+	X(glReadPixels, GL_CALLS_UPLOAD) \
+	X(glShaderSource, GL_CALLS_OBJECT) \
+	X(glCompileShader, GL_CALLS_OBJECT) \
+	X(glAttachShader, GL_CALLS_OBJECT) \
+	X(glLinkProgram, GL_CALLS_OBJECT) \
+	X(glFramebufferRenderbuffer, GL_CALLS_OBJECT) \
+	X(glGetIntegerv, GL_CALLS_QUERY) \
+	X(glGetString, GL_CALLS_QUERY) \
+	X(glGetUniformLocation, GL_CALLS_QUERY) \
+	X(glGetUniformBlockIndex, GL_CALLS_QUERY) \
+	X(glGetProgramiv, GL_CALLS_QUERY) \
+	X(glGetProgramInfoLog, GL_CALLS_QUERY) \
+	X(glGetShaderiv, GL_CALLS_QUERY) \
+	X(glGetShaderInfoLog, GL_CALLS_QUERY) \
+	X(glCheckFramebufferStatus, GL_CALLS_QUERY) \
+	X(glGetQueryObjectuiv, GL_CALLS_QUERY) \
+	X(glGetQueryObjectui64v, GL_CALLS_QUERY) \
+	X(glClientWaitSync, GL_CALLS_QUERY) \
+	X(glFinish, GL_CALLS_QUERY)
+
+/* The calls with their own wrappers below, which are counted as well */
+#define TRACKED_CALLS(X) \
+	X(glDrawArrays, GL_CALLS_DRAW) \
+	X(glDrawElements, GL_CALLS_DRAW) \
+	X(glDrawElementsBaseVertex, GL_CALLS_DRAW) \
+	X(glMultiDrawElements, GL_CALLS_DRAW) \
+	X(glBindBuffer, GL_CALLS_BIND) \
+	X(glBindBufferBase, GL_CALLS_BIND) \
+	X(glBindBufferRange, GL_CALLS_BIND) \
+	X(glActiveTexture, GL_CALLS_BIND) \
+	X(glBindTexture, GL_CALLS_BIND) \
+	X(glBindVertexArray, GL_CALLS_BIND) \
+	X(glBindRenderbuffer, GL_CALLS_BIND) \
+	X(glBufferData, GL_CALLS_UPLOAD) \
+	X(glTexImage2D, GL_CALLS_UPLOAD) \
+	X(glGenerateMipmap, GL_CALLS_UPLOAD) \
+	X(glRenderbufferStorage, GL_CALLS_UPLOAD) \
+	X(glGenBuffers, GL_CALLS_OBJECT) \
+	X(glDeleteBuffers, GL_CALLS_OBJECT) \
+	X(glGenTextures, GL_CALLS_OBJECT) \
+	X(glDeleteTextures, GL_CALLS_OBJECT) \
+	X(glGenRenderbuffers, GL_CALLS_OBJECT) \
+	X(glDeleteRenderbuffers, GL_CALLS_OBJECT) \
+	X(glGenFramebuffers, GL_CALLS_OBJECT) \
+	X(glDeleteFramebuffers, GL_CALLS_OBJECT) \
+	X(glFramebufferTexture2D, GL_CALLS_OBJECT) \
+	X(glGenVertexArrays, GL_CALLS_OBJECT) \
+	X(glDeleteVertexArrays, GL_CALLS_OBJECT) \
+	X(glCreateProgram, GL_CALLS_OBJECT) \
+	X(glDeleteProgram, GL_CALLS_OBJECT) \
+	X(glCreateShader, GL_CALLS_OBJECT) \
+	X(glDeleteShader, GL_CALLS_OBJECT) \
+	X(glGenQueries, GL_CALLS_OBJECT) \
+	X(glDeleteQueries, GL_CALLS_OBJECT) \
+	X(glFenceSync, GL_CALLS_OBJECT) \
+	X(glDeleteSync, GL_CALLS_OBJECT)
+
+enum CallIndex
+{
+#define CALL_INDEX(name, category) CALL_##name,
+	COUNTED_CALLS(CALL_INDEX)
+	TRACKED_CALLS(CALL_INDEX)
+#undef CALL_INDEX
+	CALL_COUNT
+};
+
+static const char *callNames[CALL_COUNT] =
+{
+#define CALL_NAME(name, category) #name,
+	COUNTED_CALLS(CALL_NAME)
+	TRACKED_CALLS(CALL_NAME)
+#undef CALL_NAME
+};
+
+static const GLCallCategory callCategories[CALL_COUNT] =
+{
+#define CALL_CATEGORY(name, category) category,
+	COUNTED_CALLS(CALL_CATEGORY)
+	TRACKED_CALLS(CALL_CATEGORY)
+#undef CALL_CATEGORY
+};
+
+static const char *callCategoryNames[GL_CALL_CATEGORIES] = { "draw", "uniform", "bind", "state", "upload", "object", "query" };
+static const char *memoryCategoryNames[GL_MEMORY_CATEGORIES] = { "vertex", "index", "texture", "framebuffer", "other" };
+static const char *objectKindNames[GL_OBJECT_KINDS] = { "buffers", "textures", "renderbuffers", "framebuffers",
+	"vertex arrays", "programs", "shaders", "queries", "fences" };
+
+/* The calls are counted from every thread without a lock */
+static atomic<unsigned int> callCounts[CALL_COUNT];
+static atomic<unsigned long long> verticesDrawn;
+
+static inline void countCall(int call)
+{
+	callCounts[call].fetch_add(1, memory_order_relaxed);
+}
+
+/* An object that is alive. Only buffers, textures and renderbuffers hold memory */
+struct ObjectRecord
+{
+	size_t bytes;
+	GLMemoryCategory category;
+	map<int, size_t> levels;		// of a texture, by face * 64 + level
+	bool mipmapped;					// a texture that had its mipmaps generated
+	bool renderTarget;				// a texture attached to a framebuffer
+
+	ObjectRecord() : bytes(0), category(GL_MEMORY_OTHER), mipmapped(false), renderTarget(false) {}
+};
+
+/* Objects are shared between contexts, so they are kept for every thread under the lock */
+static mutex objectLock;
+static map<size_t, ObjectRecord> objects[GL_OBJECT_KINDS];
+static size_t created, deleted;
+static bool installed;
+static GLAccountingFrame last;
+static unsigned int frameNumber;
+
+/* What is bound is part of each context, so it is followed for each thread */
+struct BindingState
+{
+	GLuint activeUnit;
+	GLuint vertexArray;
+	GLuint renderbuffer;
+	map<GLenum, GLuint> buffers;					// by target
+	map<pair<GLuint, GLenum>, GLuint> textures;		// by unit and target
+	map<GLuint, GLuint> elementBuffers;				// of each vertex array, which binds its own
+
+	BindingState() : activeUnit(0), vertexArray(0), renderbuffer(0) {}
+};
+
+static thread_local BindingState bound;
+
+/* Bytes for each texel of an internal format. Three channel 8 bit formats are padded to four
+   by the drivers, so they are counted as four like the other 32 bit formats */
+static size_t texelBytes(GLint internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_RED: case GL_R8: case GL_STENCIL_INDEX8:
+		return 1;
+	case GL_RG: case GL_RG8: case GL_R16: case GL_R16F: case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGBA16: case GL_RGB16F: case GL_RGBA16F: case GL_RG32F:
+		return 8;
+	case GL_RGB32F: case GL_RGBA32F: case GL_RGB32UI: case GL_RGBA32UI:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+static void addObjects(GLObjectKind kind, GLsizei n, const GLuint *names)
+{
+	lock_guard<mutex> guard(objectLock);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (names[i] == 0) continue;
+		ObjectRecord &record = objects[kind][names[i]];
+		record = ObjectRecord();
+		if (kind == GL_OBJECT_TEXTURE) record.category = GL_MEMORY_TEXTURE;
+		if (kind == GL_OBJECT_RENDERBUFFER) record.category = GL_MEMORY_FRAMEBUFFER;
+		created++;
+	}
+}
+
+static void removeObjects(GLObjectKind kind, GLsizei n, const GLuint *names)
+{
+	lock_guard<mutex> guard(objectLock);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (names[i] != 0) deleted += objects[kind].erase(names[i]);
+	}
+}
+
+/* Sum a texture's levels, with a third more for generated mipmaps */
+static void updateTextureBytes(ObjectRecord &record)
+{
+	size_t bytes = 0, base = 0;
+	for (map<int, size_t>::const_iterator l = record.levels.begin(); l != record.levels.end(); ++l)
+	{
+		bytes += l->second;
+		if (l->first % 64 == 0) base += l->second;
+	}
+	record.bytes = record.mipmapped ? std::max(bytes, base + base / 3) : bytes;
+	record.category = record.renderTarget ? GL_MEMORY_FRAMEBUFFER : GL_MEMORY_TEXTURE;
+}
+
+static GLuint boundBuffer(GLenum target)
+{
+	map<GLenum, GLuint>::const_iterator found = bound.buffers.find(target);
+	return found == bound.buffers.end() ? 0 : found->second;
+}
+
+static GLuint boundTexture(GLenum target)
+{
+	map<pair<GLuint, GLenum>, GLuint>::const_iterator found = bound.textures.find(make_pair(bound.activeUnit, target));
+	return found == bound.textures.end() ? 0 : found->second;
+}
+
+/* The driver's functions, for the calls with their own wrappers */
+#define REAL_POINTER(name, category) static decltype(_funcptr_##name) real_##name;
+TRACKED_CALLS(REAL_POINTER)
+#undef REAL_POINTER
+
+/* The wrapper for a call that is only counted, made from the type of its pointer */
+template <int call, typename F> struct CountedCall;
+
+template <int call, typename R, typename... A>
+struct CountedCall<call, R (CODEGEN_FUNCPTR *)(A...)>
+{
+	static R (CODEGEN_FUNCPTR *real)(A...);
+
+	static R CODEGEN_FUNCPTR hook(A... args)
+	{
+		countCall(call);
+		return real(args...);
+	}
+};
+
+template <int call, typename R, typename... A>
+R (CODEGEN_FUNCPTR *CountedCall<call, R (CODEGEN_FUNCPTR *)(A...)>::real)(A...) = 0;
+
+/* Draws */
+
+static void CODEGEN_FUNCPTR track_glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	countCall(CALL_glDrawArrays);
+	verticesDrawn.fetch_add(count, memory_order_relaxed);
+	real_glDrawArrays(mode, first, count);
+}
+
+static void CODEGEN_FUNCPTR track_glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+	countCall(CALL_glDrawElements);
+	verticesDrawn.fetch_add(count, memory_order_relaxed);
+	real_glDrawElements(mode, count, type, indices);
+}
+
+static void CODEGEN_FUNCPTR track_glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLint basevertex)
+{
+	countCall(CALL_glDrawElementsBaseVertex);
+	verticesDrawn.fetch_add(count, memory_order_relaxed);
+	real_glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+}
+
+static void CODEGEN_FUNCPTR track_glMultiDrawElements(GLenum mode, const GLsizei *count, GLenum type, const GLvoid *const *indices, GLsizei drawcount)
+{
+	countCall(CALL_glMultiDrawElements);
+	unsigned long long total = 0;
+	for (GLsizei i = 0; i < drawcount; i++) total += count[i];
+	verticesDrawn.fetch_add(total, memory_order_relaxed);
+	real_glMultiDrawElements(mode, count, type, indices, drawcount);
+}
+
+/* Bindings */
+
+static void CODEGEN_FUNCPTR track_glBindBuffer(GLenum target, GLuint buffer)
+{
+	countCall(CALL_glBindBuffer);
+	bound.buffers[target] = buffer;
+	if (target == GL_ELEMENT_ARRAY_BUFFER) bound.elementBuffers[bound.vertexArray] = buffer;
+	real_glBindBuffer(target, buffer);
+}
+
+static void CODEGEN_FUNCPTR track_glBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	countCall(CALL_glBindBufferBase);
+	bound.buffers[target] = buffer;
+	real_glBindBufferBase(target, index, buffer);
+}
+
+static void CODEGEN_FUNCPTR track_glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	countCall(CALL_glBindBufferRange);
+	bound.buffers[target] = buffer;
+	real_glBindBufferRange(target, index, buffer, offset, size);
+}
+
+static void CODEGEN_FUNCPTR track_glActiveTexture(GLenum texture)
+{
+	countCall(CALL_glActiveTexture);
+	bound.activeUnit = texture - GL_TEXTURE0;
+	real_glActiveTexture(texture);
+}
+
+static void CODEGEN_FUNCPTR track_glBindTexture(GLenum target, GLuint texture)
+{
+	countCall(CALL_glBindTexture);
+	bound.textures[make_pair(bound.activeUnit, target)] = texture;
+	real_glBindTexture(target, texture);
+}
+
+/* A vertex array brings its own element buffer binding with it */
+static void CODEGEN_FUNCPTR track_glBindVertexArray(GLuint ren_array)
+{
+	countCall(CALL_glBindVertexArray);
+	bound.vertexArray = ren_array;
+	bound.buffers[GL_ELEMENT_ARRAY_BUFFER] = bound.elementBuffers[ren_array];
+	real_glBindVertexArray(ren_array);
+}
+
+static void CODEGEN_FUNCPTR track_glBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+	countCall(CALL_glBindRenderbuffer);
+	bound.renderbuffer = renderbuffer;
+	real_glBindRenderbuffer(target, renderbuffer);
+}
+
+/* Storage */
+
+static void CODEGEN_FUNCPTR track_glBufferData(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage)
+{
+	countCall(CALL_glBufferData);
+	real_glBufferData(target, size, data, usage);
+
+	GLuint buffer = boundBuffer(target);
+	lock_guard<mutex> guard(objectLock);
+	map<size_t, ObjectRecord>::iterator found = objects[GL_OBJECT_BUFFER].find(buffer);
+	if (found == objects[GL_OBJECT_BUFFER].end()) return;
+	found->second.bytes = (size_t)size;
+	found->second.category = (target == GL_ARRAY_BUFFER) ? GL_MEMORY_VERTEX : (target == GL_ELEMENT_ARRAY_BUFFER) ? GL_MEMORY_INDEX : GL_MEMORY_OTHER;
+}
+
+static void CODEGEN_FUNCPTR track_glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+	GLint border, GLenum format, GLenum type, const GLvoid *pixels)
+{
+	countCall(CALL_glTexImage2D);
+	real_glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+
+	// Each face of a cube map is given its own levels
+	int face = 0;
+	if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+	{
+		face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+		target = GL_TEXTURE_CUBE_MAP;
+	}
+	GLuint texture = boundTexture(target);
+	lock_guard<mutex> guard(objectLock);
+	map<size_t, ObjectRecord>::iterator found = objects[GL_OBJECT_TEXTURE].find(texture);
+	if (found == objects[GL_OBJECT_TEXTURE].end()) return;
+	found->second.levels[face * 64 + level] = (size_t)width * height * texelBytes(internalformat);
+	updateTextureBytes(found->second);
+}
+
+static void CODEGEN_FUNCPTR track_glGenerateMipmap(GLenum target)
+{
+	countCall(CALL_glGenerateMipmap);
+	real_glGenerateMipmap(target);
+
+	GLuint texture = boundTexture(target);
+	lock_guard<mutex> guard(objectLock);
+	map<size_t, ObjectRecord>::iterator found = objects[GL_OBJECT_TEXTURE].find(texture);
+	if (found == objects[GL_OBJECT_TEXTURE].end()) return;
+	found->second.mipmapped = true;
+	updateTextureBytes(found->second);
+}
+
+static void CODEGEN_FUNCPTR track_glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+{
+	countCall(CALL_glRenderbufferStorage);
+	real_glRenderbufferStorage(target, internalformat, width, height);
+
+	lock_guard<mutex> guard(objectLock);
+	map<size_t, ObjectRecord>::iterator found = objects[GL_OBJECT_RENDERBUFFER].find(bound.renderbuffer);
+	if (found != objects[GL_OBJECT_RENDERBUFFER].end()) found->second.bytes = (size_t)width * height * texelBytes(internalformat);
+}
+
+static void CODEGEN_FUNCPTR track_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+{
+	countCall(CALL_glFramebufferTexture2D);
+	real_glFramebufferTexture2D(target, attachment, textarget, texture, level);
+
+	lock_guard<mutex> guard(objectLock);
+	map<size_t, ObjectRecord>::iterator found = objects[GL_OBJECT_TEXTURE].find(texture);
+	if (found == objects[GL_OBJECT_TEXTURE].end()) return;
+	found->second.renderTarget = true;
+	updateTextureBytes(found->second);
+}
+
+/* Making and deleting objects */
+
+static void CODEGEN_FUNCPTR track_glGenBuffers(GLsizei n, GLuint *buffers)
+{
+	countCall(CALL_glGenBuffers);
+	real_glGenBuffers(n, buffers);
+	addObjects(GL_OBJECT_BUFFER, n, buffers);
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+	countCall(CALL_glDeleteBuffers);
+	removeObjects(GL_OBJECT_BUFFER, n, buffers);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		for (map<GLenum, GLuint>::iterator b = bound.buffers.begin(); b != bound.buffers.end(); ++b) if (b->second == buffers[i]) b->second = 0;
+	}
+	real_glDeleteBuffers(n, buffers);
+}
+
+static void CODEGEN_FUNCPTR track_glGenTextures(GLsizei n, GLuint *textures)
+{
+	countCall(CALL_glGenTextures);
+	real_glGenTextures(n, textures);
+	addObjects(GL_OBJECT_TEXTURE, n, textures);
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteTextures(GLsizei n, const GLuint *textures)
+{
+	countCall(CALL_glDeleteTextures);
+	removeObjects(GL_OBJECT_TEXTURE, n, textures);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		for (map<pair<GLuint, GLenum>, GLuint>::iterator t = bound.textures.begin(); t != bound.textures.end(); ++t) if (t->second == textures[i]) t->second = 0;
+	}
+	real_glDeleteTextures(n, textures);
+}
+
+static void CODEGEN_FUNCPTR track_glGenRenderbuffers(GLsizei n, GLuint *renderbuffers)
+{
+	countCall(CALL_glGenRenderbuffers);
+	real_glGenRenderbuffers(n, renderbuffers);
+	addObjects(GL_OBJECT_RENDERBUFFER, n, renderbuffers);
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers)
+{
+	countCall(CALL_glDeleteRenderbuffers);
+	removeObjects(GL_OBJECT_RENDERBUFFER, n, renderbuffers);
+	real_glDeleteRenderbuffers(n, renderbuffers);
+}
+
+static void CODEGEN_FUNCPTR track_glGenFramebuffers(GLsizei n, GLuint *framebuffers)
+{
+	countCall(CALL_glGenFramebuffers);
+	real_glGenFramebuffers(n, framebuffers);
+	addObjects(GL_OBJECT_FRAMEBUFFER, n, framebuffers);
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
+{
+	countCall(CALL_glDeleteFramebuffers);
+	removeObjects(GL_OBJECT_FRAMEBUFFER, n, framebuffers);
+	real_glDeleteFramebuffers(n, framebuffers);
+}
+
+static void CODEGEN_FUNCPTR track_glGenVertexArrays(GLsizei n, GLuint *arrays)
+{
+	countCall(CALL_glGenVertexArrays);
+	real_glGenVertexArrays(n, arrays);
+	addObjects(GL_OBJECT_VERTEX_ARRAY, n, arrays);
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+	countCall(CALL_glDeleteVertexArrays);
+	removeObjects(GL_OBJECT_VERTEX_ARRAY, n, arrays);
+	for (GLsizei i = 0; i < n; i++)
+	{
+		bound.elementBuffers.erase(arrays[i]);
+		if (arrays[i] == bound.vertexArray) bound.vertexArray = 0;
+	}
+	real_glDeleteVertexArrays(n, arrays);
+}
+
+static void CODEGEN_FUNCPTR track_glGenQueries(GLsizei n, GLuint *ids)
+{
+	countCall(CALL_glGenQueries);
+	real_glGenQueries(n, ids);
+	addObjects(GL_OBJECT_QUERY, n, ids);
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteQueries(GLsizei n, const GLuint *ids)
+{
+	countCall(CALL_glDeleteQueries);
+	removeObjects(GL_OBJECT_QUERY, n, ids);
+	real_glDeleteQueries(n, ids);
+}
+
+static GLuint CODEGEN_FUNCPTR track_glCreateProgram()
+{
+	countCall(CALL_glCreateProgram);
+	GLuint program = real_glCreateProgram();
+	addObjects(GL_OBJECT_PROGRAM, 1, &program);
+	return program;
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteProgram(GLuint program)
+{
+	countCall(CALL_glDeleteProgram);
+	removeObjects(GL_OBJECT_PROGRAM, 1, &program);
+	real_glDeleteProgram(program);
+}
+
+static GLuint CODEGEN_FUNCPTR track_glCreateShader(GLenum type)
+{
+	countCall(CALL_glCreateShader);
+	GLuint shader = real_glCreateShader(type);
+	addObjects(GL_OBJECT_SHADER, 1, &shader);
+	return shader;
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteShader(GLuint shader)
+{
+	countCall(CALL_glDeleteShader);
+	removeObjects(GL_OBJECT_SHADER, 1, &shader);
+	real_glDeleteShader(shader);
+}
+
+static GLsync CODEGEN_FUNCPTR track_glFenceSync(GLenum condition, GLbitfield flags)
+{
+	countCall(CALL_glFenceSync);
+	GLsync sync = real_glFenceSync(condition, flags);
+	if (sync)
+	{
+		lock_guard<mutex> guard(objectLock);
+		objects[GL_OBJECT_SYNC][(size_t)sync] = ObjectRecord();
+		created++;
+	}
+	return sync;
+}
+
+static void CODEGEN_FUNCPTR track_glDeleteSync(GLsync sync)
+{
+	countCall(CALL_glDeleteSync);
+	{
+		lock_guard<mutex> guard(objectLock);
+		deleted += objects[GL_OBJECT_SYNC].erase((size_t)sync);
+	}
+	real_glDeleteSync(sync);
+}
+
+/* Swap each pointer that isn't already swapped, so that calling this again after
+   ogl_LoadFunctions() picks up the driver's new pointers */
+void installGLAccounting()
+{
+#define INSTALL_COUNTED(name, category) \
+	if (_funcptr_##name && _funcptr_##name != &CountedCall<CALL_##name, decltype(_funcptr_##name)>::hook) \
+	{ \
+		CountedCall<CALL_##name, decltype(_funcptr_##name)>::real = _funcptr_##name; \
+		_funcptr_##name = &CountedCall<CALL_##name, decltype(_funcptr_##name)>::hook; \
+	}
+#define INSTALL_TRACKED(name, category) \
+	if (_funcptr_##name && _funcptr_##name != &track_##name) \
+	{ \
+		real_##name = _funcptr_##name; \
+		_funcptr_##name = &track_##name; \
+	}
+	COUNTED_CALLS(INSTALL_COUNTED)
+	TRACKED_CALLS(INSTALL_TRACKED)
+#undef INSTALL_COUNTED
+#undef INSTALL_TRACKED
+
+	lock_guard<mutex> guard(objectLock);
+	installed = true;
+}
+
+bool glAccountingInstalled()
+{
+	lock_guard<mutex> guard(objectLock);
+	return installed;
+}
+
+void endGLAccountingFrame()
+{
+	GLAccountingFrame frame;
+	frame.totalCalls = 0;
+	for (int c = 0; c < GL_CALL_CATEGORIES; c++) frame.calls[c] = 0;
+	for (int call = 0; call < CALL_COUNT; call++)
+	{
+		unsigned int count = callCounts[call].exchange(0, memory_order_relaxed);
+		if (count == 0) continue;
+		frame.calls[callCategories[call]] += count;
+		frame.totalCalls += count;
+		frame.functions.push_back(make_pair(callNames[call], count));
+	}
+	sort(frame.functions.begin(), frame.functions.end(),
+		[](const pair<const char*, unsigned int> &a, const pair<const char*, unsigned int> &b) { return a.second > b.second; });
+	frame.vertices = verticesDrawn.exchange(0, memory_order_relaxed);
+
+	lock_guard<mutex> guard(objectLock);
+	frame.frame = frameNumber++;
+	frame.created = created;
+	frame.deleted = deleted;
+	created = deleted = 0;
+
+	frame.totalBytes = 0;
+	for (int m = 0; m < GL_MEMORY_CATEGORIES; m++) frame.bytes[m] = 0;
+	for (int kind = 0; kind < GL_OBJECT_KINDS; kind++)
+	{
+		frame.objects[kind] = objects[kind].size();
+		for (map<size_t, ObjectRecord>::const_iterator o = objects[kind].begin(); o != objects[kind].end(); ++o)
+		{
+			frame.bytes[o->second.category] += o->second.bytes;
+			frame.totalBytes += o->second.bytes;
+		}
+	}
+	last = frame;
+}
+
+GLAccountingFrame lastGLAccountingFrame()
+{
+	lock_guard<mutex> guard(objectLock);
+	return last;
+}
+
+static double megabytes(size_t bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+void printGLAccountingFrame(const GLAccountingFrame &frame, ostream &out)
+{
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(1);
+
+	out << "GL frame " << frame.frame << ": " << frame.totalCalls << " calls (";
+	for (int c = 0; c < GL_CALL_CATEGORIES; c++) out << (c > 0 ? ", " : "") << callCategoryNames[c] << " " << frame.calls[c];
+	out << "), " << frame.vertices << " vertices drawn" << endl;
+
+	out << "  busiest:";
+	for (size_t f = 0; f < frame.functions.size() && f < 6; f++) out << " " << frame.functions[f].first << " " << frame.functions[f].second;
+	out << endl;
+
+	out << "  alive:";
+	for (int kind = 0; kind < GL_OBJECT_KINDS; kind++) out << (kind > 0 ? ", " : " ") << frame.objects[kind] << " " << objectKindNames[kind];
+	out << " (" << frame.created << " made and " << frame.deleted << " deleted this frame)" << endl;
+
+	out << "  memory:";
+	for (int m = 0; m < GL_MEMORY_CATEGORIES; m++) out << (m > 0 ? ", " : " ") << memoryCategoryNames[m] << " " << megabytes(frame.bytes[m]) << " MB";
+	out << ", " << megabytes(frame.totalBytes) << " MB in all" << endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+size_t reportGLLeaks(ostream &out)
+{
+	struct Alive
+	{
+		int kind;
+		size_t name, bytes;
+		GLMemoryCategory category;
+	};
+	vector<Alive> alive;
+	{
+		lock_guard<mutex> guard(objectLock);
+		for (int kind = 0; kind < GL_OBJECT_KINDS; kind++)
+		{
+			for (map<size_t, ObjectRecord>::const_iterator o = objects[kind].begin(); o != objects[kind].end(); ++o)
+			{
+				Alive a = { kind, o->first, o->second.bytes, o->second.category };
+				alive.push_back(a);
+			}
+		}
+	}
+	if (alive.empty())
+	{
+		out << "No OpenGL objects were left alive" << endl;
+		return 0;
+	}
+	stable_sort(alive.begin(), alive.end(), [](const Alive &a, const Alive &b) { return a.bytes > b.bytes; });
+
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(2);
+
+	size_t counts[GL_OBJECT_KINDS] = {}, bytes[GL_OBJECT_KINDS] = {}, total = 0;
+	for (size_t i = 0; i < alive.size(); i++)
+	{
+		counts[alive[i].kind]++;
+		bytes[alive[i].kind] += alive[i].bytes;
+		total += alive[i].bytes;
+	}
+	out << alive.size() << " OpenGL objects left alive, holding about " << megabytes(total) << " MB:" << endl;
+	for (int kind = 0; kind < GL_OBJECT_KINDS; kind++)
+	{
+		if (counts[kind] == 0) continue;
+		out << "  " << left << setw(14) << objectKindNames[kind] << right << setw(6) << counts[kind];
+		if (bytes[kind] > 0) out << setw(10) << megabytes(bytes[kind]) << " MB";
+		out << endl;
+	}
+
+	// The ones holding memory, largest first, then just the names of the rest
+	const size_t listed = 20;
+	size_t holding = 0;
+	while (holding < alive.size() && alive[holding].bytes > 0) holding++;
+	for (size_t i = 0; i < holding && i < listed; i++)
+	{
+		string name = objectKindNames[alive[i].kind];
+		name = name.substr(0, name.size() - 1) + " " + to_string(alive[i].name);
+		out << "    " << left << setw(20) << name << right << setw(10) << megabytes(alive[i].bytes) << " MB "
+			<< memoryCategoryNames[alive[i].category] << endl;
+	}
+	if (holding > listed) out << "    and " << holding - listed << " more holding memory" << endl;
+	for (int kind = 0; kind < GL_OBJECT_KINDS; kind++)
+	{
+		string names;
+		for (size_t i = holding; i < alive.size(); i++)
+		{
+			if (alive[i].kind == kind && kind != GL_OBJECT_SYNC) names += " " + to_string(alive[i].name);
+		}
+		if (!names.empty()) out << "    " << objectKindNames[kind] << ":" << names << endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+	return alive.size();
+}
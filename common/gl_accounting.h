@@ -0,0 +1,89 @@
+/* gl_accounting.h
+ Counts the OpenGL calls made each frame and keeps track of the objects that are alive:
+ buffers, textures, renderbuffers, framebuffers, vertex arrays, programs, shaders, queries and
+ fences, with an estimate of the video memory the buffers, textures and renderbuffers hold.
+ The gl* names are macros for glload's function pointers (_funcptr_glGenBuffers and so on),
+ so installGLAccounting() swaps those pointers for ones that count and then call the driver.
+ Every call in common/, the loaders and the examples is seen without changing any of them,
+ and nothing is swapped, so nothing is slower, until it is installed.
+ Call it after ogl_LoadFunctions(), and again after any later ogl_LoadFunctions(), which puts
+ the driver's pointers back. GLWrapper::enableAccounting() does it and ends each frame.
+ The memory is an estimate: each texture level is counted at the size of its internal format,
+ with three channel formats padded to four as drivers store them, and generated mipmaps add a
+ third. Buffers are counted by the target they were last given data on, so vertex and index
+ buffers are told apart, and textures attached to a framebuffer count as framebuffer memory.
+ Bindings are followed for each thread, as each thread has its own context here.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include <vector>
+#include <utility>
+#include <ostream>
+
+enum GLCallCategory
+{
+	GL_CALLS_DRAW,			// draws and clears
+	GL_CALLS_UNIFORM,
+	GL_CALLS_BIND,			// binding buffers, textures, vertex arrays, framebuffers and programs
+	GL_CALLS_STATE,			// the rest of the state: enables, attribute pointers, parameters
+	GL_CALLS_UPLOAD,		// giving objects data, or reading it back
+	GL_CALLS_OBJECT,		// making, building and deleting objects
+	GL_CALLS_QUERY,			// gets and waits, which can stall
+	GL_CALL_CATEGORIES
+};
+
+enum GLMemoryCategory
+{
+	GL_MEMORY_VERTEX,
+	GL_MEMORY_INDEX,
+	GL_MEMORY_TEXTURE,
+	GL_MEMORY_FRAMEBUFFER,	// renderbuffers and textures attached to framebuffers
+	GL_MEMORY_OTHER,		// uniform, texture and pixel buffers
+	GL_MEMORY_CATEGORIES
+};
+
+enum GLObjectKind
+{
+	GL_OBJECT_BUFFER,
+	GL_OBJECT_TEXTURE,
+	GL_OBJECT_RENDERBUFFER,
+	GL_OBJECT_FRAMEBUFFER,
+	GL_OBJECT_VERTEX_ARRAY,
+	GL_OBJECT_PROGRAM,
+	GL_OBJECT_SHADER,
+	GL_OBJECT_QUERY,
+	GL_OBJECT_SYNC,
+	GL_OBJECT_KINDS
+};
+
+/* What one frame did and what was alive at the end of it */
+struct GLAccountingFrame
+{
+	unsigned int frame;								// counted from 0 when accounting was installed
+	unsigned int calls[GL_CALL_CATEGORIES];
+	unsigned int totalCalls;
+	unsigned long long vertices;					// vertices, or indices, that were drawn
+	std::vector<std::pair<const char*, unsigned int> > functions;	// each function called, the most called first
+
+	size_t objects[GL_OBJECT_KINDS];
+	size_t created, deleted;						// objects of every kind made and deleted in the frame
+	size_t bytes[GL_MEMORY_CATEGORIES];
+	size_t totalBytes;
+};
+
+void installGLAccounting();
+bool glAccountingInstalled();
+
+/* Close the frame, once a frame after the swap, and start counting the next */
+void endGLAccountingFrame();
+
+/* The last frame that was ended */
+GLAccountingFrame lastGLAccountingFrame();
+
+void printGLAccountingFrame(const GLAccountingFrame &frame, std::ostream &out);
+
+/* List every object that is still alive, the largest first, and the memory they hold. At exit
+   these are the objects nothing deleted. Returns the number of objects */
+size_t reportGLLeaks(std::ostream &out);
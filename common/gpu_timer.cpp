@@ -0,0 +1,150 @@
+/* gpu_timer.cpp
+ GPU pass timing with a ring of query objects.
+*/
+
+#include "gpu_timer.h"
+
+using namespace std;
+
+GpuTimer::GpuTimer()
+{
+	frameIndex = 0;
+	timing = false;
+}
+
+GpuTimer::~GpuTimer()
+{
+}
+
+/* The results of a frame are read framesInFlight - 1 frames after it was timed */
+void GpuTimer::makeTimer(GLuint framesInFlight)
+{
+	frames.resize(framesInFlight > 1 ? framesInFlight : 2);
+	frameIndex = 0;
+}
+
+/* Add a pass and return the number to begin() it with */
+GLuint GpuTimer::addPass(const char* name)
+{
+	Pass pass;
+	pass.name = name;
+	pass.total = 0;
+	pass.samples = 0;
+	passes.push_back(pass);
+	return (GLuint)passes.size() - 1;
+}
+
+/* Move on to the next frame of queries, reading back the results of the frame that used them before */
+void GpuTimer::beginFrame()
+{
+	frameIndex = (frameIndex + 1) % frames.size();
+	collectLate();
+	collect(frames[frameIndex]);
+}
+
+/* Read the results of a frame that are available. Asking for one that isn't would wait for the
+   GPU, so a query that is still running is set aside for collectLate() and the pass gets a new one */
+void GpuTimer::collect(Frame &frame)
+{
+	for (size_t p = 0; p < frame.timed.size(); p++)
+	{
+		if (!frame.timed[p]) continue;
+		frame.timed[p] = false;
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(frame.queries[p], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			Late pending = { frame.queries[p], (GLuint)p };
+			late.push_back(pending);
+			frame.queries[p] = 0;
+			continue;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(frame.queries[p], GL_QUERY_RESULT, &elapsed);
+		passes[p].total += (double)elapsed;
+		passes[p].samples++;
+	}
+}
+
+/* Read the results that were set aside once they are available, and free their queries */
+void GpuTimer::collectLate()
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < late.size(); i++)
+	{
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(late[i].query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			late[kept++] = late[i];
+			continue;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(late[i].query, GL_QUERY_RESULT, &elapsed);
+		passes[late[i].pass].total += (double)elapsed;
+		passes[late[i].pass].samples++;
+		spare.push_back(late[i].query);
+	}
+	late.resize(kept);
+}
+
+void GpuTimer::begin(GLuint pass)
+{
+	Frame &frame = frames[frameIndex];
+	if (frame.queries.size() < passes.size())
+	{
+		frame.queries.resize(passes.size(), 0);
+		frame.timed.resize(passes.size(), false);
+	}
+	if (frame.queries[pass] == 0)
+	{
+		if (spare.empty())
+		{
+			glGenQueries(1, &frame.queries[pass]);
+		}
+		else
+		{
+			frame.queries[pass] = spare.back();
+			spare.pop_back();
+		}
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, frame.queries[pass]);
+	frame.timed[pass] = true;
+	timing = true;
+}
+
+void GpuTimer::end()
+{
+	if (!timing) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	timing = false;
+}
+
+double GpuTimer::average(GLuint pass) const
+{
+	const Pass &p = passes[pass];
+	return p.samples ? p.total / p.samples / 1000000.0 : 0.0;
+}
+
+/* Start the averages again, for example after switching between ways of drawing the frame.
+   Results that are still on their way belong to the old averages, so they are dropped */
+void GpuTimer::reset()
+{
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		passes[p].total = 0;
+		passes[p].samples = 0;
+	}
+	for (size_t f = 0; f < frames.size(); f++)
+	{
+		frames[f].timed.assign(frames[f].timed.size(), false);
+	}
+
+	// Beginning a query again drops the result it had coming, so late ones can be used straight away
+	for (size_t i = 0; i < late.size(); i++) spare.push_back(late[i].query);
+	late.clear();
+}
@@ -0,0 +1,63 @@
+/* gpu_timer.h
+ Times passes of a frame on the GPU with GL_TIME_ELAPSED queries. The queries of a frame are
+ only read back several frames later, when the GPU has usually finished them, and a result that
+ still isn't available then is set aside and picked up at a later frame while the pass gets
+ another query, so that timing never makes the CPU wait for the GPU. Each pass's times are
+ averaged until reset().
+ Passes can't overlap: end() one before begin()ning the next.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include <string>
+#include <vector>
+
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	void makeTimer(GLuint framesInFlight = 4);
+	GLuint addPass(const char* name);
+
+	void beginFrame();
+	void begin(GLuint pass);
+	void end();
+
+	double average(GLuint pass) const;		// milliseconds, or 0 if the pass hasn't been timed since reset()
+	GLuint samples(GLuint pass) const { return passes[pass].samples; }
+	const std::string &name(GLuint pass) const { return passes[pass].name; }
+	void reset();
+
+private:
+	struct Pass
+	{
+		std::string name;
+		double total;			// nanoseconds
+		GLuint samples;
+	};
+
+	struct Frame
+	{
+		std::vector<GLuint> queries;		// one for each pass, made the first time it is timed
+		std::vector<bool> timed;
+	};
+
+	// A query whose result wasn't back when its frame came round again
+	struct Late
+	{
+		GLuint query, pass;
+	};
+
+	void collect(Frame &frame);
+	void collectLate();
+
+	std::vector<Pass> passes;
+	std::vector<Frame> frames;
+	std::vector<Late> late;
+	std::vector<GLuint> spare;		// queries that are free to use again
+	GLuint frameIndex;
+	bool timing;
+};
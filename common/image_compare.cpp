@@ -0,0 +1,103 @@
+/* image_compare.cpp
+ Perceptual image comparison in CIE L*a*b*.
+*/
+
+#include "image_compare.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+/* The sRGB transfer curve undone, for each 8 bit value */
+struct LinearTable
+{
+	float values[256];
+
+	LinearTable()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.f;
+			values[i] = (c <= 0.04045f) ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+	}
+};
+
+static float labCurve(float t)
+{
+	return (t > 0.008856f) ? cbrt(t) : 7.787f * t + 16.f / 116.f;
+}
+
+/* sRGB to L*a*b* with the D65 white point */
+static void toLab(const unsigned char *pixels, size_t count, unsigned int channels, vector<float> &lab)
+{
+	static const LinearTable linear;
+	lab.resize(count * 3);
+	for (size_t p = 0; p < count; p++)
+	{
+		const unsigned char *rgb = pixels + p * channels;
+		float r = linear.values[rgb[0]], g = linear.values[rgb[1]], b = linear.values[rgb[2]];
+		float x = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f;
+		float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+		float z = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f;
+
+		float fx = labCurve(x), fy = labCurve(y), fz = labCurve(z);
+		lab[p * 3] = 116.f * fy - 16.f;
+		lab[p * 3 + 1] = 500.f * (fx - fy);
+		lab[p * 3 + 2] = 200.f * (fy - fz);
+	}
+}
+
+ImageDifference compareImages(const unsigned char *image, const unsigned char *reference, unsigned int width,
+	unsigned int height, unsigned int channels, float threshold, vector<unsigned char> *heatMap)
+{
+	ImageDifference result = { 0.f, 0.f, 0, 0.f };
+	size_t count = (size_t)width * height;
+	if (count == 0) return result;
+
+	vector<float> imageLab, referenceLab;
+	toLab(image, count, channels, imageLab);
+	toLab(reference, count, channels, referenceLab);
+	if (heatMap) heatMap->resize(count * 3);
+
+	double total = 0.0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			// The nearest colour in the reference's 3 x 3 neighbourhood, squared
+			const float *pixel = &imageLab[((size_t)y * width + x) * 3];
+			float nearest = 1e30f;
+			for (unsigned int ny = (y > 0 ? y - 1 : 0); ny <= std::min(y + 1, height - 1); ny++)
+			{
+				for (unsigned int nx = (x > 0 ? x - 1 : 0); nx <= std::min(x + 1, width - 1); nx++)
+				{
+					const float *other = &referenceLab[((size_t)ny * width + nx) * 3];
+					float dl = pixel[0] - other[0], da = pixel[1] - other[1], db = pixel[2] - other[2];
+					nearest = std::min(nearest, dl * dl + da * da + db * db);
+				}
+			}
+
+			float deltaE = sqrt(nearest);
+			total += deltaE;
+			result.maxDeltaE = std::max(result.maxDeltaE, deltaE);
+			if (deltaE > threshold) result.pixelsOver++;
+
+			if (heatMap)
+			{
+				unsigned char *out = &(*heatMap)[((size_t)y * width + x) * 3];
+				unsigned char grey = (unsigned char)(referenceLab[((size_t)y * width + x) * 3] * 0.5f * 2.55f);
+				if (deltaE > threshold)
+				{
+					out[0] = (unsigned char)std::min(128.f + deltaE * 4.f, 255.f);
+					out[1] = out[2] = 0;
+				}
+				else out[0] = out[1] = out[2] = grey;
+			}
+		}
+	}
+
+	result.meanDeltaE = (float)(total / count);
+	result.fractionOver = (float)result.pixelsOver / count;
+	return result;
+}
@@ -0,0 +1,26 @@
+/* image_compare.h
+ Compares a rendered image with a reference the way a person would see the difference rather
+ than byte for byte. Both images are converted to CIE L*a*b*, where a distance (delta E) of
+ about 2.3 is just noticeable, and each pixel is matched against the nearest colour among the
+ reference's pixel and its eight neighbours, so an edge that moved by one pixel because of a
+ change in rounding isn't counted but a change of colour or a missing object is.
+ Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+struct ImageDifference
+{
+	float meanDeltaE, maxDeltaE;
+	size_t pixelsOver;			// pixels whose delta E is over the threshold
+	float fractionOver;			// and the fraction of the image they are
+};
+
+/* Both images are width x height with 3 or 4 channels, rows in the same order. With heatMap the
+   difference is drawn as an RGB image: the reference in grey, with the pixels over the threshold
+   in red as bright as their delta E */
+ImageDifference compareImages(const unsigned char *image, const unsigned char *reference, unsigned int width,
+	unsigned int height, unsigned int channels, float threshold = 2.3f, std::vector<unsigned char> *heatMap = NULL);
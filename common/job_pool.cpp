@@ -0,0 +1,147 @@
+/* job_pool.cpp
+ Work-stealing thread pool.
+*/
+
+#include "job_pool.h"
+#include <algorithm>
+
+using namespace std;
+
+JobPool::JobPool()
+{
+	generation = 0;
+	stopping = false;
+	current = NULL;
+	remaining = 0;
+}
+
+JobPool::~JobPool()
+{
+	stop();
+}
+
+/* Start the workers. threads = 0 uses one per hardware thread, counting the caller */
+void JobPool::makePool(unsigned int threads)
+{
+	stop();
+
+	if (threads == 0) threads = thread::hardware_concurrency();
+	if (threads == 0) threads = 1;
+
+	queues.clear();
+	for (unsigned int t = 0; t < threads; t++) queues.push_back(unique_ptr<Queue>(new Queue));
+
+	stopping = false;
+	for (unsigned int t = 1; t < threads; t++)
+	{
+		this->threads.push_back(thread(&JobPool::workerLoop, this, t));
+	}
+}
+
+void JobPool::stop()
+{
+	{
+		lock_guard<mutex> lock(wakeLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+	threads.clear();
+}
+
+/* Take a chunk: the newest of this worker's own, or else the oldest of another's */
+bool JobPool::take(unsigned int worker, Chunk &chunk)
+{
+	unsigned int count = size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Queue &queue = *queues[(worker + i) % count];
+		lock_guard<mutex> lock(queue.lock);
+		if (queue.chunks.empty()) continue;
+
+		if (i == 0)
+		{
+			chunk = queue.chunks.back();
+			queue.chunks.pop_back();
+		}
+		else
+		{
+			chunk = queue.chunks.front();
+			queue.chunks.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+/* Run chunks until there are none left to take */
+void JobPool::work(unsigned int worker)
+{
+	Chunk chunk;
+	while (take(worker, chunk))
+	{
+		(*current)(chunk.first, chunk.last, worker);
+		if (--remaining == 0)
+		{
+			lock_guard<mutex> lock(wakeLock);
+			finished.notify_all();
+		}
+	}
+}
+
+void JobPool::workerLoop(unsigned int worker)
+{
+	unsigned long long seen = 0;
+	for (;;)
+	{
+		{
+			unique_lock<mutex> lock(wakeLock);
+			wakeUp.wait(lock, [&]() { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+		}
+		work(worker);
+	}
+}
+
+void JobPool::run(size_t count, size_t grain, const Job &job)
+{
+	if (count == 0) return;
+	if (grain == 0) grain = 1;
+
+	// Not worth waking anyone for a single chunk, or without a pool
+	size_t chunks = (count + grain - 1) / grain;
+	if (size() <= 1 || chunks == 1)
+	{
+		job(0, count, 0);
+		return;
+	}
+
+	current = &job;
+	remaining = chunks;
+
+	// Each worker starts with a run of neighbouring chunks
+	unsigned int workers = size();
+	for (unsigned int w = 0; w < workers; w++)
+	{
+		size_t firstChunk = chunks * w / workers, lastChunk = chunks * (w + 1) / workers;
+		lock_guard<mutex> lock(queues[w]->lock);
+		for (size_t c = firstChunk; c < lastChunk; c++)
+		{
+			Chunk chunk = { c * grain, std::min(count, (c + 1) * grain) };
+			queues[w]->chunks.push_back(chunk);
+		}
+	}
+
+	{
+		lock_guard<mutex> lock(wakeLock);
+		generation++;
+	}
+	wakeUp.notify_all();
+
+	work(0);
+
+	unique_lock<mutex> lock(wakeLock);
+	finished.wait(lock, [&]() { return remaining == 0; });
+	current = NULL;
+}
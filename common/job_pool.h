@@ -0,0 +1,61 @@
+/* job_pool.h
+ A pool of worker threads that share out a range of work by stealing. run() cuts the range
+ into chunks and gives each thread a queue of neighbouring chunks; a thread takes its own
+ chunks from the back of its queue and, once it runs out, steals from the front of the
+ others', so a thread that is given slow chunks doesn't hold the rest up.
+ The thread that calls run() works too, as worker 0, and run() returns when every chunk is
+ done. The workers sleep between runs. Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstddef>
+
+class JobPool
+{
+public:
+	JobPool();
+	~JobPool();
+
+	void makePool(unsigned int threads = 0);
+	unsigned int size() const { return (unsigned int)queues.size(); }
+
+	/* Call job(first, last, worker) for chunks of at most grain items that cover [0, count) */
+	typedef std::function<void(size_t first, size_t last, unsigned int worker)> Job;
+	void run(size_t count, size_t grain, const Job &job);
+
+private:
+	struct Chunk
+	{
+		size_t first, last;
+	};
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<Chunk> chunks;
+	};
+
+	bool take(unsigned int worker, Chunk &chunk);
+	void work(unsigned int worker);
+	void workerLoop(unsigned int worker);
+	void stop();
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex wakeLock;
+	std::condition_variable wakeUp, finished;
+	unsigned long long generation;		// counts runs, so a worker knows when there is a new one
+	bool stopping;
+
+	const Job *current;
+	std::atomic<size_t> remaining;		// chunks of the current run not yet done
+};
@@ -0,0 +1,218 @@
+/* light_clusters.cpp
+ Builds the per-cluster light lists for clustered forward lighting.
+*/
+
+#include "light_clusters.h"
+#include <cmath>
+#include <algorithm>
+
+#if (GLM_ARCH & GLM_ARCH_SSE2_BIT)
+#define LIGHTS_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+LightClusterGrid::LightClusterGrid()
+{
+	tilesX = tilesY = slices = 0;
+	nearPlane = 0.1f;
+	farPlane = 100.f;
+	rowStride = 0;
+}
+
+void LightClusterGrid::makeGrid(unsigned int tilesX, unsigned int tilesY, unsigned int slices)
+{
+	this->tilesX = tilesX;
+	this->tilesY = tilesY;
+	this->slices = slices;
+	rowStride = (tilesX + 3) & ~3u;
+
+	// Padding clusters are infinitely far to the right so that no light ever touches them
+	xMin.assign(rowStride * slices, 1e30f);
+	xMax.assign(rowStride * slices, 1e30f);
+	yMin.resize(tilesY * slices);
+	yMax.resize(tilesY * slices);
+	sliceNear.resize(slices);
+	sliceFar.resize(slices);
+
+	cells.assign(clusterCount() * 2, 0);
+	sliceCells.resize(slices);
+	sliceLights.resize(slices);
+	sliceIndices.resize(slices);
+}
+
+/* Put the lights into view space and sort them into the clusters of this view. The slices are
+   built on the pool's threads if there is one, otherwise on the calling thread */
+void LightClusterGrid::build(const PointLight *lights, size_t count, const mat4 &view, const mat4 &projection,
+	JobPool *pool, bool simd)
+{
+	if (slices == 0) makeGrid();
+
+	// The near and far planes and the size of the view at a depth of 1, from a perspective projection
+	nearPlane = projection[3][2] / (projection[2][2] - 1.f);
+	farPlane = projection[3][2] / (projection[2][2] + 1.f);
+	float tanX = 1.f / projection[0][0], tanY = 1.f / projection[1][1];
+
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		float dn = nearPlane * pow(farPlane / nearPlane, (float)s / slices);
+		float df = nearPlane * pow(farPlane / nearPlane, (float)(s + 1) / slices);
+		sliceNear[s] = dn;
+		sliceFar[s] = df;
+
+		// A tile's sides spread out with depth, so its box spans them at both ends of the slice
+		for (unsigned int x = 0; x < tilesX; x++)
+		{
+			float a = (-1.f + 2.f * x / tilesX) * tanX, b = (-1.f + 2.f * (x + 1) / tilesX) * tanX;
+			xMin[s * rowStride + x] = std::min(a * dn, a * df);
+			xMax[s * rowStride + x] = std::max(b * dn, b * df);
+		}
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			float a = (-1.f + 2.f * y / tilesY) * tanY, b = (-1.f + 2.f * (y + 1) / tilesY) * tanY;
+			yMin[s * tilesY + y] = std::min(a * dn, a * df);
+			yMax[s * tilesY + y] = std::max(b * dn, b * df);
+		}
+	}
+
+	// The lights in view space, and the slices each one can reach
+	lightData.resize(count * 8);
+	lightFirstSlice.resize(count);
+	lightLastSlice.resize(count);
+	float sliceScale = slices / log(farPlane / nearPlane);
+	for (size_t i = 0; i < count; i++)
+	{
+		vec4 p = view * vec4(lights[i].position, 1.f);
+		float *data = &lightData[i * 8];
+		data[0] = p.x; data[1] = p.y; data[2] = p.z; data[3] = lights[i].radius;
+		data[4] = lights[i].colour.r * lights[i].intensity;
+		data[5] = lights[i].colour.g * lights[i].intensity;
+		data[6] = lights[i].colour.b * lights[i].intensity;
+		data[7] = 0.f;
+
+		float nearest = -p.z - lights[i].radius, furthest = -p.z + lights[i].radius;
+		if (furthest < nearPlane || nearest > farPlane || lights[i].radius <= 0.f)
+		{
+			lightFirstSlice[i] = 1;
+			lightLastSlice[i] = 0;
+			continue;
+		}
+		float first = (nearest <= nearPlane) ? 0.f : floor(log(nearest / nearPlane) * sliceScale);
+		float last = floor(log(std::min(furthest, farPlane) / nearPlane) * sliceScale);
+		lightFirstSlice[i] = (unsigned short)std::min(first, (float)(slices - 1));
+		lightLastSlice[i] = (unsigned short)std::min(std::max(last, 0.f), (float)(slices - 1));
+	}
+
+	if (pool)
+	{
+		pool->run(slices, 1, [this, count, simd](size_t first, size_t last, unsigned int)
+		{
+			for (size_t s = first; s < last; s++) buildSlice((unsigned int)s, count, simd);
+		});
+	}
+	else
+	{
+		for (unsigned int s = 0; s < slices; s++) buildSlice(s, count, simd);
+	}
+
+	// Join the slices' lists, moving each cluster's first index along by the lists before it
+	size_t total = 0;
+	for (unsigned int s = 0; s < slices; s++) total += sliceIndices[s].size();
+	indices.resize(total);
+
+	unsigned int base = 0;
+	unsigned int sliceClusters = tilesX * tilesY;
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		if (!sliceIndices[s].empty()) copy(sliceIndices[s].begin(), sliceIndices[s].end(), indices.begin() + base);
+		for (unsigned int c = s * sliceClusters; c < (s + 1) * sliceClusters; c++) cells[c * 2] += base;
+		base += (unsigned int)sliceIndices[s].size();
+	}
+}
+
+/* Find the lights that touch each cluster of one slice. Everything written here belongs to the slice */
+void LightClusterGrid::buildSlice(unsigned int slice, size_t count, bool simd)
+{
+	vector<unsigned int> &hitCells = sliceCells[slice];
+	vector<unsigned int> &hitLights = sliceLights[slice];
+	hitCells.clear();
+	hitLights.clear();
+
+	const float *rowMin = &xMin[slice * rowStride], *rowMax = &xMax[slice * rowStride];
+	float dn = sliceNear[slice], df = sliceFar[slice];
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (slice < lightFirstSlice[i] || slice > lightLastSlice[i]) continue;
+
+		// Squared distance from the centre to the box, one axis at a time, with what is left of the radius
+		const float *data = &lightData[i * 8];
+		float cx = data[0], cy = data[1], depth = -data[2], radius = data[3];
+		float dz = std::max(dn - depth, 0.f) + std::max(depth - df, 0.f);
+		float remaining = radius * radius - dz * dz;
+		if (remaining < 0.f) continue;
+
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			float dy = std::max(yMin[slice * tilesY + y] - cy, 0.f) + std::max(cy - yMax[slice * tilesY + y], 0.f);
+			float left = remaining - dy * dy;
+			if (left < 0.f) continue;
+
+			unsigned int rowFirst = y * tilesX;
+			unsigned int x = 0;
+#ifdef LIGHTS_HAS_SSE2
+			if (simd)
+			{
+				__m128 centre = _mm_set1_ps(cx), limit = _mm_set1_ps(left), zero = _mm_setzero_ps();
+				for (; x < tilesX; x += 4)
+				{
+					__m128 below = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(rowMin + x), centre), zero);
+					__m128 above = _mm_max_ps(_mm_sub_ps(centre, _mm_loadu_ps(rowMax + x)), zero);
+					__m128 d = _mm_add_ps(below, above);
+					int hits = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(d, d), limit));
+					for (; hits; hits &= hits - 1)
+					{
+						unsigned int lane = 0;
+						while (!(hits & (1 << lane))) lane++;
+						hitCells.push_back(rowFirst + x + lane);
+						hitLights.push_back((unsigned int)i);
+					}
+				}
+			}
+#endif
+			for (; x < tilesX; x++)
+			{
+				float dx = std::max(rowMin[x] - cx, 0.f) + std::max(cx - rowMax[x], 0.f);
+				if (dx * dx > left) continue;
+				hitCells.push_back(rowFirst + x);
+				hitLights.push_back((unsigned int)i);
+			}
+		}
+	}
+
+	// Counting sort of the hits by cluster, which keeps each cluster's lights in order
+	unsigned int sliceClusters = tilesX * tilesY;
+	unsigned int *sliceCellData = &cells[slice * sliceClusters * 2];
+	for (unsigned int c = 0; c < sliceClusters; c++) sliceCellData[c * 2 + 1] = 0;
+	for (size_t h = 0; h < hitCells.size(); h++) sliceCellData[hitCells[h] * 2 + 1]++;
+
+	unsigned int offset = 0;
+	for (unsigned int c = 0; c < sliceClusters; c++)
+	{
+		sliceCellData[c * 2] = offset;
+		offset += sliceCellData[c * 2 + 1];
+	}
+
+	vector<unsigned int> &list = sliceIndices[slice];
+	list.resize(hitCells.size());
+	for (size_t h = 0; h < hitCells.size(); h++)
+	{
+		unsigned int &next = sliceCellData[hitCells[h] * 2];
+		list[next++] = hitLights[h];
+	}
+
+	// Filling moved each first index to the end of its cluster, so move them back
+	for (unsigned int c = 0; c < sliceClusters; c++) sliceCellData[c * 2] -= sliceCellData[c * 2 + 1];
+}
@@ -0,0 +1,56 @@
+/* light_clusters.h
+ Sorts point lights into clusters of the view frustum for clustered forward lighting.
+ The frustum is cut into tilesX x tilesY tiles across the screen and into slices by depth,
+ spaced exponentially from the near plane to the far plane so that near clusters stay
+ small. Each cluster gets the list of lights whose spheres touch its bounding box, and a
+ fragment shader only loops over the lights of its own cluster (see clustered_lights.h),
+ so the cost of each pixel depends on the lights near it rather than on all of them.
+ Each depth slice is built on its own, so the slices are shared out over a JobPool, and
+ the lights are tested against four clusters of a row at a time with SSE2.
+ Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include "job_pool.h"
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+struct PointLight
+{
+	glm::vec3 position;		// world space
+	float radius;			// the light falls to nothing here
+	glm::vec3 colour;
+	float intensity;
+};
+
+class LightClusterGrid
+{
+public:
+	LightClusterGrid();
+
+	void makeGrid(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24);
+	void build(const PointLight *lights, size_t count, const glm::mat4 &view, const glm::mat4 &projection,
+		JobPool *pool = NULL, bool simd = true);
+
+	unsigned int clusterCount() const { return tilesX * tilesY * slices; }
+
+	unsigned int tilesX, tilesY, slices;
+	float nearPlane, farPlane;				// found from the projection by build()
+
+	std::vector<float> lightData;			// two vec4s a light: view space position and radius, then colour * intensity
+	std::vector<unsigned int> cells;		// first index and count for each cluster, x fastest, then y, then slice
+	std::vector<unsigned int> indices;		// the lights of each cluster, one cluster after another
+
+private:
+	void buildSlice(unsigned int slice, size_t count, bool simd);
+
+	// Bounds of each cluster in view space, x and y per slice, padded to whole SIMD groups
+	unsigned int rowStride;
+	std::vector<float> xMin, xMax, yMin, yMax;
+	std::vector<float> sliceNear, sliceFar;		// depths, positive
+
+	std::vector<unsigned short> lightFirstSlice, lightLastSlice;
+	std::vector<std::vector<unsigned int>> sliceCells, sliceLights, sliceIndices;
+};
@@ -0,0 +1,79 @@
+/* mesh_batch.cpp
+ One buffer object for many procedural meshes.
+*/
+
+#include "mesh_batch.h"
+#include <cstddef>
+
+using namespace std;
+
+MeshBatch::MeshBatch()
+{
+	attribute_v_coord = 0;
+	attribute_v_colours = 1;
+	attribute_v_normal = 2;
+
+	bufferObject = 0;
+	indexOffset = 0;
+}
+
+MeshBatch::~MeshBatch()
+{
+}
+
+/* Copy the builder's vertices and indices into one buffer. Uploading again replaces the
+   contents, reusing the same buffer object */
+void MeshBatch::upload(const MeshBuilder &builder)
+{
+	meshes = builder.meshes;
+
+	// The indices go after the vertices, which are a whole number of 4 byte floats
+	GLsizeiptr vertexBytes = builder.vertices.size() * sizeof(MeshVertex);
+	GLsizeiptr indexBytes = builder.indices.size() * sizeof(GLuint);
+	indexOffset = vertexBytes;
+
+	if (bufferObject == 0) glGenBuffers(1, &bufferObject);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes + indexBytes, NULL, GL_STATIC_DRAW);
+	if (vertexBytes > 0) glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, &builder.vertices[0]);
+	if (indexBytes > 0) glBufferSubData(GL_ARRAY_BUFFER, indexOffset, indexBytes, &builder.indices[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* Bind the buffer as both the vertices and the indices, for all of the drawMesh calls that follow */
+void MeshBatch::bind()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
+	glVertexAttribPointer(attribute_v_coord, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+	glEnableVertexAttribArray(attribute_v_coord);
+	glVertexAttribPointer(attribute_v_colours, 4, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, colour));
+	glEnableVertexAttribArray(attribute_v_colours);
+	glVertexAttribPointer(attribute_v_normal, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+	glEnableVertexAttribArray(attribute_v_normal);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObject);
+}
+
+/* Draw one mesh as points, lines or filled triangles. bind() must have been called */
+void MeshBatch::drawMesh(GLuint mesh, int drawmode)
+{
+	const MeshRange &range = meshes[mesh];
+
+	glPointSize(3.f);
+
+	// Switch between filled and wireframe modes
+	if (drawmode == 1)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	else
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	if (drawmode == 2)
+	{
+		glDrawArrays(GL_POINTS, range.firstVertex, range.vertexCount);
+	}
+	else
+	{
+		glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+			(GLvoid*)(indexOffset + range.firstIndex * sizeof(GLuint)), range.firstVertex);
+	}
+}
@@ -0,0 +1,34 @@
+/* mesh_batch.h
+ Uploads every mesh a MeshBuilder holds into one buffer object, allocated once, with the
+ vertices first and the indices after them, and draws each mesh from its offsets with
+ glDrawElementsBaseVertex. The buffer is bound once with bind(), then any number of meshes
+ can be drawn, so a scene of many procedural objects costs one buffer rather than three to
+ five for every object.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include "mesh_builder.h"
+#include <vector>
+
+class MeshBatch
+{
+public:
+	MeshBatch();
+	~MeshBatch();
+
+	void upload(const MeshBuilder &builder);
+	void bind();
+	void drawMesh(GLuint mesh, int drawmode);
+
+	GLuint attribute_v_coord;
+	GLuint attribute_v_colours;
+	GLuint attribute_v_normal;
+
+	std::vector<MeshRange> meshes;	// copied from the builder, which can then be reset
+
+private:
+	GLuint bufferObject;
+	GLsizeiptr indexOffset;			// bytes from the start of the buffer to the indices
+};
@@ -0,0 +1,330 @@
+/* mesh_builder.cpp
+ Procedural meshes built into a shared, reusable pair of arrays.
+*/
+
+#include "mesh_builder.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+MeshBuilder::MeshBuilder()
+{
+	current = MeshRange();
+}
+
+MeshBuilder::~MeshBuilder()
+{
+}
+
+/* Make room for this many more vertices and indices, so that building them doesn't reallocate.
+   The arrays at least double when they grow, as reserving exactly what each shape needs would
+   copy everything built so far for every shape. When the totals are known, reserve them before
+   the first mesh so the arrays are never copied at all */
+void MeshBuilder::reserve(size_t vertexCount, size_t indexCount)
+{
+	if (vertices.size() + vertexCount > vertices.capacity())
+		vertices.reserve(std::max(vertices.size() + vertexCount, vertices.capacity() * 2));
+	if (indices.size() + indexCount > indices.capacity())
+		indices.reserve(std::max(indices.size() + indexCount, indices.capacity() * 2));
+}
+
+/* Forget every mesh but keep the memory for the next ones */
+void MeshBuilder::reset()
+{
+	vertices.clear();
+	indices.clear();
+	meshes.clear();
+}
+
+/* Fill in one vertex */
+static inline void setVertex(MeshVertex &vertex, const vec3 &position, const vec4 &colour, const vec3 &normal)
+{
+	vertex.position[0] = position.x; vertex.position[1] = position.y; vertex.position[2] = position.z;
+	vertex.colour[0] = colour.r; vertex.colour[1] = colour.g; vertex.colour[2] = colour.b; vertex.colour[3] = colour.a;
+	vertex.normal[0] = normal.x; vertex.normal[1] = normal.y; vertex.normal[2] = normal.z;
+}
+
+/* Fill in one triangle and move on to the next */
+static inline void setTriangle(unsigned int *&index, unsigned int a, unsigned int b, unsigned int c)
+{
+	index[0] = a;
+	index[1] = b;
+	index[2] = c;
+	index += 3;
+}
+
+void MeshBuilder::beginMesh()
+{
+	current = MeshRange();
+	current.firstVertex = (unsigned int)vertices.size();
+	current.firstIndex = (unsigned int)indices.size();
+}
+
+unsigned int MeshBuilder::addVertex(const vec3 &position, const vec4 &colour, const vec3 &normal)
+{
+	MeshVertex vertex;
+	setVertex(vertex, position, colour, normal);
+	vertices.push_back(vertex);
+	return (unsigned int)vertices.size() - 1 - current.firstVertex;
+}
+
+void MeshBuilder::addTriangle(unsigned int a, unsigned int b, unsigned int c)
+{
+	indices.push_back(a);
+	indices.push_back(b);
+	indices.push_back(c);
+}
+
+/* The shapes know how many vertices and indices they make, so they add them all at once and fill
+   them in, which is much quicker than adding them one at a time */
+MeshVertex *MeshBuilder::appendVertices(size_t count)
+{
+	size_t first = vertices.size();
+	vertices.resize(first + count);
+	return &vertices[first];
+}
+
+unsigned int *MeshBuilder::appendIndices(size_t count)
+{
+	size_t first = indices.size();
+	indices.resize(first + count);
+	return &indices[first];
+}
+
+/* Finish the mesh that was begun, working out its bounding box */
+unsigned int MeshBuilder::endMesh()
+{
+	current.vertexCount = (unsigned int)vertices.size() - current.firstVertex;
+	current.indexCount = (unsigned int)indices.size() - current.firstIndex;
+	current.boundsMin = current.boundsMax = vec3(0);
+	if (current.vertexCount > 0)
+	{
+		const MeshVertex *mesh = &vertices[current.firstVertex];
+		float lower[3], upper[3];
+		for (int i = 0; i < 3; i++) lower[i] = upper[i] = mesh[0].position[i];
+		for (unsigned int v = 1; v < current.vertexCount; v++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				lower[i] = std::min(lower[i], mesh[v].position[i]);
+				upper[i] = std::max(upper[i], mesh[v].position[i]);
+			}
+		}
+		current.boundsMin = vec3(lower[0], lower[1], lower[2]);
+		current.boundsMax = vec3(upper[0], upper[1], upper[2]);
+	}
+	meshes.push_back(current);
+	return (unsigned int)meshes.size() - 1;
+}
+
+/* The cube of the Cube class, half a unit across with a colour for each face, four shared
+   vertices and two triangles on each face */
+unsigned int MeshBuilder::addCube()
+{
+	// The outward normal of each face, and two edges whose cross product is the normal
+	const vec3 faces[6][3] = {
+		{ vec3(0, 0, -1), vec3(0, 1, 0), vec3(1, 0, 0) },
+		{ vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1) },
+		{ vec3(0, 0, 1), vec3(1, 0, 0), vec3(0, 1, 0) },
+		{ vec3(-1, 0, 0), vec3(0, 0, 1), vec3(0, 1, 0) },
+		{ vec3(0, -1, 0), vec3(1, 0, 0), vec3(0, 0, 1) },
+		{ vec3(0, 1, 0), vec3(0, 0, 1), vec3(1, 0, 0) }
+	};
+	const vec4 colours[6] = {
+		vec4(0, 0, 1, 1), vec4(0, 1, 0, 1), vec4(1, 1, 0, 1), vec4(1, 0, 0, 1), vec4(1, 0, 1, 1), vec4(0, 1, 1, 1)
+	};
+
+	reserve(24, 36);
+	beginMesh();
+	MeshVertex *vertex = appendVertices(24);
+	unsigned int *index = appendIndices(36);
+	for (int f = 0; f < 6; f++)
+	{
+		vec3 n = faces[f][0], u = faces[f][1], v = faces[f][2];
+		setVertex(vertex[0], (n - u - v) * 0.25f, colours[f], n);
+		setVertex(vertex[1], (n + u - v) * 0.25f, colours[f], n);
+		setVertex(vertex[2], (n + u + v) * 0.25f, colours[f], n);
+		setVertex(vertex[3], (n - u + v) * 0.25f, colours[f], n);
+		vertex += 4;
+		unsigned int first = f * 4;
+		setTriangle(index, first, first + 1, first + 2);
+		setTriangle(index, first, first + 2, first + 3);
+	}
+	return endMesh();
+}
+
+/* The unit sphere of the Sphere class: a vertex at each pole and numlats - 1 rings of
+   numlongs vertices, coloured by their position, with the polar fans and the strips between
+   the rings as triangles */
+unsigned int MeshBuilder::addSphere(unsigned int numlats, unsigned int numlongs)
+{
+	const float DEG_TO_RADIANS = 3.141592f / 180.f;
+	float latstep = 180.f / numlats;
+	float longstep = 360.f / numlongs;
+	unsigned int rings = numlats - 1;
+
+	size_t vertexCount = 2 + rings * numlongs, indexCount = (size_t)numlongs * 6 * rings;
+	reserve(vertexCount, indexCount);
+	beginMesh();
+
+	// Every ring has the same longitudes, so their cosines and sines are worked out once
+	angleScratch.resize(numlongs * 2);
+	for (unsigned int l = 0; l < numlongs; l++)
+	{
+		float lon = (-180.f + l * longstep) * DEG_TO_RADIANS;
+		angleScratch[l * 2] = cos(lon);
+		angleScratch[l * 2 + 1] = sin(lon);
+	}
+
+	MeshVertex *vertex = appendVertices(vertexCount);
+	setVertex(*vertex++, vec3(0, 0, 1.f), vec4(0, 0, 1.f, 1.f), vec3(0, 0, 1.f));
+	for (unsigned int r = 1; r <= rings; r++)
+	{
+		float lat = (90.f - r * latstep) * DEG_TO_RADIANS;
+		float cosLat = cos(lat), sinLat = sin(lat);
+		for (unsigned int l = 0; l < numlongs; l++)
+		{
+			vec3 p(cosLat * angleScratch[l * 2], cosLat * angleScratch[l * 2 + 1], sinLat);
+			setVertex(*vertex++, p, vec4(p, 1.f), p);
+		}
+	}
+	unsigned int south = (unsigned int)vertexCount - 1;
+	setVertex(*vertex, vec3(0, 0, -1.f), vec4(0, 0, -1.f, 1.f), vec3(0, 0, -1.f));
+
+	// North pole fan, the strips between the rings, then the south pole fan
+	unsigned int *index = appendIndices(indexCount);
+	for (unsigned int l = 0; l < numlongs; l++)
+	{
+		setTriangle(index, 0, 1 + l, (l + 1 < numlongs) ? 2 + l : 1);
+	}
+	for (unsigned int r = 0; r + 1 < rings; r++)
+	{
+		unsigned int start = 1 + r * numlongs;
+		for (unsigned int l = 0; l < numlongs; l++)
+		{
+			unsigned int next = (l + 1 < numlongs) ? l + 1 : 0;
+			setTriangle(index, start + l, start + numlongs + l, start + next);
+			setTriangle(index, start + next, start + numlongs + l, start + numlongs + next);
+		}
+	}
+	unsigned int last = 1 + (rings - 1) * numlongs;
+	for (unsigned int l = 0; l < numlongs; l++)
+	{
+		setTriangle(index, south, (l + 1 < numlongs) ? last + l + 1 : last, last + l);
+	}
+	return endMesh();
+}
+
+/* An icosphere, coloured by position like the Sphere */
+unsigned int MeshBuilder::addIcosphere(unsigned int level)
+{
+	makeIcosphere(level, SPHERE_NO_TEXCOORDS, sphereScratch);
+	return addSphereMesh(sphereScratch);
+}
+
+/* A cube sphere, coloured by position like the Sphere */
+unsigned int MeshBuilder::addCubeSphere(unsigned int divisions)
+{
+	makeCubeSphere(divisions, SPHERE_NO_TEXCOORDS, sphereScratch);
+	return addSphereMesh(sphereScratch);
+}
+
+unsigned int MeshBuilder::addSphereMesh(const SphereMesh &sphere)
+{
+	size_t count = sphere.positions.size() / 3;
+	reserve(count, sphere.indices.size());
+	beginMesh();
+	MeshVertex *vertex = appendVertices(count);
+	for (size_t v = 0; v < count; v++)
+	{
+		vec3 p(sphere.positions[v * 3], sphere.positions[v * 3 + 1], sphere.positions[v * 3 + 2]);
+		setVertex(vertex[v], p, vec4(p, 1.f), p);
+	}
+	if (!sphere.indices.empty())
+	{
+		copy(sphere.indices.begin(), sphere.indices.end(), appendIndices(sphere.indices.size()));
+	}
+	return endMesh();
+}
+
+/* The cylinder of the Cylinder class, radius and length 1 about the y axis, with
+   definition vertices around each lid and around each end of the side */
+unsigned int MeshBuilder::addCylinder(unsigned int definition, const vec3 &colour)
+{
+	const float PI = 3.141592653589f;
+	vec4 c(colour, 1.f);
+	float halfLength = 0.5f;
+
+	size_t vertexCount = definition * 4 + 2, indexCount = (size_t)definition * 12;
+	reserve(vertexCount, indexCount);
+	beginMesh();
+
+	// The lids and the side share the same angles around the axis
+	angleScratch.resize(definition * 2);
+	for (unsigned int i = 0; i < definition; i++)
+	{
+		float theta = 2 * PI / definition * i;
+		angleScratch[i * 2] = cos(theta);
+		angleScratch[i * 2 + 1] = sin(theta);
+	}
+
+	MeshVertex *vertex = appendVertices(vertexCount);
+	unsigned int top = 0;
+	setVertex(*vertex++, vec3(0, halfLength, 0), c, vec3(0, 1.f, 0));
+	for (unsigned int i = 0; i < definition; i++)
+	{
+		setVertex(*vertex++, vec3(angleScratch[i * 2], halfLength, angleScratch[i * 2 + 1]), c, vec3(0, 1.f, 0));
+	}
+	unsigned int bottom = definition + 1;
+	setVertex(*vertex++, vec3(0, -halfLength, 0), c, vec3(0, -1.f, 0));
+	for (unsigned int i = 0; i < definition; i++)
+	{
+		setVertex(*vertex++, vec3(angleScratch[i * 2], -halfLength, angleScratch[i * 2 + 1]), c, vec3(0, -1.f, 0));
+	}
+	unsigned int side = bottom + 1 + definition;
+	for (unsigned int i = 0; i < definition; i++)
+	{
+		vec3 n(angleScratch[i * 2], 0, angleScratch[i * 2 + 1]);
+		setVertex(*vertex++, vec3(n.x, halfLength, n.z), c, n);
+		setVertex(*vertex++, vec3(n.x, -halfLength, n.z), c, n);
+	}
+
+	// Lids facing up and down, and the side facing out
+	unsigned int *index = appendIndices(indexCount);
+	for (unsigned int i = 0; i < definition; i++)
+	{
+		unsigned int next = (i + 1 < definition) ? i + 1 : 0;
+		setTriangle(index, top, top + 1 + next, top + 1 + i);
+		setTriangle(index, bottom, bottom + 1 + i, bottom + 1 + next);
+		setTriangle(index, side + i * 2, side + next * 2, side + i * 2 + 1);
+		setTriangle(index, side + i * 2 + 1, side + next * 2, side + next * 2 + 1);
+	}
+	return endMesh();
+}
+
+/* The flat shaded tetrahedron of the Tetrahedron class, with unit length normals */
+unsigned int MeshBuilder::addTetrahedron()
+{
+	const vec3 corners[12] = {
+		vec3(0, 0.577f, 0), vec3(-0.5f, 0, 0.289f), vec3(0.5f, 0, 0.289f),
+		vec3(0, 0.577f, 0), vec3(0.5f, 0, 0.289f), vec3(0, 0, -0.289f),
+		vec3(0.5f, 0, 0.289f), vec3(-0.5f, 0, 0.289f), vec3(0, 0, -0.289f),
+		vec3(0, 0.577f, 0), vec3(0, 0, -0.289f), vec3(-0.5f, 0, 0.289f)
+	};
+	const vec4 colours[4] = { vec4(0, 0, 1, 1), vec4(1, 0, 1, 1), vec4(0, 1, 0, 1), vec4(1, 1, 0, 1) };
+
+	reserve(12, 12);
+	beginMesh();
+	MeshVertex *vertex = appendVertices(12);
+	unsigned int *index = appendIndices(12);
+	for (int f = 0; f < 4; f++)
+	{
+		const vec3 *v = &corners[f * 3];
+		vec3 normal = normalize(cross(v[1] - v[0], v[2] - v[0]));
+		for (int i = 0; i < 3; i++) setVertex(vertex[f * 3 + i], v[i], colours[f], normal);
+		setTriangle(index, f * 3, f * 3 + 1, f * 3 + 2);
+	}
+	return endMesh();
+}
@@ -0,0 +1,75 @@
+/* mesh_builder.h
+ Builds procedural meshes on the CPU, apart from putting them into OpenGL buffers.
+ A MeshBuilder generates any number of meshes one after another into the same two arrays,
+ the interleaved vertices and the triangle indices, like a linear arena: reset() forgets the
+ meshes but keeps the memory, so building again doesn't allocate. Each mesh records where
+ it is in the arrays and its bounding box.
+ The shapes are the ones the Cube, Sphere, Cylinder and Tetrahedron classes draw, which
+ make them here, plus the icosphere and cube sphere from sphere_mesh.h, made as indexed
+ triangle lists so that every mesh can be drawn the same way. MeshBatch uploads them.
+ Nothing in here uses OpenGL so the benchmarks can run it too.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "sphere_mesh.h"
+
+/* One vertex, laid out for the attributes the example shaders use:
+   0 position, 1 colour and 2 normal */
+struct MeshVertex
+{
+	float position[3];
+	float colour[4];
+	float normal[3];
+
+	// Left unset, so that the shapes can make room for all their vertices without clearing them first
+	MeshVertex() {}
+};
+
+/* Where a mesh is in the builder's arrays. Its indices count from its first vertex */
+struct MeshRange
+{
+	unsigned int firstVertex, vertexCount;
+	unsigned int firstIndex, indexCount;
+	glm::vec3 boundsMin, boundsMax;
+};
+
+class MeshBuilder
+{
+public:
+	MeshBuilder();
+	~MeshBuilder();
+
+	void reserve(size_t vertexCount, size_t indexCount);
+	void reset();
+
+	/* Build a mesh by hand: the vertex numbers start at 0 for each mesh */
+	void beginMesh();
+	unsigned int addVertex(const glm::vec3 &position, const glm::vec4 &colour, const glm::vec3 &normal);
+	void addTriangle(unsigned int a, unsigned int b, unsigned int c);
+	unsigned int endMesh();
+
+	/* The example shapes. Each returns the number of its mesh */
+	unsigned int addCube();
+	unsigned int addSphere(unsigned int numlats, unsigned int numlongs);
+	unsigned int addIcosphere(unsigned int level);
+	unsigned int addCubeSphere(unsigned int divisions);
+	unsigned int addCylinder(unsigned int definition, const glm::vec3 &colour);
+	unsigned int addTetrahedron();
+
+	std::vector<MeshVertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshRange> meshes;
+
+private:
+	MeshVertex *appendVertices(size_t count);
+	unsigned int *appendIndices(size_t count);
+	unsigned int addSphereMesh(const SphereMesh &sphere);
+
+	MeshRange current;
+	SphereMesh sphereScratch;		// kept so that making more spheres doesn't allocate
+	std::vector<float> angleScratch;	// cosine and sine of each longitude or step around a cylinder
+};
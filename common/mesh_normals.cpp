@@ -0,0 +1,259 @@
+/* mesh_normals.cpp
+ Smooth normal and tangent generation. The angle weighting is from Thurmer and Wuthrich,
+ "Computing Vertex Normals from Polygonal Facets" (1998), and the tangent space follows
+ Mikkelsen's MikkTSpace, without its splitting of vertices whose corners disagree.
+*/
+
+#include "mesh_normals.h"
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+	// Below this many items per thread, starting the threads costs more than it saves
+	const size_t itemsPerThread = 16384;
+
+	unsigned int threadsFor(size_t count, unsigned int threads)
+	{
+		if (threads == 0)
+		{
+			threads = thread::hardware_concurrency();
+			size_t worthwhile = count / itemsPerThread;
+			if (threads > worthwhile) threads = (unsigned int)worthwhile;
+		}
+		return threads < 1 ? 1 : threads;
+	}
+
+	/* Run work(first, last, t) over [0, count) split into one range for each thread, the
+	   calling thread doing the first */
+	template <class Work>
+	void parallelRanges(size_t count, unsigned int threads, Work work)
+	{
+		size_t chunk = (count + threads - 1) / threads;
+		vector<thread> workers;
+		for (unsigned int t = 1; t < threads && t * chunk < count; t++)
+		{
+			size_t last = (t + 1) * chunk < count ? (t + 1) * chunk : count;
+			workers.push_back(thread(work, t * chunk, last, t));
+		}
+		work((size_t)0, chunk < count ? chunk : count, 0u);
+		for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+	}
+
+	inline vec3 load3(const float *p, size_t stride, unsigned int i)
+	{
+		const float *v = (const float*)((const unsigned char*)p + i * stride);
+		return vec3(v[0], v[1], v[2]);
+	}
+
+	inline vec2 load2(const float *p, size_t stride, unsigned int i)
+	{
+		const float *v = (const float*)((const unsigned char*)p + i * stride);
+		return vec2(v[0], v[1]);
+	}
+
+	/* Angles of a triangle at each of its corners */
+	void cornerAngles(vec3 a, vec3 b, vec3 c, float angles[3])
+	{
+		vec3 ab = b - a, bc = c - b, ca = a - c;
+		float lab = length(ab), lbc = length(bc), lca = length(ca);
+		angles[0] = (lab > 0.f && lca > 0.f) ? acos(clamp(-dot(ab, ca) / (lab * lca), -1.f, 1.f)) : 0.f;
+		angles[1] = (lab > 0.f && lbc > 0.f) ? acos(clamp(-dot(bc, ab) / (lbc * lab), -1.f, 1.f)) : 0.f;
+		angles[2] = (lbc > 0.f && lca > 0.f) ? acos(clamp(-dot(ca, bc) / (lca * lbc), -1.f, 1.f)) : 0.f;
+	}
+
+	/* The corners around each of keyCount keys, as a counting sort of the corners by key.
+	   Each thread counts its share of the corners into its own histogram, and the prefix sum
+	   over keys then threads gives every thread its own place to write each corner */
+	void cornersByKey(const unsigned int *keys, size_t cornerCount, size_t keyCount, unsigned int threads,
+		vector<unsigned int> &offsets, vector<unsigned int> &corners)
+	{
+		vector<vector<unsigned int> > counts(threads, vector<unsigned int>(keyCount, 0));
+		parallelRanges(cornerCount, threads, [&](size_t first, size_t last, unsigned int t)
+		{
+			vector<unsigned int> &count = counts[t];
+			for (size_t i = first; i < last; i++) count[keys[i]]++;
+		});
+
+		offsets.assign(keyCount + 1, 0);
+		unsigned int total = 0;
+		for (size_t k = 0; k < keyCount; k++)
+		{
+			offsets[k] = total;
+			for (unsigned int t = 0; t < threads; t++)
+			{
+				unsigned int n = counts[t][k];
+				counts[t][k] = total;
+				total += n;
+			}
+		}
+		offsets[keyCount] = total;
+
+		corners.resize(cornerCount);
+		parallelRanges(cornerCount, threads, [&](size_t first, size_t last, unsigned int t)
+		{
+			vector<unsigned int> &next = counts[t];
+			for (size_t i = first; i < last; i++) corners[next[keys[i]]++] = (unsigned int)i;
+		});
+	}
+}
+
+void generateNormals(const float *positions, size_t positionCount, const unsigned int *positionIndices, size_t indexCount,
+	const unsigned int *smoothingGroups, float creaseAngleDegrees, float *cornerNormals, NormalWeighting weighting, unsigned int threads)
+{
+	size_t faceCount = indexCount / 3;
+	if (faceCount == 0) return;
+	threads = threadsFor(indexCount, threads);
+
+	// Unit face normals and the weight of each corner
+	vector<vec3> faceNormals(faceCount);
+	vector<float> weights(faceCount * 3);
+	parallelRanges(faceCount, threads, [&](size_t first, size_t last, unsigned int)
+	{
+		for (size_t f = first; f < last; f++)
+		{
+			vec3 a = load3(positions, 3 * sizeof(float), positionIndices[f * 3]);
+			vec3 b = load3(positions, 3 * sizeof(float), positionIndices[f * 3 + 1]);
+			vec3 c = load3(positions, 3 * sizeof(float), positionIndices[f * 3 + 2]);
+			vec3 n = cross(b - a, c - a);
+			float doubleArea = length(n);
+			faceNormals[f] = (doubleArea > 0.f) ? n / doubleArea : vec3(0.f);
+
+			if (weighting == WEIGHT_AREA)
+			{
+				weights[f * 3] = weights[f * 3 + 1] = weights[f * 3 + 2] = doubleArea;
+			}
+			else
+			{
+				cornerAngles(a, b, c, &weights[f * 3]);
+			}
+		}
+	});
+
+	vector<unsigned int> offsets, corners;
+	cornersByKey(positionIndices, faceCount * 3, positionCount, threads, offsets, corners);
+
+	// Each corner sums the faces around its position that it is smoothed with
+	float creaseCos = cos(radians(creaseAngleDegrees));
+	parallelRanges(faceCount * 3, threads, [&](size_t first, size_t last, unsigned int)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			size_t f = i / 3;
+			vec3 own = faceNormals[f];
+			unsigned int group = smoothingGroups ? smoothingGroups[f] : 1;
+			bool degenerate = (own == vec3(0.f));
+
+			vec3 sum(0.f);
+			if (group == 0)
+			{
+				sum = own;
+			}
+			else
+			{
+				unsigned int p = positionIndices[i];
+				for (unsigned int a = offsets[p]; a < offsets[p + 1]; a++)
+				{
+					size_t other = corners[a] / 3;
+					if (smoothingGroups && smoothingGroups[other] != group) continue;
+					if (!degenerate && other != f && dot(own, faceNormals[other]) < creaseCos) continue;
+					sum += faceNormals[other] * weights[corners[a]];
+				}
+			}
+
+			float l = length(sum);
+			vec3 n = (l > 0.f) ? sum / l : (degenerate ? vec3(0.f, 0.f, 1.f) : own);
+			cornerNormals[i * 3] = n.x;
+			cornerNormals[i * 3 + 1] = n.y;
+			cornerNormals[i * 3 + 2] = n.z;
+		}
+	});
+}
+
+/* The face normals and corner weights, and the corners by position with each thread's histogram */
+size_t generateNormalsBytes(size_t positionCount, size_t indexCount, unsigned int threads)
+{
+	threads = threadsFor(indexCount, threads);
+	size_t faceCount = indexCount / 3;
+	return faceCount * sizeof(vec3) + faceCount * 3 * sizeof(float)
+		+ (threads + 1) * (positionCount + 1) * sizeof(unsigned int) + faceCount * 3 * sizeof(unsigned int);
+}
+
+void generateTangents(const float *positions, const float *normals, const float *texcoords, size_t stride, size_t vertexCount,
+	const unsigned int *indices, size_t indexCount, float *tangents, unsigned int threads)
+{
+	size_t faceCount = indexCount / 3;
+	threads = threadsFor(indexCount > vertexCount ? indexCount : vertexCount, threads);
+
+	/* The tangent and bitangent of each corner, in the plane of the vertex normal and weighted
+	   by the corner's angle. Faces whose texture coordinates have no area add nothing */
+	vector<vec3> cornerTangents(faceCount * 3), cornerBitangents(faceCount * 3);
+	parallelRanges(faceCount, threads, [&](size_t first, size_t last, unsigned int)
+	{
+		for (size_t f = first; f < last; f++)
+		{
+			const unsigned int *v = &indices[f * 3];
+			vec3 p[3] = { load3(positions, stride, v[0]), load3(positions, stride, v[1]), load3(positions, stride, v[2]) };
+			vec2 uv[3] = { load2(texcoords, stride, v[0]), load2(texcoords, stride, v[1]), load2(texcoords, stride, v[2]) };
+
+			vec3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+			vec2 d1 = uv[1] - uv[0], d2 = uv[2] - uv[0];
+			float det = d1.x * d2.y - d2.x * d1.y;
+			vec3 tangent(0.f), bitangent(0.f);
+			if (fabs(det) > 1e-20f)
+			{
+				// Only the directions matter, with the sign of the uv area kept in both
+				float sign = det > 0.f ? 1.f : -1.f;
+				tangent = (e1 * d2.y - e2 * d1.y) * sign;
+				bitangent = (e2 * d1.x - e1 * d2.x) * sign;
+			}
+
+			float angles[3];
+			cornerAngles(p[0], p[1], p[2], angles);
+			for (int c = 0; c < 3; c++)
+			{
+				vec3 n = load3(normals, stride, v[c]);
+				vec3 tc = tangent - n * dot(n, tangent), bc = bitangent - n * dot(n, bitangent);
+				float lt = length(tc), lb = length(bc);
+				cornerTangents[f * 3 + c] = (lt > 0.f) ? tc * (angles[c] / lt) : vec3(0.f);
+				cornerBitangents[f * 3 + c] = (lb > 0.f) ? bc * (angles[c] / lb) : vec3(0.f);
+			}
+		}
+	});
+
+	vector<unsigned int> offsets, corners;
+	cornersByKey(indices, faceCount * 3, vertexCount, threads, offsets, corners);
+
+	parallelRanges(vertexCount, threads, [&](size_t first, size_t last, unsigned int)
+	{
+		for (size_t v = first; v < last; v++)
+		{
+			vec3 tangent(0.f), bitangent(0.f);
+			for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+			{
+				tangent += cornerTangents[corners[a]];
+				bitangent += cornerBitangents[corners[a]];
+			}
+
+			// Gram-Schmidt against the normal. Vertices without a usable tangent get any perpendicular,
+			// or the x axis when the file gave them a zero normal that nothing is perpendicular to
+			vec3 n = load3(normals, stride, (unsigned int)v);
+			tangent -= n * dot(n, tangent);
+			float l = length(tangent);
+			if (l > 0.f) tangent /= l;
+			else if (dot(n, n) == 0.f) tangent = vec3(1.f, 0.f, 0.f);
+			else tangent = normalize(fabs(n.x) < 0.9f ? cross(n, vec3(1.f, 0.f, 0.f)) : cross(n, vec3(0.f, 1.f, 0.f)));
+
+			float w = (dot(cross(n, tangent), bitangent) < 0.f) ? -1.f : 1.f;
+			tangents[v * 4] = tangent.x;
+			tangents[v * 4 + 1] = tangent.y;
+			tangents[v * 4 + 2] = tangent.z;
+			tangents[v * 4 + 3] = w;
+		}
+	});
+}
@@ -0,0 +1,41 @@
+/* mesh_normals.h
+ Vertex normals for meshes that come without them, and tangents for normal mapping.
+	generateNormals		- smooth normals for each triangle corner. Each face adds its normal,
+						  weighted by its area or by the angle of the corner, to the corners
+						  at the same position that are in the same smoothing group and no
+						  more than the crease angle away
+	generateTangents	- per vertex tangents with the bitangent's sign in w, built the way
+						  MikkTSpace does it: each corner's tangent is projected into the
+						  plane of the vertex normal and weighted by the corner's angle
+ Both gather rather than scatter, so the faces and vertices can be split between threads
+ without atomics. The lists of faces around each position or vertex are made with a
+ counting sort that counts into per-thread partial histograms.
+ Nothing in here uses OpenGL so the benchmarks can run it too.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+enum NormalWeighting
+{
+	WEIGHT_AREA,
+	WEIGHT_ANGLE
+};
+
+/* positionIndices has a position index for each corner of each triangle. smoothingGroups
+   has one entry per triangle, or is NULL to smooth every face up to the crease angle.
+   Faces in smoothing group 0 keep their own normal, like "s off" in an obj file.
+   cornerNormals gets three floats for each index */
+void generateNormals(const float *positions, size_t positionCount, const unsigned int *positionIndices, size_t indexCount,
+	const unsigned int *smoothingGroups, float creaseAngleDegrees, float *cornerNormals,
+	NormalWeighting weighting = WEIGHT_ANGLE, unsigned int threads = 0);
+
+/* The most memory generateNormals allocates while it runs, for callers that report their peak */
+size_t generateNormalsBytes(size_t positionCount, size_t indexCount, unsigned int threads = 0);
+
+/* positions, normals and texcoords are stride bytes apart in each vertex. tangents gets
+   four floats for each vertex: the unit tangent and the sign to make the bitangent with,
+   bitangent = w * cross(normal, tangent) */
+void generateTangents(const float *positions, const float *normals, const float *texcoords, size_t stride, size_t vertexCount,
+	const unsigned int *indices, size_t indexCount, float *tangents, unsigned int threads = 0);
@@ -0,0 +1,410 @@
+/* mesh_optimiser.cpp
+ Vertex cache, overdraw and vertex fetch optimisation for indexed triangle meshes.
+ The vertex cache optimisation follows Tom Forsyth, "Linear-Speed Vertex Cache
+ Optimisation" (2006). The overdraw clustering follows Sander, Nehab and Barczak,
+ "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (2007).
+*/
+
+#include "mesh_optimiser.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+	// Forsyth's scoring constants, for a simulated LRU cache of 32 vertices
+	const int scoreCacheSize = 32;
+	const float cacheDecayPower = 1.5f;
+	const float lastTriangleScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+	const unsigned int valenceTableSize = 64;
+
+	/* Lookup tables for the two parts of a vertex's score */
+	struct ScoreTables
+	{
+		float cache[scoreCacheSize];
+		float valence[valenceTableSize];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < scoreCacheSize; i++)
+			{
+				// The last triangle's vertices all get the same score, so that it doesn't matter what order they were used in
+				cache[i] = (i < 3) ? lastTriangleScore : pow(1.f - (i - 3) / (float)(scoreCacheSize - 3), cacheDecayPower);
+			}
+			valence[0] = 0.f;
+			for (unsigned int i = 1; i < valenceTableSize; i++)
+			{
+				valence[i] = valenceBoostScale * pow((float)i, -valenceBoostPower);
+			}
+		}
+	};
+
+	const ScoreTables scores;
+
+	/* A vertex scores higher the more recently it was used, and the fewer triangles it has left,
+	   so that lone triangles are finished off rather than left until the end */
+	inline float vertexScore(int cachePosition, unsigned int liveTriangles)
+	{
+		if (liveTriangles == 0) return -1.f;
+		float score = (cachePosition >= 0) ? scores.cache[cachePosition] : 0.f;
+		return score + (liveTriangles < valenceTableSize ? scores.valence[liveTriangles] :
+			valenceBoostScale * pow((float)liveTriangles, -valenceBoostPower));
+	}
+
+	/* A FIFO cache simulated with the time that each vertex was last loaded */
+	struct FifoCache
+	{
+		vector<unsigned int> loaded;
+		unsigned int time, size;
+
+		FifoCache(size_t vertexCount, unsigned int cacheSize) : loaded(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+		/* Returns 1 if the vertex had to be transformed */
+		unsigned int use(unsigned int v)
+		{
+			if (time - loaded[v] <= size) return 0;
+			loaded[v] = time++;
+			return 1;
+		}
+
+		void flush() { time += size + 1; }
+	};
+}
+
+/* Reorder the triangles so that each one shares as many vertices as it can with the last few */
+void optimiseVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	// The triangles that use each vertex. The live ones are kept at the start of each list
+	vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++) liveTriangles[indices[i]]++;
+
+	vector<unsigned int> firstAdjacent(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) firstAdjacent[v + 1] = firstAdjacent[v] + liveTriangles[v];
+
+	vector<unsigned int> adjacent(indexCount);
+	vector<unsigned int> fill(firstAdjacent.begin(), firstAdjacent.end() - 1);
+	for (size_t i = 0; i < indexCount; i++) adjacent[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+
+	vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	// The triangles are read from a copy and written back in their new order
+	vector<unsigned int> input(indices, indices + indexCount);
+	vector<bool> emitted(triangleCount, false);
+	unsigned int cache[scoreCacheSize + 3], newCache[scoreCacheSize + 3];
+	int cacheCount = 0;
+	size_t nextUnemitted = 0;
+
+	// Start with the best triangle
+	size_t best = max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+
+	for (size_t out = 0; out < triangleCount; out++)
+	{
+		// Nothing in the cache had any triangles left, carry on from the next one in the input
+		if (best == (size_t)-1)
+		{
+			while (emitted[nextUnemitted]) nextUnemitted++;
+			best = nextUnemitted;
+		}
+
+		const unsigned int *triangle = &input[best * 3];
+		memcpy(indices + out * 3, triangle, 3 * sizeof(unsigned int));
+		emitted[best] = true;
+
+		// The triangle's vertices go to the front of the cache
+		int newCount = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			unsigned int v = triangle[i];
+			if (find(newCache, newCache + newCount, v) == newCache + newCount) newCache[newCount++] = v;
+
+			// Take the triangle off the vertex's live list
+			unsigned int *list = &adjacent[firstAdjacent[v]];
+			unsigned int last = --liveTriangles[v];
+			*find(list, list + last, (unsigned int)best) = list[last];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) newCache[newCount++] = v;
+		}
+
+		// Rescore every vertex that moved in the cache, including those that dropped out of it,
+		// and pass the change on to their triangles
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			int position = (i < scoreCacheSize) ? i : -1;
+			cachePosition[v] = position;
+
+			float score = vertexScore(position, liveTriangles[v]);
+			float change = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const unsigned int *list = &adjacent[firstAdjacent[v]];
+			for (unsigned int a = 0; a < liveTriangles[v]; a++) triangleScores[list[a]] += change;
+		}
+
+		cacheCount = min(newCount, scoreCacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+		// The next triangle is the best one that uses a vertex in the cache
+		best = (size_t)-1;
+		float bestScore = 0.f;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			const unsigned int *list = &adjacent[firstAdjacent[v]];
+			for (unsigned int a = 0; a < liveTriangles[v]; a++)
+			{
+				if (triangleScores[list[a]] > bestScore)
+				{
+					bestScore = triangleScores[list[a]];
+					best = list[a];
+				}
+			}
+		}
+	}
+}
+
+namespace
+{
+	/* A run of triangles and the value it is sorted on */
+	struct Cluster
+	{
+		size_t first, count;
+		float sortKey;
+	};
+
+	bool outwardFirst(const Cluster &a, const Cluster &b)
+	{
+		return a.sortKey > b.sortKey;
+	}
+
+	inline const float* positionOf(const float *positions, size_t stride, unsigned int v)
+	{
+		return (const float*)((const unsigned char*)positions + (size_t)v * stride);
+	}
+}
+
+/* Keep the cache-friendly order but split it into clusters, and put the clusters that face out
+   from the centre of the mesh first. Those are the ones most likely to hide the others.
+   A cluster can end where the vertex cache would be cold anyway, or where its ACMR gets
+   within threshold of the ACMR of the whole run it came from */
+void optimiseOverdraw(unsigned int *indices, size_t indexCount, const float *positions, size_t positionStride,
+	size_t vertexCount, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) return;
+
+	// Hard boundaries, where a triangle misses the cache with all three vertices
+	const unsigned int cacheSize = 16;
+	FifoCache cache(vertexCount, cacheSize);
+	vector<size_t> hardStarts;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		unsigned int misses = cache.use(indices[t * 3]) + cache.use(indices[t * 3 + 1]) + cache.use(indices[t * 3 + 2]);
+		if (t == 0 || misses == 3) hardStarts.push_back(t);
+	}
+	hardStarts.push_back(triangleCount);
+
+	// Soft boundaries inside each run
+	vector<Cluster> clusters;
+	for (size_t h = 0; h + 1 < hardStarts.size(); h++)
+	{
+		size_t start = hardStarts[h], end = hardStarts[h + 1];
+
+		cache.flush();
+		size_t misses = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			misses += cache.use(indices[t * 3]) + cache.use(indices[t * 3 + 1]) + cache.use(indices[t * 3 + 2]);
+		}
+		float runACMR = misses / (float)(end - start);
+
+		cache.flush();
+		size_t clusterStart = start;
+		misses = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			misses += cache.use(indices[t * 3]) + cache.use(indices[t * 3 + 1]) + cache.use(indices[t * 3 + 2]);
+			if (t + 1 < end && misses / (float)(t + 1 - clusterStart) <= runACMR * threshold)
+			{
+				Cluster cluster = { clusterStart, t + 1 - clusterStart, 0.f };
+				clusters.push_back(cluster);
+				clusterStart = t + 1;
+				misses = 0;
+				cache.flush();
+			}
+		}
+		Cluster cluster = { clusterStart, end - clusterStart, 0.f };
+		clusters.push_back(cluster);
+	}
+	if (clusters.size() < 2) return;
+
+	// The area weighted centre of the mesh, then of each cluster, and the cluster's area weighted normal
+	float meshCentre[3] = { 0, 0, 0 }, meshArea = 0;
+	vector<float> clusterData(clusters.size() * 7, 0.f);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		float *data = &clusterData[c * 7];
+		for (size_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++)
+		{
+			const float *p0 = positionOf(positions, positionStride, indices[t * 3]);
+			const float *p1 = positionOf(positions, positionStride, indices[t * 3 + 1]);
+			const float *p2 = positionOf(positions, positionStride, indices[t * 3 + 2]);
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int i = 0; i < 3; i++)
+			{
+				data[i] += area * (p0[i] + p1[i] + p2[i]) / 3.f;
+				data[3 + i] += n[i];
+			}
+			data[6] += area;
+		}
+
+		for (int i = 0; i < 3; i++) meshCentre[i] += data[i];
+		meshArea += data[6];
+	}
+	if (meshArea > 0) for (int i = 0; i < 3; i++) meshCentre[i] /= meshArea;
+
+	// Sort on how far the cluster is out along its own normal
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const float *data = &clusterData[c * 7];
+		float length = sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+		float key = 0;
+		if (data[6] > 0 && length > 0)
+		{
+			for (int i = 0; i < 3; i++) key += (data[i] / data[6] - meshCentre[i]) * data[3 + i] / length;
+		}
+		clusters[c].sortKey = key;
+	}
+	stable_sort(clusters.begin(), clusters.end(), outwardFirst);
+
+	vector<unsigned int> input(indices, indices + indexCount);
+	size_t out = 0;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		memcpy(indices + out, &input[clusters[c].first * 3], clusters[c].count * 3 * sizeof(unsigned int));
+		out += clusters[c].count * 3;
+	}
+}
+
+/* Renumber the vertices in the order the indices first use them and move them to match, so
+   that fetching the vertices walks through memory. Vertices that no triangle uses are moved
+   to the end. Returns the number that are used. The vertices are moved in place */
+size_t optimiseVertexFetch(void *vertices, size_t vertexSize, size_t vertexCount, unsigned int *indices, size_t indexCount)
+{
+	const unsigned int unused = 0xFFFFFFFFu;
+	vector<unsigned int> remap(vertexCount, unused);
+	unsigned int next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int &target = remap[indices[i]];
+		if (target == unused) target = next++;
+		indices[i] = target;
+	}
+	size_t used = next;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == unused) remap[v] = next++;
+	}
+
+	// Follow each cycle of the renumbering, carrying one vertex along. A vertex that has
+	// been put in its place is marked by mapping it to itself
+	unsigned char *data = (unsigned char*)vertices;
+	vector<unsigned char> carried(vertexSize), displaced(vertexSize);
+	for (size_t start = 0; start < vertexCount; start++)
+	{
+		if (remap[start] == start) continue;
+
+		size_t from = start;
+		memcpy(&carried[0], data + from * vertexSize, vertexSize);
+		while (remap[from] != from)
+		{
+			size_t to = remap[from];
+			remap[from] = (unsigned int)from;
+
+			memcpy(&displaced[0], data + to * vertexSize, vertexSize);
+			memcpy(data + to * vertexSize, &carried[0], vertexSize);
+			carried.swap(displaced);
+			from = to;
+		}
+	}
+	return used;
+}
+
+/* Count the vertices that a FIFO post-transform cache of cacheSize entries would transform */
+VertexCacheStats analyseVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = { indexCount / 3, 0, 0, 0.f, 0.f };
+
+	FifoCache cache(vertexCount, cacheSize);
+	vector<bool> seen(vertexCount, false);
+	for (size_t i = 0; i < stats.triangles * 3; i++)
+	{
+		stats.transformed += cache.use(indices[i]);
+		if (!seen[indices[i]])
+		{
+			seen[indices[i]] = true;
+			stats.vertices++;
+		}
+	}
+
+	if (stats.triangles > 0) stats.acmr = stats.transformed / (float)stats.triangles;
+	if (stats.vertices > 0) stats.atvr = stats.transformed / (float)stats.vertices;
+	return stats;
+}
+
+/* Bytes read from memory for the vertices that miss the post-transform cache, through a
+   direct-mapped cache of 128 lines of 64 bytes, over the size of the vertices used.
+   1 means that each vertex was read once */
+float analyseVertexFetch(const unsigned int *indices, size_t indexCount, size_t vertexCount, size_t vertexSize)
+{
+	const size_t lineSize = 64, lineCount = 128;
+	vector<size_t> lines(lineCount, (size_t)-1);
+	FifoCache cache(vertexCount, 16);
+	vector<bool> seen(vertexCount, false);
+	size_t fetched = 0, used = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (!seen[v])
+		{
+			seen[v] = true;
+			used++;
+		}
+		if (!cache.use(v)) continue;
+
+		for (size_t line = v * vertexSize / lineSize; line <= ((v + 1) * vertexSize - 1) / lineSize; line++)
+		{
+			if (lines[line % lineCount] != line)
+			{
+				lines[line % lineCount] = line;
+				fetched += lineSize;
+			}
+		}
+	}
+	return used > 0 ? fetched / (float)(used * vertexSize) : 0.f;
+}
@@ -0,0 +1,36 @@
+/* mesh_optimiser.h
+ Reorders indexed triangle meshes so that the GPU does less work drawing them. This is
+ meant to run once, when a mesh is loaded, in this order:
+	optimiseVertexCache	- Tom Forsyth's linear-speed vertex cache optimisation, so that
+						  triangles reuse the vertices that were just transformed
+	optimiseOverdraw	- splits the cache-friendly order into clusters and draws the ones
+						  facing out from the middle of the mesh first, so that more of the
+						  hidden fragments fail the depth test
+	optimiseVertexFetch	- puts the vertices in the order that the indices first use them
+ analyseVertexCache simulates a FIFO post-transform cache to measure the result, and
+ analyseVertexFetch a small memory cache in front of the vertex buffer.
+ Nothing in here uses OpenGL so the benchmarks can run it too.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+/* Vertex shader invocations per triangle (ACMR, 0.5 at best, 3 at worst) and per
+   vertex used (ATVR, 1 at best) */
+struct VertexCacheStats
+{
+	size_t triangles;
+	size_t vertices;
+	size_t transformed;
+	float acmr;
+	float atvr;
+};
+
+void optimiseVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount);
+void optimiseOverdraw(unsigned int *indices, size_t indexCount, const float *positions, size_t positionStride,
+	size_t vertexCount, float threshold = 1.05f);
+size_t optimiseVertexFetch(void *vertices, size_t vertexSize, size_t vertexCount, unsigned int *indices, size_t indexCount);
+
+VertexCacheStats analyseVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+float analyseVertexFetch(const unsigned int *indices, size_t indexCount, size_t vertexCount, size_t vertexSize);
@@ -0,0 +1,427 @@
+/* meshlets.cpp
+ Meshlet building and culling. Meshlets are grown greedily over neighbouring triangles,
+ a little like meshoptimizer's clusteriser. The normal cone test is the one from the
+ cluster culling in Wihlidal, "Optimizing the Graphics Pipeline with Compute" (GDC 2016),
+ made conservative for the whole bounding sphere.
+*/
+
+#include "meshlets.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+#if (GLM_ARCH & GLM_ARCH_SSE2_BIT)
+#define MESHLETS_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+	// Below this many meshlets per thread, starting the threads costs more than it saves
+	const size_t meshletsPerThread = 4096;
+
+	// How much a neighbour facing the other way counts against it, in extra vertices
+	const float coneWeight = 1.f;
+
+	inline const float *positionOf(const float *positions, size_t stride, unsigned int v)
+	{
+		return (const float*)((const unsigned char*)positions + v * stride);
+	}
+
+	/* Orders vertices by position, to find the ones that are in the same place */
+	struct PositionOrder
+	{
+		const float *positions;
+		size_t stride;
+
+		PositionOrder(const float *positions, size_t stride) : positions(positions), stride(stride) {}
+		bool operator()(unsigned int a, unsigned int b) const
+		{
+			const float *pa = positionOf(positions, stride, a), *pb = positionOf(positions, stride, b);
+			if (pa[0] != pb[0]) return pa[0] < pb[0];
+			if (pa[1] != pb[1]) return pa[1] < pb[1];
+			return pa[2] < pb[2];
+		}
+	};
+
+	/* Bounding sphere and normal cone of triangles [first, first + count) */
+	void addMeshlet(MeshletSet &m, const unsigned int *indices, unsigned int firstIndex, size_t first, size_t count,
+		const float *positions, size_t stride)
+	{
+		float lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+		for (size_t i = first; i < first + count; i++)
+		{
+			const float *p = positionOf(positions, stride, indices[i]);
+			for (int c = 0; c < 3; c++)
+			{
+				if (p[c] < lo[c]) lo[c] = p[c];
+				if (p[c] > hi[c]) hi[c] = p[c];
+			}
+		}
+
+		vec3 centre = (vec3(lo[0], lo[1], lo[2]) + vec3(hi[0], hi[1], hi[2])) * 0.5f;
+		float radius = 0.f;
+		for (size_t i = first; i < first + count; i++)
+		{
+			const float *p = positionOf(positions, stride, indices[i]);
+			float d = length(vec3(p[0], p[1], p[2]) - centre);
+			if (d > radius) radius = d;
+		}
+
+		// The axis is the mean of the unit triangle normals, the cone is as wide as the furthest one
+		vector<vec3> normals;
+		normals.reserve(count / 3);
+		vec3 axis(0.f);
+		for (size_t i = first; i < first + count; i += 3)
+		{
+			const float *a = positionOf(positions, stride, indices[i]);
+			const float *b = positionOf(positions, stride, indices[i + 1]);
+			const float *c = positionOf(positions, stride, indices[i + 2]);
+			vec3 n = cross(vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+			float area = length(n);
+			if (area <= 0.f) continue;		// degenerate triangles can't be seen from either side
+			normals.push_back(n / area);
+			axis += normals.back();
+		}
+
+		float coneCos = 0.f;
+		float axisLength = length(axis);
+		if (axisLength > 1e-6f)
+		{
+			axis /= axisLength;
+			coneCos = 1.f;
+			for (size_t i = 0; i < normals.size(); i++)
+			{
+				float d = dot(normals[i], axis);
+				if (d < coneCos) coneCos = d;
+			}
+		}
+
+		// Normals spread over a hemisphere or more can always be seen from somewhere, so the cone test must never pass
+		if (coneCos <= 0.f)
+		{
+			axis = vec3(0.f, 0.f, 1.f);
+			coneCos = 0.f;
+		}
+
+		m.firstIndex.push_back(firstIndex + (unsigned int)first);
+		m.indexCount.push_back((unsigned int)count);
+		m.centreX.push_back(centre.x); m.centreY.push_back(centre.y); m.centreZ.push_back(centre.z);
+		m.radius.push_back(radius);
+		m.axisX.push_back(axis.x); m.axisY.push_back(axis.y); m.axisZ.push_back(axis.z);
+		m.coneCos.push_back(coneCos);
+		m.coneSin.push_back(sqrt(1.f - coneCos * coneCos));
+	}
+
+	/* Add a meshlet's triangles to the reordered indices in the order they came in, which keeps
+	   the vertex cache order within the meshlet, and work out its bounds */
+	void finishMeshlet(MeshletSet &m, vector<unsigned int> &triangles, const unsigned int *indices, vector<unsigned int> &ordered,
+		unsigned int firstIndex, const float *positions, size_t stride)
+	{
+		sort(triangles.begin(), triangles.end());
+		size_t start = ordered.size();
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			for (int c = 0; c < 3; c++) ordered.push_back(indices[triangles[i] * 3 + c]);
+		}
+		addMeshlet(m, &ordered[0], firstIndex, start, ordered.size() - start, positions, stride);
+		triangles.clear();
+	}
+
+	/* A meshlet is culled if its sphere is wholly outside one plane, or if every triangle's
+	   plane has the camera behind it. With d from the camera to the centre, the smallest
+	   dot(n, d) for a normal in the cone is dot(axis, d) cos - |axis x d| sin, and each
+	   triangle is at most the radius from the centre */
+	size_t cullScalar(const MeshletSet &m, const MeshletCullView &view, unsigned char *visible, size_t first, size_t last)
+	{
+		size_t count = 0;
+		for (size_t i = first; i < last; i++)
+		{
+			float x = m.centreX[i], y = m.centreY[i], z = m.centreZ[i], r = m.radius[i];
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				inside = view.planes[p][0] * x + view.planes[p][1] * y + view.planes[p][2] * z + view.planes[p][3] >= -r;
+			}
+
+			if (inside && view.backfaces)
+			{
+				float dx = x - view.camera[0], dy = y - view.camera[1], dz = z - view.camera[2];
+				float along = m.axisX[i] * dx + m.axisY[i] * dy + m.axisZ[i] * dz;
+				float across = sqrt(fmax(dx * dx + dy * dy + dz * dz - along * along, 0.f));
+				inside = along * m.coneCos[i] - across * m.coneSin[i] <= r;
+			}
+
+			visible[i] = inside;
+			count += inside;
+		}
+		return count;
+	}
+
+#ifdef MESHLETS_HAS_SSE2
+	/* The same tests for four meshlets at a time, finishing off with the scalar version */
+	size_t cullSSE2(const MeshletSet &m, const MeshletCullView &view, unsigned char *visible, size_t first, size_t last)
+	{
+		__m128 planes[6][4];
+		for (int p = 0; p < 6; p++)
+			for (int c = 0; c < 4; c++) planes[p][c] = _mm_set1_ps(view.planes[p][c]);
+		__m128 cameraX = _mm_set1_ps(view.camera[0]), cameraY = _mm_set1_ps(view.camera[1]), cameraZ = _mm_set1_ps(view.camera[2]);
+		__m128 zero = _mm_setzero_ps();
+
+		size_t count = 0, i = first;
+		for (; i + 4 <= last; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&m.centreX[i]), y = _mm_loadu_ps(&m.centreY[i]), z = _mm_loadu_ps(&m.centreZ[i]);
+			__m128 r = _mm_loadu_ps(&m.radius[i]);
+			__m128 negativeR = _mm_sub_ps(zero, r);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+					_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negativeR));
+			}
+
+			if (view.backfaces)
+			{
+				__m128 dx = _mm_sub_ps(x, cameraX), dy = _mm_sub_ps(y, cameraY), dz = _mm_sub_ps(z, cameraZ);
+				__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m.axisX[i]), dx), _mm_mul_ps(_mm_loadu_ps(&m.axisY[i]), dy)),
+					_mm_mul_ps(_mm_loadu_ps(&m.axisZ[i]), dz));
+				__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(distance2, _mm_mul_ps(along, along)), zero));
+				__m128 nearest = _mm_sub_ps(_mm_mul_ps(along, _mm_loadu_ps(&m.coneCos[i])), _mm_mul_ps(across, _mm_loadu_ps(&m.coneSin[i])));
+				inside = _mm_and_ps(inside, _mm_cmple_ps(nearest, r));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			visible[i] = mask & 1;
+			visible[i + 1] = (mask >> 1) & 1;
+			visible[i + 2] = (mask >> 2) & 1;
+			visible[i + 3] = (mask >> 3) & 1;
+			count += visible[i] + visible[i + 1] + visible[i + 2] + visible[i + 3];
+		}
+		return count + cullScalar(m, view, visible, i, last);
+	}
+#endif
+
+	size_t cullRange(const MeshletSet &m, const MeshletCullView &view, unsigned char *visible, size_t first, size_t last, bool simd)
+	{
+#ifdef MESHLETS_HAS_SSE2
+		if (simd) return cullSSE2(m, view, visible, first, last);
+#endif
+		return cullScalar(m, view, visible, first, last);
+	}
+}
+
+void MeshletSet::clear()
+{
+	firstIndex.clear(); indexCount.clear();
+	centreX.clear(); centreY.clear(); centreZ.clear(); radius.clear();
+	axisX.clear(); axisY.clear(); axisZ.clear();
+	coneCos.clear(); coneSin.clear();
+}
+
+/* Add meshlets for indices[0 .. indexCount-1], reordering the triangles so that each meshlet's
+   are consecutive. A meshlet grows from a seed triangle by adding the neighbouring triangle
+   that needs the fewest new vertices and is closest to facing the same way as the rest,
+   until the next would need more than maxVertices vertices or make more than maxTriangles
+   triangles. Seeds are taken in the order the triangles came in, which keeps most of the
+   vertex cache order. firstIndex is where indices starts in the element buffer.
+   Returns the number of meshlets added */
+size_t buildMeshlets(MeshletSet &meshlets, unsigned int *indices, size_t indexCount, unsigned int firstIndex,
+	const float *positions, size_t positionStride, size_t vertexCount, unsigned int maxVertices, unsigned int maxTriangles)
+{
+	size_t before = meshlets.size();
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return 0;
+
+	/* The triangles around each position. Vertices at the same position are one corner here,
+	   so that faces split by their normals or texture coordinates are still neighbours */
+	vector<unsigned int> corner(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) corner[v] = (unsigned int)v;
+	sort(corner.begin(), corner.end(), PositionOrder(positions, positionStride));
+	vector<unsigned int> positionOfVertex(vertexCount);
+	unsigned int positionCount = 0;
+	for (size_t k = 0; k < vertexCount; k++)
+	{
+		if (k > 0 && PositionOrder(positions, positionStride)(corner[k - 1], corner[k])) positionCount++;
+		positionOfVertex[corner[k]] = positionCount;
+	}
+	positionCount++;
+	vector<unsigned int>().swap(corner);
+
+	vector<unsigned int> offsets(positionCount + 1, 0), adjacency(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount * 3; i++) offsets[positionOfVertex[indices[i]] + 1]++;
+	for (size_t p = 0; p < positionCount; p++) offsets[p + 1] += offsets[p];
+	vector<unsigned int> live(positionCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int p = positionOfVertex[indices[i]];
+		adjacency[offsets[p] + live[p]++] = (unsigned int)(i / 3);
+	}
+
+	vector<vec3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const float *a = positionOf(positions, positionStride, indices[t * 3]);
+		const float *b = positionOf(positions, positionStride, indices[t * 3 + 1]);
+		const float *c = positionOf(positions, positionStride, indices[t * 3 + 2]);
+		vec3 n = cross(vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+		float area = length(n);
+		normals[t] = (area > 0.f) ? n / area : vec3(0.f);
+	}
+
+	// The meshlet that last used each vertex, numbered from 1 so that 0 means none
+	vector<unsigned int> usedBy(vertexCount, 0);
+	vector<unsigned int> meshletVertices, meshletTriangles;
+	vector<unsigned char> emitted(triangleCount, 0);
+	vector<unsigned int> ordered;
+	ordered.reserve(triangleCount * 3);
+
+	unsigned int meshlet = 1, last = 0;
+	size_t seed = 0;
+	vec3 axis(0.f);
+
+	for (size_t added = 0; added < triangleCount; added++)
+	{
+		// The best unused neighbour of the last triangle, or failing that of any vertex in the meshlet
+		unsigned int best = ~0u;
+		float bestScore = 1e30f;
+		vec3 facing = (length(axis) > 0.f) ? normalize(axis) : axis;
+		for (int pass = 0; pass < 2 && best == ~0u && !meshletTriangles.empty(); pass++)
+		{
+			size_t around = pass ? meshletVertices.size() : 3;
+			for (size_t k = 0; k < around; k++)
+			{
+				unsigned int p = positionOfVertex[pass ? meshletVertices[k] : indices[last * 3 + k]];
+				for (unsigned int a = offsets[p]; a < offsets[p] + live[p]; a++)
+				{
+					unsigned int t = adjacency[a];
+
+					int extra = 0;
+					for (int c = 0; c < 3; c++) extra += (usedBy[indices[t * 3 + c]] != meshlet);
+					float score = extra + (1.f - dot(normals[t], facing)) * coneWeight;
+					if (score < bestScore)
+					{
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+		}
+
+		if (best == ~0u)
+		{
+			while (emitted[seed]) seed++;
+			best = (unsigned int)seed;
+		}
+
+		// Start a new meshlet, with this triangle, if it doesn't fit
+		unsigned int extra = 0;
+		for (int c = 0; c < 3; c++) extra += (usedBy[indices[best * 3 + c]] != meshlet);
+		if (!meshletTriangles.empty() && (meshletVertices.size() + extra > maxVertices || meshletTriangles.size() >= maxTriangles))
+		{
+			finishMeshlet(meshlets, meshletTriangles, indices, ordered, firstIndex, positions, positionStride);
+			meshlet++;
+			meshletVertices.clear();
+			axis = vec3(0.f);
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[best * 3 + c];
+			if (usedBy[v] != meshlet)
+			{
+				usedBy[v] = meshlet;
+				meshletVertices.push_back(v);
+			}
+		}
+		emitted[best] = 1;
+		meshletTriangles.push_back(best);
+
+		// Take it out of the lists of triangles around its corners
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int p = positionOfVertex[indices[best * 3 + c]];
+			for (unsigned int a = offsets[p]; a < offsets[p] + live[p]; a++)
+			{
+				if (adjacency[a] != best) continue;
+				adjacency[a] = adjacency[offsets[p] + --live[p]];
+				break;
+			}
+		}
+		axis += normals[best];
+		last = best;
+	}
+	finishMeshlet(meshlets, meshletTriangles, indices, ordered, firstIndex, positions, positionStride);
+
+	copy(ordered.begin(), ordered.end(), indices);
+	return meshlets.size() - before;
+}
+
+/* Cull with the frustum of projection * modelView, where modelView takes the meshlets'
+   space to eye space. The planes are found as in Gribb and Hartmann */
+MeshletCullView makeCullView(const mat4 &modelView, const mat4 &projection, bool backfaces)
+{
+	MeshletCullView view;
+	mat4 clip = projection * modelView;
+	for (int p = 0; p < 6; p++)
+	{
+		// left, right, bottom, top, near, far: row 3 plus or minus rows 0, 1 and 2
+		int row = p / 2;
+		float sign = (p & 1) ? -1.f : 1.f;
+		vec4 plane;
+		for (int c = 0; c < 4; c++) plane[c] = clip[c][3] + sign * clip[c][row];
+
+		float scale = length(vec3(plane));
+		if (scale > 0.f) plane /= scale;
+		for (int c = 0; c < 4; c++) view.planes[p][c] = plane[c];
+	}
+
+	vec4 camera = inverse(modelView) * vec4(0.f, 0.f, 0.f, 1.f);
+	view.camera[0] = camera.x / camera.w;
+	view.camera[1] = camera.y / camera.w;
+	view.camera[2] = camera.z / camera.w;
+	view.backfaces = backfaces;
+	return view;
+}
+
+/* Set visible[i] to 1 for each meshlet that may be seen and 0 for the rest, and return
+   how many may be seen. threads = 0 uses as many threads as are worth starting */
+size_t cullMeshlets(const MeshletSet &meshlets, const MeshletCullView &view, unsigned char *visible, unsigned int threads, bool simd)
+{
+	size_t count = meshlets.size();
+	if (threads == 0)
+	{
+		threads = thread::hardware_concurrency();
+		size_t worthwhile = count / meshletsPerThread;
+		if (threads > worthwhile) threads = (unsigned int)worthwhile;
+	}
+	if (threads <= 1) return cullRange(meshlets, view, visible, 0, count, simd);
+
+	// Split into ranges of whole SIMD groups, the calling thread takes the first
+	vector<thread> workers;
+	vector<size_t> counts(threads, 0);
+	size_t chunk = (count / threads + 3) & ~(size_t)3;
+	for (unsigned int t = 1; t < threads; t++)
+	{
+		size_t first = t * chunk, last = (t + 1 == threads) ? count : first + chunk;
+		if (first >= count) break;
+		if (last > count) last = count;
+		workers.push_back(thread([&meshlets, &view, visible, &counts, t, first, last, simd]()
+		{
+			counts[t] = cullRange(meshlets, view, visible, first, last, simd);
+		}));
+	}
+	counts[0] = cullRange(meshlets, view, visible, 0, chunk < count ? chunk : count, simd);
+
+	size_t total = 0;
+	for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+	for (unsigned int t = 0; t < threads; t++) total += counts[t];
+	return total;
+}
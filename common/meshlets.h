@@ -0,0 +1,46 @@
+/* meshlets.h
+ Splits an indexed triangle mesh into meshlets, small runs of consecutive triangles that
+ use at most 64 vertices, and culls them on the CPU each frame so that only the parts of a
+ large model that can be seen are drawn.
+ Each meshlet has a bounding sphere, tested against the view frustum, and a cone that
+ holds all of its triangle normals, so that a meshlet whose triangles all face away from
+ the camera can be dropped when back faces aren't drawn.
+ Building the meshlets moves each one's triangles together in the index buffer, keeping
+ the order they came in within a meshlet, so build them after mesh_optimiser has put the
+ triangles in vertex cache order.
+ The bounds are held as structure-of-arrays so that the cull tests four at a time with
+ SSE2, and large sets are split between threads.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+struct MeshletSet
+{
+	std::vector<unsigned int> firstIndex, indexCount;
+	std::vector<float> centreX, centreY, centreZ, radius;
+	std::vector<float> axisX, axisY, axisZ;		// mean normal of the triangles
+	std::vector<float> coneCos, coneSin;		// of the widest angle from the axis to a normal
+
+	size_t size() const { return firstIndex.size(); }
+	void clear();
+};
+
+/* The frustum planes and camera position in the meshlets' own space */
+struct MeshletCullView
+{
+	float planes[6][4];
+	float camera[3];
+	bool backfaces;		// also cull meshlets that face away from the camera
+};
+
+size_t buildMeshlets(MeshletSet &meshlets, unsigned int *indices, size_t indexCount, unsigned int firstIndex,
+	const float *positions, size_t positionStride, size_t vertexCount,
+	unsigned int maxVertices = 64, unsigned int maxTriangles = 124);
+
+MeshletCullView makeCullView(const glm::mat4 &modelView, const glm::mat4 &projection, bool backfaces);
+size_t cullMeshlets(const MeshletSet &meshlets, const MeshletCullView &view, unsigned char *visible,
+	unsigned int threads = 0, bool simd = true);
@@ -0,0 +1,214 @@
+/* occlusion_buffer.cpp
+ Rasterises occluder boxes into a coarse depth buffer and tests bounding boxes against it.
+*/
+
+#include "occlusion_buffer.h"
+#include <cmath>
+#include <algorithm>
+
+#if (GLM_ARCH & GLM_ARCH_SSE2_BIT)
+#define OCCLUSION_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+// Corners closer to the camera than this are taken to be clipped by the near plane
+static const float nearestW = 1e-3f;
+
+// The twelve triangles of a box, as corners numbered with x in bit 0, y in bit 1 and z in bit 2
+static const int boxTriangles[12][3] = {
+	{ 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 },
+	{ 0, 1, 4 }, { 1, 5, 4 }, { 2, 6, 3 }, { 3, 6, 7 },
+	{ 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 }
+};
+
+OcclusionBuffer::OcclusionBuffer()
+{
+	width = height = 0;
+}
+
+/* The width is rounded up to whole groups of four pixels */
+void OcclusionBuffer::makeBuffer(unsigned int width, unsigned int height)
+{
+	this->width = (width + 3) & ~3u;
+	this->height = height;
+	depth.assign(this->width * height, 1.f);
+}
+
+/* Forget the last frame's occluders and set the camera for this one */
+void OcclusionBuffer::beginFrame(const mat4 &viewProjection)
+{
+	if (width == 0) makeBuffer();
+	this->viewProjection = viewProjection;
+	triangles.clear();
+}
+
+/* Add a box, in the space of the model matrix, that hides everything behind it. Boxes that reach
+   behind the camera are left out, which only means that less is hidden */
+void OcclusionBuffer::addOccluder(const mat4 &model, const vec3 &lower, const vec3 &upper)
+{
+	mat4 transform = viewProjection * model;
+	vec3 corners[8];
+	for (int c = 0; c < 8; c++)
+	{
+		vec4 clip = transform * vec4((c & 1) ? upper.x : lower.x, (c & 2) ? upper.y : lower.y, (c & 4) ? upper.z : lower.z, 1.f);
+		if (clip.w < nearestW) return;
+		corners[c] = vec3((clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height,
+			clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	for (int t = 0; t < 12; t++)
+	{
+		const vec3 &a = corners[boxTriangles[t][0]];
+		vec3 b = corners[boxTriangles[t][1]], c = corners[boxTriangles[t][2]];
+
+		// Both sides of the box are drawn, turned the same way round so that inside is positive
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (fabs(area) < 1e-6f) continue;
+		if (area < 0.f) swap(b, c);
+
+		float top = std::max(a.y, std::max(b.y, c.y)), bottom = std::min(a.y, std::min(b.y, c.y));
+		if (top < 0.f || bottom >= (float)height) continue;
+		if (std::max(a.x, std::max(b.x, c.x)) < 0.f || std::min(a.x, std::min(b.x, c.x)) >= (float)width) continue;
+
+		Triangle triangle;
+		triangle.x[0] = a.x; triangle.x[1] = b.x; triangle.x[2] = c.x;
+		triangle.y[0] = a.y; triangle.y[1] = b.y; triangle.y[2] = c.y;
+		triangle.z[0] = a.z; triangle.z[1] = b.z; triangle.z[2] = c.z;
+		triangle.minY = std::max((int)floor(bottom), 0);
+		triangle.maxY = std::min((int)ceil(top), (int)height - 1);
+		triangles.push_back(triangle);
+	}
+}
+
+/* Clear the buffer and draw the occluders into it, in bands of rows shared out over the pool */
+void OcclusionBuffer::rasterise(JobPool *pool, bool simd)
+{
+	const unsigned int bandRows = 8;
+	unsigned int bands = (height + bandRows - 1) / bandRows;
+	if (pool)
+	{
+		pool->run(bands, 1, [this, simd](size_t first, size_t last, unsigned int)
+		{
+			for (size_t b = first; b < last; b++)
+			{
+				rasteriseBand((unsigned int)b * bandRows, std::min((unsigned int)(b + 1) * bandRows, height), simd);
+			}
+		});
+	}
+	else
+	{
+		for (unsigned int b = 0; b < bands; b++) rasteriseBand(b * bandRows, std::min((b + 1) * bandRows, height), simd);
+	}
+}
+
+/* Draw every triangle that reaches rows [firstRow, lastRow), keeping the nearest depth. A pixel is
+   covered when its centre is inside all three edges */
+void OcclusionBuffer::rasteriseBand(unsigned int firstRow, unsigned int lastRow, bool simd)
+{
+	fill(depth.begin() + firstRow * width, depth.begin() + lastRow * width, 1.f);
+
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		const Triangle &tri = triangles[t];
+		int rowStart = std::max(tri.minY, (int)firstRow), rowEnd = std::min(tri.maxY, (int)lastRow - 1);
+		if (rowStart > rowEnd) continue;
+
+		// Edge i runs from vertex i to the next, and is A * x + B * y + C, positive on the inside
+		float A[3], B[3], C[3];
+		for (int e = 0; e < 3; e++)
+		{
+			int n = (e + 1) % 3;
+			A[e] = tri.y[e] - tri.y[n];
+			B[e] = tri.x[n] - tri.x[e];
+			C[e] = tri.x[e] * tri.y[n] - tri.x[n] * tri.y[e];
+		}
+
+		// The depth plane z = dzdx * x + dzdy * y + z0
+		float area = A[0] * tri.x[2] + B[0] * tri.y[2] + C[0];
+		float dzdx = (A[1] * tri.z[0] + A[2] * tri.z[1] + A[0] * tri.z[2]) / area;
+		float dzdy = (B[1] * tri.z[0] + B[2] * tri.z[1] + B[0] * tri.z[2]) / area;
+		float z0 = tri.z[0] - dzdx * tri.x[0] - dzdy * tri.y[0];
+
+		float left = std::min(tri.x[0], std::min(tri.x[1], tri.x[2])), right = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+		int columnStart = std::max((int)floor(left), 0) & ~3, columnEnd = std::min((int)ceil(right), (int)width - 1);
+
+		for (int y = rowStart; y <= rowEnd; y++)
+		{
+			float py = y + 0.5f;
+			float row[3] = { B[0] * py + C[0], B[1] * py + C[1], B[2] * py + C[2] };
+			float rowDepth = dzdy * py + z0;
+			float *line = &depth[y * width];
+			int x = columnStart;
+#ifdef OCCLUSION_HAS_SSE2
+			if (simd)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+				const __m128 four = _mm_set1_ps(4.f), zero = _mm_setzero_ps();
+				const __m128 a0 = _mm_set1_ps(A[0]), a1 = _mm_set1_ps(A[1]), a2 = _mm_set1_ps(A[2]), dz = _mm_set1_ps(dzdx);
+				const __m128 r0 = _mm_set1_ps(row[0]), r1 = _mm_set1_ps(row[1]), r2 = _mm_set1_ps(row[2]), rz = _mm_set1_ps(rowDepth);
+				for (; x <= columnEnd; x += 4, px = _mm_add_ps(px, four))
+				{
+					__m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), r0), zero),
+						_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), r1), zero),
+							_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), r2), zero)));
+					if (_mm_movemask_ps(inside) == 0) continue;
+
+					__m128 stored = _mm_loadu_ps(line + x);
+					__m128 nearer = _mm_min_ps(stored, _mm_add_ps(_mm_mul_ps(dz, px), rz));
+					_mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+				}
+			}
+#endif
+			for (; x <= columnEnd; x++)
+			{
+				float px = x + 0.5f;
+				if (A[0] * px + row[0] < 0.f || A[1] * px + row[1] < 0.f || A[2] * px + row[2] < 0.f) continue;
+				line[x] = std::min(line[x], dzdx * px + rowDepth);
+			}
+		}
+	}
+}
+
+/* Whether any of a box, in the space of the model matrix, might be in front of the occluders.
+   Boxes that reach behind the camera are always visible */
+bool OcclusionBuffer::visible(const mat4 &model, const vec3 &lower, const vec3 &upper) const
+{
+	mat4 transform = viewProjection * model;
+	vec2 low(1e30f), high(-1e30f);
+	float nearest = 1.f;
+	for (int c = 0; c < 8; c++)
+	{
+		vec4 clip = transform * vec4((c & 1) ? upper.x : lower.x, (c & 2) ? upper.y : lower.y, (c & 4) ? upper.z : lower.z, 1.f);
+		if (clip.w < nearestW) return true;
+		vec2 screen((clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height);
+		low = glm::min(low, screen);
+		high = glm::max(high, screen);
+		nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	// Every pixel that the box touches any part of
+	int x0 = std::max((int)floor(low.x), 0), x1 = std::min((int)ceil(high.x), (int)width);
+	int y0 = std::max((int)floor(low.y), 0), y1 = std::min((int)ceil(high.y), (int)height);
+	if (x0 >= x1 || y0 >= y1) return false;
+
+	for (int y = y0; y < y1; y++)
+	{
+		const float *line = &depth[y * width];
+		int x = x0;
+#ifdef OCCLUSION_HAS_SSE2
+		__m128 boxDepth = _mm_set1_ps(nearest);
+		for (; x + 4 <= x1; x += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(line + x), boxDepth))) return true;
+		}
+#endif
+		for (; x < x1; x++)
+		{
+			if (line[x] >= nearest) return true;
+		}
+	}
+	return false;
+}
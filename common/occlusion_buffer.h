@@ -0,0 +1,49 @@
+/* occlusion_buffer.h
+ Software occlusion culling. A few large, simple occluders, like boxes inside walls and
+ shelves, are rasterised on the CPU into a small depth buffer, 256 x 128 by default, and
+ objects are then tested against it by their bounding boxes before their draws are
+ submitted. An object is only hidden if every pixel its box could cover already has an
+ occluder in front of the box's nearest point.
+ The occluders must be inside the things that hide, never bigger than them, since anything
+ behind them is taken to be hidden.
+ The buffer is rasterised in bands of rows on a JobPool, four pixels at a time with SSE2,
+ and once it is built visible() only reads it, so any number of threads can test against it.
+ Nothing in here uses OpenGL, so it works the same whatever the GPU.
+*/
+
+#pragma once
+
+#include "job_pool.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer();
+
+	void makeBuffer(unsigned int width = 256, unsigned int height = 128);
+
+	void beginFrame(const glm::mat4 &viewProjection);
+	void addOccluder(const glm::mat4 &model, const glm::vec3 &lower, const glm::vec3 &upper);
+	void rasterise(JobPool *pool = NULL, bool simd = true);
+
+	bool visible(const glm::mat4 &model, const glm::vec3 &lower, const glm::vec3 &upper) const;
+
+	unsigned int width, height;
+	std::vector<float> depth;		// nearest occluder of each pixel, as window depth from 0 to 1, rows from the bottom
+	size_t triangleCount() const { return triangles.size(); }
+
+private:
+	// A screen space triangle, wound so that its edge functions are positive inside
+	struct Triangle
+	{
+		float x[3], y[3], z[3];
+		int minY, maxY;
+	};
+
+	void rasteriseBand(unsigned int firstRow, unsigned int lastRow, bool simd);
+
+	glm::mat4 viewProjection;
+	std::vector<Triangle> triangles;
+};
@@ -0,0 +1,149 @@
+/* overdraw_counter.cpp
+ Additive fragment counts and a samples passed query for measuring overdraw.
+*/
+
+#include "overdraw_counter.h"
+#include <iostream>
+
+using namespace std;
+
+OverdrawCounter::OverdrawCounter()
+{
+	width = height = 0;
+	framebuffer = countTexture = depthBuffer = emptyVertexArray = 0;
+	queryIndex = 0;
+	counting = false;
+	fragments = pixels = 0;
+}
+
+OverdrawCounter::~OverdrawCounter()
+{
+}
+
+/* Create the count framebuffer at the size of the window. The samples passed results are read
+   framesInFlight - 1 frames after they were counted */
+void OverdrawCounter::makeCounter(GLsizei width, GLsizei height, GLuint framesInFlight)
+{
+	glGenFramebuffers(1, &framebuffer);
+	glGenTextures(1, &countTexture);
+	glGenRenderbuffers(1, &depthBuffer);
+	glGenVertexArrays(1, &emptyVertexArray);
+
+	queries.resize(framesInFlight > 1 ? framesInFlight : 2);
+	glGenQueries((GLsizei)queries.size(), &queries[0]);
+	queryPixels.assign(queries.size(), 0.0);
+
+	this->width = width;
+	this->height = height;
+	allocate();
+}
+
+/* Reallocate the count and depth buffers when the window changes size */
+void OverdrawCounter::resize(GLsizei width, GLsizei height)
+{
+	if (width == this->width && height == this->height) return;
+	this->width = width;
+	this->height = height;
+	if (framebuffer) allocate();
+}
+
+void OverdrawCounter::allocate()
+{
+	GLsizei w = width > 0 ? width : 1, h = height > 0 ? height : 1;
+
+	glBindTexture(GL_TEXTURE_2D, countTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, w, h, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, countTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		cout << "Overdraw framebuffer is incomplete" << endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* Draw into the cleared count framebuffer until unbind(), adding up. A depth pre-pass drawn
+   with the colour masked off doesn't add anything to the heat map */
+void OverdrawCounter::bind()
+{
+	const GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glDrawBuffers(1, &drawBuffer);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+}
+
+/* Count the fragments that pass the depth test until endCount(), for fragmentsPerPixel().
+   Call it once a frame, around the draws that shade */
+void OverdrawCounter::beginCount()
+{
+	// Take in the oldest query's result before it is used again
+	queryIndex = (queryIndex + 1) % queries.size();
+	if (queryPixels[queryIndex] > 0)
+	{
+		GLuint samples = 0;
+		glGetQueryObjectuiv(queries[queryIndex], GL_QUERY_RESULT, &samples);
+		fragments += samples;
+		pixels += queryPixels[queryIndex];
+	}
+	queryPixels[queryIndex] = (double)width * height;
+
+	glBeginQuery(GL_SAMPLES_PASSED, queries[queryIndex]);
+	counting = true;
+}
+
+void OverdrawCounter::endCount()
+{
+	if (!counting) return;
+	glEndQuery(GL_SAMPLES_PASSED);
+	counting = false;
+}
+
+void OverdrawCounter::unbind()
+{
+	endCount();
+	glDisable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* Draw the counts over the whole window. The program reads them from the "overdrawCount" texture */
+void OverdrawCounter::show(GLuint heatMapProgram)
+{
+	glUseProgram(heatMapProgram);
+	glUniform1i(glGetUniformLocation(heatMapProgram, "overdrawCount"), 0);
+	glBindTexture(GL_TEXTURE_2D, countTexture);
+
+	GLint previous;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(previous);
+	glEnable(GL_DEPTH_TEST);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+double OverdrawCounter::fragmentsPerPixel() const
+{
+	return pixels > 0 ? fragments / pixels : 0.0;
+}
+
+/* Start the average again, dropping the counts still on their way */
+void OverdrawCounter::reset()
+{
+	fragments = pixels = 0;
+	queryPixels.assign(queries.size(), 0.0);
+}
@@ -0,0 +1,51 @@
+/* overdraw_counter.h
+ Measures overdraw: how many fragments are shaded for each pixel of a pass. While counting,
+ the pass is drawn into a framebuffer of its own with a program that writes 1 to every
+ fragment and additive blending, so each pixel ends up holding the number of fragments that
+ passed the depth test there. show() draws the counts to the window as a heat map.
+ A GL_SAMPLES_PASSED query gives the average per pixel, read back a few frames later so that
+ the CPU doesn't wait for it. It only runs between beginCount() and endCount(), so that a depth
+ pre-pass drawn while the counter is bound can be left out of it and only the fragments that
+ are shaded are counted.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include <vector>
+
+class OverdrawCounter
+{
+public:
+	OverdrawCounter();
+	~OverdrawCounter();
+
+	void makeCounter(GLsizei width, GLsizei height, GLuint framesInFlight = 4);
+	void resize(GLsizei width, GLsizei height);
+
+	void bind();
+	void beginCount();
+	void endCount();
+	void unbind();
+	void show(GLuint heatMapProgram);
+
+	double fragmentsPerPixel() const;		// averaged over the frames counted since reset()
+	void reset();
+
+	GLsizei width, height;
+
+private:
+	void allocate();
+
+	GLuint framebuffer;
+	GLuint countTexture;		// GL_R16F, blended additively
+	GLuint depthBuffer;
+	GLuint emptyVertexArray;	// the heat map's full-screen triangle is made from gl_VertexID
+
+	std::vector<GLuint> queries;
+	std::vector<double> queryPixels;		// pixels in the frame each query counted, 0 when it has no result waiting
+	bool counting;
+	GLuint queryIndex;
+
+	double fragments, pixels;
+};
@@ -0,0 +1,142 @@
+/* png_writer.cpp
+ Uncompressed PNG encoding: a zlib stream of stored deflate blocks, with the CRC and Adler checksums.
+*/
+
+#include "png_writer.h"
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+/* The CRC-32 of PNG chunks, a byte at a time from a table. The table is a local static so that
+   it is made once, safely, whichever thread gets here first */
+struct CrcTable
+{
+	unsigned int entries[256];
+
+	CrcTable()
+	{
+		for (unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			entries[n] = c;
+		}
+	}
+};
+
+static unsigned int crc32(const unsigned char *data, size_t length)
+{
+	static const CrcTable table;
+	unsigned int crc = 0xffffffffu;
+	for (size_t i = 0; i < length; i++) crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void putBigEndian(vector<unsigned char> &out, unsigned int value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+/* A chunk is its length, its type, its data and the CRC of the type and data */
+static void putChunk(vector<unsigned char> &out, const char *type, const unsigned char *data, size_t length)
+{
+	putBigEndian(out, (unsigned int)length);
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	if (length) out.insert(out.end(), data, data + length);
+	putBigEndian(out, crc32(&out[start], length + 4));
+}
+
+void encodePNG(vector<unsigned char> &png, unsigned int width, unsigned int height, unsigned int channels,
+	const unsigned char *pixels, size_t rowStride, bool bottomUp)
+{
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	static const unsigned char colourTypes[5] = { 0, 0, 4, 2, 6 };
+	size_t rowBytes = (size_t)width * channels;
+	if (rowStride == 0) rowStride = rowBytes;
+
+	png.assign(signature, signature + 8);
+
+	vector<unsigned char> header;
+	putBigEndian(header, width);
+	putBigEndian(header, height);
+	header.push_back(8);							// bits per channel
+	header.push_back(colourTypes[channels]);
+	header.push_back(0);							// deflate
+	header.push_back(0);							// adaptive filtering
+	header.push_back(0);							// not interlaced
+	putChunk(png, "IHDR", &header[0], header.size());
+
+	// The filtered image is each row with a filter type of 0, none, in front of it
+	size_t rawSize = (rowBytes + 1) * height;
+	const size_t blockSize = 65535;
+	size_t blocks = std::max((rawSize + blockSize - 1) / blockSize, (size_t)1);
+
+	vector<unsigned char> stream;
+	stream.reserve(2 + rawSize + blocks * 5 + 4);
+	stream.push_back(0x78);		// deflate with a 32K window
+	stream.push_back(0x01);		// no preset dictionary, the header is a multiple of 31
+
+	unsigned int a = 1, b = 0;		// Adler-32 of the raw data
+	size_t row = 0, column = 0, left = rawSize;
+	for (size_t block = 0; block < blocks; block++)
+	{
+		unsigned int length = (unsigned int)std::min(left, blockSize);
+		left -= length;
+		stream.push_back(left == 0 ? 1 : 0);		// last block or not, stored
+		stream.push_back((unsigned char)length);
+		stream.push_back((unsigned char)(length >> 8));
+		stream.push_back((unsigned char)~length);
+		stream.push_back((unsigned char)(~length >> 8));
+
+		while (length > 0)
+		{
+			const unsigned char *line = pixels + (bottomUp ? height - 1 - row : row) * rowStride;
+			size_t count;
+			if (column == 0)
+			{
+				stream.push_back(0);
+				count = 1;
+			}
+			else
+			{
+				count = std::min((size_t)length, rowBytes - (column - 1));
+				stream.insert(stream.end(), line + column - 1, line + column - 1 + count);
+			}
+
+			for (size_t i = stream.size() - count; i < stream.size(); i++)
+			{
+				a = (a + stream[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+			length -= (unsigned int)count;
+			column += count;
+			if (column == rowBytes + 1)
+			{
+				column = 0;
+				row++;
+			}
+		}
+	}
+	putBigEndian(stream, (b << 16) | a);
+
+	putChunk(png, "IDAT", &stream[0], stream.size());
+	putChunk(png, "IEND", NULL, 0);
+}
+
+bool writePNG(const string &file, unsigned int width, unsigned int height, unsigned int channels,
+	const unsigned char *pixels, size_t rowStride, bool bottomUp)
+{
+	if (channels < 1 || channels > 4 || width == 0 || height == 0) return false;
+
+	vector<unsigned char> png;
+	encodePNG(png, width, height, channels, pixels, rowStride, bottomUp);
+
+	ofstream out(file.c_str(), ios::binary);
+	out.write((const char*)&png[0], png.size());
+	return out.good();
+}
@@ -0,0 +1,22 @@
+/* png_writer.h
+ Writes 8 bit images as PNG files with no other library. The image data is stored in deflate
+ blocks without compressing it, so the files are big but the writer is small and fast, and
+ any PNG reader, stb_image included, can load them.
+ Rows are given from the top unless bottomUp is set, which is how glReadPixels returns them.
+ Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/* channels is 1 for grey, 2 for grey and alpha, 3 for RGB and 4 for RGBA. rowStride is the bytes
+   from one row to the next, 0 for rows that are packed together */
+bool writePNG(const std::string &file, unsigned int width, unsigned int height, unsigned int channels,
+	const unsigned char *pixels, size_t rowStride = 0, bool bottomUp = false);
+
+/* The same, into memory */
+void encodePNG(std::vector<unsigned char> &png, unsigned int width, unsigned int height, unsigned int channels,
+	const unsigned char *pixels, size_t rowStride = 0, bool bottomUp = false);
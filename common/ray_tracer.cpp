@@ -0,0 +1,608 @@
+/* ray_tracer.cpp
+ Builds the bounding volume hierarchy and traces camera and shadow rays through it, one ray or a
+ packet of four at a time.
+*/
+
+#include "ray_tracer.h"
+#include "png_writer.h"
+#include <cmath>
+#include <algorithm>
+
+#if (GLM_ARCH & GLM_ARCH_SSE2_BIT)
+#define RAY_TRACER_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+static const unsigned int noTriangle = ~0u;
+
+/* Dot and cross products written out, so that the scalar and SSE2 tests add up in the same order */
+static inline float dot3(float ax, float ay, float az, float bx, float by, float bz)
+{
+	return ax * bx + ay * by + az * bz;
+}
+
+static float surfaceArea(const vec3 &lower, const vec3 &upper)
+{
+	vec3 size = glm::max(upper - lower, vec3(0.f));
+	return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+RayTracer::RayTracer()
+{
+	width = height = 0;
+	tilesX = tilesY = 0;
+	passes = 0;
+	background = vec3(0.f);
+	inverseViewProjection = mat4(1.0f);
+	lightPosition = vec4(0.f, 0.f, 0.f, 1.f);
+	sunPower = 1.f;
+}
+
+RayTracer::~RayTracer()
+{
+}
+
+/* The frame is traced on threads threads, 0 for one per hardware thread */
+void RayTracer::makeFramebuffer(unsigned int width, unsigned int height, unsigned int threads)
+{
+	this->width = width;
+	this->height = height;
+	tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	colour.assign(width * height * 4, 0);
+	accumulated.assign(width * height * 3, 0.f);
+	tileRays.assign(tilesX * tilesY, 0);
+	passes = 0;
+	if (pool.size() == 0) pool.makePool(threads);
+}
+
+void RayTracer::clearScene()
+{
+	materials.clear();
+	geometry.clear();
+	shading.clear();
+	nodes.clear();
+}
+
+/* Add a mesh's triangles in world space. Call buildBVH() once they are all added */
+void RayTracer::addMesh(const SoftMesh &mesh, const mat4 &model, const SoftMaterial &material)
+{
+	unsigned int materialIndex = (unsigned int)materials.size();
+	materials.push_back(material);
+	mat3 normalMatrix = transpose(inverse(mat3(model)));
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		TriangleShading s;
+		vec3 corners[3];
+		for (int c = 0; c < 3; c++)
+		{
+			const SoftVertex &v = mesh.vertices[mesh.indices[i + c]];
+			corners[c] = vec3(model * vec4(v.position, 1.f));
+			s.normal[c] = normalMatrix * v.normal;
+			s.texcoord[c] = v.texcoord;
+			s.colour[c] = v.colour;
+		}
+		vec3 e1 = corners[1] - corners[0], e2 = corners[2] - corners[0];
+		if (dot(cross(e1, e2), cross(e1, e2)) == 0.f) continue;
+
+		s.material = materialIndex;
+		s.castsShadow = material.lit && !material.emissive;
+		shading.push_back(s);
+
+		TriangleGeometry g;
+		for (int a = 0; a < 3; a++)
+		{
+			g.v0[a] = corners[0][a];
+			g.e1[a] = e1[a];
+			g.e2[a] = e2[a];
+		}
+		geometry.push_back(g);
+	}
+}
+
+/* Build the hierarchy over the triangles added so far, and put the triangles into the order of its leaves */
+void RayTracer::buildBVH()
+{
+	nodes.clear();
+	unsigned int count = (unsigned int)geometry.size();
+	if (count == 0) return;
+
+	vector<vec3> centres(count), lowers(count), uppers(count);
+	for (unsigned int t = 0; t < count; t++)
+	{
+		const TriangleGeometry &g = geometry[t];
+		vec3 a(g.v0[0], g.v0[1], g.v0[2]), b = a + vec3(g.e1[0], g.e1[1], g.e1[2]), c = a + vec3(g.e2[0], g.e2[1], g.e2[2]);
+		lowers[t] = glm::min(a, glm::min(b, c));
+		uppers[t] = glm::max(a, glm::max(b, c));
+		centres[t] = (lowers[t] + uppers[t]) * 0.5f;
+	}
+
+	vector<unsigned int> order(count);
+	for (unsigned int t = 0; t < count; t++) order[t] = t;
+
+	nodes.reserve(count * 2);
+	nodes.push_back(Node());
+	buildNode(0, 0, count, order, centres, lowers, uppers);
+
+	vector<TriangleGeometry> sortedGeometry(count);
+	vector<TriangleShading> sortedShading(count);
+	for (unsigned int t = 0; t < count; t++)
+	{
+		sortedGeometry[t] = geometry[order[t]];
+		sortedShading[t] = shading[order[t]];
+	}
+	geometry.swap(sortedGeometry);
+	shading.swap(sortedShading);
+}
+
+/* Make node the box around triangles [first, first + count) of order, and split them if the surface
+   area heuristic says that testing two boxes first is cheaper than testing every triangle */
+void RayTracer::buildNode(unsigned int node, unsigned int first, unsigned int count, vector<unsigned int> &order,
+	const vector<vec3> &centres, const vector<vec3> &lowers, const vector<vec3> &uppers)
+{
+	vec3 lower(1e30f), upper(-1e30f), centreLower(1e30f), centreUpper(-1e30f);
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		lower = glm::min(lower, lowers[order[i]]);
+		upper = glm::max(upper, uppers[order[i]]);
+		centreLower = glm::min(centreLower, centres[order[i]]);
+		centreUpper = glm::max(centreUpper, centres[order[i]]);
+	}
+	for (int a = 0; a < 3; a++)
+	{
+		nodes[node].lower[a] = lower[a];
+		nodes[node].upper[a] = upper[a];
+	}
+	nodes[node].offset = first;
+	nodes[node].count = (unsigned short)count;
+	nodes[node].axis = 0;
+	if (count <= MAX_LEAF) return;
+
+	vec3 extent = centreUpper - centreLower;
+	int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+
+	// Sort the centres into bins along the longest axis, then try a split between each pair of bins
+	int split = -1;
+	float bestCost = 1e30f;
+	float binScale = (extent[axis] > 0.f) ? BINS * 0.9999f / extent[axis] : 0.f;
+	if (binScale > 0.f)
+	{
+		unsigned int binCount[BINS] = {};
+		vec3 binLower[BINS], binUpper[BINS];
+		for (int b = 0; b < BINS; b++)
+		{
+			binLower[b] = vec3(1e30f);
+			binUpper[b] = vec3(-1e30f);
+		}
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			unsigned int t = order[i];
+			int b = std::min((int)((centres[t][axis] - centreLower[axis]) * binScale), BINS - 1);
+			binCount[b]++;
+			binLower[b] = glm::min(binLower[b], lowers[t]);
+			binUpper[b] = glm::max(binUpper[b], uppers[t]);
+		}
+
+		float leftArea[BINS];
+		unsigned int leftCount[BINS];
+		vec3 l(1e30f), u(-1e30f);
+		unsigned int n = 0;
+		for (int b = 0; b < BINS - 1; b++)
+		{
+			l = glm::min(l, binLower[b]);
+			u = glm::max(u, binUpper[b]);
+			n += binCount[b];
+			leftArea[b] = surfaceArea(l, u);
+			leftCount[b] = n;
+		}
+		l = vec3(1e30f);
+		u = vec3(-1e30f);
+		n = 0;
+		for (int b = BINS - 1; b > 0; b--)
+		{
+			l = glm::min(l, binLower[b]);
+			u = glm::max(u, binUpper[b]);
+			n += binCount[b];
+			if (n == 0 || leftCount[b - 1] == 0) continue;
+			float cost = leftArea[b - 1] * leftCount[b - 1] + surfaceArea(l, u) * n;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				split = b;
+			}
+		}
+	}
+
+	// A box costs as much to test as a triangle
+	float area = surfaceArea(lower, upper);
+	if (split >= 0 && count <= 16 && area + bestCost >= area * count) return;
+
+	unsigned int *begin = &order[first], *end = begin + count, *middle;
+	if (split >= 0)
+	{
+		float scale = binScale, start = centreLower[axis];
+		middle = partition(begin, end, [&](unsigned int t)
+		{
+			return std::min((int)((centres[t][axis] - start) * scale), BINS - 1) < split;
+		});
+	}
+	else
+	{
+		// Every centre is in the same place, so just halve them
+		if (count <= 255) return;
+		middle = begin + count / 2;
+	}
+
+	unsigned int leftCount = (unsigned int)(middle - begin);
+	unsigned int children = (unsigned int)nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	nodes[node].offset = children;
+	nodes[node].count = 0;
+	nodes[node].axis = (unsigned short)axis;
+	buildNode(children, first, leftCount, order, centres, lowers, uppers);
+	buildNode(children + 1, first + leftCount, count - leftCount, order, centres, lowers, uppers);
+}
+
+void RayTracer::setCamera(const mat4 &view, const mat4 &projection)
+{
+	inverseViewProjection = inverse(projection * view);
+}
+
+void RayTracer::setLight(const vec4 &position, float sunPower)
+{
+	lightPosition = position;
+	this->sunPower = sunPower;
+}
+
+void RayTracer::resetAccumulation()
+{
+	fill(accumulated.begin(), accumulated.end(), 0.f);
+	passes = 0;
+}
+
+/* The ray through a point of the screen, in pixels from the top left, from the near plane to the far one */
+RayTracer::Ray RayTracer::cameraRay(float x, float y) const
+{
+	float ndcX = x / width * 2.f - 1.f, ndcY = 1.f - y / height * 2.f;
+	vec4 nearPoint = inverseViewProjection * vec4(ndcX, ndcY, -1.f, 1.f);
+	vec4 farPoint = inverseViewProjection * vec4(ndcX, ndcY, 1.f, 1.f);
+
+	Ray ray;
+	ray.origin = vec3(nearPoint) / nearPoint.w;
+	ray.direction = vec3(farPoint) / farPoint.w - ray.origin;
+	ray.tMax = length(ray.direction);
+	ray.direction /= ray.tMax;
+
+	// Axes the ray runs along exactly would give 0 * infinity in the box tests
+	for (int a = 0; a < 3; a++)
+	{
+		float d = ray.direction[a];
+		ray.inverse[a] = 1.f / ((fabs(d) > 1e-12f) ? d : (d < 0.f ? -1e-12f : 1e-12f));
+	}
+	return ray;
+}
+
+/* The ray from a hit towards the light, if the hit is on something the light reaches. It starts a
+   little off the surface, on the side of the light, so that it doesn't hit the triangle it leaves */
+bool RayTracer::shadowRay(const Ray &ray, const Hit &hit, Ray &toLight) const
+{
+	if (hit.triangle == noTriangle) return false;
+	const SoftMaterial &material = materials[shading[hit.triangle].material];
+	if (!material.lit) return false;
+
+	const TriangleGeometry &g = geometry[hit.triangle];
+	vec3 P = ray.origin + ray.direction * hit.t;
+	vec3 faceNormal = normalize(cross(vec3(g.e1[0], g.e1[1], g.e1[2]), vec3(g.e2[0], g.e2[1], g.e2[2])));
+	vec3 L = vec3(lightPosition) - P;
+	float distance = length(L);
+	if (distance <= 0.f) return false;
+
+	float offset = 1e-4f * (1.f + std::max(fabs(P.x), std::max(fabs(P.y), fabs(P.z))));
+	toLight.origin = P + faceNormal * (dot(faceNormal, L) >= 0.f ? offset : -offset);
+	toLight.direction = L / distance;
+	toLight.tMax = distance;
+	for (int a = 0; a < 3; a++)
+	{
+		float d = toLight.direction[a];
+		toLight.inverse[a] = 1.f / ((fabs(d) > 1e-12f) ? d : (d < 0.f ? -1e-12f : 1e-12f));
+	}
+	return true;
+}
+
+/* The nearest hit along a ray, or with anyHit, whether it hits anything that casts a shadow */
+bool RayTracer::intersect(const Ray &ray, Hit &hit, bool anyHit) const
+{
+	hit.triangle = noTriangle;
+	hit.t = ray.tMax;
+	if (nodes.empty()) return false;
+
+	unsigned int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node &node = nodes[stack[--top]];
+		float tNear = 0.f, tFar = hit.t;
+		for (int a = 0; a < 3; a++)
+		{
+			float t1 = (node.lower[a] - ray.origin[a]) * ray.inverse[a], t2 = (node.upper[a] - ray.origin[a]) * ray.inverse[a];
+			tNear = std::max(tNear, std::min(t1, t2));
+			tFar = std::min(tFar, std::max(t1, t2));
+		}
+		if (tNear > tFar) continue;
+
+		if (node.count == 0)
+		{
+			// The far child goes on the stack first, so the near one is looked in first
+			bool backwards = ray.direction[node.axis] < 0.f;
+			stack[top++] = node.offset + (backwards ? 0 : 1);
+			stack[top++] = node.offset + (backwards ? 1 : 0);
+			continue;
+		}
+
+		for (unsigned int t = node.offset; t < node.offset + node.count; t++)
+		{
+			if (anyHit && !shading[t].castsShadow) continue;
+			const TriangleGeometry &g = geometry[t];
+			const vec3 &d = ray.direction;
+
+			// Moller and Trumbore's test
+			float px = d.y * g.e2[2] - d.z * g.e2[1], py = d.z * g.e2[0] - d.x * g.e2[2], pz = d.x * g.e2[1] - d.y * g.e2[0];
+			float det = dot3(g.e1[0], g.e1[1], g.e1[2], px, py, pz);
+			if (!(fabs(det) > 1e-12f)) continue;
+			float invDet = 1.f / det;
+			float sx = ray.origin.x - g.v0[0], sy = ray.origin.y - g.v0[1], sz = ray.origin.z - g.v0[2];
+			float u = dot3(sx, sy, sz, px, py, pz) * invDet;
+			float qx = sy * g.e1[2] - sz * g.e1[1], qy = sz * g.e1[0] - sx * g.e1[2], qz = sx * g.e1[1] - sy * g.e1[0];
+			float v = dot3(d.x, d.y, d.z, qx, qy, qz) * invDet;
+			float distance = dot3(g.e2[0], g.e2[1], g.e2[2], qx, qy, qz) * invDet;
+			if (!(u >= 0.f && v >= 0.f && u + v <= 1.f && distance > 0.f && distance < hit.t)) continue;
+
+			hit.triangle = t;
+			hit.t = distance;
+			hit.u = u;
+			hit.v = v;
+			if (anyHit) return true;
+		}
+	}
+	return hit.triangle != noTriangle;
+}
+
+/* The same for four rays at once, the rays whose bits are set in active. A box is looked in if any
+   of the rays reaches it, and the rays go through the boxes in the order that suits the first of them */
+void RayTracer::intersectPacket(const Ray *rays, Hit *hits, int active, bool anyHit) const
+{
+#ifdef RAY_TRACER_HAS_SSE2
+	for (int r = 0; r < 4; r++)
+	{
+		hits[r].triangle = noTriangle;
+		hits[r].t = rays[r].tMax;
+	}
+	if (nodes.empty() || active == 0) return;
+
+	__m128 o[3], d[3], inv[3];
+	for (int a = 0; a < 3; a++)
+	{
+		o[a] = _mm_setr_ps(rays[0].origin[a], rays[1].origin[a], rays[2].origin[a], rays[3].origin[a]);
+		d[a] = _mm_setr_ps(rays[0].direction[a], rays[1].direction[a], rays[2].direction[a], rays[3].direction[a]);
+		inv[a] = _mm_setr_ps(rays[0].inverse[a], rays[1].inverse[a], rays[2].inverse[a], rays[3].inverse[a]);
+	}
+	__m128 tHit = _mm_setr_ps(rays[0].tMax, rays[1].tMax, rays[2].tMax, rays[3].tMax);
+	__m128 u = _mm_setzero_ps(), v = _mm_setzero_ps();
+	__m128i triangle = _mm_set1_epi32(-1);
+	__m128 live = _mm_castsi128_ps(_mm_setr_epi32(-(active & 1), -((active >> 1) & 1), -((active >> 2) & 1), -((active >> 3) & 1)));
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), tiny = _mm_set1_ps(1e-12f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	int lead = 0;
+	while (!(active & (1 << lead))) lead++;
+
+	unsigned int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node &node = nodes[stack[--top]];
+		__m128 tNear = zero, tFar = tHit;
+		for (int a = 0; a < 3; a++)
+		{
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.lower[a]), o[a]), inv[a]);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.upper[a]), o[a]), inv[a]);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2));
+			tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+		}
+		if (_mm_movemask_ps(_mm_and_ps(live, _mm_cmple_ps(tNear, tFar))) == 0) continue;
+
+		if (node.count == 0)
+		{
+			bool backwards = rays[lead].direction[node.axis] < 0.f;
+			stack[top++] = node.offset + (backwards ? 0 : 1);
+			stack[top++] = node.offset + (backwards ? 1 : 0);
+			continue;
+		}
+
+		for (unsigned int t = node.offset; t < node.offset + node.count; t++)
+		{
+			if (anyHit && !shading[t].castsShadow) continue;
+			const TriangleGeometry &g = geometry[t];
+			__m128 e1x = _mm_set1_ps(g.e1[0]), e1y = _mm_set1_ps(g.e1[1]), e1z = _mm_set1_ps(g.e1[2]);
+			__m128 e2x = _mm_set1_ps(g.e2[0]), e2y = _mm_set1_ps(g.e2[1]), e2z = _mm_set1_ps(g.e2[2]);
+
+			__m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+			__m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+			__m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+			__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			__m128 invDet = _mm_div_ps(one, det);
+			__m128 sx = _mm_sub_ps(o[0], _mm_set1_ps(g.v0[0]));
+			__m128 sy = _mm_sub_ps(o[1], _mm_set1_ps(g.v0[1]));
+			__m128 sz = _mm_sub_ps(o[2], _mm_set1_ps(g.v0[2]));
+			__m128 tu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			__m128 tv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), invDet);
+			__m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+			__m128 inside = _mm_and_ps(_mm_cmpgt_ps(_mm_and_ps(det, absMask), tiny), live);
+			inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(tu, zero), _mm_cmpge_ps(tv, zero)));
+			inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(tu, tv), one));
+			inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(distance, zero), _mm_cmplt_ps(distance, tHit)));
+			int mask = _mm_movemask_ps(inside);
+			if (mask == 0) continue;
+
+			tHit = _mm_or_ps(_mm_and_ps(inside, distance), _mm_andnot_ps(inside, tHit));
+			u = _mm_or_ps(_mm_and_ps(inside, tu), _mm_andnot_ps(inside, u));
+			v = _mm_or_ps(_mm_and_ps(inside, tv), _mm_andnot_ps(inside, v));
+			__m128i hitMask = _mm_castps_si128(inside);
+			triangle = _mm_or_si128(_mm_and_si128(hitMask, _mm_set1_epi32((int)t)), _mm_andnot_si128(hitMask, triangle));
+
+			// A shadow ray is done as soon as it hits anything
+			if (anyHit)
+			{
+				live = _mm_andnot_ps(inside, live);
+				if (_mm_movemask_ps(live) == 0)
+				{
+					top = 0;
+					break;
+				}
+			}
+		}
+	}
+
+	float ts[4], us[4], vs[4];
+	int triangles[4];
+	_mm_storeu_ps(ts, tHit);
+	_mm_storeu_ps(us, u);
+	_mm_storeu_ps(vs, v);
+	_mm_storeu_si128((__m128i*)triangles, triangle);
+	for (int r = 0; r < 4; r++)
+	{
+		hits[r].triangle = (unsigned int)triangles[r];
+		hits[r].t = ts[r];
+		hits[r].u = us[r];
+		hits[r].v = vs[r];
+	}
+#else
+	for (int r = 0; r < 4; r++)
+	{
+		if (active & (1 << r)) intersect(rays[r], hits[r], anyHit);
+		else hits[r].triangle = noTriangle;
+	}
+#endif
+}
+
+/* Light a hit as assignment.frag does, lightVisible saying whether its shadow ray reached the light */
+vec3 RayTracer::shade(const Ray &ray, const Hit &hit, bool lightVisible) const
+{
+	if (hit.triangle == noTriangle) return background;
+
+	const TriangleShading &s = shading[hit.triangle];
+	const SoftMaterial &material = materials[s.material];
+	if (!material.lit) return vec3(material.colour);
+
+	float w = 1.f - hit.u - hit.v;
+	vec4 texcolour = (s.colour[0] * w + s.colour[1] * hit.u + s.colour[2] * hit.v) * material.colour;
+	if (material.texture) texcolour *= material.texture->sample(s.texcoord[0] * w + s.texcoord[1] * hit.u + s.texcoord[2] * hit.v);
+
+	vec3 N = normalize(s.normal[0] * w + s.normal[1] * hit.u + s.normal[2] * hit.v);
+	vec3 P = ray.origin + ray.direction * hit.t;
+	vec3 L = vec3(lightPosition) - P;
+	float distance = length(L);
+	if (distance > 0.f) L /= distance;
+	return phongLighting(material, vec3(texcolour), N, L, -ray.direction, distance, sunPower, lightVisible);
+}
+
+/* Add one more sample to every pixel. The first pass goes through the pixel centres, the rest are
+   spread over the pixels by the R2 sequence */
+void RayTracer::trace(bool simd)
+{
+	if (width == 0) return;
+	passes++;
+	pool.run(tilesX * tilesY, 1, [this, simd](size_t first, size_t last, unsigned int)
+	{
+		for (size_t tile = first; tile < last; tile++) traceTile((unsigned int)tile, simd);
+	});
+}
+
+void RayTracer::traceTile(unsigned int tile, bool simd)
+{
+	unsigned int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+	unsigned int right = std::min(tileX + TILE_SIZE, width), bottom = std::min(tileY + TILE_SIZE, height);
+
+	float jitterX = 0.5f, jitterY = 0.5f;
+	if (passes > 1)
+	{
+		jitterX = fmod(0.5f + (passes - 1) * 0.7548776662f, 1.f);
+		jitterY = fmod(0.5f + (passes - 1) * 0.5698402910f, 1.f);
+	}
+
+	unsigned long long rays = 0;
+	for (unsigned int y = tileY; y < bottom; y += 2)
+	{
+		for (unsigned int x = tileX; x < right; x += 2)
+		{
+			// A 2 x 2 packet of pixels, with the ones past the edges of the frame left out
+			Ray cameraRays[4], shadowRays[4];
+			Hit hits[4], shadowHits[4];
+			int active = 0, shadowActive = 0;
+			for (int p = 0; p < 4; p++)
+			{
+				unsigned int px = x + (p & 1), py = y + (p >> 1);
+				cameraRays[p] = cameraRay(std::min(px, width - 1) + jitterX, std::min(py, height - 1) + jitterY);
+				if (px < width && py < height) active |= 1 << p;
+			}
+
+			if (simd) intersectPacket(cameraRays, hits, active, false);
+			else
+			{
+				for (int p = 0; p < 4; p++) if (active & (1 << p)) intersect(cameraRays[p], hits[p], false);
+			}
+
+			for (int p = 0; p < 4; p++)
+			{
+				if ((active & (1 << p)) && shadowRay(cameraRays[p], hits[p], shadowRays[p])) shadowActive |= 1 << p;
+				else shadowRays[p] = cameraRays[p];
+			}
+			if (simd) intersectPacket(shadowRays, shadowHits, shadowActive, true);
+			else
+			{
+				for (int p = 0; p < 4; p++) if (shadowActive & (1 << p)) intersect(shadowRays[p], shadowHits[p], true);
+			}
+
+			for (int p = 0; p < 4; p++)
+			{
+				if (!(active & (1 << p))) continue;
+				rays += 1 + ((shadowActive >> p) & 1);
+
+				bool lightVisible = !(shadowActive & (1 << p)) || shadowHits[p].triangle == noTriangle;
+				vec3 sample = shade(cameraRays[p], hits[p], lightVisible);
+				unsigned int pixel = (y + (p >> 1)) * width + x + (p & 1);
+				float *sum = &accumulated[pixel * 3];
+				unsigned char *out = &colour[pixel * 4];
+				for (int c = 0; c < 3; c++)
+				{
+					sum[c] += sample[c];
+					out[c] = (unsigned char)(glm::clamp(sum[c] / passes, 0.f, 1.f) * 255.f + 0.5f);
+				}
+				out[3] = 255;
+			}
+		}
+	}
+	tileRays[tile] = rays;
+}
+
+unsigned long long RayTracer::raysTraced() const
+{
+	unsigned long long total = 0;
+	for (size_t t = 0; t < tileRays.size(); t++) total += tileRays[t];
+	return total;
+}
+
+bool RayTracer::writePNG(const string &file) const
+{
+	return ::writePNG(file, width, height, 4, colour.empty() ? NULL : &colour[0]);
+}
@@ -0,0 +1,119 @@
+/* ray_tracer.h
+ A Whitted style ray tracer for offline stills of the example scenes. It takes the same meshes,
+ textures and materials as the software rasteriser (see soft_raster.h), the same camera matrices
+ and the same point light, and lights each hit with the same port of assignment.frag, but shadows
+ come from a ray to the light instead of a shadow_matrix projection onto the ground.
+ addMesh() puts a mesh's triangles into world space and buildBVH() builds a bounding volume
+ hierarchy over all of them, choosing each split with the surface area heuristic over 16 bins of
+ the triangles' centres. trace() shoots one more ray through every pixel, jittered within the
+ pixel from the second pass on, and adds the result into a float framebuffer, so calling it again
+ and again refines the image progressively; colour always holds the average so far.
+ The frame is cut into 16 x 16 pixel tiles that are shared out over a JobPool. With SSE2 the rays
+ go through the hierarchy four at a time, a 2 x 2 packet of pixels, and so do their shadow rays.
+ Each pass is the same however many threads there are. Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include "soft_raster.h"
+#include "job_pool.h"
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+class RayTracer
+{
+public:
+	RayTracer();
+	~RayTracer();
+
+	void makeFramebuffer(unsigned int width, unsigned int height, unsigned int threads = 0);
+
+	/* The scene. Materials that are unlit or emissive cast no shadows, so the sphere that marks
+	   the light doesn't hide it */
+	void clearScene();
+	void addMesh(const SoftMesh &mesh, const glm::mat4 &model, const SoftMaterial &material);
+	void buildBVH();
+
+	void setCamera(const glm::mat4 &view, const glm::mat4 &projection);
+	void setLight(const glm::vec4 &position, float sunPower);		// world space, like lightPosition
+
+	/* Start a new image, after the camera or the light moves */
+	void resetAccumulation();
+	void trace(bool simd = true);
+
+	bool writePNG(const std::string &file) const;
+
+	unsigned int width, height;
+	std::vector<unsigned char> colour;		// RGBA, the average of the passes so far, rows from the top
+	glm::vec3 background;
+
+	unsigned int samples() const { return passes; }
+	size_t triangleCount() const { return shading.size(); }
+	size_t nodeCount() const { return nodes.size(); }
+	unsigned long long raysTraced() const;		// in the last pass, camera and shadow rays
+
+private:
+	enum { TILE_SIZE = 16, BINS = 16, MAX_LEAF = 4 };
+
+	// A node of the hierarchy. An inner node's children are next to each other from offset,
+	// a leaf's triangles are count triangles from offset
+	struct Node
+	{
+		float lower[3], upper[3];
+		unsigned int offset;
+		unsigned short count, axis;
+	};
+
+	// A triangle for the intersection tests: a corner and the two edges from it
+	struct TriangleGeometry
+	{
+		float v0[3], e1[3], e2[3];
+	};
+
+	// What shading a hit needs, in world space
+	struct TriangleShading
+	{
+		glm::vec3 normal[3];
+		glm::vec2 texcoord[3];
+		glm::vec4 colour[3];
+		unsigned int material;
+		bool castsShadow;
+	};
+
+	struct Ray
+	{
+		glm::vec3 origin, direction, inverse;
+		float tMax;
+	};
+
+	struct Hit
+	{
+		unsigned int triangle;		// ~0u for none
+		float t, u, v;
+	};
+
+	void buildNode(unsigned int node, unsigned int first, unsigned int count, std::vector<unsigned int> &order,
+		const std::vector<glm::vec3> &centres, const std::vector<glm::vec3> &lowers, const std::vector<glm::vec3> &uppers);
+	bool intersect(const Ray &ray, Hit &hit, bool anyHit) const;
+	void intersectPacket(const Ray *rays, Hit *hits, int active, bool anyHit) const;
+	Ray cameraRay(float x, float y) const;
+	bool shadowRay(const Ray &ray, const Hit &hit, Ray &toLight) const;
+	glm::vec3 shade(const Ray &ray, const Hit &hit, bool lit) const;
+	void traceTile(unsigned int tile, bool simd);
+
+	unsigned int tilesX, tilesY;
+	unsigned int passes;
+	std::vector<float> accumulated;		// RGB sums of the passes
+	std::vector<unsigned long long> tileRays;
+
+	glm::mat4 inverseViewProjection;
+	glm::vec4 lightPosition;
+	float sunPower;
+
+	std::vector<SoftMaterial> materials;
+	std::vector<TriangleGeometry> geometry;
+	std::vector<TriangleShading> shading;
+	std::vector<Node> nodes;
+	JobPool pool;
+};
@@ -0,0 +1,100 @@
+/* scene_hierarchy.cpp
+ Flat transform hierarchy with dirty flags.
+ Because every parent comes before its children, one forward pass is enough: a node
+ is recomputed if it changed itself or if its parent was recomputed earlier in the pass.
+*/
+
+#include "scene_hierarchy.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+SceneHierarchy::SceneHierarchy()
+{
+	firstDirty = 0;
+}
+
+/* Add a node under parent (-1 for a root) and return its index. The parent must already
+   exist, which keeps the arrays sorted parents first */
+int SceneHierarchy::addNode(int parent, vec3 translation, vec3 rotation, vec3 pivot, vec3 scale)
+{
+	if (parent >= size()) parent = -1;
+
+	int node = size();
+	parentIndex.push_back(parent);
+	tx.push_back(translation.x); ty.push_back(translation.y); tz.push_back(translation.z);
+	rx.push_back(rotation.x); ry.push_back(rotation.y); rz.push_back(rotation.z);
+	px.push_back(pivot.x); py.push_back(pivot.y); pz.push_back(pivot.z);
+	sx.push_back(scale.x); sy.push_back(scale.y); sz.push_back(scale.z);
+	dirty.push_back(0);
+	worldMatrix.push_back(mat4(1.0f));
+
+	markDirty(node);
+	return node;
+}
+
+/* The setters only mark the node dirty if the value really changed, so they can be
+   called every frame from the animation variables */
+void SceneHierarchy::setTranslation(int node, vec3 translation)
+{
+	if (tx[node] == translation.x && ty[node] == translation.y && tz[node] == translation.z) return;
+	tx[node] = translation.x; ty[node] = translation.y; tz[node] = translation.z;
+	markDirty(node);
+}
+
+void SceneHierarchy::setRotation(int node, vec3 rotation)
+{
+	if (rx[node] == rotation.x && ry[node] == rotation.y && rz[node] == rotation.z) return;
+	rx[node] = rotation.x; ry[node] = rotation.y; rz[node] = rotation.z;
+	markDirty(node);
+}
+
+void SceneHierarchy::setScale(int node, vec3 scale)
+{
+	if (sx[node] == scale.x && sy[node] == scale.y && sz[node] == scale.z) return;
+	sx[node] = scale.x; sy[node] = scale.y; sz[node] = scale.z;
+	markDirty(node);
+}
+
+void SceneHierarchy::markDirty(int node)
+{
+	dirty[node] = 1;
+	if (node < firstDirty) firstDirty = node;
+}
+
+/* translate * pivot * rotate * -pivot * scale */
+mat4 SceneHierarchy::localMatrix(int node) const
+{
+	vec3 pivot(px[node], py[node], pz[node]);
+
+	mat4 local = translate(mat4(1.0f), vec3(tx[node], ty[node], tz[node]) + pivot);
+	local = rotate(local, -radians(rx[node]), vec3(1, 0, 0));
+	local = rotate(local, -radians(ry[node]), vec3(0, 1, 0));
+	local = rotate(local, -radians(rz[node]), vec3(0, 0, 1));
+	local = translate(local, -pivot);
+	return scale(local, vec3(sx[node], sy[node], sz[node]));
+}
+
+/* Recompute the world matrices of the dirty nodes and everything below them.
+   Returns the number of nodes that were recomputed */
+int SceneHierarchy::update()
+{
+	int count = size(), recomputed = 0;
+
+	// Nodes before the first dirty one, and so all of their parents, are unchanged
+	for (int i = firstDirty; i < count; i++)
+	{
+		int p = parentIndex[i];
+		if (p >= 0 && dirty[p]) dirty[i] = 1;
+		if (!dirty[i]) continue;
+
+		worldMatrix[i] = (p >= 0) ? worldMatrix[p] * localMatrix(i) : localMatrix(i);
+		recomputed++;
+	}
+
+	// The flags are cleared afterwards so the children above could still see their parent's
+	for (int i = firstDirty; i < count; i++) dirty[i] = 0;
+	firstDirty = count;
+	return recomputed;
+}
@@ -0,0 +1,44 @@
+/* scene_hierarchy.h
+ A flat transform hierarchy. Nodes are stored in arrays in parent-before-child order,
+ with each node's parent as an index and its local translation, rotation, pivot and
+ scale held as structure-of-arrays.
+ Changing a node marks it dirty, and update() recomputes the world matrices of the dirty
+ nodes and their descendants in one pass from the first dirty node to the end.
+*/
+
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+class SceneHierarchy
+{
+public:
+	SceneHierarchy();
+
+	int addNode(int parent, glm::vec3 translation, glm::vec3 rotation = glm::vec3(0), glm::vec3 pivot = glm::vec3(0),
+		glm::vec3 scale = glm::vec3(1));
+
+	void setTranslation(int node, glm::vec3 translation);
+	void setRotation(int node, glm::vec3 rotation);
+	void setScale(int node, glm::vec3 scale);
+
+	int update();
+	const glm::mat4& world(int node) const { return worldMatrix[node]; }
+	int parent(int node) const { return parentIndex[node]; }
+	int size() const { return (int)parentIndex.size(); }
+
+private:
+	void markDirty(int node);
+	glm::mat4 localMatrix(int node) const;
+
+	std::vector<int> parentIndex;			// -1 for a root, otherwise always less than the node's own index
+	std::vector<float> tx, ty, tz;
+	std::vector<float> rx, ry, rz;			// degrees, applied like rotate(-radians(x)) about X, then Y, then Z
+	std::vector<float> px, py, pz;			// point the rotation is about, in the node's own space
+	std::vector<float> sx, sy, sz;			// inherited by the children
+	std::vector<unsigned char> dirty;
+	std::vector<glm::mat4> worldMatrix;
+
+	int firstDirty;			// lowest dirty node, size() when nothing has changed
+};
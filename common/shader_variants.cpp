@@ -0,0 +1,144 @@
+/* shader_variants.cpp
+ Builds and caches compile-time variants of a shader program selected by a bitmask of features.
+*/
+
+#include "shader_variants.h"
+#include <iostream>
+
+using namespace std;
+
+ShaderVariants::ShaderVariants()
+{
+	glw = 0;
+	hotReload = false;
+	current = 0;
+	frame = 1;
+}
+
+ShaderVariants::~ShaderVariants()
+{
+}
+
+/* Set the shader files the variants are built from. Nothing is compiled until a variant is used */
+void ShaderVariants::load(GLWrapper* glw, const char* vertex_path, const char* fragment_path, bool hotReload)
+{
+	this->glw = glw;
+	this->vertexPath = vertex_path;
+	this->fragmentPath = fragment_path;
+	this->hotReload = hotReload;
+}
+
+/* Add a feature and return the bit that selects it. The name is #defined in variants that use it */
+GLuint ShaderVariants::addFeature(const char* define)
+{
+	featureNames.push_back(define);
+	return 1u << (featureNames.size() - 1);
+}
+
+/* Register a uniform whose location should be written to *location whenever the current variant changes.
+   This lets the application keep using a single set of uniform IDs across all of the variants */
+void ShaderVariants::bindUniform(const char* name, GLuint* location)
+{
+	uniformNames.push_back(name);
+	uniformTargets.push_back(location);
+}
+
+/* Register a uniform block that should be attached to a binding point in every variant */
+void ShaderVariants::bindUniformBlock(const char* name, GLuint bindingPoint)
+{
+	blockNames.push_back(name);
+	blockBindings.push_back(bindingPoint);
+}
+
+/* Build the #define block for a combination of features */
+string ShaderVariants::defines(GLuint features)
+{
+	string block;
+	for (size_t i = 0; i < featureNames.size(); i++)
+	{
+		if (features & (1u << i)) block += "#define " + featureNames[i] + "\n";
+	}
+	return block;
+}
+
+/* Find a variant, compiling it the first time it is asked for */
+ShaderVariants::Variant& ShaderVariants::variant(GLuint features)
+{
+	map<GLuint, Variant>::iterator found = variants.find(features);
+	if (found != variants.end()) return found->second;
+
+	// Built before the variant is added, so one that throws isn't left behind half made
+	GLuint program = glw->LoadShader(vertexPath.c_str(), fragmentPath.c_str(), defines(features));
+	Variant& v = variants[features];
+	v.program = program;
+	v.resolvedProgram = 0;
+	v.lastFrame = 0;
+
+	if (hotReload)
+	{
+		glw->watchShader(&v.program, vertexPath.c_str(), fragmentPath.c_str(), 0, defines(features));
+	}
+	return v;
+}
+
+/* Return the program for a combination of features */
+GLuint ShaderVariants::program(GLuint features)
+{
+	return variant(features).program;
+}
+
+/* Return the program that was made current by the last call to use() */
+GLuint ShaderVariants::currentProgram()
+{
+	return current ? current->program : 0;
+}
+
+/* Make a variant current and point the bound uniform IDs at its locations.
+   Returns true the first time the variant is used in a frame, so the caller knows
+   to send it the uniforms that are shared by the whole frame. */
+bool ShaderVariants::use(GLuint features)
+{
+	Variant& v = variant(features);
+
+	// A hot-reload swaps the program underneath us so look the locations and blocks up again
+	bool reloaded = (v.resolvedProgram != v.program);
+	if (reloaded)
+	{
+		v.locations.resize(uniformNames.size());
+		for (size_t i = 0; i < uniformNames.size(); i++)
+		{
+			v.locations[i] = glGetUniformLocation(v.program, uniformNames[i].c_str());
+		}
+		for (size_t i = 0; i < blockNames.size(); i++)
+		{
+			GLuint blockIndex = glGetUniformBlockIndex(v.program, blockNames[i].c_str());
+			if (blockIndex != GL_INVALID_INDEX) glUniformBlockBinding(v.program, blockIndex, blockBindings[i]);
+		}
+		v.resolvedProgram = v.program;
+		v.lastFrame = 0;
+	}
+
+	if (current != &v || reloaded)
+	{
+		glUseProgram(v.program);
+		for (size_t i = 0; i < uniformTargets.size(); i++) *uniformTargets[i] = v.locations[i];
+		current = &v;
+	}
+
+	bool firstUse = (v.lastFrame != frame);
+	v.lastFrame = frame;
+	return firstUse;
+}
+
+/* Forget the current variant, call this after making another program current with glUseProgram */
+void ShaderVariants::release()
+{
+	current = 0;
+}
+
+/* Start a new frame, the first use() of each variant after this returns true */
+void ShaderVariants::beginFrame()
+{
+	frame++;
+	current = 0;
+}
@@ -0,0 +1,57 @@
+/* shader_variants.h
+ Builds and caches compile-time variants of a shader program. Each feature is a #define
+ that is injected into both shader stages, so that a shader can use #ifdef instead of
+ branching on mode uniforms for every vertex and fragment.
+ Variants are compiled the first time they are used.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include <map>
+#include <vector>
+
+class ShaderVariants
+{
+public:
+	ShaderVariants();
+	~ShaderVariants();
+
+	void load(GLWrapper* glw, const char* vertex_path, const char* fragment_path, bool hotReload = false);
+	GLuint addFeature(const char* define);
+	void bindUniform(const char* name, GLuint* location);
+	void bindUniformBlock(const char* name, GLuint bindingPoint);
+
+	bool use(GLuint features);
+	void release();
+	void beginFrame();
+
+	GLuint program(GLuint features);
+	GLuint currentProgram();
+	std::string defines(GLuint features);
+
+private:
+	struct Variant
+	{
+		GLuint program;
+		GLuint resolvedProgram;		// program that the uniform locations were looked up in
+		std::vector<GLuint> locations;
+		GLuint lastFrame;
+	};
+
+	Variant& variant(GLuint features);
+
+	GLWrapper* glw;
+	std::string vertexPath, fragmentPath;
+	bool hotReload;
+
+	std::vector<std::string> featureNames;
+	std::vector<std::string> uniformNames;
+	std::vector<GLuint*> uniformTargets;
+	std::vector<std::string> blockNames;
+	std::vector<GLuint> blockBindings;
+
+	std::map<GLuint, Variant> variants;		// map nodes don't move, so the hot-reloader can hold on to &program
+	Variant* current;
+	GLuint frame;
+};
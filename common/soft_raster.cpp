@@ -0,0 +1,719 @@
+/* soft_raster.cpp
+ Transforms, clips, bins and rasterises triangles on the CPU, and lights them like assignment.frag.
+*/
+
+#include "soft_raster.h"
+#include "png_writer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if (GLM_ARCH & GLM_ARCH_SSE2_BIT)
+#define SOFT_RASTER_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+// Where each attribute of a ShadedVertex starts
+enum { EYE_POSITION = 0, LIGHT_VECTOR = 3, NORMAL = 6, TEXCOORD = 9, LIGHT_DISTANCE = 11, COLOUR = 12 };
+
+// The constants of assignment.frag and lighting.glsl
+static const vec3 specularAlbedo(1.f, 0.8f, 0.6f);
+static const float shininess = 80.f;
+static const vec3 emissiveColour(1.f, 1.f, 0.8f);
+
+void SoftMesh::fromBuilder(const MeshBuilder &builder, unsigned int mesh)
+{
+	const MeshRange &range = builder.meshes[mesh];
+	vertices.resize(range.vertexCount);
+	for (unsigned int v = 0; v < range.vertexCount; v++)
+	{
+		const MeshVertex &from = builder.vertices[range.firstVertex + v];
+		vertices[v].position = vec3(from.position[0], from.position[1], from.position[2]);
+		vertices[v].normal = vec3(from.normal[0], from.normal[1], from.normal[2]);
+		vertices[v].texcoord = vec2(0.f);
+		vertices[v].colour = vec4(from.colour[0], from.colour[1], from.colour[2], from.colour[3]);
+	}
+	indices.assign(builder.indices.begin() + range.firstIndex, builder.indices.begin() + range.firstIndex + range.indexCount);
+}
+
+/* The normal of each vertex of a unit sphere is its position */
+void SoftMesh::fromSphere(const SphereMesh &sphere, const vec4 &colour)
+{
+	vertices.resize(sphere.positions.size() / 3);
+	for (size_t v = 0; v < vertices.size(); v++)
+	{
+		vertices[v].position = vertices[v].normal = vec3(sphere.positions[v * 3], sphere.positions[v * 3 + 1], sphere.positions[v * 3 + 2]);
+		vertices[v].texcoord = sphere.texcoords.empty() ? vec2(0.f) : vec2(sphere.texcoords[v * 2], sphere.texcoords[v * 2 + 1]);
+		vertices[v].colour = colour;
+	}
+	indices = sphere.indices;
+}
+
+SoftTexture::SoftTexture()
+{
+	width = height = 0;
+}
+
+/* Copy an image of 1 to 4 channels, as stb_image gives them, into RGBA */
+void SoftTexture::makeTexture(unsigned int width, unsigned int height, unsigned int channels, const unsigned char *data)
+{
+	this->width = width;
+	this->height = height;
+	texels.resize(width * height * 4);
+	for (size_t p = 0; p < (size_t)width * height; p++)
+	{
+		const unsigned char *from = data + p * channels;
+		unsigned char *to = &texels[p * 4];
+		to[0] = from[0];
+		to[1] = (channels >= 3) ? from[1] : from[0];
+		to[2] = (channels >= 3) ? from[2] : from[0];
+		to[3] = (channels == 4) ? from[3] : (channels == 2) ? from[1] : 255;
+	}
+}
+
+/* Bilinear filtering with GL_REPEAT wrapping */
+vec4 SoftTexture::sample(const vec2 &uv) const
+{
+	if (width == 0) return vec4(1.f);
+
+	float x = uv.x * width - 0.5f, y = uv.y * height - 0.5f;
+	float fx = floor(x), fy = floor(y);
+	float wx = x - fx, wy = y - fy;
+	int x0 = ((int)fmod(fx, (float)width) + width) % width, y0 = ((int)fmod(fy, (float)height) + height) % height;
+	int x1 = (x0 + 1) % width, y1 = (y0 + 1) % height;
+
+	const unsigned char *t00 = &texels[(y0 * width + x0) * 4], *t10 = &texels[(y0 * width + x1) * 4];
+	const unsigned char *t01 = &texels[(y1 * width + x0) * 4], *t11 = &texels[(y1 * width + x1) * 4];
+	vec4 result;
+	for (int c = 0; c < 4; c++)
+	{
+		float top = t00[c] + (t10[c] - t00[c]) * wx, bottom = t01[c] + (t11[c] - t01[c]) * wx;
+		result[c] = (top + (bottom - top) * wy) * (1.f / 255.f);
+	}
+	return result;
+}
+
+SoftMaterial::SoftMaterial()
+{
+	texture = NULL;
+	lit = true;
+	specular = emissive = false;
+	colour = vec4(1.f);
+}
+
+vec3 phongLighting(const SoftMaterial &material, const vec3 &albedo, const vec3 &N, const vec3 &L, const vec3 &V,
+	float lightDistance, float sunPower, bool lightVisible)
+{
+	// diffuse_term, specular_term and attenuation_term of lighting.glsl
+	vec3 lighting(0.f);
+	if (lightVisible)
+	{
+		lighting = std::max(dot(N, L), 0.f) * albedo;
+		if (material.specular)
+		{
+			vec3 R = reflect(-L, N);
+			lighting += pow(std::max(dot(R, V), 0.f), shininess) * specularAlbedo;
+		}
+	}
+	float attenuation = 1.f / (sunPower + sunPower * lightDistance + sunPower * lightDistance * lightDistance);
+
+	vec3 colour = attenuation * lighting + albedo * 0.3f;
+	if (material.emissive) colour += emissiveColour;
+	return colour;
+}
+
+SoftRasteriser::SoftRasteriser()
+{
+	width = height = 0;
+	tilesX = tilesY = 0;
+	stride = blocksX = 0;
+	lightPosition = vec4(0.f, 0.f, 0.f, 1.f);
+	sunPower = 1.f;
+	view = projection = mat4(1.0f);
+}
+
+SoftRasteriser::~SoftRasteriser()
+{
+}
+
+/* The frame is rasterised on threads threads, 0 for one per hardware thread */
+void SoftRasteriser::makeFramebuffer(unsigned int width, unsigned int height, unsigned int threads)
+{
+	this->width = width;
+	this->height = height;
+	tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	stride = blocksX * BLOCK_SIZE;
+
+	// The padding past the edges is never drawn, so it stays at the far plane
+	unsigned int blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	colour.assign(width * height * 4, 0);
+	depth.assign(stride * blocksY * BLOCK_SIZE, 1.f);
+	blockFurthest.assign(blocksX * blocksY, 1.f);
+	tileSkipped.assign(tilesX * tilesY, 0);
+	if (pool.size() == 0) pool.makePool(threads);
+}
+
+void SoftRasteriser::setCamera(const mat4 &view, const mat4 &projection)
+{
+	this->view = view;
+	this->projection = projection;
+}
+
+void SoftRasteriser::setLight(const vec4 &position, float sunPower)
+{
+	lightPosition = position;
+	this->sunPower = sunPower;
+}
+
+/* Start a frame. The framebuffer itself is cleared tile by tile as finish() draws it */
+void SoftRasteriser::clear(const vec4 &colour)
+{
+	clearColour = colour;
+	materials.clear();
+	draws.clear();
+}
+
+/* Record a draw of the mesh with the current uniforms. The work is all done in finish() */
+void SoftRasteriser::draw(const SoftMesh &mesh, const mat4 &model, const SoftMaterial &material)
+{
+	if (mesh.vertices.empty() || width == 0) return;
+
+	Draw next;
+	next.mesh = &mesh;
+	next.modelview = view * model;
+	next.projection = projection;
+	next.normalMatrix = transpose(inverse(mat3(next.modelview)));
+	next.light = view * lightPosition;
+	next.material = (unsigned int)materials.size();
+	next.firstVertex = next.firstTriangle = 0;
+	if (!draws.empty())
+	{
+		const Draw &last = draws.back();
+		next.firstVertex = last.firstVertex + last.mesh->vertices.size();
+		next.firstTriangle = last.firstTriangle + last.mesh->indices.size() / 3;
+	}
+	materials.push_back(material);
+	draws.push_back(next);
+}
+
+/* The vertex shader */
+void SoftRasteriser::shadeVertex(const Draw &draw, const SoftVertex &in, ShadedVertex &out) const
+{
+	vec4 eye = draw.modelview * vec4(in.position, 1.f);
+	vec3 N = normalize(draw.normalMatrix * in.normal);
+	// A light with w = 0 is a direction, as in OpenGL, the same for every vertex and not attenuated
+	vec3 L = vec3(draw.light);
+	float distance = 0.f;
+	if (draw.light.w != 0.f)
+	{
+		L -= vec3(eye);
+		distance = length(L);
+		if (distance > 0.f) L /= distance;
+	}
+	else L = normalize(L);
+
+	out.clip = draw.projection * eye;
+	float *a = out.attributes;
+	a[EYE_POSITION] = eye.x; a[EYE_POSITION + 1] = eye.y; a[EYE_POSITION + 2] = eye.z;
+	a[LIGHT_VECTOR] = L.x; a[LIGHT_VECTOR + 1] = L.y; a[LIGHT_VECTOR + 2] = L.z;
+	a[NORMAL] = N.x; a[NORMAL + 1] = N.y; a[NORMAL + 2] = N.z;
+	a[TEXCOORD] = in.texcoord.x; a[TEXCOORD + 1] = in.texcoord.y;
+	a[LIGHT_DISTANCE] = distance;
+	a[COLOUR] = in.colour.r; a[COLOUR + 1] = in.colour.g; a[COLOUR + 2] = in.colour.b; a[COLOUR + 3] = in.colour.a;
+}
+
+/* Divide by w and map to the window, for a vertex with w > 0 */
+void SoftRasteriser::project(const ShadedVertex &in, ScreenVertex &out) const
+{
+	const vec4 &p = in.clip;
+	float invW = 1.f / p.w;
+	out.x = (p.x * invW * 0.5f + 0.5f) * width;
+	out.y = (0.5f - p.y * invW * 0.5f) * height;
+	out.z = p.z * invW * 0.5f + 0.5f;
+	out.invW = invW;
+	for (int i = 0; i < ATTRIBUTES; i++) out.attributes[i] = in.attributes[i] * invW;
+}
+
+/* Set up the frame's triangles from first to last into a batch and bin them */
+void SoftRasteriser::setupBatch(unsigned int batch, size_t first, size_t last)
+{
+	Batch &into = batches[batch];
+	into.triangles.clear();
+	into.clipped.clear();
+	into.bins.resize(tilesX * tilesY);
+	for (size_t b = 0; b < into.bins.size(); b++) into.bins[b].clear();
+
+	// The draw that the first triangle is in
+	size_t d = upper_bound(draws.begin(), draws.end(), first, [](size_t t, const Draw &draw) { return t < draw.firstTriangle; })
+		- draws.begin() - 1;
+	for (size_t t = first; t < last; t++)
+	{
+		while (t >= draws[d].firstTriangle + draws[d].mesh->indices.size() / 3) d++;
+		const Draw &draw = draws[d];
+		const unsigned int *index = &draw.mesh->indices[(t - draw.firstTriangle) * 3];
+		size_t a = draw.firstVertex + index[0], b = draw.firstVertex + index[1], c = draw.firstVertex + index[2];
+
+		// Leave out triangles that are wholly outside one side of the view volume
+		int outsideAll = 63, clipsNear = 0;
+		const ShadedVertex *corners[3] = { &shaded[a], &shaded[b], &shaded[c] };
+		for (int v = 0; v < 3; v++)
+		{
+			const vec4 &p = corners[v]->clip;
+			int outside = (p.x > p.w) | ((p.x < -p.w) << 1) | ((p.y > p.w) << 2) | ((p.y < -p.w) << 3) | ((p.z > p.w) << 4)
+				| ((p.z < -p.w) << 5);
+			outsideAll &= outside;
+			clipsNear |= outside & 32;
+		}
+		if (outsideAll) continue;
+
+		if (clipsNear)
+		{
+			clipTriangle(into, *corners[0], *corners[1], *corners[2], draw.material);
+		}
+		else
+		{
+			const ScreenVertex *screen[3] = { &projected[a], &projected[b], &projected[c] };
+			setupTriangle(into, screen, draw.material);
+		}
+	}
+}
+
+/* Cut a triangle that crosses the near plane, z = -w, and set up what is left of it, at most two triangles */
+void SoftRasteriser::clipTriangle(Batch &batch, const ShadedVertex &a, const ShadedVertex &b, const ShadedVertex &c, unsigned int material)
+{
+	const ShadedVertex *in[3] = { &a, &b, &c };
+	ShadedVertex out[4];
+	int count = 0;
+	for (int v = 0; v < 3; v++)
+	{
+		const ShadedVertex &from = *in[v], &to = *in[(v + 1) % 3];
+		float dFrom = from.clip.z + from.clip.w, dTo = to.clip.z + to.clip.w;
+		if (dFrom >= 0.f) out[count++] = from;
+		if ((dFrom >= 0.f) != (dTo >= 0.f))
+		{
+			float t = dFrom / (dFrom - dTo);
+			ShadedVertex &cut = out[count++];
+			cut.clip = mix(from.clip, to.clip, t);
+			for (int i = 0; i < ATTRIBUTES; i++) cut.attributes[i] = from.attributes[i] + (to.attributes[i] - from.attributes[i]) * t;
+		}
+	}
+
+	size_t first = batch.clipped.size();
+	batch.clipped.resize(first + count);
+	for (int v = 0; v < count; v++) project(out[v], batch.clipped[first + v]);
+	for (int v = 1; v + 1 < count; v++)
+	{
+		const ScreenVertex *setup[3] = { &batch.clipped[first], &batch.clipped[first + v], &batch.clipped[first + v + 1] };
+		setupTriangle(batch, setup, material);
+	}
+}
+
+/* Put a triangle in the bins of the tiles its bounding box touches. Both sides are drawn, like
+   the examples, which don't cull faces */
+void SoftRasteriser::setupTriangle(Batch &batch, const ScreenVertex *const *corners, unsigned int material)
+{
+	const ScreenVertex &a = *corners[0], &b = *corners[1], &c = *corners[2];
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (!(fabs(area) > 1e-8f)) return;
+
+	Triangle t;
+	t.corners[0] = &a;
+	t.corners[1] = (area < 0.f) ? &c : &b;
+	t.corners[2] = (area < 0.f) ? &b : &c;
+	t.nearest = std::min(a.z, std::min(b.z, c.z));
+	if (t.nearest >= 1.f) return;
+
+	// The pixels whose centres are inside the bounding box, clamped to the screen before they become ints
+	float left = std::min(a.x, std::min(b.x, c.x)), right = std::max(a.x, std::max(b.x, c.x));
+	float top = std::min(a.y, std::min(b.y, c.y)), bottom = std::max(a.y, std::max(b.y, c.y));
+	t.minX = (int)ceil(glm::clamp(left, 0.f, (float)width) - 0.5f);
+	t.maxX = std::min((int)floor(glm::clamp(right, 0.f, (float)width) - 0.5f), (int)width - 1);
+	t.minY = (int)ceil(glm::clamp(top, 0.f, (float)height) - 0.5f);
+	t.maxY = std::min((int)floor(glm::clamp(bottom, 0.f, (float)height) - 0.5f), (int)height - 1);
+	if (t.minX > t.maxX || t.minY > t.maxY) return;
+	t.material = material;
+
+	unsigned int index = (unsigned int)batch.triangles.size();
+	batch.triangles.push_back(t);
+	for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++)
+		for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++) batch.bins[ty * tilesX + tx].push_back(index);
+}
+
+/* Draw the frame: shade the vertices of all of the draws, set up the triangles in a few batches
+   for each thread, so that a thread that is given big triangles doesn't hold the rest up, and
+   rasterise the tiles, one tile per job */
+void SoftRasteriser::finish(bool simd)
+{
+	size_t vertexCount = 0, triangleTotal = 0;
+	if (!draws.empty())
+	{
+		const Draw &last = draws.back();
+		vertexCount = last.firstVertex + last.mesh->vertices.size();
+		triangleTotal = last.firstTriangle + last.mesh->indices.size() / 3;
+	}
+
+	shaded.resize(vertexCount);
+	projected.resize(vertexCount);
+	pool.run(vertexCount, 4096, [this](size_t first, size_t last, unsigned int)
+	{
+		size_t d = upper_bound(draws.begin(), draws.end(), first, [](size_t v, const Draw &draw) { return v < draw.firstVertex; })
+			- draws.begin() - 1;
+		for (size_t v = first; v < last; v++)
+		{
+			while (v >= draws[d].firstVertex + draws[d].mesh->vertices.size()) d++;
+			shadeVertex(draws[d], draws[d].mesh->vertices[v - draws[d].firstVertex], shaded[v]);
+			if (shaded[v].clip.w > 0.f) project(shaded[v], projected[v]);
+		}
+	});
+
+	// Batches of at least 1024 triangles, as a smaller batch costs more to hand out than to set up
+	size_t batchCount = std::min((size_t)pool.size() * 4, (triangleTotal + 1023) / 1024);
+	batches.resize(batchCount);
+	pool.run(batchCount, 1, [this, batchCount, triangleTotal](size_t first, size_t last, unsigned int)
+	{
+		for (size_t b = first; b < last; b++)
+			setupBatch((unsigned int)b, triangleTotal * b / batchCount, triangleTotal * (b + 1) / batchCount);
+	});
+
+	pool.run(tilesX * tilesY, 1, [this, simd](size_t first, size_t last, unsigned int)
+	{
+		for (size_t tile = first; tile < last; tile++) rasteriseTile((unsigned int)tile, simd);
+	});
+}
+
+/* Clear one tile and draw its triangles into it. A pixel is covered when its centre is inside all
+   three edges, or on an edge that is a top or left edge, so that triangles that share an edge
+   never both draw the pixels along it */
+void SoftRasteriser::rasteriseTile(unsigned int tile, bool simd)
+{
+	int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+	int tileRight = std::min(tileX + TILE_SIZE, (int)width) - 1, tileBottom = std::min(tileY + TILE_SIZE, (int)height) - 1;
+
+	unsigned char clearBytes[4];
+	for (int c = 0; c < 4; c++) clearBytes[c] = (unsigned char)(glm::clamp(clearColour[c], 0.f, 1.f) * 255.f + 0.5f);
+	for (int y = tileY; y <= tileBottom; y++)
+	{
+		for (int x = tileX; x <= tileRight; x++) memcpy(&colour[(y * width + x) * 4], clearBytes, 4);
+		fill(depth.begin() + y * stride + tileX, depth.begin() + y * stride + tileRight + 1, 1.f);
+	}
+	for (int by = tileY / BLOCK_SIZE; by <= tileBottom / BLOCK_SIZE; by++)
+		for (int bx = tileX / BLOCK_SIZE; bx <= tileRight / BLOCK_SIZE; bx++) blockFurthest[by * blocksX + bx] = 1.f;
+
+	unsigned long long skipped = 0;
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		const vector<unsigned int> &bin = batches[b].bins[tile];
+		for (size_t i = 0; i < bin.size(); i++)
+		{
+			const Triangle &tri = batches[b].triangles[bin[i]];
+			const ScreenVertex *const *corner = tri.corners;
+
+			// Edge i runs from vertex i to the next, and is A * x + B * y + C, positive on the inside
+			float A[3], B[3], C[3];
+			bool topLeft[3];
+			for (int e = 0; e < 3; e++)
+			{
+				int n = (e + 1) % 3;
+				A[e] = corner[e]->y - corner[n]->y;
+				B[e] = corner[n]->x - corner[e]->x;
+				C[e] = corner[e]->x * corner[n]->y - corner[n]->x * corner[e]->y;
+				topLeft[e] = (A[e] > 0.f) || (A[e] == 0.f && B[e] > 0.f);
+			}
+
+			// The depth plane z = dzdx * x + dzdy * y + z0
+			float area = A[0] * corner[2]->x + B[0] * corner[2]->y + C[0];
+			float dzdx = (A[1] * corner[0]->z + A[2] * corner[1]->z + A[0] * corner[2]->z) / area;
+			float dzdy = (B[1] * corner[0]->z + B[2] * corner[1]->z + B[0] * corner[2]->z) / area;
+			float z0 = corner[0]->z - dzdx * corner[0]->x - dzdy * corner[0]->y;
+
+			int left = std::max(tri.minX, tileX), right = std::min(tri.maxX, tileRight);
+			int top = std::max(tri.minY, tileY), bottom = std::min(tri.maxY, tileBottom);
+			if (left > right || top > bottom) continue;
+
+			for (int by = top / BLOCK_SIZE; by <= bottom / BLOCK_SIZE; by++)
+			{
+				for (int bx = left / BLOCK_SIZE; bx <= right / BLOCK_SIZE; bx++)
+				{
+					// Skip blocks that are already nearer than all of the triangle, and blocks wholly outside an edge
+					if (tri.nearest >= blockFurthest[by * blocksX + bx])
+					{
+						skipped++;
+						continue;
+					}
+					float blockX = bx * BLOCK_SIZE + 0.5f, blockY = by * BLOCK_SIZE + 0.5f;
+					bool outside = false;
+					for (int e = 0; e < 3 && !outside; e++)
+					{
+						float x = (A[e] > 0.f) ? blockX + BLOCK_SIZE - 1 : blockX, y = (B[e] > 0.f) ? blockY + BLOCK_SIZE - 1 : blockY;
+						outside = (A[e] * x + B[e] * y + C[e] < 0.f);
+					}
+					if (outside) continue;
+
+					int x0 = std::max(bx * BLOCK_SIZE, left), x1 = std::min(bx * BLOCK_SIZE + BLOCK_SIZE - 1, right);
+					int y0 = std::max(by * BLOCK_SIZE, top), y1 = std::min(by * BLOCK_SIZE + BLOCK_SIZE - 1, bottom);
+					bool written = false;
+					for (int y = y0; y <= y1; y++)
+					{
+						float py = y + 0.5f;
+						float row[3] = { B[0] * py + C[0], B[1] * py + C[1], B[2] * py + C[2] };
+						float rowDepth = dzdy * py + z0;
+						float *line = &depth[y * stride];
+						int x = x0;
+#ifdef SOFT_RASTER_HAS_SSE2
+						if (simd)
+						{
+							// Four pixels at a time from the start of the block, leaving out those past the box
+							x = bx * BLOCK_SIZE;
+							const __m128 four = _mm_set1_ps(4.f), zero = _mm_setzero_ps();
+							const __m128 first = _mm_set1_ps((float)x0), last = _mm_set1_ps((float)x1);
+							__m128 column = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+							for (; x <= x1; x += 4, column = _mm_add_ps(column, four))
+							{
+								__m128 px = _mm_add_ps(column, _mm_set1_ps(0.5f));
+								__m128 e[3], inside = _mm_and_ps(_mm_cmpge_ps(column, first), _mm_cmple_ps(column, last));
+								for (int k = 0; k < 3; k++)
+								{
+									e[k] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[k]), px), _mm_set1_ps(row[k]));
+									inside = _mm_and_ps(inside, topLeft[k] ? _mm_cmpge_ps(e[k], zero) : _mm_cmpgt_ps(e[k], zero));
+								}
+								__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(rowDepth));
+								__m128 before = _mm_loadu_ps(line + x);
+								__m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, before));
+								int mask = _mm_movemask_ps(pass);
+								if (mask == 0) continue;
+
+								_mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, before)));
+								float edges[12];
+								for (int k = 0; k < 3; k++) _mm_storeu_ps(edges + k * 4, e[k]);
+								written = true;
+
+								// Small triangles often leave a single pixel of the four, which is quicker on its own
+								if (mask & (mask - 1))
+								{
+									shadeQuad(tri, edges, area, mask, y * width + x);
+								}
+								else
+								{
+									int lane = (mask & 3) ? (mask & 1 ? 0 : 1) : (mask & 4 ? 2 : 3);
+									float laneEdges[3] = { edges[lane], edges[4 + lane], edges[8 + lane] };
+									shade(tri, laneEdges, area, y * width + x + lane);
+								}
+							}
+						}
+#endif
+						for (; x <= x1; x++)
+						{
+							float px = x + 0.5f;
+							float e[3];
+							bool inside = true;
+							for (int k = 0; k < 3; k++)
+							{
+								e[k] = A[k] * px + row[k];
+								inside = inside && (topLeft[k] ? e[k] >= 0.f : e[k] > 0.f);
+							}
+							float z = dzdx * px + rowDepth;
+							if (!inside || !(z < line[x])) continue;
+
+							line[x] = z;
+							shade(tri, e, area, y * width + x);
+							written = true;
+						}
+					}
+					if (written) updateBlock(bx, by);
+				}
+			}
+		}
+	}
+	tileSkipped[tile] = skipped;
+}
+
+/* Recompute the furthest depth of a block after drawing into it */
+void SoftRasteriser::updateBlock(unsigned int bx, unsigned int by)
+{
+	float furthest = 0.f;
+	for (unsigned int y = 0; y < BLOCK_SIZE; y++)
+	{
+		const float *line = &depth[(by * BLOCK_SIZE + y) * stride + bx * BLOCK_SIZE];
+		for (unsigned int x = 0; x < BLOCK_SIZE; x++) furthest = std::max(furthest, line[x]);
+	}
+	blockFurthest[by * blocksX + bx] = furthest;
+}
+
+/* The fragment shader: interpolate the attributes perspective correct from the edge functions,
+   which are the barycentric coordinates times the area, and light the pixel like assignment.frag */
+void SoftRasteriser::shade(const Triangle &triangle, const float *edges, float area, unsigned int pixel)
+{
+	// Edge 1 is opposite vertex 0, edge 2 opposite vertex 1 and edge 0 opposite vertex 2
+	float l0 = edges[1] / area, l1 = edges[2] / area, l2 = edges[0] / area;
+	float w = 1.f / (l0 * triangle.corners[0]->invW + l1 * triangle.corners[1]->invW + l2 * triangle.corners[2]->invW);
+	float a[ATTRIBUTES];
+	for (int i = 0; i < ATTRIBUTES; i++)
+	{
+		a[i] = (l0 * triangle.corners[0]->attributes[i] + l1 * triangle.corners[1]->attributes[i] + l2 * triangle.corners[2]->attributes[i]) * w;
+	}
+
+	const SoftMaterial &material = materials[triangle.material];
+	vec4 result;
+	if (!material.lit)
+	{
+		result = material.colour;
+	}
+	else
+	{
+		vec4 texcolour = vec4(a[COLOUR], a[COLOUR + 1], a[COLOUR + 2], a[COLOUR + 3]) * material.colour;
+		if (material.texture) texcolour *= material.texture->sample(vec2(a[TEXCOORD], a[TEXCOORD + 1]));
+		vec3 albedo = vec3(texcolour);
+
+		vec3 N = normalize(vec3(a[NORMAL], a[NORMAL + 1], a[NORMAL + 2]));
+		vec3 L = normalize(vec3(a[LIGHT_VECTOR], a[LIGHT_VECTOR + 1], a[LIGHT_VECTOR + 2]));
+		vec3 V = normalize(-vec3(a[EYE_POSITION], a[EYE_POSITION + 1], a[EYE_POSITION + 2]));
+		vec3 lit = phongLighting(material, albedo, N, L, V, a[LIGHT_DISTANCE], sunPower);
+		result = vec4(lit, 1.f);
+	}
+
+	unsigned char *out = &colour[pixel * 4];
+	for (int c = 0; c < 4; c++) out[c] = (unsigned char)(glm::clamp(result[c], 0.f, 1.f) * 255.f + 0.5f);
+}
+
+#ifdef SOFT_RASTER_HAS_SSE2
+namespace
+{
+	inline __m128 dot3(const __m128 *a, const __m128 *b)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+	}
+
+	// normalize() as glm has it, v times one over the square root of its length squared
+	inline void normalise3(__m128 *v)
+	{
+		__m128 scale = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(dot3(v, v)));
+		for (int c = 0; c < 3; c++) v[c] = _mm_mul_ps(v[c], scale);
+	}
+}
+
+/* shade() for the four pixels in a row from pixel that are in mask, each column of the registers
+   a pixel. The sums are those of shade() and phongLighting() in the same order, and the maxima
+   and clamps pick the same side when they are equal, so every pixel comes out exactly as shade()
+   would make it. Only the texture and the specular power are found a pixel at a time */
+void SoftRasteriser::shadeQuad(const Triangle &triangle, const float *edges, float area, int mask, unsigned int pixel)
+{
+	const SoftMaterial &material = materials[triangle.material];
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+	__m128 result[4];
+	if (!material.lit)
+	{
+		for (int c = 0; c < 4; c++) result[c] = _mm_set1_ps(material.colour[c]);
+	}
+	else
+	{
+		__m128 size = _mm_set1_ps(area);
+		__m128 l0 = _mm_div_ps(_mm_loadu_ps(edges + 4), size), l1 = _mm_div_ps(_mm_loadu_ps(edges + 8), size);
+		__m128 l2 = _mm_div_ps(_mm_loadu_ps(edges), size);
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l0, _mm_set1_ps(triangle.corners[0]->invW)), _mm_mul_ps(l1, _mm_set1_ps(triangle.corners[1]->invW))),
+			_mm_mul_ps(l2, _mm_set1_ps(triangle.corners[2]->invW)));
+		__m128 w = _mm_div_ps(one, sum);
+		__m128 a[ATTRIBUTES];
+		for (int i = 0; i < ATTRIBUTES; i++)
+		{
+			a[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l0, _mm_set1_ps(triangle.corners[0]->attributes[i])),
+				_mm_mul_ps(l1, _mm_set1_ps(triangle.corners[1]->attributes[i]))), _mm_mul_ps(l2, _mm_set1_ps(triangle.corners[2]->attributes[i])));
+			a[i] = _mm_mul_ps(a[i], w);
+		}
+
+		__m128 texcolour[4];
+		for (int c = 0; c < 4; c++) texcolour[c] = _mm_mul_ps(a[COLOUR + c], _mm_set1_ps(material.colour[c]));
+		if (material.texture)
+		{
+			float u[4], v[4], texel[4][4];
+			_mm_storeu_ps(u, a[TEXCOORD]);
+			_mm_storeu_ps(v, a[TEXCOORD + 1]);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				vec4 t = (mask & (1 << lane)) ? material.texture->sample(vec2(u[lane], v[lane])) : vec4(0.f);
+				for (int c = 0; c < 4; c++) texel[c][lane] = t[c];
+			}
+			for (int c = 0; c < 4; c++) texcolour[c] = _mm_mul_ps(texcolour[c], _mm_loadu_ps(texel[c]));
+		}
+
+		__m128 N[3] = { a[NORMAL], a[NORMAL + 1], a[NORMAL + 2] };
+		__m128 L[3] = { a[LIGHT_VECTOR], a[LIGHT_VECTOR + 1], a[LIGHT_VECTOR + 2] };
+		__m128 V[3];
+		for (int c = 0; c < 3; c++) V[c] = _mm_sub_ps(zero, a[EYE_POSITION + c]);
+		normalise3(N);
+		normalise3(L);
+		normalise3(V);
+
+		// std::max(x, 0.f) keeps x unless x < 0, as _mm_max_ps(zero, x) does
+		__m128 diffuse = _mm_max_ps(zero, dot3(N, L)), lighting[3];
+		for (int c = 0; c < 3; c++) lighting[c] = _mm_mul_ps(diffuse, texcolour[c]);
+		if (material.specular)
+		{
+			// reflect(-L, N) is -L - N * dot(N, -L) * 2
+			__m128 I[3], R[3];
+			for (int c = 0; c < 3; c++) I[c] = _mm_sub_ps(zero, L[c]);
+			__m128 d = dot3(N, I);
+			for (int c = 0; c < 3; c++) R[c] = _mm_sub_ps(I[c], _mm_mul_ps(_mm_mul_ps(N[c], d), _mm_set1_ps(2.f)));
+			float base[4], power[4];
+			_mm_storeu_ps(base, _mm_max_ps(zero, dot3(R, V)));
+			for (int lane = 0; lane < 4; lane++) power[lane] = (mask & (1 << lane)) ? pow(base[lane], shininess) : 0.f;
+			__m128 highlight = _mm_loadu_ps(power);
+			for (int c = 0; c < 3; c++) lighting[c] = _mm_add_ps(lighting[c], _mm_mul_ps(highlight, _mm_set1_ps(specularAlbedo[c])));
+		}
+
+		__m128 power = _mm_set1_ps(sunPower), distance = a[LIGHT_DISTANCE];
+		__m128 falloff = _mm_add_ps(_mm_add_ps(power, _mm_mul_ps(power, distance)), _mm_mul_ps(_mm_mul_ps(power, distance), distance));
+		__m128 attenuation = _mm_div_ps(one, falloff);
+		for (int c = 0; c < 3; c++)
+		{
+			result[c] = _mm_add_ps(_mm_mul_ps(attenuation, lighting[c]), _mm_mul_ps(texcolour[c], _mm_set1_ps(0.3f)));
+			if (material.emissive) result[c] = _mm_add_ps(result[c], _mm_set1_ps(emissiveColour[c]));
+		}
+		result[3] = one;
+	}
+
+	// glm::clamp is min(max(x, 0), 1), which keeps x unless it is past a limit, then to bytes a pixel at a time
+	for (int c = 0; c < 4; c++)
+	{
+		result[c] = _mm_min_ps(one, _mm_max_ps(zero, result[c]));
+		result[c] = _mm_add_ps(_mm_mul_ps(result[c], _mm_set1_ps(255.f)), _mm_set1_ps(0.5f));
+	}
+	_MM_TRANSPOSE4_PS(result[0], result[1], result[2], result[3]);
+	__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(_mm_cvttps_epi32(result[0]), _mm_cvttps_epi32(result[1])),
+		_mm_packs_epi32(_mm_cvttps_epi32(result[2]), _mm_cvttps_epi32(result[3])));
+	if (mask == 15)
+	{
+		_mm_storeu_si128((__m128i*)&colour[pixel * 4], bytes);
+	}
+	else
+	{
+		unsigned char pixels[16];
+		_mm_storeu_si128((__m128i*)pixels, bytes);
+		for (int lane = 0; lane < 4; lane++)
+			if (mask & (1 << lane)) memcpy(&colour[(pixel + lane) * 4], pixels + lane * 4, 4);
+	}
+}
+#endif
+
+size_t SoftRasteriser::triangleCount() const
+{
+	size_t total = 0;
+	for (size_t b = 0; b < batches.size(); b++) total += batches[b].triangles.size();
+	return total;
+}
+
+unsigned long long SoftRasteriser::blocksSkipped() const
+{
+	unsigned long long total = 0;
+	for (size_t t = 0; t < tileSkipped.size(); t++) total += tileSkipped[t];
+	return total;
+}
+
+bool SoftRasteriser::writePNG(const string &file) const
+{
+	return ::writePNG(file, width, height, 4, colour.empty() ? NULL : &colour[0]);
+}
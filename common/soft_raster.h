@@ -0,0 +1,183 @@
+/* soft_raster.h
+ A software rasteriser, so that the example scenes can be rendered where there is no GPU,
+ like a render farm or a test run. It takes the same model, view and projection matrices as
+ the OpenGL examples and lights each pixel with a port of the Phong lighting of assignment.vert
+ and assignment.frag (see shaders/lighting.glsl).
+ draw() only records a mesh with its matrices and material, so the mesh must still be there
+ at finish(). finish() then does the frame's work on a JobPool: it transforms and lights the
+ vertices of every draw as the vertex shader does, cuts the triangles into runs that are clipped
+ at the near plane, set up and binned into the 64 x 64 pixel tiles of the framebuffer that they
+ touch, each run on one thread, and at last rasterises the tiles, each tile on one thread and its
+ triangles in the order they were drawn, so the image is the same however many threads there are.
+ With SSE2 the pixels are drawn four in a row at a time, their coverage, depth, attributes and
+ lighting all found together and only the texture and the specular power looked up a pixel at a
+ time, in the same order of sums as one pixel, so that both give exactly the same image. Each
+ 8 x 8 block of the depth buffer keeps its furthest depth, a hierarchical Z buffer, so a triangle
+ skips the blocks that are already nearer than all of it.
+ Attributes are interpolated perspective correct and textures are sampled bilinearly and
+ wrapped, from RGBA images with their first row at v = 0, the way stb_image loads them for
+ OpenGL. The framebuffer is RGBA with its first row at the top, ready for writePNG().
+ The meshes come from MeshBuilder and sphere_mesh.h, which make the same shapes as the Cube,
+ Sphere and Cylinder classes, or from an obj file read on the CPU. Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include "job_pool.h"
+#include "mesh_builder.h"
+#include "sphere_mesh.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <glm/glm.hpp>
+
+struct SoftVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texcoord;
+	glm::vec4 colour;		// multiplies the texture
+};
+
+/* An indexed triangle list */
+struct SoftMesh
+{
+	std::vector<SoftVertex> vertices;
+	std::vector<unsigned int> indices;
+
+	void fromBuilder(const MeshBuilder &builder, unsigned int mesh);
+	void fromSphere(const SphereMesh &sphere, const glm::vec4 &colour = glm::vec4(1.f));
+};
+
+/* An RGBA image to sample */
+struct SoftTexture
+{
+	SoftTexture();
+
+	void makeTexture(unsigned int width, unsigned int height, unsigned int channels, const unsigned char *data);
+	glm::vec4 sample(const glm::vec2 &uv) const;
+
+	unsigned int width, height;
+	std::vector<unsigned char> texels;
+};
+
+/* How a draw is shaded, like the variants of assignment.frag. An unlit draw is its colour, like shadow.frag */
+struct SoftMaterial
+{
+	SoftMaterial();
+
+	const SoftTexture *texture;		// NULL to use the vertex colours alone
+	bool lit, specular, emissive;
+	glm::vec4 colour;
+};
+
+/* The Phong lighting of assignment.frag at one point of a lit material. albedo is the texture colour,
+   N and L the unit normal and direction to the light and V the unit direction to the eye. A point
+   that can't see the light, in a shadow, only gets the ambient and emitted light */
+glm::vec3 phongLighting(const SoftMaterial &material, const glm::vec3 &albedo, const glm::vec3 &N, const glm::vec3 &L,
+	const glm::vec3 &V, float lightDistance, float sunPower, bool lightVisible = true);
+
+class SoftRasteriser
+{
+public:
+	SoftRasteriser();
+	~SoftRasteriser();
+
+	void makeFramebuffer(unsigned int width, unsigned int height, unsigned int threads = 0);
+
+	/* The uniforms. Set them before the draws that use them */
+	void setCamera(const glm::mat4 &view, const glm::mat4 &projection);
+	void setLight(const glm::vec4 &position, float sunPower);		// world space, like lightPosition. w = 0 for a direction
+
+	void clear(const glm::vec4 &colour);
+	void draw(const SoftMesh &mesh, const glm::mat4 &model, const SoftMaterial &material);
+	void finish(bool simd = true);
+
+	bool writePNG(const std::string &file) const;
+
+	unsigned int width, height;
+	std::vector<unsigned char> colour;		// RGBA, rows from the top
+
+	// What the last frame did
+	size_t triangleCount() const;
+	unsigned long long blocksSkipped() const;		// blocks of triangles that the hierarchical Z threw away
+
+private:
+	enum { TILE_SIZE = 64, BLOCK_SIZE = 8, ATTRIBUTES = 16 };
+
+	// A vertex as the vertex shader leaves it. The attributes are the eye space position, the light
+	// vector, the normal, the texture coordinate, the distance to the light and the colour
+	struct ShadedVertex
+	{
+		glm::vec4 clip;
+		float attributes[ATTRIBUTES];
+	};
+
+	// A vertex in front of the eye projected onto the screen, with its attributes divided by w so
+	// that they can be interpolated across the screen
+	struct ScreenVertex
+	{
+		float x, y, z, invW;
+		float attributes[ATTRIBUTES];
+	};
+
+	// A screen space triangle, its corners wound so that its edge functions are positive inside
+	struct Triangle
+	{
+		const ScreenVertex *corners[3];
+		float nearest;						// smallest z
+		int minX, minY, maxX, maxY;			// pixels, inclusive
+		unsigned int material;
+	};
+
+	// A mesh as draw() recorded it, with the uniforms it was drawn with. Its vertices are shaded
+	// from firstVertex in shaded and its triangles are numbered in the frame from firstTriangle
+	struct Draw
+	{
+		const SoftMesh *mesh;
+		glm::mat4 modelview, projection;
+		glm::mat3 normalMatrix;
+		glm::vec4 light;		// eye space, a direction when w = 0
+		unsigned int material;
+		size_t firstVertex, firstTriangle;
+	};
+
+	// The triangles set up from one run of the frame's triangles, and the ones of them in each tile.
+	// The corners that clipping makes are kept in a deque, which doesn't move them as it grows
+	struct Batch
+	{
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<unsigned int>> bins;
+		std::deque<ScreenVertex> clipped;
+	};
+
+	void shadeVertex(const Draw &draw, const SoftVertex &in, ShadedVertex &out) const;
+	void project(const ShadedVertex &in, ScreenVertex &out) const;
+	void setupBatch(unsigned int batch, size_t first, size_t last);
+	void setupTriangle(Batch &batch, const ScreenVertex *const *corners, unsigned int material);
+	void clipTriangle(Batch &batch, const ShadedVertex &a, const ShadedVertex &b, const ShadedVertex &c, unsigned int material);
+	void rasteriseTile(unsigned int tile, bool simd);
+	void shade(const Triangle &triangle, const float *edges, float area, unsigned int pixel);
+#if (GLM_ARCH & GLM_ARCH_SSE2_BIT)
+	void shadeQuad(const Triangle &triangle, const float *edges, float area, int mask, unsigned int pixel);
+#endif
+	void updateBlock(unsigned int bx, unsigned int by);
+
+	unsigned int tilesX, tilesY;
+	unsigned int stride, blocksX;		// depth buffer row length, padded to whole blocks, and blocks in a row
+	std::vector<float> depth;			// window depth from 0 to 1
+	std::vector<float> blockFurthest;	// the hierarchical Z: the furthest depth in each block
+	glm::vec4 clearColour;
+
+	glm::mat4 view, projection;
+	glm::vec4 lightPosition;
+	float sunPower;
+
+	std::vector<SoftMaterial> materials;		// one for each draw
+	std::vector<Draw> draws;
+	std::vector<ShadedVertex> shaded;			// the vertices of all of the draws
+	std::vector<ScreenVertex> projected;		// and those of them in front of the eye on the screen
+	std::vector<Batch> batches;					// in the order the triangles were drawn
+	std::vector<unsigned long long> tileSkipped;
+	JobPool pool;
+};
@@ -2,11 +2,13 @@
  Example class to create a generic sphere object
  Resolution can be controlled by setting the number of latitudes and longitudes
  Iain Martin November 2018
+ The geometry comes from MeshBuilder::addSphere and is drawn from one buffer object by a MeshBatch.
 */
 
 #pragma once
 
 #include "wrapper_glfw.h"
+#include "mesh_batch.h"
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -19,12 +21,6 @@ public:
 	void makeSphere(GLuint numlats, GLuint numlongs);
 	void drawSphere(int drawmode);
 
-	// Define vertex buffer object names (e.g as globals)
-	GLuint sphereBufferObject;
-	GLuint sphereNormals;
-	GLuint sphereColours;
-	GLuint elementbuffer;
-
 	GLuint attribute_v_coord;
 	GLuint attribute_v_normal;
 	GLuint attribute_v_colours;
@@ -34,5 +30,6 @@ public:
 	int numlongs;
 
 private:
-	void makeUnitSphere(GLfloat *pVertices);
+	MeshBatch batch;
+	GLuint mesh;
 };
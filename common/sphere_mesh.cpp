@@ -0,0 +1,259 @@
+/* sphere_mesh.cpp
+ Icosphere and cube sphere generators.
+*/
+
+#include "sphere_mesh.h"
+#include <cmath>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+	const float PI = 3.141592653589f;
+
+	unsigned int addPosition(SphereMesh &mesh, vec3 p)
+	{
+		mesh.positions.push_back(p.x);
+		mesh.positions.push_back(p.y);
+		mesh.positions.push_back(p.z);
+		return (unsigned int)(mesh.positions.size() / 3 - 1);
+	}
+
+	void addTriangle(SphereMesh &mesh, unsigned int a, unsigned int b, unsigned int c)
+	{
+		mesh.indices.push_back(a);
+		mesh.indices.push_back(b);
+		mesh.indices.push_back(c);
+	}
+
+	/* A copy of vertex v with its own texture coordinates */
+	unsigned int copyVertex(SphereMesh &mesh, unsigned int v, float u, float t)
+	{
+		unsigned int copy = addPosition(mesh, vec3(mesh.positions[v * 3], mesh.positions[v * 3 + 1], mesh.positions[v * 3 + 2]));
+		mesh.texcoords.push_back(u);
+		mesh.texcoords.push_back(t);
+		return copy;
+	}
+
+	/* Give a mesh of shared vertices longitude and latitude texture coordinates, the same as
+	   the Sphere class gives: u from 0 at -180 degrees to 1 at +180, v from 0 at the south pole.
+	   Triangles that cross the dateline use copies of their vertices on the low side with 1 added
+	   to u, and each triangle at a pole gets a copy of the pole in the middle of its two other u */
+	void addLongLatTexcoords(SphereMesh &mesh)
+	{
+		size_t shared = mesh.positions.size() / 3;
+		mesh.texcoords.resize(shared * 2);
+		vector<bool> pole(shared);
+		for (size_t v = 0; v < shared; v++)
+		{
+			float x = mesh.positions[v * 3], y = mesh.positions[v * 3 + 1], z = mesh.positions[v * 3 + 2];
+			pole[v] = (x == 0.f && y == 0.f);
+			mesh.texcoords[v * 2] = pole[v] ? 0.5f : atan2(y, x) / (2 * PI) + 0.5f;
+			mesh.texcoords[v * 2 + 1] = asin(clamp(z, -1.f, 1.f)) / PI + 0.5f;
+		}
+
+		vector<unsigned int> wrapped(shared, 0);		// copy with u + 1, 0 until made
+		for (size_t t = 0; t < mesh.indices.size(); t += 3)
+		{
+			unsigned int *tri = &mesh.indices[t];
+			float u[3], lowest = 2.f, highest = -1.f;
+			for (int c = 0; c < 3; c++)
+			{
+				u[c] = mesh.texcoords[tri[c] * 2];
+				if (pole[tri[c]]) continue;
+				lowest = std::min(lowest, u[c]);
+				highest = std::max(highest, u[c]);
+			}
+
+			if (highest - lowest > 0.5f)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					if (pole[tri[c]] || u[c] >= 0.5f) continue;
+					if (wrapped[tri[c]] == 0) wrapped[tri[c]] = copyVertex(mesh, tri[c], u[c] + 1.f, mesh.texcoords[tri[c] * 2 + 1]);
+					tri[c] = wrapped[tri[c]];
+					u[c] += 1.f;
+				}
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				if (!pole[tri[c]]) continue;
+				float middle = (u[(c + 1) % 3] + u[(c + 2) % 3]) * 0.5f;
+				tri[c] = copyVertex(mesh, tri[c], middle, mesh.texcoords[tri[c] * 2 + 1]);
+			}
+		}
+	}
+}
+
+size_t icosphereVertexCount(unsigned int level)
+{
+	return 10 * ((size_t)1 << (2 * level)) + 2;
+}
+
+size_t icosphereTriangleCount(unsigned int level)
+{
+	return 20 * ((size_t)1 << (2 * level));
+}
+
+/* The count for SPHERE_LONGLAT_TEXCOORDS is before the dateline and pole copies */
+size_t cubeSphereVertexCount(unsigned int divisions, SphereTexcoords texcoords)
+{
+	size_t n = divisions;
+	return (texcoords == SPHERE_FACE_TEXCOORDS) ? 6 * (n + 1) * (n + 1) : 6 * n * n + 2;
+}
+
+size_t cubeSphereTriangleCount(unsigned int divisions)
+{
+	return 12 * (size_t)divisions * divisions;
+}
+
+void makeIcosphere(unsigned int level, SphereTexcoords texcoords, SphereMesh &mesh)
+{
+	mesh.positions.clear();
+	mesh.texcoords.clear();
+	mesh.indices.clear();
+	mesh.positions.reserve(icosphereVertexCount(level) * 3);
+	mesh.indices.reserve(icosphereTriangleCount(level) * 3);
+
+	// A vertex at each pole and two rings of five, the lower ring turned by 36 degrees
+	float ringZ = 1.f / sqrt(5.f), ringRadius = 2.f / sqrt(5.f);
+	unsigned int top = addPosition(mesh, vec3(0, 0, 1.f));
+	for (int i = 0; i < 10; i++)
+	{
+		float angle = (i < 5 ? i * 72.f : (i - 5) * 72.f + 36.f) * PI / 180.f;
+		addPosition(mesh, vec3(ringRadius * cos(angle), ringRadius * sin(angle), i < 5 ? ringZ : -ringZ));
+	}
+	unsigned int bottom = addPosition(mesh, vec3(0, 0, -1.f));
+
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		unsigned int upper = 1 + i, upperNext = 1 + (i + 1) % 5;
+		unsigned int lower = 6 + i, lowerNext = 6 + (i + 1) % 5;
+		addTriangle(mesh, top, upper, upperNext);
+		addTriangle(mesh, upper, lower, upperNext);
+		addTriangle(mesh, upperNext, lower, lowerNext);
+		addTriangle(mesh, bottom, lowerNext, lower);
+	}
+
+	// Split each triangle into four, sharing the new vertex on each edge with the triangle across it
+	vector<unsigned int> split;
+	unordered_map<unsigned long long, unsigned int> midpoints;
+	for (unsigned int l = 0; l < level; l++)
+	{
+		midpoints.clear();
+		midpoints.reserve(mesh.indices.size() / 2);
+		split.resize(mesh.indices.size() * 4);
+
+		for (size_t t = 0; t < mesh.indices.size(); t += 3)
+		{
+			unsigned int corner[3] = { mesh.indices[t], mesh.indices[t + 1], mesh.indices[t + 2] }, middle[3];
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = corner[e], b = corner[(e + 1) % 3];
+				unsigned long long key = (a < b) ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+				unordered_map<unsigned long long, unsigned int>::iterator found = midpoints.find(key);
+				if (found != midpoints.end())
+				{
+					middle[e] = found->second;
+					continue;
+				}
+				vec3 pa(mesh.positions[a * 3], mesh.positions[a * 3 + 1], mesh.positions[a * 3 + 2]);
+				vec3 pb(mesh.positions[b * 3], mesh.positions[b * 3 + 1], mesh.positions[b * 3 + 2]);
+				middle[e] = midpoints[key] = addPosition(mesh, normalize(pa + pb));
+			}
+
+			unsigned int *out = &split[t * 4];
+			unsigned int children[12] = {
+				corner[0], middle[0], middle[2],
+				middle[0], corner[1], middle[1],
+				middle[2], middle[1], corner[2],
+				middle[0], middle[1], middle[2]
+			};
+			for (int i = 0; i < 12; i++) out[i] = children[i];
+		}
+		mesh.indices.swap(split);
+	}
+
+	if (texcoords == SPHERE_LONGLAT_TEXCOORDS) addLongLatTexcoords(mesh);
+}
+
+void makeCubeSphere(unsigned int divisions, SphereTexcoords texcoords, SphereMesh &mesh)
+{
+	unsigned int n = divisions < 1 ? 1 : divisions;
+	bool ownVertices = (texcoords == SPHERE_FACE_TEXCOORDS);
+
+	mesh.positions.clear();
+	mesh.texcoords.clear();
+	mesh.indices.clear();
+	mesh.positions.reserve(cubeSphereVertexCount(n, texcoords) * 3);
+	mesh.indices.reserve(cubeSphereTriangleCount(n) * 3);
+	if (ownVertices) mesh.texcoords.reserve(cubeSphereVertexCount(n, texcoords) * 2);
+
+	// Points on the cube's edges are shared between faces, found by their whole number cube coordinates
+	unordered_map<unsigned long long, unsigned int> edgePoints;
+	vector<unsigned int> grid((n + 1) * (n + 1));
+
+	for (int face = 0; face < 6; face++)
+	{
+		// The face's axis and the two across it, in the order that makes the face counter-clockwise from outside
+		int axis = face / 2;
+		bool positive = (face % 2 == 0);
+		int across = positive ? (axis + 1) % 3 : (axis + 2) % 3;
+		int up = positive ? (axis + 2) % 3 : (axis + 1) % 3;
+
+		for (unsigned int j = 0; j <= n; j++)
+		{
+			for (unsigned int i = 0; i <= n; i++)
+			{
+				unsigned int lattice[3];
+				lattice[axis] = positive ? n : 0;
+				lattice[across] = i;
+				lattice[up] = j;
+
+				bool edge = (i == 0 || i == n || j == 0 || j == n);
+				unsigned long long key = ((unsigned long long)lattice[0] << 42) | ((unsigned long long)lattice[1] << 21) | lattice[2];
+				if (!ownVertices && edge)
+				{
+					unordered_map<unsigned long long, unsigned int>::iterator found = edgePoints.find(key);
+					if (found != edgePoints.end())
+					{
+						grid[j * (n + 1) + i] = found->second;
+						continue;
+					}
+				}
+
+				// Equal angle mapping: the same angle between each pair of grid lines seen from the centre
+				vec3 p;
+				for (int c = 0; c < 3; c++) p[c] = tan((lattice[c] * 2.f / n - 1.f) * PI / 4.f);
+				if (positive) p[axis] = 1.f;
+				else p[axis] = -1.f;
+				unsigned int v = addPosition(mesh, normalize(p));
+				grid[j * (n + 1) + i] = v;
+
+				if (ownVertices)
+				{
+					mesh.texcoords.push_back((float)i / n);
+					mesh.texcoords.push_back((float)j / n);
+				}
+				else if (edge) edgePoints[key] = v;
+			}
+		}
+
+		for (unsigned int j = 0; j < n; j++)
+		{
+			for (unsigned int i = 0; i < n; i++)
+			{
+				unsigned int a = grid[j * (n + 1) + i], b = grid[j * (n + 1) + i + 1];
+				unsigned int c = grid[(j + 1) * (n + 1) + i + 1], d = grid[(j + 1) * (n + 1) + i];
+				addTriangle(mesh, a, b, c);
+				addTriangle(mesh, a, c, d);
+			}
+		}
+	}
+
+	if (texcoords == SPHERE_LONGLAT_TEXCOORDS) addLongLatTexcoords(mesh);
+}
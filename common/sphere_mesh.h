@@ -0,0 +1,44 @@
+/* sphere_mesh.h
+ Unit spheres with an even spread of triangles, as an alternative to the latitude and
+ longitude sphere, which crowds its triangles in at the poles.
+	makeIcosphere	- an icosahedron with each triangle split into four, level times over:
+					  20 * 4^level triangles and 10 * 4^level + 2 vertices
+	makeCubeSphere	- a cube with each face cut into a divisions x divisions grid, pushed out
+					  onto the sphere with an equal angle mapping: 12 * divisions^2 triangles
+					  and 6 * divisions^2 + 2 vertices
+ Both are made with integer steps, share every vertex they can and give the counts above
+ exactly, so arrays can be sized before anything is made. Texture coordinates add vertices:
+ longitude and latitude ones split the vertices along the dateline and give each triangle at
+ a pole its own copy of the pole, so the texture wraps without a smeared seam, and face ones
+ (cube sphere only) give each face its own (divisions + 1)^2 vertices.
+ The poles are on the z axis and u runs with longitude, like the Sphere classes; a cube sphere
+ only has a vertex at each pole when divisions is even. The normal
+ of each vertex is its position. Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+enum SphereTexcoords
+{
+	SPHERE_NO_TEXCOORDS,
+	SPHERE_LONGLAT_TEXCOORDS,
+	SPHERE_FACE_TEXCOORDS		// 0 to 1 across each face of a cube sphere
+};
+
+struct SphereMesh
+{
+	std::vector<float> positions;		// xyz, also the normals
+	std::vector<float> texcoords;		// uv, empty without texture coordinates
+	std::vector<unsigned int> indices;	// counter-clockwise seen from outside
+};
+
+size_t icosphereVertexCount(unsigned int level);
+size_t icosphereTriangleCount(unsigned int level);
+size_t cubeSphereVertexCount(unsigned int divisions, SphereTexcoords texcoords = SPHERE_NO_TEXCOORDS);
+size_t cubeSphereTriangleCount(unsigned int divisions);
+
+void makeIcosphere(unsigned int level, SphereTexcoords texcoords, SphereMesh &mesh);
+void makeCubeSphere(unsigned int divisions, SphereTexcoords texcoords, SphereMesh &mesh);
@@ -22,6 +22,8 @@ Sphere::Sphere(bool useTexture)
 	attribute_v_normal = 2;
 	attribute_v_texcoord = 3;
 	numspherevertices = 0;		// We set this when we know the numlats and numlongs values in makeSphere
+	numindices = 0;
+	triangleList = false;
 	drawmode = 0;
 
 	// Initialise other member variables (good practice)
@@ -52,6 +54,7 @@ void Sphere::makeSphere(GLuint numlats, GLuint numlongs)
 	numspherevertices = numvertices;
 	this->numlats = numlats;
 	this->numlongs = numlongs;
+	triangleList = false;
 
 	// Create the temporary arrays to create the sphere vertex attributes
 	GLfloat* pVertices = new GLfloat[numvertices * 3];
@@ -138,6 +141,68 @@ void Sphere::makeSphere(GLuint numlats, GLuint numlongs)
 	delete [] pVertices;
 }
 
+/* Make the sphere as an icosphere, with longitude and latitude texture coordinates if texturing
+   is enabled. Level 4 gives 5120 triangles */
+void Sphere::makeIcosphere(GLuint level)
+{
+	SphereMesh mesh;
+	::makeIcosphere(level, enableTexture ? SPHERE_LONGLAT_TEXCOORDS : SPHERE_NO_TEXCOORDS, mesh);
+	makeMeshBuffers(mesh);
+}
+
+/* Make the sphere as a cube sphere, with longitude and latitude texture coordinates if texturing
+   is enabled. 20 divisions gives 4800 triangles */
+void Sphere::makeCubeSphere(GLuint divisions)
+{
+	SphereMesh mesh;
+	::makeCubeSphere(divisions, enableTexture ? SPHERE_LONGLAT_TEXCOORDS : SPHERE_NO_TEXCOORDS, mesh);
+	makeMeshBuffers(mesh);
+}
+
+/* Create the same buffer objects as makeSphere from an icosphere or cube sphere, with the
+   positions as the normals and colours */
+void Sphere::makeMeshBuffers(const SphereMesh &mesh)
+{
+	GLuint numvertices = (GLuint)(mesh.positions.size() / 3);
+	numspherevertices = numvertices;
+	numindices = (GLuint)mesh.indices.size();
+	triangleList = true;
+
+	vector<GLfloat> colours(numvertices * 4);
+	for (GLuint i = 0; i < numvertices; i++)
+	{
+		colours[i * 4] = mesh.positions[i * 3];
+		colours[i * 4 + 1] = mesh.positions[i * 3 + 1];
+		colours[i * 4 + 2] = mesh.positions[i * 3 + 2];
+		colours[i * 4 + 3] = 1.f;
+	}
+
+	glGenBuffers(1, &sphereBufferObject);
+	glBindBuffer(GL_ARRAY_BUFFER, sphereBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numvertices * 3, &mesh.positions[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &sphereNormals);
+	glBindBuffer(GL_ARRAY_BUFFER, sphereNormals);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numvertices * 3, &mesh.positions[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &sphereColours);
+	glBindBuffer(GL_ARRAY_BUFFER, sphereColours);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numvertices * 4, &colours[0], GL_STATIC_DRAW);
+
+	if (enableTexture)
+	{
+		glGenBuffers(1, &sphereTexCoords);
+		glBindBuffer(GL_ARRAY_BUFFER, sphereTexCoords);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numvertices * 2, &mesh.texcoords[0], GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &elementbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numindices * sizeof(GLuint), &mesh.indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
 
 /* Define the vertex positions and texture coordinates for a sphere. 
   The array of vertices must have previously been created.
@@ -156,18 +221,16 @@ void Sphere::makeUnitSphere(GLfloat *pVertices, GLfloat *pTexCoords)
 	GLfloat latstep = 180.f / numlats;
 	GLfloat longstep = 360.f / (numlongs - 1);
 
-	/* Define vertices along latitude lines */
-	for (GLfloat lat = 90.f - latstep; lat > -90.f; lat -= latstep)
+	/* Define vertices along latitude lines. Counting whole steps rather than adding up floats
+	   gives exactly numlats - 1 rings of numlongs vertices, the last one on the dateline at +180 */
+	for (GLuint ring = 1; ring < numlats; ring++)
 	{
+		GLfloat lat = 90.f - ring * latstep;
 		lat_radians = lat * DEG_TO_RADIANS;
 
-		// This includes a quick hack to avoid a precion error.
-		// lon should be limited to a max of 180.f but in practice this misses
-		// out the dateline veretx duplication in some onstances (values on numlongs) so
-		// I've increased  lon max to 180.f + longstep / 10.f to ensure that the last
-		// set of vertices gets drawn. 
-		for (GLfloat lon = -180.f; lon <= (180.f + longstep / 10.f); lon += longstep)
+		for (GLuint step = 0; step < numlongs; step++)
 		{
+			GLfloat lon = -180.f + step * longstep;
 			lon_radians = lon * DEG_TO_RADIANS;
 
 			x = cos(lat_radians) * cos(lon_radians);
@@ -235,6 +298,11 @@ void Sphere::drawSphere(int drawmode)
 	{
 		glDrawArrays(GL_POINTS, 0, numspherevertices);
 	}
+	else if (triangleList)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+		glDrawElements(GL_TRIANGLES, numindices, GL_UNSIGNED_INT, (GLvoid*)(0));
+	}
 	else
 	{
 		/* Bind the indexed vertex buffer */
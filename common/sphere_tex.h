@@ -1,12 +1,15 @@
 /* sphere.h
  Example class to create a generic sphere object with texture coordinates
- Resolution can be controlled by setting number of latitudes and longitudes
+ Resolution can be controlled by setting number of latitudes and longitudes, or the sphere
+ can be made as an icosphere or cube sphere (see sphere_mesh.h), which spread their triangles
+ evenly rather than crowding them in at the poles
  Iain Martin November 2019
 */
 
 #pragma once
 
 #include "wrapper_glfw.h"
+#include "sphere_mesh.h"
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -17,6 +20,8 @@ public:
 	~Sphere();
 
 	void makeSphere(GLuint numlats, GLuint numlongs);
+	void makeIcosphere(GLuint level);
+	void makeCubeSphere(GLuint divisions);
 	void drawSphere(int drawmode);
 
 	// Define vertex buffer object names (e.g as globals)
@@ -34,9 +39,12 @@ public:
 	unsigned int numspherevertices;
 	unsigned int numlats;
 	unsigned int numlongs;
+	unsigned int numindices;		// for the icosphere and cube sphere, drawn as a triangle list
+	bool triangleList;
 	unsigned int drawmode;
 	bool enableTexture;
 
 private:
 	void makeUnitSphere(GLfloat *pVertices, GLfloat *pTexCoords);
+	void makeMeshBuffers(const SphereMesh &mesh);
 };
@@ -0,0 +1,111 @@
+/* station_model.cpp
+ The parts of assignment_one's space station and the claw on the end of its arm.
+*/
+
+#include "station_model.h"
+
+using namespace std;
+using namespace glm;
+
+StationModel::StationModel()
+{
+	sceneNode = stationNode = armRootNode = armJointNode = armTipNode = -1;
+}
+
+StationModel::~StationModel()
+{
+}
+
+/* Add a part of the station and return the node that places it. The size only applies to
+   the part's own shape, so it goes on a child node that nothing else hangs off */
+int StationModel::addPart(int parent, vec3 position, vec3 rotation, vec3 pivot, vec3 size, vec3 colour, PartShape shape)
+{
+	int placed = hierarchy.addNode(parent, position, rotation, pivot);
+
+	StationPart part;
+	part.node = hierarchy.addNode(placed, vec3(0), vec3(0), vec3(0), size);
+	part.colour = colour;
+	part.shape = shape;
+	parts.push_back(part);
+	return placed;
+}
+
+/* Build the ISS hierarchy. The positions are the ones the parts were drawn at, made
+   relative to their parent node */
+void StationModel::makeStation(float modelScale, vec3 position)
+{
+	vec3 grey(0.5f, 0.5f, 0.5f), dark(0.2f, 0.2f, 0.2f), white(0.9f, 0.9f, 0.9f);
+
+	sceneNode = hierarchy.addNode(-1, vec3(0), vec3(0), vec3(0), vec3(modelScale));
+	stationNode = hierarchy.addNode(sceneNode, position);
+
+	// Hull
+	addPart(stationNode, vec3(0, 0, 0), vec3(90.f, 0, 0), vec3(0), vec3(0.3f, 1.5f, 0.3f), grey, PART_CYLINDER);
+	addPart(stationNode, vec3(0, 0, 1.0f), vec3(90.f, 0, 0), vec3(0), vec3(0.15f, 1.5f, 0.15f), grey, PART_CYLINDER);
+	addPart(stationNode, vec3(0, 0, 1.6f), vec3(90.f, 0, 0), vec3(0), vec3(0.3f, 1.5f, 0.3f), grey, PART_CYLINDER);
+	addPart(stationNode, vec3(0, 0.9f, 1.6f), vec3(0, 90.f, 0), vec3(0), vec3(0.3f, 1.0f, 0.3f), grey, PART_CYLINDER);
+	addPart(stationNode, vec3(0, 0.5f, 1.6f), vec3(0, 90.f, 0), vec3(0), vec3(0.15f, 1.0f, 0.15f), grey, PART_CYLINDER);
+	addPart(stationNode, vec3(0, -0.9f, 1.6f), vec3(0, 90.f, 0), vec3(0), vec3(0.3f, 1.0f, 0.3f), grey, PART_CYLINDER);
+	addPart(stationNode, vec3(0, -0.5f, 1.6f), vec3(0, 90.f, 0), vec3(0), vec3(0.15f, 1.0f, 0.15f), grey, PART_CYLINDER);
+
+	// Solar array rods and panels, the left pair turns with panelOneRotation and the right with panelTwoRotation
+	float rods[4][2] = { { 0.7f, 0.4f }, { 0.7f, -0.4f }, { -0.7f, -0.4f }, { -0.7f, 0.4f } };
+	for (int i = 0; i < 4; i++)
+	{
+		vector<int> &nodes = (i < 2) ? panelOneNodes : panelTwoNodes;
+		float rodX = rods[i][0], panelX = rodX + (rodX > 0 ? 0.1f : -0.1f), z = rods[i][1];
+		nodes.push_back(addPart(stationNode, vec3(rodX, 0, z), vec3(0), vec3(0), vec3(2.5f, 0.06f, 0.05f), grey, PART_CUBE));
+		nodes.push_back(addPart(stationNode, vec3(panelX, 0, z), vec3(0), vec3(0), vec3(1.8f, 0.05f, 0.5f), dark, PART_CUBE));
+	}
+
+	// Arm. Each segment turns about the end nearest the station and carries the segments after it
+	vec3 pivot(0, 0, 0.25f);
+	armRootNode = addPart(stationNode, vec3(0, 0, -1.f), vec3(0), pivot, vec3(0.2f, 0.2f, 1.f), vec3(0.2f, 0.2f, 0.5f), PART_CUBE);
+	armJointNode = addPart(armRootNode, vec3(0, 0, -0.5f), vec3(0), pivot, vec3(0.2f, 0.2f, 1.f), vec3(0.1f, 0.1f, 0.6f), PART_CUBE);
+	armTipNode = addPart(armJointNode, vec3(0, 0, -0.5f), vec3(0), pivot, vec3(0.2f, 0.2f, 1.f), white, PART_CUBE);
+	addPart(armTipNode, vec3(0, 0, -0.25f), vec3(0), vec3(0), vec3(0.2f, 0.2f, 0.2f), white, PART_CLAW);
+}
+
+void StationModel::setPlacement(float modelScale, vec3 position)
+{
+	hierarchy.setScale(sceneNode, vec3(modelScale));
+	hierarchy.setTranslation(stationNode, position);
+}
+
+void StationModel::setPanels(float panelOneRotation, float panelTwoRotation)
+{
+	for (size_t i = 0; i < panelOneNodes.size(); i++) hierarchy.setRotation(panelOneNodes[i], vec3(panelOneRotation, 0, 0));
+	for (size_t i = 0; i < panelTwoNodes.size(); i++) hierarchy.setRotation(panelTwoNodes[i], vec3(panelTwoRotation, 0, 0));
+}
+
+void StationModel::setArm(vec3 rootRotation, vec3 jointRotation, vec3 tipRotation)
+{
+	hierarchy.setRotation(armRootNode, rootRotation);
+	hierarchy.setRotation(armJointNode, jointRotation);
+	hierarchy.setRotation(armTipNode, tipRotation);
+}
+
+/* The same triangles and colours as Claw::makeClaw, each with its own face normal */
+unsigned int addClaw(MeshBuilder &builder)
+{
+	const vec3 corners[12] = {
+		vec3(1, 1, 0), vec3(-1, -1, 0), vec3(1, -1, 0),
+		vec3(1, 1, 0), vec3(-1, -1, 0), vec3(-1, 1, 0),
+		vec3(0, -1, -2), vec3(-1, -1, 0), vec3(1, -1, 0),
+		vec3(0, 1, -2), vec3(-1, 1, 0), vec3(1, 1, 0)
+	};
+
+	builder.reserve(12, 12);
+	builder.beginMesh();
+	for (int f = 0; f < 4; f++)
+	{
+		const vec3 *v = &corners[f * 3];
+		vec4 colour = (f < 2) ? vec4(0, 0, 1.f, 1.f) : vec4(0, 1.f, 0, 1.f);
+		vec3 normal = normalize(cross(v[1] - v[0], v[2] - v[0]));
+		unsigned int first = builder.addVertex(v[0], colour, normal);
+		builder.addVertex(v[1], colour, normal);
+		builder.addVertex(v[2], colour, normal);
+		builder.addTriangle(first, first + 1, first + 2);
+	}
+	return builder.endMesh();
+}
@@ -0,0 +1,54 @@
+/* station_model.h
+ The space station of assignment_one: the transform hierarchy of its parts, with the shape and
+ colour of each. poslight draws it with OpenGL and soft_render rasterises it for the regression
+ check, both from this one table, so a change to the station shows up in the check.
+ The parts hang off the station node, and the arm segments off each other so that each joint
+ only moves its own subtree. Nothing in here uses OpenGL.
+*/
+
+#pragma once
+
+#include "scene_hierarchy.h"
+#include "mesh_builder.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+/* A part of the station to draw: the node that places it, its colour and its shape */
+enum PartShape { PART_CYLINDER, PART_CUBE, PART_CLAW };
+struct StationPart
+{
+	int node;
+	glm::vec3 colour;
+	PartShape shape;
+};
+
+class StationModel
+{
+public:
+	StationModel();
+	~StationModel();
+
+	void makeStation(float modelScale = 1.f, glm::vec3 position = glm::vec3(0));
+
+	/* Move the station and its moving parts. Nodes whose values haven't changed stay clean, so
+	   moving one arm joint only recomputes that joint and the segments after it */
+	void setPlacement(float modelScale, glm::vec3 position);
+	void setPanels(float panelOneRotation, float panelTwoRotation);
+	void setArm(glm::vec3 rootRotation, glm::vec3 jointRotation, glm::vec3 tipRotation);
+	int update() { return hierarchy.update(); }
+
+	const glm::mat4& world(const StationPart &part) const { return hierarchy.world(part.node); }
+
+	SceneHierarchy hierarchy;
+	std::vector<StationPart> parts;
+
+private:
+	int addPart(int parent, glm::vec3 position, glm::vec3 rotation, glm::vec3 pivot, glm::vec3 size, glm::vec3 colour,
+		PartShape shape);
+
+	int sceneNode, stationNode, armRootNode, armJointNode, armTipNode;
+	std::vector<int> panelOneNodes, panelTwoNodes;		// the left pair of solar arrays and the right
+};
+
+/* The claw's four triangles, those of the Claw class, as a mesh in a MeshBuilder */
+unsigned int addClaw(MeshBuilder &builder);
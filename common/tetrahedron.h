@@ -1,11 +1,13 @@
 /* tetrahedron.h
  Example class to create a tetrahedron object
  Iain Martin November 2018
+ The geometry comes from MeshBuilder::addTetrahedron and is drawn from one buffer object by a MeshBatch.
 */
 
 #pragma once
 
 #include "wrapper_glfw.h"
+#include "mesh_batch.h"
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -17,21 +19,13 @@ public:
 
 	/* function prototypes */
 	void defineTetrahedron();
-	void drawTetrahedron();
-
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec3> normals;
-	std::vector<GLushort> elements;
-
-	// Define vertex buffer object names (e.g as globals)
-	GLuint tetra_buffer_normals;
-	GLuint tetra_buffer_vertices;
-	GLuint tetra_buffer_colours;
+	void drawTetrahedron(int drawmode);
 
 	GLuint attribute_v_coord;
 	GLuint attribute_v_normal;
 	GLuint attribute_v_colours;
 
-	int numvertices;
-	int drawmode;
+private:
+	MeshBatch batch;
+	GLuint mesh;
 };
@@ -0,0 +1,77 @@
+/* texture_cache.cpp
+ Loads image files into OpenGL textures with stb_image, once per file.
+*/
+
+#include "texture_cache.h"
+#include "stb_image.h"
+#include <iostream>
+
+using namespace std;
+
+TextureCache::TextureCache()
+{
+}
+
+/* The GL context may already be gone when this runs, so the textures are only deleted by clear() */
+TextureCache::~TextureCache()
+{
+}
+
+/* The texture for an image file, loaded the first time it is asked for. Returns 0 if the
+   file can't be loaded */
+GLuint TextureCache::load(const string &filename, bool generateMipmaps)
+{
+	map<string, GLuint>::iterator found = textures.find(filename);
+	if (found != textures.end()) return found->second;
+
+	GLuint texID = 0;
+	int width, height, nrChannels;
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
+	if (data)
+	{
+		GLenum formats[] = { GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		GLenum pixel_format = formats[nrChannels];
+
+		glGenTextures(1, &texID);
+		glBindTexture(GL_TEXTURE_2D, texID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, pixel_format, width, height, 0, pixel_format, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		// Greyscale images, with or without alpha, are read back as grey rather than red
+		if (nrChannels < 3)
+		{
+			GLint swizzle[] = { GL_RED, GL_RED, GL_RED, nrChannels == 2 ? GL_GREEN : GL_ONE };
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+
+		if (generateMipmaps)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		else
+		{
+			// If mipmaps are not used then ensure that the min filter is defined
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		stbi_image_free(data);
+	}
+	else
+	{
+		cerr << "Could not load texture " << filename << endl;
+	}
+
+	textures[filename] = texID;
+	return texID;
+}
+
+/* Delete all of the textures */
+void TextureCache::clear()
+{
+	for (map<string, GLuint>::iterator i = textures.begin(); i != textures.end(); i++)
+	{
+		if (i->second) glDeleteTextures(1, &i->second);
+	}
+	textures.clear();
+}
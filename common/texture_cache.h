@@ -0,0 +1,25 @@
+/* texture_cache.h
+ Loads image files into OpenGL textures with stb_image, once per file. Objects that
+ share a texture, like the materials of several obj models, get the same texture name.
+ The application must define STB_IMAGE_IMPLEMENTATION in one of its own files.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include <map>
+#include <string>
+
+class TextureCache
+{
+public:
+	TextureCache();
+	~TextureCache();
+
+	GLuint load(const std::string &filename, bool generateMipmaps = true);
+	void clear();
+	size_t size() const { return textures.size(); }
+
+private:
+	std::map<std::string, GLuint> textures;		// 0 for files that couldn't be loaded, so they aren't tried again
+};
@@ -0,0 +1,177 @@
+/* transform_pipeline.cpp
+ Computes per-object transforms on the CPU and streams them into a uniform buffer.
+*/
+
+#include "transform_pipeline.h"
+#include <cstring>
+
+using namespace std;
+using namespace glm;
+
+TransformPipeline::TransformPipeline()
+{
+	bindingPoint = 0;
+	transformBuffer = 0;
+	stride = 0;
+	capacity = 0;
+	used = 0;
+}
+
+TransformPipeline::~TransformPipeline()
+{
+}
+
+/* Create the uniform buffer that the transforms are streamed into. Each slot
+   is padded to the uniform buffer offset alignment so it can be bound on its own */
+void TransformPipeline::makePipeline(GLuint bindingPoint, GLuint capacity)
+{
+	this->bindingPoint = bindingPoint;
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	stride = ((GLuint)sizeof(ObjectTransforms) + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &transformBuffer);
+	this->capacity = capacity;
+	allocate(transformBuffer, capacity);
+	used = 0;
+}
+
+/* (Re)allocate a buffer's storage. The driver keeps the old storage alive for any
+   draws that still use it, so this never waits on the GPU */
+void TransformPipeline::allocate(GLuint buffer, GLuint capacity)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, capacity * stride, 0, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/* Point the program's Transforms block at our binding point. Call this again
+   whenever the program is rebuilt */
+void TransformPipeline::bindProgram(GLuint program)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(program, "Transforms");
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(program, blockIndex, bindingPoint);
+	}
+}
+
+/* Set the camera for this frame and start writing from the beginning of fresh storage. Storage is
+   only ever orphaned here: a frame that ran out hands out slots in overflow buffers instead, as
+   slots it gave out before are still to be bound, and the next frame's buffer holds them all */
+void TransformPipeline::beginFrame(const mat4 &view, const mat4 &projection)
+{
+	this->view = view;
+	this->projection = projection;
+	viewProjection = projection * view;
+
+	if (used > capacity) capacity = used;
+	allocate(transformBuffer, capacity);
+	for (size_t i = 0; i < overflow.size(); i++) spareBuffers.push_back(overflow[i].buffer);
+	overflow.clear();
+	used = 0;
+}
+
+/* Find room for count slots, in an overflow buffer when the last buffer is full, and upload them
+   from the staging area. Returns the first slot */
+GLuint TransformPipeline::upload(GLuint count)
+{
+	GLuint end = overflow.empty() ? capacity : overflow.back().firstSlot + overflow.back().capacity;
+	if (used + count > end)
+	{
+		Overflow more;
+		more.firstSlot = end;
+		more.capacity = (count > capacity) ? count : capacity;
+		if (spareBuffers.empty())
+		{
+			glGenBuffers(1, &more.buffer);
+		}
+		else
+		{
+			more.buffer = spareBuffers.back();
+			spareBuffers.pop_back();
+		}
+		allocate(more.buffer, more.capacity);
+		overflow.push_back(more);
+		used = end;
+	}
+
+	GLuint first = used, offset;
+	GLuint buffer = bufferOf(first, offset);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset * stride, count * stride, &staging[0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	used += count;
+	return first;
+}
+
+/* The buffer that holds a slot, and where the slot is in it */
+GLuint TransformPipeline::bufferOf(GLuint slot, GLuint &offset) const
+{
+	for (size_t i = overflow.size(); i > 0; i--)
+	{
+		if (slot >= overflow[i - 1].firstSlot)
+		{
+			offset = slot - overflow[i - 1].firstSlot;
+			return overflow[i - 1].buffer;
+		}
+	}
+	offset = slot;
+	return transformBuffer;
+}
+
+/* Compute the transforms for a batch of objects and upload them in one go.
+   Returns the slot of the first object, pass slot + i to bindObject() before drawing object i */
+GLuint TransformPipeline::addObjects(const mat4 *models, GLuint count)
+{
+	if (count == 0) return used;
+
+	staging.resize(count * stride);
+	for (GLuint i = 0; i < count; i++)
+	{
+		ObjectTransforms transforms = objectTransforms(models[i], view, viewProjection);
+		memcpy(&staging[i * stride], &transforms, sizeof(ObjectTransforms));
+	}
+	return upload(count);
+}
+
+/* Compute the transforms for a batch of instances with the SIMD batch kernels and upload them in one go.
+   Returns the slot of the first instance */
+GLuint TransformPipeline::addBatch(const TransformBatch &batch)
+{
+	GLuint count = (GLuint)batch.size();
+	if (count == 0) return used;
+
+	staging.resize(count * stride);
+	batchTransform(batch, view, projection, (ObjectTransforms*)&staging[0], stride);
+	return upload(count);
+}
+
+/* Upload transforms that were computed elsewhere, e.g. by the threads recording draw lists.
+   Returns the slot of the first object */
+GLuint TransformPipeline::addTransforms(const ObjectTransforms *objects, GLuint count)
+{
+	if (count == 0) return used;
+
+	staging.resize(count * stride);
+	for (GLuint i = 0; i < count; i++)
+	{
+		memcpy(&staging[i * stride], &objects[i], sizeof(ObjectTransforms));
+	}
+	return upload(count);
+}
+
+/* Bind the transforms of an object that was added this frame */
+void TransformPipeline::bindObject(GLuint slot)
+{
+	GLuint offset;
+	GLuint buffer = bufferOf(slot, offset);
+	glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, buffer, offset * stride, sizeof(ObjectTransforms));
+}
+
+/* Compute, upload and bind the transforms for a single object */
+void TransformPipeline::setModel(const mat4 &model)
+{
+	bindObject(addObjects(&model, 1));
+}
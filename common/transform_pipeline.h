@@ -0,0 +1,54 @@
+/* transform_pipeline.h
+ Computes the model, model-view, model-view-projection and normal matrices for each
+ object once on the CPU and streams them to the shaders through the "Transforms"
+ uniform block declared in shaders/transforms.glsl.
+ This keeps matrix products and inverse-transposes out of the vertex shader.
+*/
+
+#pragma once
+
+#include "wrapper_glfw.h"
+#include "batch_transform.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+class TransformPipeline
+{
+public:
+	TransformPipeline();
+	~TransformPipeline();
+
+	void makePipeline(GLuint bindingPoint = 0, GLuint capacity = 1024);
+	void bindProgram(GLuint program);
+
+	void beginFrame(const glm::mat4 &view, const glm::mat4 &projection);
+	GLuint addObjects(const glm::mat4 *models, GLuint count);
+	GLuint addBatch(const TransformBatch &batch);
+	GLuint addTransforms(const ObjectTransforms *objects, GLuint count);
+	void bindObject(GLuint slot);
+	void setModel(const glm::mat4 &model);
+
+	GLuint bindingPoint;
+
+private:
+	// A buffer that a frame needed once the main one was full. Its slots follow on from those before it
+	struct Overflow
+	{
+		GLuint buffer;
+		GLuint firstSlot, capacity;
+	};
+
+	void allocate(GLuint buffer, GLuint capacity);
+	GLuint upload(GLuint count);
+	GLuint bufferOf(GLuint slot, GLuint &offset) const;
+
+	GLuint transformBuffer;
+	GLuint stride;			// size of one slot, rounded up to the uniform buffer offset alignment
+	GLuint capacity;		// number of slots in the buffer
+	GLuint used;			// slots handed out this frame, counting on through the overflow buffers
+	std::vector<Overflow> overflow;		// this frame's
+	std::vector<GLuint> spareBuffers;	// overflow buffers of earlier frames, to be orphaned and used again
+
+	glm::mat4 view, projection, viewProjection;
+	std::vector<unsigned char> staging;
+};
@@ -0,0 +1,266 @@
+/* vertex_quantiser.cpp
+ Packs float vertices into 16 bit positions, octahedral normals and 16 bit texture
+ coordinates, and measures the error that this causes.
+ The octahedral mapping is from Cigolle et al., "A Survey of Efficient Representations
+ for Independent Unit Vectors" (2014).
+*/
+
+#include "vertex_quantiser.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+	inline const float* attribute(const float *first, size_t stride, size_t i)
+	{
+		return (const float*)((const unsigned char*)first + i * stride);
+	}
+
+	inline float signNotZero(float x)
+	{
+		return x >= 0.f ? 1.f : -1.f;
+	}
+
+	/* Signed normalised to float the way OpenGL does it */
+	inline float snormToFloat(short v, int bits)
+	{
+		float maxValue = (float)((1 << (bits - 1)) - 1);
+		return max(v / maxValue, -1.f);
+	}
+
+	inline float angleDegrees(const float a[3], const float b[3])
+	{
+		float d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		return acos(min(max(d, -1.f), 1.f)) * 57.2957795f;
+	}
+
+	inline bool normalise(float n[3])
+	{
+		float length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.f) return false;
+		for (int i = 0; i < 3; i++) n[i] /= length;
+		return true;
+	}
+}
+
+/* Map the normal onto an octahedron and unfold it into a square. Each of the four
+   roundings of the result is tried, keeping the one closest to the normal */
+void octahedralEncode(const float normal[3], int bits, short encoded[2])
+{
+	float l1 = fabs(normal[0]) + fabs(normal[1]) + fabs(normal[2]);
+	if (l1 == 0.f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	float x = normal[0] / l1, y = normal[1] / l1;
+	if (normal[2] < 0.f)
+	{
+		float folded = (1.f - fabs(y)) * signNotZero(x);
+		y = (1.f - fabs(x)) * signNotZero(y);
+		x = folded;
+	}
+
+	float maxValue = (float)((1 << (bits - 1)) - 1);
+	float unit[3] = { normal[0], normal[1], normal[2] };
+	normalise(unit);
+
+	float bestError = 1e30f;
+	for (int i = 0; i < 4; i++)
+	{
+		short candidate[2] = {
+			(short)((i & 1) ? ceil(x * maxValue) : floor(x * maxValue)),
+			(short)((i & 2) ? ceil(y * maxValue) : floor(y * maxValue))
+		};
+		float decoded[3];
+		octahedralDecode(candidate, bits, decoded);
+		float error = 1.f - (decoded[0] * unit[0] + decoded[1] * unit[1] + decoded[2] * unit[2]);
+		if (error < bestError)
+		{
+			bestError = error;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+}
+
+/* The same decode as octDecode in shaders/octahedral.glsl */
+void octahedralDecode(const short encoded[2], int bits, float normal[3])
+{
+	float x = snormToFloat(encoded[0], bits), y = snormToFloat(encoded[1], bits);
+	float z = 1.f - fabs(x) - fabs(y);
+	float t = max(-z, 0.f);
+	normal[0] = x + (x >= 0.f ? -t : t);
+	normal[1] = y + (y >= 0.f ? -t : t);
+	normal[2] = z;
+	normalise(normal);
+}
+
+/* Round a float to the nearest half float, ties to even */
+unsigned short halfFromFloat(float f)
+{
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+	unsigned short sign = (unsigned short)((bits >> 16) & 0x8000);
+	unsigned int magnitude = bits & 0x7FFFFFFF;
+
+	// Too large, infinity or NaN
+	if (magnitude >= 0x47800000) return sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00);
+
+	// Subnormal halves are multiples of 2^-24
+	if (magnitude < 0x38800000)
+	{
+		float a;
+		memcpy(&a, &magnitude, sizeof(a));
+		return sign | (unsigned short)nearbyint(a * 16777216.f);
+	}
+
+	// Rebias the exponent from 127 to 15 and round off 13 bits of mantissa
+	unsigned int h = (magnitude - 0x38000000) >> 13;
+	unsigned int rest = magnitude & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) h++;
+	return sign | (unsigned short)h;
+}
+
+float floatFromHalf(unsigned short h)
+{
+	int exponent = (h >> 10) & 0x1F, mantissa = h & 0x3FF;
+	float v;
+	if (exponent == 0) v = mantissa / 16777216.f;
+	else if (exponent == 31) v = mantissa ? NAN : INFINITY;
+	else v = ldexp((float)(mantissa | 0x400), exponent - 25);
+	return (h & 0x8000) ? -v : v;
+}
+
+/* Pack count vertices, whose attributes are stride bytes apart, into the quantised format */
+void quantiseVertices(const float *positions, const float *normals, const float *texcoords, size_t stride, size_t count,
+	VertexFormat format, QuantisedVertices &out)
+{
+	out.normalBits = (format == VERTEX_QUANTISED_FINE) ? 16 : 8;
+	out.vertexSize = (out.normalBits == 16) ? 16 : 12;
+	out.normalOffset = (out.normalBits == 16) ? 8 : 6;
+	out.texcoordOffset = out.vertexSize - 4;
+	out.data.assign(count * out.vertexSize, 0);
+
+	// The bounding box, with one scale for all three axes
+	float maxCorner[3] = { 0, 0, 0 };
+	for (int c = 0; c < 3; c++) out.positionMin[c] = count ? attribute(positions, stride, 0)[c] : 0.f;
+	for (int c = 0; c < 3; c++) maxCorner[c] = out.positionMin[c];
+	out.texcoordsHalf = false;
+	for (size_t i = 0; i < count; i++)
+	{
+		const float *p = attribute(positions, stride, i);
+		for (int c = 0; c < 3; c++)
+		{
+			out.positionMin[c] = min(out.positionMin[c], p[c]);
+			maxCorner[c] = max(maxCorner[c], p[c]);
+		}
+		const float *t = attribute(texcoords, stride, i);
+		if (t[0] < 0.f || t[0] > 1.f || t[1] < 0.f || t[1] > 1.f) out.texcoordsHalf = true;
+	}
+	out.positionScale = max(max(maxCorner[0] - out.positionMin[0], maxCorner[1] - out.positionMin[1]), maxCorner[2] - out.positionMin[2]);
+	if (out.positionScale <= 0.f) out.positionScale = 1.f;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned char *vertex = &out.data[i * out.vertexSize];
+
+		const float *p = attribute(positions, stride, i);
+		unsigned short position[3];
+		for (int c = 0; c < 3; c++)
+		{
+			float unit = (p[c] - out.positionMin[c]) / out.positionScale;
+			position[c] = (unsigned short)min(max(floor(unit * 65535.f + 0.5f), 0.f), 65535.f);
+		}
+		memcpy(vertex, position, sizeof(position));
+
+		short normal[2];
+		octahedralEncode(attribute(normals, stride, i), out.normalBits, normal);
+		if (out.normalBits == 16)
+		{
+			memcpy(vertex + out.normalOffset, normal, sizeof(normal));
+		}
+		else
+		{
+			signed char packed[2] = { (signed char)normal[0], (signed char)normal[1] };
+			memcpy(vertex + out.normalOffset, packed, sizeof(packed));
+		}
+
+		const float *t = attribute(texcoords, stride, i);
+		unsigned short texcoord[2];
+		for (int c = 0; c < 2; c++)
+		{
+			texcoord[c] = out.texcoordsHalf ? halfFromFloat(t[c]) : (unsigned short)floor(t[c] * 65535.f + 0.5f);
+		}
+		memcpy(vertex + out.texcoordOffset, texcoord, sizeof(texcoord));
+	}
+}
+
+/* Unpack each vertex the way the GPU will and compare it with the float vertex.
+   Vertices without a normal are left out of the normal error */
+QuantisationError measureQuantisation(const float *positions, const float *normals, const float *texcoords, size_t stride,
+	size_t count, const QuantisedVertices &quantised)
+{
+	QuantisationError error = { 0, 0, 0, 0, 0, 0 };
+	double positionSum = 0, normalSum = 0;
+	size_t normalCount = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned char *vertex = &quantised.data[i * quantised.vertexSize];
+
+		unsigned short position[3];
+		memcpy(position, vertex, sizeof(position));
+		const float *p = attribute(positions, stride, i);
+		float distance = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			float d = quantised.positionMin[c] + quantised.positionScale * (position[c] / 65535.f) - p[c];
+			distance += d * d;
+		}
+		distance = sqrt(distance);
+		error.positionMax = max(error.positionMax, distance);
+		positionSum += distance;
+
+		short normal[2];
+		if (quantised.normalBits == 16)
+		{
+			memcpy(normal, vertex + quantised.normalOffset, sizeof(normal));
+		}
+		else
+		{
+			signed char packed[2];
+			memcpy(packed, vertex + quantised.normalOffset, sizeof(packed));
+			normal[0] = packed[0];
+			normal[1] = packed[1];
+		}
+		float reference[3], decoded[3];
+		memcpy(reference, attribute(normals, stride, i), sizeof(reference));
+		if (normalise(reference))
+		{
+			octahedralDecode(normal, quantised.normalBits, decoded);
+			float angle = angleDegrees(reference, decoded);
+			error.normalMaxDegrees = max(error.normalMaxDegrees, angle);
+			normalSum += angle;
+			normalCount++;
+		}
+
+		unsigned short texcoord[2];
+		memcpy(texcoord, vertex + quantised.texcoordOffset, sizeof(texcoord));
+		const float *t = attribute(texcoords, stride, i);
+		for (int c = 0; c < 2; c++)
+		{
+			float value = quantised.texcoordsHalf ? floatFromHalf(texcoord[c]) : texcoord[c] / 65535.f;
+			error.texcoordMax = max(error.texcoordMax, fabs(value - t[c]));
+		}
+	}
+
+	if (count > 0) error.positionMean = (float)(positionSum / count);
+	if (normalCount > 0) error.normalMeanDegrees = (float)(normalSum / normalCount);
+	error.positionRelative = error.positionMax / quantised.positionScale;
+	return error;
+}
@@ -0,0 +1,56 @@
+/* vertex_quantiser.h
+ Packs float vertices (position, normal, texture coordinate) into a smaller format:
+	positions	- 3 x 16 bit unsigned normalised, relative to the mesh's bounding box. The
+				  same scale is used on every axis so that the dequantisation, which is
+				  folded into the model matrix, doesn't skew the normals
+	normals		- octahedral encoded in 2 x 8 or 2 x 16 bit signed normalised, decoded in
+				  the vertex shader (shaders/octahedral.glsl)
+	texcoords	- 2 x 16 bit unsigned normalised when they are all in [0, 1], half floats
+				  for tiled texture coordinates
+ With 8 bit normals a vertex is 12 bytes, with 16 bit normals it is 16 bytes, against 32
+ bytes for floats. measureQuantisation compares the result with the float vertices.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+enum VertexFormat
+{
+	VERTEX_FLOAT,			// 32 bytes
+	VERTEX_QUANTISED,		// 12 bytes, 8 bit octahedral normals
+	VERTEX_QUANTISED_FINE	// 16 bytes, 16 bit octahedral normals
+};
+
+/* Packed vertices and what is needed to set up the attributes and undo the quantisation */
+struct QuantisedVertices
+{
+	std::vector<unsigned char> data;
+	size_t vertexSize;
+	size_t normalOffset;		// the position is at offset 0
+	size_t texcoordOffset;
+	int normalBits;				// 8 or 16
+	bool texcoordsHalf;			// half floats rather than unsigned normalised
+	float positionMin[3];
+	float positionScale;		// position = positionMin + positionScale * quantised / 65535
+};
+
+/* The largest and the mean difference from the float vertices */
+struct QuantisationError
+{
+	float positionMax, positionMean;	// in model units
+	float positionRelative;				// positionMax over the largest side of the bounding box
+	float normalMaxDegrees, normalMeanDegrees;
+	float texcoordMax;
+};
+
+void quantiseVertices(const float *positions, const float *normals, const float *texcoords, size_t stride, size_t count,
+	VertexFormat format, QuantisedVertices &out);
+QuantisationError measureQuantisation(const float *positions, const float *normals, const float *texcoords, size_t stride,
+	size_t count, const QuantisedVertices &quantised);
+
+void octahedralEncode(const float normal[3], int bits, short encoded[2]);
+void octahedralDecode(const short encoded[2], int bits, float normal[3]);
+unsigned short halfFromFloat(float f);
+float floatFromHalf(unsigned short h);
@@ -6,15 +6,154 @@
   */
 
 #include "wrapper_glfw.h"
+#include "frame_capture.h"
+#include "gl_accounting.h"
 
   /* Inlcude some standard headers */
 
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+/* GL_KHR_parallel_shader_compile is newer than our glload headers so define what we use here */
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRY *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+/* When a file was last written, as finely as the file system records it, and its size. Two saves
+   in the same second, which st_mtime alone can't tell apart, still differ in one or the other */
+struct FileStamp
+{
+	long long seconds, nanoseconds, size;
+
+	bool operator!=(const FileStamp& other) const
+	{
+		return seconds != other.seconds || nanoseconds != other.nanoseconds || size != other.size;
+	}
+};
+
+/* Return the modification time and size of a file, all 0 if it cannot be read */
+static FileStamp fileStamp(const string& path)
+{
+	FileStamp stamp = { 0, 0, 0 };
+#ifdef _WIN32
+	// The write time is in 100 ns ticks
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info)) return stamp;
+	unsigned long long ticks = ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	stamp.seconds = (long long)(ticks / 10000000);
+	stamp.nanoseconds = (long long)(ticks % 10000000) * 100;
+	stamp.size = ((long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return stamp;
+	stamp.seconds = info.st_mtime;
+#ifdef __APPLE__
+	stamp.nanoseconds = info.st_mtimespec.tv_nsec;
+#else
+	stamp.nanoseconds = info.st_mtim.tv_nsec;
+#endif
+	stamp.size = info.st_size;
+#endif
+	return stamp;
+}
+
+/* Return the absolute path of a file, with symbolic links and "." and ".." resolved, so that a file
+   reached by two different relative paths is seen to be the same. A file that can't be found is
+   returned as it is, for readFile to report */
+static string normalisePath(const string& path)
+{
+#ifdef _WIN32
+	char full[_MAX_PATH];
+	if (_fullpath(full, path.c_str(), _MAX_PATH))
+	{
+		string result = full;
+		replace(result.begin(), result.end(), '\\', '/');
+		return result;
+	}
+#else
+	char* full = realpath(path.c_str(), NULL);
+	if (full)
+	{
+		string result = full;
+		free(full);
+		return result;
+	}
+#endif
+	return path;
+}
+
+/* Return the directory part of a path, "." when there isn't one */
+static string fileDirectory(const string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return (slash == string::npos) ? string(".") : path.substr(0, slash);
+}
+
+/* A program that is rebuilt whenever its vertex or fragment shader, or any file they include, changes */
+struct WatchedShader
+{
+	GLuint* target;
+	string vertPath, fragPath, defines;
+	ShaderReloadCallback onReload;
+	vector<string> files;
+	vector<FileStamp> stamps;
+};
+
+/* A rebuilt program waiting to be swapped in at the next frame boundary */
+struct PendingShader
+{
+	size_t index;
+	GLuint program;
+};
+
+/* Record the source files of a watched program and their current modification times and sizes */
+static void updateWatchedFiles(WatchedShader& w, const vector<string>& vertFiles, const vector<string>& fragFiles)
+{
+	w.files = vertFiles;
+	for (size_t i = 0; i < fragFiles.size(); i++)
+	{
+		if (find(w.files.begin(), w.files.end(), fragFiles[i]) == w.files.end()) w.files.push_back(fragFiles[i]);
+	}
+
+	w.stamps.resize(w.files.size());
+	for (size_t i = 0; i < w.files.size(); i++) w.stamps[i] = fileStamp(w.files[i]);
+}
+
+/* State shared between the render thread and the background compile thread. The compile thread
+   owns a hidden window whose context shares objects with the main window, so programs linked
+   there can be used directly by the render thread once they are complete. */
+struct ShaderReloader
+{
+	GLFWwindow* context;
+	thread worker;
+	atomic<bool> running;
+	mutex lock;
+	vector<WatchedShader> watched;
+	vector<PendingShader> pending;
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+};
+
 /* Constructor for wrapper object */
 GLWrapper::GLWrapper(int width, int height, const char* title) {
 
@@ -23,6 +162,9 @@ GLWrapper::GLWrapper(int width, int height, const char* title) {
 	this->title = title;
 	this->fps = 1;
 	this->running = true;
+	this->reloader = 0;
+	this->capture = 0;
+	this->accounting = false;
 
 	/* Initialise GLFW and exit if it fails */
 	if (!glfwInit())
@@ -66,6 +208,9 @@ GLWrapper::GLWrapper(int width, int height, const char* title) {
 
 /* Terminate GLFW on destruvtion of the wrapepr object */
 GLWrapper::~GLWrapper() {
+	releaseCapture();
+	stopShaderReloads();
+	endAccounting();
 	glfwTerminate();
 }
 
@@ -107,11 +252,26 @@ int GLWrapper::eventLoop()
 		// Call function to draw your graphics
 		renderer();
 
+		// Read the frame back before it is swapped away
+		if (capture)
+		{
+			int framebufferWidth, framebufferHeight;
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			capture->captureFrame(framebufferWidth, framebufferHeight);
+		}
+
 		// Swap buffers
 		glfwSwapBuffers(window);
+		if (accounting) endGLAccountingFrame();
 		glfwPollEvents();
+
+		// Swap in any shader programs rebuilt since the last frame
+		applyShaderReloads();
 	}
 
+	releaseCapture();
+	stopShaderReloads();
+	endAccounting();
 	glfwTerminate();
 	return 0;
 }
@@ -143,13 +303,30 @@ void GLWrapper::setKeyCallback(void(*func)(GLFWwindow* window, int key, int scan
 
 /* Build shaders from strings containing shader source code */
 GLuint GLWrapper::BuildShader(GLenum eShaderType, const string& shaderText)
+{
+	GLuint shader;
+	if (!CompileShader(eShaderType, shaderText, shader))
+	{
+		throw exception("Shader compile exception");
+	}
+
+	return shader;
+}
+
+/* Start compiling a shader from source without asking how it went, which would wait for the
+   compile to finish */
+static GLuint startShaderCompile(GLenum eShaderType, const string& shaderText)
 {
 	GLuint shader = glCreateShader(eShaderType);
 	const char* strFileData = shaderText.c_str();
 	glShaderSource(shader, 1, &strFileData, NULL);
-
 	glCompileShader(shader);
+	return shader;
+}
 
+/* Return whether a shader compiled, printing the compile log if it didn't */
+static bool shaderCompiled(GLenum eShaderType, GLuint shader)
+{
 	GLint status;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
 	if (status == GL_FALSE)
@@ -172,11 +349,25 @@ GLuint GLWrapper::BuildShader(GLenum eShaderType, const string& shaderText)
 
 		cerr << "Compile error in " << strShaderType << "\n\t" << strInfoLog << endl;
 		delete[] strInfoLog;
+		return false;
+	}
 
-		throw exception("Shader compile exception");
+	return true;
+}
+
+/* Compile a shader from source, printing the compile log on failure.
+   Unlike BuildShader this does not throw */
+bool GLWrapper::CompileShader(GLenum eShaderType, const string& shaderText, GLuint& shader)
+{
+	shader = startShaderCompile(eShaderType, shaderText);
+	if (!shaderCompiled(eShaderType, shader))
+	{
+		glDeleteShader(shader);
+		shader = 0;
+		return false;
 	}
 
-	return shader;
+	return true;
 }
 
 /* Read a text file into a string*/
@@ -200,14 +391,81 @@ string GLWrapper::readFile(const char* filePath)
 	return content;
 }
 
-/* Load vertex and fragment shader and return the compiled program */
-GLuint GLWrapper::LoadShader(const char* vertex_path, const char* fragment_path)
+/* Expand #include "file" directives in a shader, resolving paths relative to the including file.
+   Each file is included once, the paths being normalised so that it is the same file whichever
+   way it is reached. #line directives keep compile errors pointing at the right line,
+   with the source string number being the index of the file in the files list. */
+static void expandIncludes(GLWrapper* glw, const string& path, string& output, vector<string>& files)
+{
+	size_t fileIndex = files.size();
+	files.push_back(path);
+
+	string source = glw->readFile(path.c_str());
+	size_t start = 0;
+	int lineNumber = 1;
+	while (start < source.size())
+	{
+		size_t end = source.find('\n', start);
+		if (end == string::npos) end = source.size();
+		string line = source.substr(start, end - start);
+		start = end + 1;
+		lineNumber++;
+
+		size_t first = line.find_first_not_of(" \t");
+		if (first == string::npos || line.compare(first, 8, "#include") != 0)
+		{
+			output += line + "\n";
+			continue;
+		}
+
+		size_t open = line.find('"', first);
+		size_t close = (open == string::npos) ? string::npos : line.find('"', open + 1);
+		if (close == string::npos)
+		{
+			cerr << path << "(" << lineNumber - 1 << "): malformed #include" << endl;
+			output += "\n";
+			continue;
+		}
+
+		string include = normalisePath(fileDirectory(path) + "/" + line.substr(open + 1, close - open - 1));
+		if (find(files.begin(), files.end(), include) == files.end())
+		{
+			output += "#line 1 " + to_string(files.size()) + "\n";
+			expandIncludes(glw, include, output, files);
+		}
+		output += "#line " + to_string(lineNumber) + " " + to_string(fileIndex) + "\n";
+	}
+}
+
+/* Read a shader file, expand its #includes and insert the given #define lines after the #version line.
+   The list of files that make up the shader is returned in files if requested */
+string GLWrapper::preprocessShader(const char* filePath, const string& defines, vector<string>* files)
+{
+	vector<string> included;
+	string source;
+	expandIncludes(this, normalisePath(filePath), source, included);
+	if (files) *files = included;
+
+	if (defines.empty()) return source;
+
+	// #version has to stay the first statement in the shader
+	size_t version = source.find("#version");
+	size_t insert = (version == string::npos) ? 0 : source.find('\n', version) + 1;
+	int versionLine = (int)count(source.begin(), source.begin() + insert, '\n');
+
+	return source.substr(0, insert) + defines + "#line " + to_string(versionLine + 1) + " 0\n" + source.substr(insert);
+}
+
+/* Load vertex and fragment shader and return the compiled program.
+   Shaders may #include other files, and defines is inserted into both of them
+   to select compile-time variants */
+GLuint GLWrapper::LoadShader(const char* vertex_path, const char* fragment_path, const string& defines)
 {
 	GLuint vertShader, fragShader;
 
 	// Read shaders
-	string vertShaderStr = readFile(vertex_path);
-	string fragShaderStr = readFile(fragment_path);
+	string vertShaderStr = preprocessShader(vertex_path, defines);
+	string fragShaderStr = preprocessShader(fragment_path, defines);
 
 	GLint result = GL_FALSE;
 	int logLength;
@@ -275,4 +533,308 @@ GLuint GLWrapper::BuildShaderProgram(string vertShaderStr, string fragShaderStr)
 	glDeleteShader(fragShader);
 
 	return program;
-}
\ No newline at end of file
+}
+
+
+/* Background compile thread. Waits for a watched shader file to change (inotify on Linux,
+   polling file stamps elsewhere), then rebuilds every affected program on the shared context.
+   Programs that fail to compile or link are discarded so the render thread keeps the old one. */
+static void shaderReloadWorker(GLWrapper* glw, ShaderReloader* reloader)
+{
+	glfwMakeContextCurrent(reloader->context);
+
+	// Let the driver compile on its own threads when it can, so we only ever wait on the result
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+	{
+		reloader->glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		if (reloader->glMaxShaderCompilerThreadsKHR) reloader->glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
+#ifdef __linux__
+	int notify = inotify_init1(IN_NONBLOCK);
+	vector<string> directories;
+#endif
+
+	while (reloader->running)
+	{
+		vector<WatchedShader> watched;
+		{
+			lock_guard<mutex> guard(reloader->lock);
+			watched = reloader->watched;
+		}
+
+#ifdef __linux__
+		// Watch the directories rather than the files as editors often save by replacing the file
+		for (size_t i = 0; i < watched.size() && notify >= 0; i++)
+		{
+			for (size_t f = 0; f < watched[i].files.size(); f++)
+			{
+				string dir = fileDirectory(watched[i].files[f]);
+				if (find(directories.begin(), directories.end(), dir) != directories.end()) continue;
+				inotify_add_watch(notify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				directories.push_back(dir);
+			}
+		}
+
+		if (notify >= 0)
+		{
+			pollfd fd = { notify, POLLIN, 0 };
+			if (poll(&fd, 1, 250) > 0)
+			{
+				// Drain the events and give the editor a moment to finish writing
+				char events[4096];
+				while (read(notify, events, sizeof(events)) > 0) {}
+				this_thread::sleep_for(chrono::milliseconds(50));
+			}
+		}
+		else
+#endif
+		{
+			this_thread::sleep_for(chrono::milliseconds(250));
+		}
+
+		// Find the programs whose sources are newer than the last build
+		vector<size_t> changed;
+		for (size_t i = 0; i < watched.size(); i++)
+		{
+			for (size_t f = 0; f < watched[i].files.size(); f++)
+			{
+				if (fileStamp(watched[i].files[f]) != watched[i].stamps[f])
+				{
+					changed.push_back(i);
+					break;
+				}
+			}
+		}
+		if (changed.empty()) continue;
+
+		// Issue every compile and link before checking any results. Even a compile status would wait for
+		// the compile, so nothing is asked until the link is complete, and the compile logs are only
+		// read when it failed
+		vector<GLuint> programs(changed.size(), 0);
+		vector<GLuint> shaders(changed.size() * 2, 0);
+		for (size_t c = 0; c < changed.size(); c++)
+		{
+			WatchedShader& w = watched[changed[c]];
+			cout << "Rebuilding " << w.vertPath << " / " << w.fragPath << endl;
+
+			// Includes may have been added or removed so the file list is refreshed on every build
+			vector<string> vertFiles, fragFiles;
+			string vertShaderStr = glw->preprocessShader(w.vertPath.c_str(), w.defines, &vertFiles);
+			string fragShaderStr = glw->preprocessShader(w.fragPath.c_str(), w.defines, &fragFiles);
+			updateWatchedFiles(w, vertFiles, fragFiles);
+			{
+				lock_guard<mutex> guard(reloader->lock);
+				reloader->watched[changed[c]].files = w.files;
+				reloader->watched[changed[c]].stamps = w.stamps;
+			}
+
+			shaders[c * 2] = startShaderCompile(GL_VERTEX_SHADER, vertShaderStr);
+			shaders[c * 2 + 1] = startShaderCompile(GL_FRAGMENT_SHADER, fragShaderStr);
+			programs[c] = glCreateProgram();
+			glAttachShader(programs[c], shaders[c * 2]);
+			glAttachShader(programs[c], shaders[c * 2 + 1]);
+			glLinkProgram(programs[c]);
+		}
+
+		for (size_t c = 0; c < changed.size(); c++)
+		{
+			if (!programs[c]) continue;
+
+			GLint status = GL_FALSE;
+			if (reloader->glMaxShaderCompilerThreadsKHR)
+			{
+				while (reloader->running)
+				{
+					glGetProgramiv(programs[c], GL_COMPLETION_STATUS_KHR, &status);
+					if (status == GL_TRUE) break;
+					this_thread::sleep_for(chrono::milliseconds(1));
+				}
+			}
+
+			glGetProgramiv(programs[c], GL_LINK_STATUS, &status);
+			if (status == GL_FALSE)
+			{
+				// A shader that didn't compile explains the failure better than the linker does
+				bool compiled = shaderCompiled(GL_VERTEX_SHADER, shaders[c * 2]);
+				compiled = shaderCompiled(GL_FRAGMENT_SHADER, shaders[c * 2 + 1]) && compiled;
+				if (compiled)
+				{
+					GLint infoLogLength;
+					glGetProgramiv(programs[c], GL_INFO_LOG_LENGTH, &infoLogLength);
+					vector<GLchar> strInfoLog(infoLogLength + 1);
+					glGetProgramInfoLog(programs[c], infoLogLength, NULL, &strInfoLog[0]);
+					cerr << "Linker error: " << &strInfoLog[0] << endl;
+				}
+
+				glDeleteProgram(programs[c]);
+				programs[c] = 0;
+			}
+			glDeleteShader(shaders[c * 2]);
+			glDeleteShader(shaders[c * 2 + 1]);
+		}
+
+		// Make sure the programs are complete before another context uses them
+		glFinish();
+
+		lock_guard<mutex> guard(reloader->lock);
+		for (size_t c = 0; c < changed.size(); c++)
+		{
+			if (!programs[c]) continue;
+			PendingShader p = { changed[c], programs[c] };
+			reloader->pending.push_back(p);
+		}
+	}
+
+#ifdef __linux__
+	if (notify >= 0) close(notify);
+#endif
+	glfwMakeContextCurrent(0);
+}
+
+/* Register a program to be rebuilt whenever its shader files, or files they include, change. The new program is swapped
+   into *program at a frame boundary and onReload is called so uniform locations can be looked up again.
+   If the new source fails to build the old program is kept. */
+void GLWrapper::watchShader(GLuint* program, const char* vertex_path, const char* fragment_path, ShaderReloadCallback onReload, const string& defines)
+{
+	if (!reloader)
+	{
+		// The shared context has to be created here, GLFW only creates windows on the main thread
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		GLFWwindow* context = glfwCreateWindow(1, 1, "", 0, window);
+		glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+		glfwMakeContextCurrent(window);
+
+		if (!context)
+		{
+			cerr << "Could not create a shared context, shader hot-reload is disabled." << endl;
+			return;
+		}
+
+		reloader = new ShaderReloader();
+		reloader->context = context;
+		reloader->running = true;
+		reloader->glMaxShaderCompilerThreadsKHR = 0;
+	}
+
+	WatchedShader w;
+	w.target = program;
+	w.vertPath = vertex_path;
+	w.fragPath = fragment_path;
+	w.defines = defines;
+	w.onReload = onReload;
+
+	vector<string> vertFiles, fragFiles;
+	preprocessShader(vertex_path, defines, &vertFiles);
+	preprocessShader(fragment_path, defines, &fragFiles);
+	updateWatchedFiles(w, vertFiles, fragFiles);
+	{
+		lock_guard<mutex> guard(reloader->lock);
+		reloader->watched.push_back(w);
+	}
+
+	if (!reloader->worker.joinable())
+	{
+		reloader->worker = thread(shaderReloadWorker, this, reloader);
+	}
+}
+
+/* Swap rebuilt programs in. Called between frames so a draw never sees half of a reload */
+void GLWrapper::applyShaderReloads()
+{
+	if (!reloader) return;
+
+	vector<PendingShader> pending;
+	vector<WatchedShader> watched;
+	{
+		lock_guard<mutex> guard(reloader->lock);
+		if (reloader->pending.empty()) return;
+		pending.swap(reloader->pending);
+		watched = reloader->watched;
+	}
+
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		const WatchedShader& w = watched[pending[i].index];
+		GLuint old = *w.target;
+		*w.target = pending[i].program;
+		if (old) glDeleteProgram(old);
+		if (w.onReload) w.onReload(*w.target);
+	}
+}
+
+/* Stop the compile thread and release the shared context */
+void GLWrapper::stopShaderReloads()
+{
+	if (!reloader) return;
+
+	reloader->running = false;
+	if (reloader->worker.joinable()) reloader->worker.join();
+
+	for (size_t i = 0; i < reloader->pending.size(); i++)
+	{
+		glDeleteProgram(reloader->pending[i].program);
+	}
+
+	glfwDestroyWindow(reloader->context);
+	delete reloader;
+	reloader = 0;
+}
+
+
+/* Capture the next frame into a PNG file */
+void GLWrapper::screenshot(const char* file)
+{
+	getCapture()->screenshot(file);
+}
+
+/* Capture every frame from the next one on, as prefix000000.png and so on, or into prefix.rgb */
+void GLWrapper::startCapture(const char* prefix, bool raw)
+{
+	getCapture()->startSequence(prefix, raw);
+	cout << "Capturing to " << prefix << (raw ? ".rgb" : "######.png") << endl;
+}
+
+void GLWrapper::stopCapture()
+{
+	if (!capture || !capture->recording()) return;
+	capture->stopSequence();
+	capture->finish();
+	cout << "Captured " << capture->framesWritten() << " frames, " << capture->stalls() << " of them waited on the GPU or the disk" << endl;
+}
+
+/* The capture is made the first time it is used, on the render thread */
+FrameCapture* GLWrapper::getCapture()
+{
+	if (!capture)
+	{
+		capture = new FrameCapture();
+		capture->makeCapture();
+	}
+	return capture;
+}
+
+/* Write out every frame still on its way, while the context is still here to read them */
+void GLWrapper::releaseCapture()
+{
+	if (!capture) return;
+	stopCapture();
+	delete capture;
+	capture = 0;
+}
+
+/* Count the GL calls and objects from here on (see gl_accounting.h). Call this after the
+   application's own ogl_LoadFunctions(), which puts the driver's functions back */
+void GLWrapper::enableAccounting()
+{
+	installGLAccounting();
+	accounting = true;
+}
+
+/* List the objects nothing deleted, while the context that holds them is still here */
+void GLWrapper::endAccounting()
+{
+	if (!accounting) return;
+	reportGLLeaks(cout);
+	accounting = false;
+}
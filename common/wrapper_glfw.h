@@ -6,12 +6,20 @@ Iain Martin August 2014
 #pragma once
 
 #include <string>
+#include <vector>
 
 /* Inlcude GL_Load and GLFW */
 #include <glload/gl_4_0.h>
 #include <glload/gl_load.h>
 #include <GLFW/glfw3.h>
 
+/* Called on the render thread after a watched shader program has been rebuilt and swapped in,
+   so that the application can re-resolve its uniform locations */
+typedef void(*ShaderReloadCallback)(GLuint program);
+
+struct ShaderReloader;
+class FrameCapture;
+
 class GLWrapper {
 private:
 
@@ -22,6 +30,13 @@ private:
 	void(*renderer)();
 	bool running;
 	GLFWwindow* window;
+	ShaderReloader* reloader;
+	FrameCapture* capture;
+	bool accounting;
+
+	void stopShaderReloads();
+	void releaseCapture();
+	void endAccounting();
 
 public:
 	GLWrapper(int width, int height, const char *title);
@@ -40,10 +55,28 @@ public:
 	void setErrorCallback(void(*f)(int error, const char* description));
 
 	/* Shader load and build support functions */
-	GLuint LoadShader(const char *vertex_path, const char *fragment_path);
+	GLuint LoadShader(const char *vertex_path, const char *fragment_path, const std::string &defines = "");
 	GLuint BuildShader(GLenum eShaderType, const std::string &shaderText);
+	bool CompileShader(GLenum eShaderType, const std::string &shaderText, GLuint &shader);
 	GLuint BuildShaderProgram(std::string vertShaderStr, std::string fragShaderStr);
 	std::string readFile(const char *filePath);
+	std::string preprocessShader(const char *filePath, const std::string &defines, std::vector<std::string> *files = 0);
+
+	/* Shader hot-reload: rebuilds a program on a background context when its source files change */
+	void watchShader(GLuint *program, const char *vertex_path, const char *fragment_path, ShaderReloadCallback onReload = 0, const std::string &defines = "");
+	void applyShaderReloads();
+
+	/* Frame capture: frames are read back through a ring of pixel buffers and written by a worker thread,
+	   so capturing doesn't hold the frame rate up (see frame_capture.h). A screenshot is the next frame,
+	   a capture every frame until stopCapture(), as numbered PNGs or with raw set a single raw RGB file */
+	void screenshot(const char *file);
+	void startCapture(const char *prefix, bool raw = false);
+	void stopCapture();
+	FrameCapture* getCapture();
+
+	/* GL call and object accounting: each frame is ended after the swap, and the objects still
+	   alive are reported when the loop ends (see gl_accounting.h) */
+	void enableAccounting();
 
 	int eventLoop();
 	GLFWwindow* getWindow();
@@ -3,6 +3,12 @@
 
 #version 420 core
 
+// Compile-time variants, selected by the application:
+//   EMIT        - the object emits light (used for the light source sphere)
+//   ATTENUATION - attenuate the light with distance
+
+#include "../../shaders/lighting.glsl"
+
 in vec4 fcolour;
 in vec4 vertexPosition;
 in vec4 color;
@@ -12,7 +18,6 @@ in vec3 vertexNormal;
 out vec4 outputColor;
 
 // These are the uniforms that are defined in the application
-uniform uint colourmode, emitmode, attenuationmode;
 uniform float sunPower;
 
 // Global constants (for this vertex shader)
@@ -22,44 +27,28 @@ int  shininess = 50;
 
 void main()
 {
-	vec3 emissive = vec3(0);				// Create a vec3(0, 0, 0) for our emmissive light
-	vec4 position_h = vertexPosition;	// Convert the (x,y,z) position to homogeneous coords (x,y,z,w)
-	vec4 diffuse_albedo;					// This is the vertex colour, used to handle the colourmode change
-	vec3 light_pos3 = lightDirection.xyz;			
-
 	float distanceToLight = length(lightDirection);
 
-	vec3 normalizedLightPosition = normalize(light_pos3);
-	vec3 normalizedLightVector = normalize(lightDirection);
-
-	// Calculate the diffuse component
-	vec3 diffuse = max(dot(vertexNormal, normalizedLightPosition), 0.0) * color.xyz;
+	vec3 N = normalize(vertexNormal);
+	vec3 L = normalize(lightDirection);
 
-	vec3 V = normalize(-vertexPosition.xyz);	
-	vec3 R = reflect(-normalizedLightVector, vertexNormal);
-	vec3 specular = pow(max(dot(R, V), 0.0), shininess) * specular_albedo;
+	// Calculate the diffuse and specular components
+	vec3 diffuse = diffuse_term(N, L) * color.xyz;
+	vec3 specular = specular_term(N, L, vertexPosition.xyz, shininess, specular_albedo);
 
-	float attenuation;
-	if (attenuationmode != 1)
-	{
-		attenuation = 1.0;
-	}
-	else
-	{
-		// Define attenuation constants. These could be uniforms for greater flexibility
-		float attenuation_k1 = sunPower;
-		float attenuation_k2 = sunPower;
-		float attenuation_k3 = sunPower;
-		attenuation = 1.0 / (attenuation_k1 + attenuation_k2 * distanceToLight + attenuation_k3 * pow(distanceToLight, 2));
-	}
+#ifdef ATTENUATION
+	// Define attenuation constants. These could be uniforms for greater flexibility
+	float attenuation = attenuation_term(distanceToLight, sunPower, sunPower, sunPower);
+#else
+	float attenuation = 1.0;
+#endif
 
-
-
-	if (emitmode == 1) emissive = vec3(1.0, 1.0, 0.8);
-	
 	vec3 ambient = color.xyz * 0.2;
 
+	vec3 colour = attenuation * (ambient + diffuse + specular);
+#ifdef EMIT
+	colour += emissive_colour;
+#endif
 
-	outputColor = vec4(attenuation * (ambient + diffuse + specular) + emissive, 1.0f);
-
+	outputColor = vec4(colour, 1.0f);
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 // Specify minimum OpenGL version
 #version 420 core
 
+// Compile-time variants, selected by the application:
+//   PART_COLOUR - colour each part with partColor instead of a flat grey
+
 // Define the vertex attributes
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 colour;
@@ -18,14 +21,10 @@ out vec3 lightDirection;
 out vec3 vertexNormal;
 
 // These are the uniforms that are defined in the application
-uniform mat4 model, view, projection;
-uniform mat3 normalmatrix;
-uniform uint colourmode, emitmode;
+#include "../../shaders/transforms.glsl"
 uniform vec4 lightpos;
 uniform vec3 partColor;
 
-uniform uint attenuationmode;
-
 // Global constants (for this vertex shader)
 vec3 specular_albedo = vec3(1.0, 0.8, 0.6);
 vec3 global_ambient = vec3(0.05, 0.05, 0.05);
@@ -38,18 +37,17 @@ void main()
 	vec4 diffuse_albedo;					// This is the vertex colour, used to handle the colourmode change
 	vec3 light_pos3 = lightpos.xyz;			
 
-	// Switch the vertex colour based on the colourmode
-	if (colourmode == 1)
-		//diffuse_albedo = colour;
-		diffuse_albedo = vec4(partColor, 1.0f);
-	else
-		diffuse_albedo = vec4(0.4, 0.4, 0.4, 1.0);
+	// Switch the vertex colour based on the colour variant
+#ifdef PART_COLOUR
+	diffuse_albedo = vec4(partColor, 1.0f);
+#else
+	diffuse_albedo = vec4(0.4, 0.4, 0.4, 1.0);
+#endif
 
 	vec3 ambient = diffuse_albedo.xyz * 0.2;
 
 	// Define our vectors to calculate diffuse and specular lighting
-	mat4 mv_matrix = view * model;		// Calculate the model-view transformation
-	vec4 P = mv_matrix * position_h;	// Modify the vertex position (x, y, z, w) by the model-view transformation
+	vec4 P = modelview * position_h;	// Modify the vertex position (x, y, z, w) by the model-view transformation
 	vec3 N = normalize(normalmatrix * normal);		// Modify the normals by the normal-matrix (i.e. to model-view (or eye) coordinates )
 	vec3 L = light_pos3 - P.xyz;		// Calculate the vector from the light position to the vertex in eye space
 	float distanceToLight = length(L);	// For attenuation
@@ -62,7 +60,7 @@ void main()
 
 	lightDirection = L;
 
-	gl_Position = (projection * view * model) * position_h;
+	gl_Position = mvp * position_h;
 }
 
 
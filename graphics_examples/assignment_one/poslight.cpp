@@ -22,7 +22,6 @@ if you prefer */
    also includes the OpenGL extension initialisation*/
 #include "wrapper_glfw.h"
 #include <iostream>
-#include <stack>
 
    /* Include GLM core and matrix extensions*/
 #include <glm/glm.hpp>
@@ -30,21 +29,25 @@ if you prefer */
 #include <glm/gtc/type_ptr.hpp>
 
 // Include headers for our objects
-#include "sphere.h"
-#include "cube.h"
-#include "claw.h"
-#include "cylinder.h"
+#include "mesh_builder.h"
+#include "mesh_batch.h"
+#include "shader_variants.h"
+#include "transform_pipeline.h"
+#include "station_model.h"
 
 using namespace std;
 using namespace glm;
 
 void printInstructions();
 void setColor(float red, float green, float blue);
+void useVariant(GLuint features);
 
 /* Define buffer object indices */
 GLuint elementbuffer;
 
-GLuint program;		/* Identifier for the shader prgoram */
+ShaderVariants shaders;	/* Compile-time variants of the shader program */
+TransformPipeline transforms;	/* Per-object matrices, computed on the CPU */
+GLuint emitFeature, attenuationFeature, partColourFeature;
 GLuint vao;			/* Vertex array (Containor) object. This is the index of the VAO that will be the container for
 					   our buffer objects */
 
@@ -73,20 +76,21 @@ vec3 armRootRotation;
 vec3 armJointRotation;
 vec3 armTipRotation;
 
-vec3 pivot;
+/* The ISS. Its parts are in station_model.cpp, where soft_render's regression check gets them too */
+StationModel station;
 
 /* Uniforms*/
-GLuint modelID, viewID, projectionID, lightposID, normalmatrixID, sunPowerID, partColorID;
-GLuint colourmodeID, emitmodeID, attenuationmodeID;
+GLuint lightposID, sunPowerID, partColorID;
+
+/* Per-frame uniforms, sent to each shader variant the first time it is used in a frame */
+vec4 frameLight;
 
 GLfloat aspect_ratio;		/* Aspect ratio of the window defined in the reshape callback*/
 GLuint numspherevertices;
 
-/* Global instances of our objects */
-Sphere aSphere;
-Cube aCube;
-Claw aClaw;
-Cylinder aCylinder;
+/* Our objects, built on the CPU and all uploaded into one buffer */
+MeshBatch shapes;
+GLuint sphereMesh, cubeMesh, clawMesh, cylinderMesh;
 
 /*
 This function is called before entering the main rendering loop.
@@ -127,10 +131,26 @@ void init(GLWrapper* glw)
 	// Create the vertex array object and make it current
 	glBindVertexArray(vao);
 
-	/* Load and build the vertex and fragment shaders */
+	/* Load and build the vertex and fragment shaders. The colour, emit and attenuation modes
+	   are compiled into separate variants of the program rather than switched with uniforms */
+	shaders.load(glw, "assignment.vert", "assignment.frag", true);
+	emitFeature = shaders.addFeature("EMIT");
+	attenuationFeature = shaders.addFeature("ATTENUATION");
+	partColourFeature = shaders.addFeature("PART_COLOUR");
+
+	/* The model, model-view and normal matrices come from the transform pipeline */
+	transforms.makePipeline();
+	shaders.bindUniformBlock("Transforms", transforms.bindingPoint);
+
+	/* Define uniforms to send to vertex shader */
+	shaders.bindUniform("lightpos", &lightposID);
+	shaders.bindUniform("sunPower", &sunPowerID);
+	shaders.bindUniform("partColor", &partColorID);
+
 	try
 	{
-		program = glw->LoadShader("assignment.vert", "assignment.frag");
+		shaders.program(partColourFeature);
+		shaders.program(partColourFeature | emitFeature);
 	}
 	catch (exception& e)
 	{
@@ -139,27 +159,30 @@ void init(GLWrapper* glw)
 		exit(0);
 	}
 
-	/* Define uniforms to send to vertex shader */
-	modelID = glGetUniformLocation(program, "model");
-	colourmodeID = glGetUniformLocation(program, "colourmode");
-	emitmodeID = glGetUniformLocation(program, "emitmode");
-	attenuationmodeID = glGetUniformLocation(program, "attenuationmode");
-	viewID = glGetUniformLocation(program, "view");
-	projectionID = glGetUniformLocation(program, "projection");
-	lightposID = glGetUniformLocation(program, "lightpos");
-	normalmatrixID = glGetUniformLocation(program, "normalmatrix");
-	sunPowerID = glGetUniformLocation(program, "sunPower");
-	partColorID = glGetUniformLocation(program, "partColor");
-
-	/* create our sphere and cube objects */
-	aSphere.makeSphere(numlats, numlongs);
-	aCube.makeCube();
-	aClaw.makeClaw();
-	aCylinder.makeCylinder();
+	/* create our sphere, cube, claw and cylinder objects */
+	MeshBuilder builder;
+	sphereMesh = builder.addSphere(numlats, numlongs);
+	cubeMesh = builder.addCube();
+	clawMesh = addClaw(builder);
+	cylinderMesh = builder.addCylinder(100, vec3(1.f));
+	shapes.upload(builder);
+
+	station.makeStation(model_scale, issPosition);
 
 	printInstructions();
 }
 
+/* Make a variant of the shader current, sending it the per-frame uniforms if it hasn't had them yet */
+void useVariant(GLuint features)
+{
+	if (shaders.use(features))
+	{
+		glUniform1f(sunPowerID, sunPower);
+		glUniform4fv(lightposID, 1, value_ptr(frameLight));
+	}
+	glUniform3fv(partColorID, 1, value_ptr(partColor));
+}
+
 /* Called to update the display. Note that this function is called in the event loop in the wrapper
    class because we registered display as a callback function */
 void display()
@@ -173,16 +196,8 @@ void display()
 	/* Enable depth test  */
 	glEnable(GL_DEPTH_TEST);
 
-	/* Make the compiled shader program current */
-	glUseProgram(program);
-
-	// Define our model transformation in a stack and 
-	// push the identity matrix onto the stack
-	stack<mat4> model;
-	model.push(mat4(1.0f));
-
-	// Define the normal matrix
-	mat3 normalmatrix;
+	/* Start a new frame of shader variant use */
+	shaders.beginFrame();
 
 	// Projection matrix : 45 Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
 	mat4 projection = perspective(radians(30.0f), aspect_ratio, 0.1f, 100.0f);
@@ -202,443 +217,47 @@ void display()
 	// Define the light position and transform by the view matrix
 	vec4 lightpos = view * vec4(lightPosition, 1.0);
 
-	// Send our projection and view uniforms to the currently bound shader
-	// I do that here because they are the same for all objects
-	glUniform1ui(colourmodeID, colourmode);
-	glUniform1ui(attenuationmodeID, attenuationmode);
-	glUniform1f(sunPowerID, sunPower);
-	glUniformMatrix4fv(viewID, 1, GL_FALSE, &view[0][0]);
-	glUniformMatrix4fv(projectionID, 1, GL_FALSE, &projection[0][0]);
-	glUniform4fv(lightposID, 1, value_ptr(lightpos));
-	glUniform3fv(partColorID, 1, value_ptr(partColor));
-
-	/* Draw a small sphere in the lightsource position to visually represent the light source */
-	model.push(model.top());
-	{
-		model.top() = translate(model.top(), vec3(lightPosition.x, lightPosition.y, lightPosition.z));
-		model.top() = scale(model.top(), vec3(0.05f, 0.05f, 0.05f)); // make a small sphere
-		// Recalculate the normal matrix and send the model and normal matrices to the vertex shader
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-		normalmatrix = transpose(inverse(mat3(view * model.top())));
-		glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+	// Keep the light position for the shader variants and give the view and projection
+	// to the transform pipeline. I do that here because they are the same for all objects
+	frameLight = lightpos;
+	transforms.beginFrame(view, projection);
 
-		/* Draw our lightposition sphere  with emit mode on*/
-		emitmode = 1;
-		glUniform1ui(emitmodeID, emitmode);
-		aSphere.drawSphere(drawmode);
-		emitmode = 0;
-		glUniform1ui(emitmodeID, emitmode);
-	}
-	model.pop();
+	// Select the variant for the current colour and attenuation modes
+	GLuint features = (colourmode ? partColourFeature : 0) | (attenuationmode ? attenuationFeature : 0);
 
-	// Define the global model transformations (rotate and scale). Note, we're not modifying thel ight source position
-	model.top() = scale(model.top(), vec3(model_scale, model_scale, model_scale));//scale equally in all axis
-	//model.top() = rotate(model.top(), -radians(angle_x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-	//model.top() = rotate(model.top(), -radians(angle_y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-	//model.top() = rotate(model.top(), -radians(angle_z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
+	/* Every object comes from the same buffer, so it only needs binding once */
+	shapes.bind();
 
-	// ISS
+	/* Draw a small sphere in the lightsource position to visually represent the light source */
 	{
-		// Hull
-		model.push(model.top());
-		{
-			setColor(0.5f, 0.5f, 0.5f);
-
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y, issPosition.z));
-			model.top() = rotate(model.top(), -radians(90.0f), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(0.3f, 1.5f, 0.3f)); // make a small sphere
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCylinder.drawCylinder(drawmode);
-		}
-		model.pop();
-
-		model.push(model.top());
-		{
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y, issPosition.z + 1.0f));
-			model.top() = rotate(model.top(), -radians(90.0f), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(0.15f, 1.5f, 0.15f)); // make a small sphere
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCylinder.drawCylinder(drawmode);
-		}
-		model.pop();
-
-		model.push(model.top());
-		{
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y, issPosition.z + 1.6f));
-			model.top() = rotate(model.top(), -radians(90.0f), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(0.3f, 1.5f, 0.3f)); // make a small sphere
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCylinder.drawCylinder(drawmode);
-		}
-		model.pop();
-
-		model.push(model.top());
-		{
-
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y + 0.9f, issPosition.z + 1.6f));
-			model.top() = rotate(model.top(), -radians(90.0f), glm::vec3(0, 1, 0));
-			model.top() = scale(model.top(), vec3(0.3f, 1.0f, 0.3f)); // make a small sphere
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCylinder.drawCylinder(drawmode);
-		}
-		model.pop();
-
-		model.push(model.top());
-		{
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y + 0.5f, issPosition.z + 1.6f));
-			model.top() = rotate(model.top(), -radians(90.0f), glm::vec3(0, 1, 0));
-			model.top() = scale(model.top(), vec3(0.15f, 1.0f, 0.15f)); // make a small sphere
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCylinder.drawCylinder(drawmode);
-		}
-		model.pop();
-
-		model.push(model.top());
-		{
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y - 0.9f, issPosition.z + 1.6f));
-			model.top() = rotate(model.top(), -radians(90.0f), glm::vec3(0, 1, 0));
-			model.top() = scale(model.top(), vec3(0.3f, 1.0f, 0.3f)); // make a small sphere
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCylinder.drawCylinder(drawmode);
-		}
-		model.pop();
-
-		model.push(model.top());
-		{
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y - 0.5f, issPosition.z + 1.6f));
-			model.top() = rotate(model.top(), -radians(90.0f), glm::vec3(0, 1, 0));
-			model.top() = scale(model.top(), vec3(0.15f, 1.0f, 0.15f)); // make a small sphere
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCylinder.drawCylinder(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Rod Left
-		model.push(model.top());
-		{
-			setColor(0.5f, 0.5f, 0.5f);
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x + 0.7f, issPosition.y, issPosition.z + 0.4f));
-			model.top() = rotate(model.top(), -radians(panelOneRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(2.5f, 0.06f, 0.05f)); // make a small sphere
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Left
-		model.push(model.top());
-		{
-			setColor(0.2f, 0.2f, 0.2f);
-
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x + 0.8f, issPosition.y, issPosition.z + 0.4f));
-			model.top() = rotate(model.top(), -radians(panelOneRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(1.8f, 0.05f, 0.5f)); // make a small sphere
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Rod Left
-		model.push(model.top());
-		{
-			setColor(0.5f, 0.5f, 0.5f);
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x + 0.7f, issPosition.y, issPosition.z - 0.4f));
-			model.top() = rotate(model.top(), -radians(panelOneRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(2.5f, 0.06f, 0.05f)); // make a small sphere
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Left
-		model.push(model.top());
-		{
-			setColor(0.2f, 0.2f, 0.2f);
-
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x + 0.8f, issPosition.y, issPosition.z - 0.4f));
-			model.top() = rotate(model.top(), -radians(panelOneRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(1.8f, 0.05f, 0.5f)); // make a small sphere
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Rod Right
-		model.push(model.top());
-		{
-			setColor(0.5f, 0.5f, 0.5f);
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x - 0.7f, issPosition.y, issPosition.z - 0.4f));
-			model.top() = rotate(model.top(), -radians(panelTwoRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(2.5f, 0.06f, 0.05f));
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Right
-		model.push(model.top());
-		{
-			setColor(0.2f, 0.2f, 0.2f);
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x - 0.8f, issPosition.y, issPosition.z - 0.4f));
-			model.top() = rotate(model.top(), -radians(panelTwoRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(1.8f, 0.05f, 0.5f)); // make a small sphere
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Rod Right
-		model.push(model.top());
-		{
-			setColor(0.5f, 0.5f, 0.5f);
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x - 0.7f, issPosition.y, issPosition.z + 0.4f));
-			model.top() = rotate(model.top(), -radians(panelTwoRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(2.5f, 0.06f, 0.05f));
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Solar Array Right
-		model.push(model.top());
-		{
-			setColor(0.2f, 0.2f, 0.2f);
-			// Define the model transformations for the cube
-			model.top() = translate(model.top(), vec3(issPosition.x - 0.8f, issPosition.y, issPosition.z + 0.4f));
-			model.top() = rotate(model.top(), -radians(panelTwoRotation), glm::vec3(1, 0, 0));
-			model.top() = scale(model.top(), vec3(1.8f, 0.05f, 0.5f)); // make a small sphere
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		mat4 previous;
-
-		// Arm Root
-		model.push(model.top());
-		{
-			setColor(0.2f, 0.2f, 0.5f);
-
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y, issPosition.z - 1.f));
-			pivot = vec3(0, 0, 0.25f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armRootRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			model.top() = scale(model.top(), vec3(0.2f, 0.2f, 1.f));
-
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-			previous = model.top();
-
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Arm Joint
-		model.push(model.top());
-		{
-			setColor(0.1f, 0.1f, 0.6f);
-			// Define the model transformations for the cube
-
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y, issPosition.z - 1.5f));
-
-			//model.top() = rotate(model.top(), -radians(45.f), glm::vec3(0, 1, 0)); //rotating in clockwise direction around x-axis
-
-
-			pivot = vec3(0, 0, 0.75f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armRootRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			pivot = vec3(0, 0, 0.25f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armJointRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armJointRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armJointRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			// local rotation relative to parent was something like parent rotation times inverse of local rotation 
-
-			model.top() = scale(model.top(), vec3(0.2f, 0.2f, 1.f));
-
-			// Send the model uniform and normal matrix to the currently bound shader,
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
+		useVariant(features | emitFeature);
 
-			// Recalculate the normal matrix and send to the vertex shader
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+		mat4 model = translate(mat4(1.0f), vec3(lightPosition.x, lightPosition.y, lightPosition.z));
+		model = scale(model, vec3(0.05f, 0.05f, 0.05f)); // make a small sphere
+		// Send the model, model-view and normal matrices to the vertex shader
+		transforms.setModel(model);
 
-			previous = model.top();
-
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Arm Tip
-		model.push(model.top());
-		{
-			setColor(0.9f, 0.9f, 0.9f);
-			// Define the model transformations for the cube
-
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y, issPosition.z - 2.0f));
-
-			//model.top() = rotate(model.top(), -radians(45.f), glm::vec3(0, 1, 0)); //rotating in clockwise direction around x-axis
-
-
-			pivot = vec3(0, 0, 1.25f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armRootRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			pivot = vec3(0, 0, 0.75f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armJointRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armJointRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armJointRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			pivot = vec3(0, 0, 0.25f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armTipRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armTipRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armTipRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			// local rotation relative to parent was something like parent rotation times inverse of local rotation 
-
-			model.top() = scale(model.top(), vec3(0.2f, 0.2f, 1.f));
-
-			// Send the model uniform and normal matrix to the currently bound shader,
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-
-			// Recalculate the normal matrix and send to the vertex shader
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-			previous = model.top();
-
-			aCube.drawCube(drawmode);
-		}
-		model.pop();
-
-		// Arm Tip
-		model.push(model.top());
-		{
-			setColor(0.9f, 0.9f, 0.9f);
-			// Define the model transformations for the cube
-
-			model.top() = translate(model.top(), vec3(issPosition.x, issPosition.y, issPosition.z - 2.25f));
-
-			//model.top() = rotate(model.top(), -radians(45.f), glm::vec3(0, 1, 0)); //rotating in clockwise direction around x-axis
-
-
-			pivot = vec3(0, 0, 1.5f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armRootRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armRootRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			pivot = vec3(0, 0, 1.0f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armJointRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armJointRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armJointRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			pivot = vec3(0, 0, 0.5f);
-
-			model.top() = translate(model.top(), pivot);
-			model.top() = rotate(model.top(), -radians(armTipRotation.x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-			model.top() = rotate(model.top(), -radians(armTipRotation.y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-			model.top() = rotate(model.top(), -radians(armTipRotation.z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-			model.top() = translate(model.top(), -pivot);
-
-			model.top() = scale(model.top(), vec3(0.2f, 0.2f, 0.2f));
-			glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-			previous = model.top();
-			aClaw.drawClaw(drawmode);
-		}
-		model.pop();
+		/* Draw our lightposition sphere  with emit mode on*/
+		shapes.drawMesh(sphereMesh, drawmode);
 	}
 
-	// This block of code draws the sphere
-	model.push(model.top());
-	{
-		model.top() = translate(model.top(), vec3(-x - 0.5f, 0, 0));
-		model.top() = scale(model.top(), vec3(model_scale / 3.f, model_scale / 3.f, model_scale / 3.f));//scale equally in all axis
+	useVariant(features);
 
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-		normalmatrix = transpose(inverse(mat3(view * model.top())));
-		glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+	// ISS. Only the parts under a node that moved since the last frame get new world matrices
+	station.setPlacement(model_scale, issPosition);
+	station.setPanels(panelOneRotation, panelTwoRotation);
+	station.setArm(armRootRotation, armJointRotation, armTipRotation);
+	station.update();
+	for (size_t i = 0; i < station.parts.size(); i++)
+	{
+		const StationPart &part = station.parts[i];
+		setColor(part.colour.r, part.colour.g, part.colour.b);
+		transforms.setModel(station.world(part));
 
-		//aSphere.drawSphere(drawmode); // Draw our sphere
+		if (part.shape == PART_CYLINDER) shapes.drawMesh(cylinderMesh, drawmode);
+		else if (part.shape == PART_CUBE) shapes.drawMesh(cubeMesh, drawmode);
+		else shapes.drawMesh(clawMesh, drawmode);
 	}
-	model.pop();
 
 	glDisableVertexAttribArray(0);
 	glUseProgram(0);
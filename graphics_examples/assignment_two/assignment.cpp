@@ -14,8 +14,21 @@
 #include <stack>
 #include "assignment.h"
 #include <cube_tex.h>
+#include "shader_variants.h"
+#include "transform_pipeline.h"
+#include "draw_lists.h"
+#include "clustered_lights.h"
+#include "gbuffer.h"
+#include "gpu_timer.h"
+#include "overdraw_counter.h"
+#include "occlusion_buffer.h"
+#include "frame_capture.h"
+#include "gl_accounting.h"
 
 #include <chrono>
+#include <iomanip>
+#include <vector>
+#include <random>
 
 #define GROUND_OFFSET 3.33
 #define ROCK_WALL_OFFSET_X 5.85
@@ -25,11 +38,17 @@ using namespace std;
 using namespace glm;
 
 bool LoadTexture(string filename, GLuint& texID, bool bGenMipmaps);
-void DrawModel(TinyObjLoader object, GLuint textureID, vec3 position, vec3 rotation, float size, bool shiny, bool emissive);
-void SetShiny(bool active);
-void SetEmissive(bool active);
-
-GLuint program, shadow;
+mat4 ModelMatrix(vec3 position, vec3 rotation, float size);
+void RecordScene(size_t first, size_t last, DrawList &list);
+void ReplayDraws(GLuint firstTransform, bool gbufferPass, const vector<unsigned int> &order, GLuint overrideProgram);
+void UseVariant(GLuint features);
+void ResolveTransformUniforms(GLuint program);
+void InnerBox(const TinyObjLoader &object, vec3 from, vec3 to, vec3 &lower, vec3 &upper);
+
+ShaderVariants shaders;
+TransformPipeline transforms;
+GLuint specularFeature, emitFeature, octNormalsFeature, clusteredFeature, gbufferFeature;
+GLuint shadow;
 GLuint vao;
 GLuint colourmode;
 
@@ -43,20 +62,94 @@ vec3 buddhaPosition = vec3(0, 0, 0);
 
 GLfloat sunPower = 0.05f;
 
-GLuint modelID, viewID, projectionID, lightposID, sunPowerID;
-GLuint modelShadowID, viewShadowID, projectionShadowID;
-GLuint colourmodeID, emitmodeID, specularmodeID;
+GLuint lightposID, sunPowerID;
+GLuint colourmodeID;
 
 GLfloat aspect_ratio;
 
+// Per-frame uniforms, sent to each shader variant the first time it is used in a frame
+vec4 frameLight;
+
+// The camera for this frame, for culling the models' meshlets
+mat4 frameProjection;
+
+/* Small coloured lights circling over the ground, lit with clustered forward lighting on top of the main light */
+const int numPointLights = 512;
+ClusteredLights pointLights;
+vector<PointLight> lights;
+vector<vec4> lightOrbits;		// centre of each light's circle, and where on it the light starts
+bool clusteredLighting = true;
+
+/* Deferred shading: the lit models and tiles are drawn into the G-buffer and lit once per pixel
+   by the lighting pass, which has its own variants for the point lights. G switches to it and back */
+GBuffer gbuffer;
+const GLuint GBUFFER_UNIT = 4;		// albedo, normal and depth, after the point lights' texture units
+ShaderVariants lightingPass;
+GLuint lightingClusteredFeature;
+GLuint inverseProjectionID, deferredLightposID, deferredSunPowerID;
+bool deferredShading = false;
+
+/* GPU time of each pass, printed every couple of seconds while T has turned it on */
+GpuTimer gpuTimer;
+GLuint forwardTimer, gbufferTimer, lightingTimer, unlitTimer;
+bool reportTimes = false;
+double lastTimeReport = 0, forwardTime = 0, deferredTime = 0;
+
+/* How the scene pass keeps overdraw down, cycled with P: the packets' state order, nearest first, or
+   a depth pre-pass nearest first followed by shading only the fragments whose depth is equal */
+enum DrawOrder { STATE_ORDER, FRONT_TO_BACK, DEPTH_PREPASS, DRAW_ORDERS };
+const char *drawOrderNames[DRAW_ORDERS] = { "state order", "front to back", "depth pre-pass" };
+DrawOrder drawOrder = STATE_ORDER;
+GLuint depthOnly, overdrawCount, overdrawHeatMap;
+vector<unsigned int> stateOrder, frontToBack;
+
+/* O shows how many fragments the scene pass shades for each pixel */
+OverdrawCounter overdraw;
+bool showOverdraw = false;
+double lastOverdrawReport = 0;
+
+/* Software occlusion culling, C turns it on and off. Boxes inside the walls and the shelves are
+   rasterised on the recorder's threads, and the models and tiles hidden behind them aren't recorded */
+OcclusionBuffer occlusion;
+bool occlusionCulling = true;
+vector<mat4> wallModels;
+vec3 wallOccluderLower, wallOccluderUpper, shelfOccluderLower, shelfOccluderUpper;
+
+/* F12 saves a screenshot and F11 records every frame until it is pressed again, as PNGs or, with
+   shift held, as raw video. The frames are read back and written without holding the frame rate up */
+GLWrapper *window_wrapper;
+int screenshots = 0;
+
 TinyObjLoader buddhaObject, squirrelObject, blockObject, rockWall, katana, bookshelf;
 
 Sphere aSphere(false);
 Cube aCube;
 
+/* The scene's draws are recorded on worker threads and replayed on this one. These are the
+   meshes that the draw packets name. A packet's program is 0 for the shadow program and
+   1 + the features for a variant of the main shader */
+enum SceneMesh { MESH_BUDDHA, MESH_BOOKSHELF, MESH_KATANA, MESH_GROUND, MESH_WALL, MESH_LIGHT };
+TinyObjLoader *sceneObjects[] = { &buddhaObject, &bookshelf, &katana, &blockObject, &rockWall };
+const GLuint SHADOW_PROGRAM = 0;
+
+/* A model drawn with a shadow projected onto the ground */
+struct ShadowedModel
+{
+	SceneMesh mesh;
+	GLuint texture;
+	vec3 position;
+	float size;
+};
+const int numShadowedModels = 4;
+ShadowedModel shadowedModels[numShadowedModels];
+
+DrawRecorder recorder;
+DrawView frameDraws;
+
 GLuint texID, groundTextureID, squirrelTextureID, rockTextureID, bookshelfTextureID;
 
-stack<mat4> model;
+// Placements of the static ground and wall tiles, their transforms are computed and uploaded in one batch each frame
+TransformBatch groundTiles, wallTiles;
 
 double offset = 0;
 int buddhaPosAngle = 0;
@@ -76,23 +169,56 @@ void init(GLWrapper* glw)
 	// Create the vertex array object and make it current
 	glBindVertexArray(vao);
 
-	/* Load and create our object*/
-	buddhaObject.load_obj("Models/Buddha/buddha.obj");
+	/* Load and create our object. The detailed models are quantised to 12 bytes per vertex,
+	   the tiles keep float vertices because their transforms are made by the batch kernels */
+	buddhaObject.load_obj("Models/Buddha/buddha.obj", false, VERTEX_QUANTISED);
 	blockObject.load_obj("Models/Ground/ground.obj");
 	rockWall.load_obj("Models/Rock Wall/rock-wall.obj");
-	katana.load_obj("Models/Katana/katana.obj");
-	bookshelf.load_obj("Models/Books/books.obj");
+	katana.load_obj("Models/Katana/katana.obj", false, VERTEX_QUANTISED);
+	bookshelf.load_obj("Models/Books/books.obj", false, VERTEX_QUANTISED);
 
 
-	// Creater the sphere (params are num_lats and num_longs)
-	aSphere.makeSphere(60, 60);
+	// Create the sphere as an icosphere: 5120 evenly spread triangles rather than the 7080 of
+	// makeSphere(60, 60), which crowds them in at the poles
+	aSphere.makeIcosphere(4);
 
 
-	/* Load and build the vertex and fragment shaders */
+	/* Load and build the vertex and fragment shaders. The lighting features are compiled
+	   into separate variants of the program rather than switched with uniforms */
+	shaders.load(glw, "assignment.vert", "assignment.frag", true);
+	specularFeature = shaders.addFeature("SPECULAR");
+	emitFeature = shaders.addFeature("EMIT");
+	octNormalsFeature = shaders.addFeature("OCT_NORMALS");
+	clusteredFeature = shaders.addFeature("CLUSTERED_LIGHTS");
+	gbufferFeature = shaders.addFeature("GBUFFER");
+
+	/* The model, model-view and normal matrices come from the transform pipeline */
+	transforms.makePipeline();
+	shaders.bindUniformBlock("Transforms", transforms.bindingPoint);
+
+	/* The deferred lighting pass, whose variants only differ in the point lights */
+	lightingPass.load(glw, "../../shaders/fullscreen.vert", "deferred_lighting.frag", true);
+	lightingClusteredFeature = lightingPass.addFeature("CLUSTERED_LIGHTS");
+	lightingPass.bindUniform("inverseProjection", &inverseProjectionID);
+	lightingPass.bindUniform("lightpos", &deferredLightposID);
+	lightingPass.bindUniform("sunPower", &deferredSunPowerID);
+
+	/* Define uniforms to send to vertex shader */
+	shaders.bindUniform("colourmode", &colourmodeID);
+	shaders.bindUniform("sunPower", &sunPowerID);
+	shaders.bindUniform("lightpos", &lightposID);
+
 	try
 	{
-		program = glw->LoadShader("assignment.vert", "assignment.frag");
+		shaders.program(0);
+		shaders.program(specularFeature);
+		shaders.program(emitFeature);
+		shaders.program(specularFeature | octNormalsFeature);
+		lightingPass.program(0);
 		shadow = glw->LoadShader("shadow.vert", "shadow.frag");
+		depthOnly = glw->LoadShader("depth_only.vert", "depth_only.frag");
+		overdrawCount = glw->LoadShader("depth_only.vert", "overdraw_count.frag");
+		overdrawHeatMap = glw->LoadShader("../../shaders/fullscreen.vert", "../../shaders/overdraw_heatmap.frag");
 	}
 	catch (exception& e)
 	{
@@ -108,22 +234,88 @@ void init(GLWrapper* glw)
 
 	aCube.makeCube();
 
-	/* Define uniforms to send to vertex shader */
-	modelID = glGetUniformLocation(program, "model");
-	emitmodeID = glGetUniformLocation(program, "emitmode");
-	colourmodeID = glGetUniformLocation(program, "colourmode");
-	specularmodeID = glGetUniformLocation(program, "specularmode");
-	viewID = glGetUniformLocation(program, "view");
-	projectionID = glGetUniformLocation(program, "projection");
+	ResolveTransformUniforms(shadow);
+	ResolveTransformUniforms(depthOnly);
+	ResolveTransformUniforms(overdrawCount);
+
+	/* Rebuild the shadow and depth shaders in the background when their files are edited */
+	glw->watchShader(&shadow, "shadow.vert", "shadow.frag", ResolveTransformUniforms);
+	glw->watchShader(&depthOnly, "depth_only.vert", "depth_only.frag", ResolveTransformUniforms);
+	glw->watchShader(&overdrawCount, "depth_only.vert", "overdraw_count.frag", ResolveTransformUniforms);
+
+	/* Record the draws on one thread for each hardware thread */
+	recorder.makeRecorder();
+
+	/* The G-buffer matches the window, reshape() keeps it that way */
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(glw->getWindow(), &framebufferWidth, &framebufferHeight);
+	gbuffer.makeGBuffer(framebufferWidth, framebufferHeight);
+	overdraw.makeCounter(framebufferWidth, framebufferHeight);
+
+	gpuTimer.makeTimer();
+	forwardTimer = gpuTimer.addPass("forward");
+	gbufferTimer = gpuTimer.addPass("G-buffer");
+	lightingTimer = gpuTimer.addPass("lighting");
+	unlitTimer = gpuTimer.addPass("unlit");
+
+	/* Scatter the point lights over the ground, always in the same places */
+	pointLights.makeClusters();
+	mt19937 random(1);
+	uniform_real_distribution<float> unit(0.f, 1.f);
+	lights.resize(numPointLights);
+	lightOrbits.resize(numPointLights);
+	for (int i = 0; i < numPointLights; i++)
+	{
+		lightOrbits[i] = vec4(unit(random) * 60.f - 30.f, 0.2f + unit(random) * 0.6f, unit(random) * 50.f - 20.f, unit(random) * 6.283f);
+		lights[i].radius = 1.f + unit(random) * 1.5f;
+		lights[i].colour = vec3(unit(random), unit(random), unit(random));
+		lights[i].intensity = 1.5f;
+	}
 
-	modelShadowID = glGetUniformLocation(shadow, "model");
-	viewShadowID = glGetUniformLocation(shadow, "view");
-	projectionShadowID = glGetUniformLocation(shadow, "projection");
+	/* The ground and walls never move so set out their placements once. ModelMatrix scales by size / 3 */
+	for (int x = -9; x < 9; x++)
+		for (int y = -6; y < 10; y++)
+			groundTiles.add(vec3(GROUND_OFFSET * x, -0.2f, GROUND_OFFSET * y), vec3(0, 0, 0), vec3(0.5f / 3.f));
 
-	sunPowerID = glGetUniformLocation(program, "sunPower");
-	lightposID = glGetUniformLocation(program, "lightpos");
+	for (int x = -3; x <= 3; x++)
+		for (int y = -1; y < 5; y++)
+			wallTiles.add(vec3(ROCK_WALL_OFFSET_X * x, ROCK_WALL_OFFSET_Y * y, -20), vec3(0, 180, 0), vec3(1 / 3.f));
 
-	model.push(mat4(1.0f));
+	for (int z = -3; z <= 3; z++)
+		for (int y = -1; y < 5; y++)
+			wallTiles.add(vec3(ROCK_WALL_OFFSET_X * 3, ROCK_WALL_OFFSET_Y * y, ROCK_WALL_OFFSET_X * z), vec3(0, -90, 0), vec3(1 / 3.f));
+
+	for (int z = -3; z <= 3; z++)
+		for (int y = -1; y < 5; y++)
+			wallTiles.add(vec3(ROCK_WALL_OFFSET_X * -3, ROCK_WALL_OFFSET_Y * y, ROCK_WALL_OFFSET_X * z), vec3(0, 90, 0), vec3(1 / 3.f));
+
+	/* The occluders: a sheet through the middle of each wall tile, and the back of each shelf.
+	   They are kept inside the edges of the meshes, which aren't straight */
+	vector<ObjectTransforms> placedWalls(wallTiles.size());
+	batchTransform(wallTiles, mat4(1.0f), mat4(1.0f), &placedWalls[0]);
+	for (size_t w = 0; w < placedWalls.size(); w++) wallModels.push_back(placedWalls[w].model);
+
+	vec3 wallSize = rockWall.boundsUpper() - rockWall.boundsLower();
+	int thinnest = (wallSize.x < wallSize.y) ? ((wallSize.x < wallSize.z) ? 0 : 2) : ((wallSize.y < wallSize.z) ? 1 : 2);
+	vec3 wallFrom(0.05f), wallTo(0.95f);
+	wallFrom[thinnest] = wallTo[thinnest] = 0.5f;
+	InnerBox(rockWall, wallFrom, wallTo, wallOccluderLower, wallOccluderUpper);
+	InnerBox(bookshelf, vec3(0.1f, 0.05f, 0.f), vec3(0.9f, 0.95f, 0.05f), shelfOccluderLower, shelfOccluderUpper);
+	occlusion.makeBuffer(256, 128);
+}
+
+/* A box inside an object's bounding box, from and to given as fractions of it along each axis */
+void InnerBox(const TinyObjLoader &object, vec3 from, vec3 to, vec3 &lower, vec3 &upper)
+{
+	vec3 size = object.boundsUpper() - object.boundsLower();
+	lower = object.boundsLower() + size * from;
+	upper = object.boundsLower() + size * to;
+}
+
+/* Attach the shadow or a depth only program to the transform pipeline, they have no other uniforms */
+void ResolveTransformUniforms(GLuint program)
+{
+	transforms.bindProgram(program);
 }
 
 // Image parameters
@@ -163,7 +355,6 @@ mat4 shadow_matrix(vec4 L, vec4 P)
  */
 bool LoadTexture(string filename, GLuint& texID, bool bGenMipmaps)
 {
-	glGenTextures(1, &texID);
 	// local image parameters
 	int width, height, nrChannels;
 
@@ -180,6 +371,9 @@ bool LoadTexture(string filename, GLuint& texID, bool bGenMipmaps)
 		else
 			pixel_format = GL_RGBA;
 
+		// Only make the texture once the image has loaded, so a failed load doesn't leave one behind
+		glGenTextures(1, &texID);
+
 		// Bind the texture ID before the call to create the texture.
 			// texID[i] will now be the identifier for this specific texture
 		glBindTexture(GL_TEXTURE_2D, texID);
@@ -201,88 +395,353 @@ bool LoadTexture(string filename, GLuint& texID, bool bGenMipmaps)
 	else
 	{
 		//printf("stb_image  loading error: filename=%s", filename);
+		texID = 0;
 		return false;
 	}
 	stbi_image_free(data);
 	return true;
 }
 
-void SetShiny(bool active)
+/* Make a variant of the main shader current, sending it the per-frame uniforms if it hasn't had them yet */
+void UseVariant(GLuint features)
 {
-	glUniform1ui(specularmodeID, active ? 1 : 0);
+	if (shaders.use(features))
+	{
+		glUniform1ui(colourmodeID, colourmode);
+		glUniform1f(sunPowerID, sunPower);
+		glUniform4fv(lightposID, 1, value_ptr(frameLight));
+		if (features & clusteredFeature) pointLights.setUniforms(shaders.currentProgram());
+	}
 }
 
-void SetEmissive(bool active)
+/* Move each point light around its circle and sort them into the clusters of this view */
+void UpdatePointLights(const mat4 &view, const mat4 &projection)
 {
-	glUniform1ui(emitmodeID, active ? 1 : 0);
+	float time = (float)glfwGetTime();
+	for (int i = 0; i < numPointLights; i++)
+	{
+		float angle = lightOrbits[i].w + time * 0.5f;
+		lights[i].position = vec3(lightOrbits[i]) + vec3(cos(angle), 0.f, sin(angle)) * 1.5f;
+	}
+
+	pointLights.update(lights, view, projection);
+	pointLights.bindTextures();
+}
+
+/* Placement of a model relative to its parent */
+mat4 ModelMatrix(vec3 position, vec3 rotation, float size)
+{
+	mat4 m = translate(mat4(1.0f), position);
+	m = scale(m, vec3(size / 3.f, size / 3.f, size / 3.f));
+	m = rotate(m, -radians(rotation.x), vec3(1, 0, 0));
+	m = rotate(m, -radians(rotation.y), vec3(0, 1, 0));
+	m = rotate(m, -radians(rotation.z), vec3(0, 0, 1));
+	return m;
 }
 
-mat3 normalmatrix;
+/* The shader features a model is drawn with. When shading is deferred the lighting pass adds the point lights */
+GLuint ModelFeatures(const TinyObjLoader &object, bool shiny, bool emissive)
+{
+	GLuint features = (shiny ? specularFeature : 0) | (emissive ? emitFeature : 0) | (object.octahedralNormals() ? octNormalsFeature : 0);
+	if (deferredShading && !emissive) return features | gbufferFeature;
+	return features | (clusteredLighting ? clusteredFeature : 0);
+}
+
+/* Record a model and its shadow. The shadow is flattened onto the ground, so it isn't culled with the model */
+void RecordShadowedModel(DrawList &list, unsigned int item)
+{
+	const ShadowedModel &m = shadowedModels[item];
+	TinyObjLoader &object = *sceneObjects[m.mesh];
+
+	mat4 shadow = translate(mat4(1.0f), vec3(0, -0.19f, 0));
+	shadow = shadow * shadow_matrix(lightPosition - vec4(m.position, 1.0), vec4(0, 1.0, 0, 0.0));
+	shadow = translate(shadow, vec3(m.position.x, m.position.y + 0.19f, m.position.z));
+	list.add(item, m.mesh, SHADOW_PROGRAM, 0, shadow * object.positionTransform(), frameDraws);
 
-void DrawWithShadow(mat4 view, TinyObjLoader object, GLuint textureID, vec3 objectPosition, float scaler)
+	mat4 placement = ModelMatrix(m.position, vec3(0, 0, 0), m.size);
+	if (frameDraws.visible(placement, object.boundingSphere())
+		&& (!occlusionCulling || occlusion.visible(placement, object.boundsLower(), object.boundsUpper())))
+	{
+		list.add(item, m.mesh, 1 + ModelFeatures(object, true, false), m.texture, placement * object.positionTransform(), frameDraws);
+	}
+}
+
+/* Record a run of tiles, transformed together by the batch kernels. Tiles are float meshes, with no position transform */
+void RecordTiles(DrawList &list, SceneMesh mesh, const TransformBatch &tiles, GLuint textureID, size_t first, size_t count,
+	unsigned int firstItem)
 {
-	// Draw the object (monkey), with a projected shadow, spinning around it's y-axis
-	model.push(model.top());
+	TinyObjLoader &object = *sceneObjects[mesh];
+	GLuint program = 1 + ModelFeatures(object, false, false);
+
+	list.scratch.resize(count);
+	batchTransform(tiles, first, count, frameDraws.view, frameDraws.projection, &list.scratch[0], sizeof(ObjectTransforms),
+		batchTransformBestPath());
+	for (size_t t = 0; t < count; t++)
 	{
-		// Draw the shadow
-		model.push(model.top());
+		const mat4 &model = list.scratch[t].model;
+		if (frameDraws.visible(model, object.boundingSphere())
+			&& (!occlusionCulling || occlusion.visible(model, object.boundsLower(), object.boundsUpper())))
 		{
-			// Switch to our shadow renderer shader
-			glUseProgram(shadow);
+			list.add(firstItem + (unsigned int)t, mesh, program, textureID, list.scratch[t]);
+		}
+	}
+}
 
-			model.top() = translate(model.top(), vec3(0, -0.19f, 0));
+/* Rasterise the occluders for this frame's view on the recorder's threads, before the scene is recorded against them */
+void RasteriseOccluders()
+{
+	occlusion.beginFrame(frameDraws.viewProjection);
+	for (size_t w = 0; w < wallModels.size(); w++) occlusion.addOccluder(wallModels[w], wallOccluderLower, wallOccluderUpper);
+	for (int i = 0; i < numShadowedModels; i++)
+	{
+		const ShadowedModel &m = shadowedModels[i];
+		if (m.mesh != MESH_BOOKSHELF) continue;
+		occlusion.addOccluder(ModelMatrix(m.position, vec3(0, 0, 0), m.size), shelfOccluderLower, shelfOccluderUpper);
+	}
+	occlusion.rasterise(&recorder.jobs());
+}
 
-			// Calculate the shadow matrix from light position and plane normal
-			mat4 shadow = shadow_matrix(lightPosition - vec4(objectPosition, 1.0), vec4(0, 1.0, 0, 0.0));
-			//model.top() = scale(model.top(), vec3(scaler, scaler, scaler));
-			model.top() = model.top() * shadow;
+/* Record the sphere that marks the light */
+void RecordLight(DrawList &list, unsigned int item)
+{
+	mat4 light = translate(mat4(1.0f), vec3(lightPosition.x, lightPosition.y, lightPosition.z));
+	light = scale(light, vec3(0.01f, 0.01f, 0.01f));
+	light = rotate(light, -radians(angle_x), vec3(1, 0, 0));
+	light = rotate(light, -radians(angle_y), vec3(0, 1, 0));
+	light = rotate(light, -radians(angle_z), vec3(0, 0, 1));
+
+	/* Note that you probably want a different texture for this Sphere! */
+	list.add(item, MESH_LIGHT, 1 + emitFeature, texID, light, frameDraws);
+}
 
+/* The scene's items in the order they are recorded: the shadowed models, the ground tiles, the wall tiles and the light */
+size_t SceneItemCount()
+{
+	return numShadowedModels + groundTiles.size() + wallTiles.size() + 1;
+}
 
-			model.top() = translate(model.top(), vec3(objectPosition.x, objectPosition.y + 0.19f, objectPosition.z));
+/* Record the draws of scene items [first, last). Called on the worker threads, so it only reads the scene */
+void RecordScene(size_t first, size_t last, DrawList &list)
+{
+	size_t groundStart = numShadowedModels, wallStart = groundStart + groundTiles.size();
+	size_t lightItem = wallStart + wallTiles.size();
 
-			// Send our current model, view and projection ONLY to our shadow matrix
-			glUniformMatrix4fv(modelShadowID, 1, GL_FALSE, &(model.top()[0][0]));
-			glUniformMatrix4fv(viewShadowID, 1, GL_FALSE, &view[0][0]);
+	for (size_t i = first; i < last;)
+	{
+		if (i < groundStart)
+		{
+			RecordShadowedModel(list, (unsigned int)i);
+			i++;
+		}
+		else if (i < wallStart)
+		{
+			size_t end = std::min(last, wallStart);
+			RecordTiles(list, MESH_GROUND, groundTiles, groundTextureID, i - groundStart, end - i, (unsigned int)i);
+			i = end;
+		}
+		else if (i < lightItem)
+		{
+			size_t end = std::min(last, lightItem);
+			RecordTiles(list, MESH_WALL, wallTiles, rockTextureID, i - wallStart, end - i, (unsigned int)i);
+			i = end;
+		}
+		else
+		{
+			RecordLight(list, (unsigned int)i);
+			i++;
+		}
+	}
+}
 
-			/* Draw our shadow object */
-			object.drawObject(drawmode);
+/* Draw the recorded packets that write into the G-buffer, or the ones that don't, in the given order,
+   only changing the program when it changes. Their transforms were uploaded from firstTransform on.
+   An override program, like the depth pre-pass's, draws all of them instead of their own programs */
+void ReplayDraws(GLuint firstTransform, bool gbufferPass, const vector<unsigned int> &order, GLuint overrideProgram)
+{
+	const vector<DrawPacket> &packets = recorder.packets;
+	GLuint program = ~0u;
+	if (overrideProgram)
+	{
+		glUseProgram(overrideProgram);
+		shaders.release();
+	}
 
-			/* Make the compiled shader program current again */
-			glUseProgram(program);
+	for (size_t o = 0; o < order.size(); o++)
+	{
+		const DrawPacket &packet = packets[order[o]];
+		bool gbufferPacket = (packet.program != SHADOW_PROGRAM && ((packet.program - 1) & gbufferFeature));
+		if (gbufferPacket != gbufferPass) continue;
+
+		if (!overrideProgram && packet.program != program)
+		{
+			program = packet.program;
+			if (program == SHADOW_PROGRAM)
+			{
+				glUseProgram(shadow);
+
+				/* The next draw has to make a shader variant current again */
+				shaders.release();
+			}
+			else UseVariant(program - 1);
+		}
+
+		transforms.bindObject(firstTransform + packet.transform);
+		glBindTexture(GL_TEXTURE_2D, packet.texture);
+
+		if (packet.mesh == MESH_LIGHT)
+		{
+			aSphere.drawSphere(drawmode);
+			continue;
 		}
-		model.pop();
 
-		DrawModel(object, textureID, objectPosition, vec3(0, 0, 0), scaler, true, false);
+		/* Only draw the meshlets of the models that are in view. GL_CULL_FACE is off so back facing ones are kept.
+		   The depth pre-pass culls them the same way, so that it lays down the depths the shading pass draws */
+		TinyObjLoader &object = *sceneObjects[packet.mesh];
+		if (packet.mesh <= MESH_KATANA && packet.program != SHADOW_PROGRAM)
+		{
+			object.cull(recorder.transforms[packet.transform].modelview, frameProjection, false);
+		}
+		object.drawObject(drawmode);
 	}
-	model.pop();
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void DrawModel(TinyObjLoader object, GLuint textureID, vec3 position, vec3 rotation, float size, bool shiny, bool emissive)
+/* Light every pixel of the G-buffer once, writing its depth too so that the unlit draws that follow are hidden properly */
+void DrawLightingPass(const mat4 &projection)
 {
-	model.push(model.top());
+	gbuffer.bindTextures(GBUFFER_UNIT);
+	if (lightingPass.use(clusteredLighting ? lightingClusteredFeature : 0))
 	{
-		model.top() = translate(model.top(), position);
-		model.top() = scale(model.top(), vec3(size / 3.f, size / 3.f, size / 3.f));
-		model.top() = rotate(model.top(), -radians(rotation.x), vec3(1, 0, 0));
-		model.top() = rotate(model.top(), -radians(rotation.y), vec3(0, 1, 0));
-		model.top() = rotate(model.top(), -radians(rotation.z), vec3(0, 0, 1));
+		GLuint program = lightingPass.currentProgram();
+		glUniform1i(glGetUniformLocation(program, "gbufferAlbedo"), GBUFFER_UNIT);
+		glUniform1i(glGetUniformLocation(program, "gbufferNormal"), GBUFFER_UNIT + 1);
+		glUniform1i(glGetUniformLocation(program, "gbufferDepth"), GBUFFER_UNIT + 2);
+		glUniformMatrix4fv(inverseProjectionID, 1, GL_FALSE, value_ptr(inverse(projection)));
+		glUniform4fv(deferredLightposID, 1, value_ptr(frameLight));
+		glUniform1f(deferredSunPowerID, sunPower);
+		if (clusteredLighting) pointLights.setUniforms(program);
+	}
 
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-		//glUniformMatrix4fv(modelShadowID, 1, GL_FALSE, &(model.top()[0][0]));
+	glDepthFunc(GL_ALWAYS);
+	gbuffer.drawFullScreen();
+	glDepthFunc(GL_LESS);
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
+	/* The next draw has to make a shader variant current again */
+	lightingPass.release();
+	shaders.release();
+}
 
-		SetShiny(shiny);
-		SetEmissive(emissive);
+/* The scene pass: the forward shaded draws, or the draws that fill the G-buffer. With the depth pre-pass
+   the depths are laid down nearest first with the colour off, then only the nearest fragment of each pixel
+   passes GL_EQUAL and is shaded, so the shading pass can keep to the state order.
+   An override program draws the shading pass instead of the packets' own programs, and a counter counts
+   the fragments of the shading pass alone */
+void DrawScenePass(GLuint firstTransform, bool gbufferPass, GLuint overrideProgram, OverdrawCounter *counter)
+{
+	if (drawOrder == DEPTH_PREPASS)
+	{
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		ReplayDraws(firstTransform, gbufferPass, frontToBack, depthOnly);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
 
-		object.drawObject(drawmode);
+	if (counter) counter->beginCount();
+	ReplayDraws(firstTransform, gbufferPass, drawOrder == FRONT_TO_BACK ? frontToBack : stateOrder, overrideProgram);
+	if (counter) counter->endCount();
 
-		SetShiny(!shiny);
-		SetEmissive(!emissive);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+/* Draw the frame's packets, timing each pass. Deferred shading fills the G-buffer, lights it and then
+   draws the shadows and the light's sphere, which aren't lit, over the top */
+void DrawFrame(const mat4 &projection)
+{
+	if (recorder.packets.empty()) return;
+	GLuint firstTransform = transforms.addTransforms(&recorder.transforms[0], (GLuint)recorder.transforms.size());
+
+	stateOrder.resize(recorder.packets.size());
+	for (size_t p = 0; p < stateOrder.size(); p++) stateOrder[p] = (unsigned int)p;
+	if (drawOrder != STATE_ORDER) frontToBackOrder(recorder.packets, frontToBack);
+
+	if (showOverdraw)
+	{
+		/* Count the fragments that the scene pass shades, and show them instead of the frame */
+		overdraw.bind();
+		DrawScenePass(firstTransform, deferredShading, overdrawCount, &overdraw);
+		overdraw.unbind();
+		overdraw.show(overdrawHeatMap);
+		return;
+	}
 
-		glBindTexture(GL_TEXTURE_2D, 0);
+	if (!deferredShading)
+	{
+		gpuTimer.begin(forwardTimer);
+		DrawScenePass(firstTransform, false, 0, NULL);
+		gpuTimer.end();
+		return;
 	}
-	model.pop();
+
+	gpuTimer.begin(gbufferTimer);
+	gbuffer.bindForWriting();
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	DrawScenePass(firstTransform, true, 0, NULL);
+	gbuffer.unbind();
+	gpuTimer.end();
+
+	gpuTimer.begin(lightingTimer);
+	DrawLightingPass(projection);
+	gpuTimer.end();
+
+	gpuTimer.begin(unlitTimer);
+	ReplayDraws(firstTransform, false, stateOrder, 0);
+	gpuTimer.end();
+}
+
+/* Print the average GPU time of each pass of the path in use every two seconds, with the last total of the other path */
+void ReportPassTimes()
+{
+	double now = glfwGetTime();
+	if (!reportTimes || now - lastTimeReport < 2.0) return;
+	lastTimeReport = now;
+
+	cout << fixed << setprecision(2);
+	if (deferredShading && gpuTimer.samples(gbufferTimer))
+	{
+		deferredTime = gpuTimer.average(gbufferTimer) + gpuTimer.average(lightingTimer) + gpuTimer.average(unlitTimer);
+		cout << "Deferred: G-buffer " << gpuTimer.average(gbufferTimer) << " ms + lighting " << gpuTimer.average(lightingTimer)
+			<< " ms + unlit " << gpuTimer.average(unlitTimer) << " ms = " << deferredTime << " ms, " << recorder.packets.size() << " draws";
+		if (forwardTime > 0) cout << ", forward was " << forwardTime << " ms";
+		cout << endl;
+	}
+	else if (!deferredShading && gpuTimer.samples(forwardTimer))
+	{
+		forwardTime = gpuTimer.average(forwardTimer);
+		cout << "Forward: " << forwardTime << " ms, " << recorder.packets.size() << " draws";
+		if (deferredTime > 0) cout << ", deferred was " << deferredTime << " ms";
+		cout << endl;
+	}
+	cout.unsetf(ios::floatfield);
+	gpuTimer.reset();
+}
+
+/* Print how many fragments the scene pass shaded for each pixel every two seconds, while the overdraw is shown */
+void ReportOverdraw()
+{
+	double now = glfwGetTime();
+	if (!showOverdraw || now - lastOverdrawReport < 2.0) return;
+	lastOverdrawReport = now;
+
+	if (overdraw.fragmentsPerPixel() > 0)
+	{
+		cout << "Overdraw, " << (deferredShading ? "G-buffer" : "forward") << " in " << drawOrderNames[drawOrder] << ": "
+			<< fixed << setprecision(2) << overdraw.fragmentsPerPixel() << " fragments shaded a pixel" << endl;
+		cout.unsetf(ios::floatfield);
+	}
+	overdraw.reset();
 }
 
 /* Called to update the display. Note that this function is called in the event loop in the wrapper
@@ -298,8 +757,10 @@ void display()
 	/* Enable depth test  */
 	glEnable(GL_DEPTH_TEST);
 
-	/* Make the compiled shader program current */
-	glUseProgram(program);
+	/* Start a new frame of shader variant use */
+	shaders.beginFrame();
+	lightingPass.beginFrame();
+	gpuTimer.beginFrame();
 
 	// Projection matrix : 45° Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
 	mat4 projection = perspective(radians(30.0f), aspect_ratio, 0.1f, 100.0f);
@@ -315,66 +776,26 @@ void display()
 	buddhaPosition.y = 0.1 * sin(buddhaPosAngle * 3.14 / 180);
 	if (buddhaPosAngle >= 360) buddhaPosAngle = 0;
 
-	glUniform1ui(colourmodeID, colourmode);
-	glUniformMatrix4fv(viewID, 1, GL_FALSE, &view[0][0]);
-	glUniform1f(sunPowerID, sunPower);
-	glUniformMatrix4fv(projectionID, 1, GL_FALSE, &projection[0][0]);
-	glUniform1ui(specularmodeID, 0);
-	glUniform1ui(emitmodeID, 0);
-
-	vec4 light = view * lightPosition;
-	glUniform4fv(lightposID, 1, value_ptr(light));
-
-	glUseProgram(shadow);
-
-	glUniformMatrix4fv(viewShadowID, 1, GL_FALSE, &view[0][0]);
-	glUniformMatrix4fv(projectionShadowID, 1, GL_FALSE, &projection[0][0]);
-
-	glUseProgram(program);
-
-	DrawWithShadow(view, buddhaObject, rockTextureID, buddhaPosition, 2);
-	DrawWithShadow(view, bookshelf, bookshelfTextureID, vec3(-3, -0.08, -6.2), 3);
-	DrawWithShadow(view, bookshelf, bookshelfTextureID, vec3(3, -0.08, -6.2), 3);
-	DrawWithShadow(view, katana, rockTextureID, vec3(0, -0.05, -6.2), 3);
-
-	//DrawModel(squirrelObject, squirrelTextureID, vec3(x - 0.5f, y, z), vec3(angle_x, angle_y, angle_z), 1, false, false);
-
-	for (int x = -9; x < 9; x++)
-		for (int y = -6; y < 10; y++)
-			DrawModel(blockObject, groundTextureID, vec3(GROUND_OFFSET * x, -0.2f, GROUND_OFFSET * y), vec3(0, 0, 0), 0.5, false, false);
-
-	for (int x = -3; x <= 3; x++)
-		for (int y = -1; y < 5; y++)
-			DrawModel(rockWall, rockTextureID, vec3(ROCK_WALL_OFFSET_X * x, ROCK_WALL_OFFSET_Y * y, -20), vec3(0, 180, 0), 1, false, false);
-
-	for (int z = -3; z <= 3; z++)
-		for (int y = -1; y < 5; y++)
-			DrawModel(rockWall, rockTextureID, vec3(ROCK_WALL_OFFSET_X * 3, ROCK_WALL_OFFSET_Y * y, ROCK_WALL_OFFSET_X * z), vec3(0, -90, 0), 1, false, false);
-
-	for (int z = -3; z <= 3; z++)
-		for (int y = -1; y < 5; y++)
-			DrawModel(rockWall, rockTextureID, vec3(ROCK_WALL_OFFSET_X * -3, ROCK_WALL_OFFSET_Y * y, ROCK_WALL_OFFSET_X * z), vec3(0, 90, 0), 1, false, false);
-
-
-	model.push(model.top());
-	{
-		model.top() = translate(model.top(), vec3(lightPosition.x, lightPosition.y, lightPosition.z));
-		model.top() = scale(model.top(), vec3(0.01f, 0.01f, 0.01f));
-		model.top() = rotate(model.top(), -radians(angle_x), vec3(1, 0, 0));
-		model.top() = rotate(model.top(), -radians(angle_y), vec3(0, 1, 0));
-		model.top() = rotate(model.top(), -radians(angle_z), vec3(0, 0, 1));
-
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-
-		/* Draw our sphere */
-		/* Note that you probably want a different texture for this Sphere! */
-		glBindTexture(GL_TEXTURE_2D, texID);
-		SetEmissive(true);
-		aSphere.drawSphere(drawmode);
-		SetEmissive(false);
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
-	model.pop();
+	frameLight = view * lightPosition;
+	frameProjection = projection;
+	frameDraws.set(view, projection);
+	transforms.beginFrame(view, projection);
+	if (clusteredLighting) UpdatePointLights(view, projection);
+
+	ShadowedModel models[numShadowedModels] = {
+		{ MESH_BUDDHA, rockTextureID, buddhaPosition, 2 },
+		{ MESH_BOOKSHELF, bookshelfTextureID, vec3(-3, -0.08, -6.2), 3 },
+		{ MESH_BOOKSHELF, bookshelfTextureID, vec3(3, -0.08, -6.2), 3 },
+		{ MESH_KATANA, rockTextureID, vec3(0, -0.05, -6.2), 3 }
+	};
+	for (int i = 0; i < numShadowedModels; i++) shadowedModels[i] = models[i];
+
+	/* Cull and transform the scene on the worker threads, then draw it from this one */
+	if (occlusionCulling) RasteriseOccluders();
+	recorder.record(SceneItemCount(), 32, RecordScene);
+	DrawFrame(projection);
+	ReportPassTimes();
+	ReportOverdraw();
 
 	glDisableVertexAttribArray(0);
 	glUseProgram(0);
@@ -389,6 +810,8 @@ void display()
 static void reshape(GLFWwindow* window, int w, int h)
 {
 	glViewport(0, 0, (GLsizei)w, (GLsizei)h);
+	gbuffer.resize(w, h);
+	overdraw.resize(w, h);
 	aspect_ratio = ((float)w / 640.f * 4.f) / ((float)h / 480.f * 3.f);
 }
 
@@ -430,6 +853,64 @@ static void keyCallback(GLFWwindow* window, int key, int s, int action, int mods
 	if (key == GLFW_KEY_HOME) lightPosition.y += 0.05f;
 	if (key == GLFW_KEY_END) lightPosition.y -= 0.05f;
 
+	if (key == 'L' && action == GLFW_PRESS)
+	{
+		clusteredLighting = !clusteredLighting;
+		cout << "Point lights " << (clusteredLighting ? "on" : "off") << endl;
+	}
+
+	if (key == 'G' && action == GLFW_PRESS)
+	{
+		deferredShading = !deferredShading;
+		gpuTimer.reset();
+		lastTimeReport = glfwGetTime();
+		cout << (deferredShading ? "Deferred" : "Forward") << " shading" << endl;
+	}
+
+	if (key == 'P' && action == GLFW_PRESS)
+	{
+		drawOrder = (DrawOrder)((drawOrder + 1) % DRAW_ORDERS);
+		gpuTimer.reset();
+		overdraw.reset();
+		cout << "Scene drawn in " << drawOrderNames[drawOrder] << endl;
+	}
+
+	if (key == 'O' && action == GLFW_PRESS)
+	{
+		showOverdraw = !showOverdraw;
+		overdraw.reset();
+		lastOverdrawReport = glfwGetTime();
+	}
+
+	if (key == 'C' && action == GLFW_PRESS)
+	{
+		occlusionCulling = !occlusionCulling;
+		cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << endl;
+	}
+
+	if (key == 'T' && action == GLFW_PRESS)
+	{
+		reportTimes = !reportTimes;
+		gpuTimer.reset();
+		lastTimeReport = glfwGetTime();
+	}
+
+	if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+	{
+		window_wrapper->screenshot(("screenshot" + to_string(screenshots++) + ".png").c_str());
+	}
+
+	if (key == GLFW_KEY_F11 && action == GLFW_PRESS)
+	{
+		if (window_wrapper->getCapture()->recording()) window_wrapper->stopCapture();
+		else window_wrapper->startCapture("capture", (mods & GLFW_MOD_SHIFT) != 0);
+	}
+
+	if (key == GLFW_KEY_F10 && action == GLFW_PRESS)
+	{
+		printGLAccountingFrame(lastGLAccountingFrame(), cout);
+	}
+
 	/*
 	if (key == 'M' && action != GLFW_PRESS)
 	{
@@ -456,6 +937,15 @@ void printInstructions()
 	cout << " Light controls (arrows):" << endl << endl;
 	cout << "       Up  " << "               Home     " << endl;
 	cout << " Left Down Right" << "          End   " << endl << endl << endl << endl;
+
+	cout << " L turns the " << numPointLights << " point lights on and off" << endl;
+	cout << " G switches between forward and deferred shading" << endl;
+	cout << " P switches between drawing in state order, front to back and with a depth pre-pass" << endl;
+	cout << " O shows the overdraw, how many fragments are shaded for each pixel" << endl;
+	cout << " C turns occlusion culling behind the walls and shelves on and off" << endl;
+	cout << " T prints the GPU time of each pass" << endl;
+	cout << " F12 saves a screenshot, F11 records frames until pressed again (shift+F11 as raw video)" << endl;
+	cout << " F10 prints the GL calls, live objects and video memory of the last frame" << endl << endl;
 }
 
 /* Entry point of program */
@@ -463,6 +953,7 @@ int main(int argc, char* argv[])
 {
 	GLWrapper* glw = new GLWrapper(1920 * 0.8f, 1080 * 0.9f, "Assignment Two - Marius Urbelis");
 	//GLWrapper *glw = new GLWrapper(1920 * 1.5f, 1080 * 1.5f, "Assignment Two - Marius Urbelis");
+	window_wrapper = glw;
 
 	if (!ogl_LoadFunctions())
 	{
@@ -470,6 +961,9 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
+	// After ogl_LoadFunctions(), which would put back the functions it swaps
+	glw->enableAccounting();
+
 	glw->setRenderer(display);
 	glw->setKeyCallback(keyCallback);
 	glw->setReshapeCallback(reshape);
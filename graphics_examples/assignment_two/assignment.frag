@@ -1,16 +1,35 @@
 #version 400
 
+// Compile-time variants, selected by the application:
+//   EMIT     - the object emits light (used for the light source sphere)
+//   SPECULAR - add a Phong specular highlight
+//   CLUSTERED_LIGHTS - add the many point lights of ClusteredLights
+//   GBUFFER  - write the albedo, shininess and normal into the deferred shading G-buffer
+//              instead of lighting the fragment, which deferred_lighting.frag does later
+
+#include "../../shaders/lighting.glsl"
+#ifdef CLUSTERED_LIGHTS
+#include "../../shaders/clustered_lights.glsl"
+#endif
+#ifdef GBUFFER
+#include "../../shaders/octahedral.glsl"
+#endif
+
 in vec4 fcolour;
 in vec2 ftexcoord;
 in float distanceToLight;
+#ifdef GBUFFER
+layout(location = 0) out vec4 gbufferAlbedo;
+layout(location = 1) out vec2 gbufferNormal;
+#else
 out vec4 outputColor;
+#endif
 
 in vec4 vertexPosition;
 in vec3 lightVector;
 in vec3 vertexNormal;
 
 uniform sampler2D tex1;
-uniform uint colourmode, emitmode, attenuationmode, specularmode;
 uniform float sunPower;
 
 vec3 specular_albedo = vec3(1.0, 0.8, 0.6);
@@ -21,27 +40,39 @@ void main()
 {
 	vec4 texcolour = texture(tex1, ftexcoord);
 
-	vec3 diffuse = max(dot(vertexNormal, lightVector), 0.0) * texcolour.xyz;
+	vec3 N = normalize(vertexNormal);
 
-	vec3 emissive = vec3(0);
-	if (emitmode == 1) emissive = vec3(1.0, 1.0, 0.8);
-	
-	vec3 V = normalize(-vertexPosition.xyz);
-	vec3 R = reflect(-normalize(lightVector), normalize(vertexNormal));
-	vec3 specular = pow(max(dot(R, V), 0.0), shininess) * specular_albedo;
+#ifdef GBUFFER
+#ifdef SPECULAR
+	gbufferAlbedo = vec4(texcolour.rgb, shininess / 255.0);
+#else
+	gbufferAlbedo = vec4(texcolour.rgb, 0.0);
+#endif
+	gbufferNormal = octEncode(N);
+#else
+	vec3 L = normalize(lightVector);
 
-	float attenuation;
-	
-	float attenuation_k1 = sunPower;
-	float attenuation_k2 = sunPower;
-	float attenuation_k3 = sunPower;
-	
-	attenuation = 1.0 / (attenuation_k1 +
-						 attenuation_k2 * distanceToLight +
-						 attenuation_k3 * pow(distanceToLight, 2));
+	vec3 lighting = diffuse_term(N, L) * texcolour.xyz;
+#ifdef SPECULAR
+	lighting += specular_term(N, L, vertexPosition.xyz, shininess, specular_albedo);
+#endif
 
+	float attenuation = attenuation_term(distanceToLight, sunPower, sunPower, sunPower);
 
 	vec3 ambient = texcolour.xyz * 0.3;
-	
-	outputColor = vec4(attenuation * ((specularmode == 1) ? (diffuse + specular) : diffuse) + ambient + emissive, 1.0f);
+
+	vec3 colour = attenuation * lighting + ambient;
+#ifdef CLUSTERED_LIGHTS
+#ifdef SPECULAR
+	colour += clustered_lighting(vertexPosition.xyz, N, texcolour.xyz, shininess, specular_albedo);
+#else
+	colour += clustered_lighting(vertexPosition.xyz, N, texcolour.xyz, 0.0, specular_albedo);
+#endif
+#endif
+#ifdef EMIT
+	colour += emissive_colour;
+#endif
+
+	outputColor = vec4(colour, 1.0f);
+#endif
 }
\ No newline at end of file
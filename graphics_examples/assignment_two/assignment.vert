@@ -1,12 +1,22 @@
 #version 400
 
+// Compile-time variants, selected by the application:
+//   OCT_NORMALS - the mesh is quantised and its normals are octahedral encoded
+
 // These are the vertex attributes
 layout(location = 0) in vec3 position;
+#ifdef OCT_NORMALS
+layout(location = 1) in vec2 normal;
+#else
 layout(location = 1) in vec3 normal;
+#endif
 layout(location = 2) in vec2 texcoord;
 
+// Per-object model-view, projection and normal matrices
+#include "../../shaders/transforms.glsl"
+#include "../../shaders/octahedral.glsl"
+
 // Uniform variables are passed in from the application
-uniform mat4 model, view, projection;
 uniform uint colourmode;
 uniform vec4 lightpos;
 
@@ -19,14 +29,19 @@ out vec3 vertexNormal;
 out vec2 ftexcoord;
 out float distanceToLight;
 
+// The depth pre-pass in depth_only.vert must give exactly the same depths
+invariant gl_Position;
+
 void main()
 {
 	vec4 position_h = vec4(position, 1.0);
 	
-	mat4 mv_matrix = view * model;
-
-	vertexNormal = normalize(transpose(inverse(mat3(mv_matrix))) * normal);
-	vertexPosition = mv_matrix * position_h;
+#ifdef OCT_NORMALS
+	vertexNormal = normalize(normalmatrix * octDecode(normal));
+#else
+	vertexNormal = normalize(normalmatrix * normal);
+#endif
+	vertexPosition = modelview * position_h;
 
 	lightVector = lightpos.xyz - vertexPosition.xyz;
 	distanceToLight = length(lightVector);
@@ -35,5 +50,5 @@ void main()
 	
 	ftexcoord = texcoord;
 
-	gl_Position = projection * mv_matrix * position_h;
+	gl_Position = mvp * position_h;
 }
\ No newline at end of file
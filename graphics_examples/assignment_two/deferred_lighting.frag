@@ -0,0 +1,58 @@
+#version 400
+
+// The lighting pass of deferred shading. Lights each pixel once from the G-buffer that the
+// GBUFFER variant of assignment.frag wrote, with the same lighting as the forward shader.
+//
+// Compile-time variants, selected by the application:
+//   CLUSTERED_LIGHTS - add the many point lights of ClusteredLights
+
+#include "../../shaders/lighting.glsl"
+#include "../../shaders/octahedral.glsl"
+#ifdef CLUSTERED_LIGHTS
+#include "../../shaders/clustered_lights.glsl"
+#endif
+
+in vec2 screenPosition;
+out vec4 outputColor;
+
+uniform sampler2D gbufferAlbedo;
+uniform sampler2D gbufferNormal;
+uniform sampler2D gbufferDepth;
+uniform mat4 inverseProjection;
+uniform vec4 lightpos;
+uniform float sunPower;
+
+vec3 specular_albedo = vec3(1.0, 0.8, 0.6);
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gbufferDepth, pixel, 0).r;
+	if (depth == 1.0) discard;
+
+	// Later forward draws, like the shadows, are depth tested against the G-buffer's depth
+	gl_FragDepth = depth;
+
+	vec4 albedo = texelFetch(gbufferAlbedo, pixel, 0);
+	vec3 N = octDecode(texelFetch(gbufferNormal, pixel, 0).xy);
+	float shininess = floor(albedo.a * 255.0 + 0.5);
+
+	vec4 position = inverseProjection * vec4(screenPosition, depth * 2.0 - 1.0, 1.0);
+	vec3 P = position.xyz / position.w;
+
+	vec3 toLight = lightpos.xyz - P;
+	float distanceToLight = length(toLight);
+	vec3 L = toLight / distanceToLight;
+
+	vec3 lighting = diffuse_term(N, L) * albedo.rgb;
+	if (shininess > 0.0) lighting += specular_term(N, L, P, shininess, specular_albedo);
+
+	float attenuation = attenuation_term(distanceToLight, sunPower, sunPower, sunPower);
+
+	vec3 colour = attenuation * lighting + albedo.rgb * 0.3;
+#ifdef CLUSTERED_LIGHTS
+	colour += clustered_lighting(P, N, albedo.rgb, shininess, specular_albedo);
+#endif
+
+	outputColor = vec4(colour, 1.0);
+}
@@ -0,0 +1,7 @@
+#version 400
+
+// The depth pre-pass only writes depth, with the colour masked off
+
+void main()
+{
+}
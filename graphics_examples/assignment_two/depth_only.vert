@@ -0,0 +1,15 @@
+#version 400
+
+// Position only, for the depth pre-pass and for counting overdraw. gl_Position is invariant
+// here and in the shaders of the shading pass, so that their depths are exactly equal
+
+layout(location = 0) in vec3 position;
+
+#include "../../shaders/transforms.glsl"
+
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = mvp * vec4(position, 1.0);
+}
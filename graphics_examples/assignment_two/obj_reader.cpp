@@ -0,0 +1,461 @@
+/* obj_reader.cpp
+Streams an obj file through LoadObjWithCallback, welding each face corner into a shared vertex as it
+is read. While streaming only the raw attributes, the indices and the three attribute indices of
+each welded vertex are held, instead of LoadObj's copy and a de-indexed copy. The vertices are made
+at their final size once the file is read and the weld table is freed.
+
+Corners without a normal are given a smooth one before the vertices are made, and the vertices they
+were welded into are split again wherever their faces ended up with different normals.
+
+The raw attributes have to be held until the last face is read, as a face can use any v, vt or
+vn line before it, so the least a load can need is the mesh and the raw attributes together.
+*/
+
+#include "obj_reader.h"
+#include "mesh_normals.h"
+#include "tiny_obj_loader.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdio.h>
+
+using namespace std;
+
+/* Line counts from the first pass over the file */
+struct ObjCounts
+{
+	size_t positions, normals, texcoords, triangles;
+};
+
+/* Everything the callbacks build up while the file is streamed. Only the corners are welded
+   while streaming, the vertices themselves are made once the number of them is known */
+struct ObjStream
+{
+	vector<float> positions, normals, texcoords;
+	vector<unsigned int> indices;
+	vector<int> corners;		// position, texcoord and normal index of each welded vertex
+	vector<unsigned int> table;		// hash of corners to welded vertices, emptySlot when unused
+	vector<pair<size_t, unsigned int> > smoothingRuns;	// first triangle and smoothing group of each run of faces
+	unsigned int smoothingGroup;			// set by s, 0 (off) before the first one
+	bool hasSmoothingGroups;
+	bool missingNormals;		// some corner has no normal in the file
+	size_t skippedFaces;
+	size_t peakBytes;			// the most that was held at once
+
+	vector<string> textureNames;	// map_Kd of each material
+	vector<ObjRun> runs;
+	int material;					// set by usemtl, -1 before the first one
+};
+
+/* A generated normal for a vertex whose corners had none, on the vertex itself or on a copy of it */
+struct NormalSplit
+{
+	unsigned int vertex, source;
+	float normal[3];
+};
+
+static const unsigned int emptySlot = 0xFFFFFFFFu;
+
+/* Everything the stream holds, with extra for what is held beside it */
+static void notePeak(ObjStream &s, size_t extra)
+{
+	size_t bytes = (s.positions.capacity() + s.normals.capacity() + s.texcoords.capacity()) * sizeof(float)
+		+ s.indices.capacity() * sizeof(unsigned int) + s.corners.capacity() * sizeof(int) + s.table.capacity() * sizeof(unsigned int)
+		+ s.smoothingRuns.capacity() * sizeof(pair<size_t, unsigned int>) + s.runs.capacity() * sizeof(ObjRun) + extra;
+	if (bytes > s.peakBytes) s.peakBytes = bytes;
+}
+
+/* Count the v, vn and vt lines and the triangles that the f lines will make, without
+   parsing any numbers. Returns false if the file can't be read */
+static bool countObj(const string &inputfile, ObjCounts &counts)
+{
+	FILE *file = fopen(inputfile.c_str(), "rb");
+	if (!file) return false;
+
+	counts.positions = counts.normals = counts.texcoords = counts.triangles = 0;
+
+	char block[65536];
+	char prefix[2] = { 0, 0 };
+	int prefixLength = 0, corners = 0;
+	bool prefixDone = false, inToken = false;
+	size_t n;
+	while ((n = fread(block, 1, sizeof(block), file)) > 0)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			char c = block[i];
+			bool space = (c == ' ' || c == '\t');
+			if (c == '\n' || c == '\r')
+			{
+				// End of a line, the prefix says what it was
+				if (prefixDone && prefixLength == 1 && prefix[0] == 'v') counts.positions++;
+				else if (prefixDone && prefixLength == 2 && prefix[0] == 'v' && prefix[1] == 'n') counts.normals++;
+				else if (prefixDone && prefixLength == 2 && prefix[0] == 'v' && prefix[1] == 't') counts.texcoords++;
+				else if (prefixDone && prefixLength == 1 && prefix[0] == 'f' && corners > 2) counts.triangles += corners - 2;
+
+				prefixLength = corners = 0;
+				prefixDone = inToken = false;
+			}
+			else if (!prefixDone)
+			{
+				if (!space)
+				{
+					if (prefixLength < 2) prefix[prefixLength] = c;
+					prefixLength++;
+				}
+				else if (prefixLength > 0) prefixDone = true;
+			}
+			else
+			{
+				if (!space && !inToken) corners++;
+				inToken = !space;
+			}
+		}
+	}
+	// A last line without a newline
+	if (prefixDone && prefixLength == 1 && prefix[0] == 'f' && corners > 2) counts.triangles += corners - 2;
+	else if (prefixDone && prefixLength == 1 && prefix[0] == 'v') counts.positions++;
+
+	fclose(file);
+	return true;
+}
+
+/* Turn an obj index, which counts from 1 or back from the end when negative, into
+   an array index. Missing (0) or out of range indices give -1 */
+static int resolveIndex(int index, size_t count)
+{
+	long long i = (index > 0) ? (long long)index - 1 : (long long)count + index;
+	return (index == 0 || i < 0 || i >= (long long)count) ? -1 : (int)i;
+}
+
+static size_t hashCorner(int v, int vt, int vn)
+{
+	unsigned int h = (unsigned int)v * 73856093u ^ (unsigned int)vt * 19349663u ^ (unsigned int)vn * 83492791u;
+	return (size_t)(h * 2654435761u ^ (h >> 15));
+}
+
+/* Rebuild the hash table at twice the size, the old one is freed after the new one is made */
+static void growTable(ObjStream &s)
+{
+	notePeak(s, s.table.size() * 2 * sizeof(unsigned int));
+	s.table.assign(s.table.size() * 2, emptySlot);
+	size_t mask = s.table.size() - 1;
+	for (unsigned int w = 0; w < s.corners.size() / 3; w++)
+	{
+		const int *c = &s.corners[w * 3];
+		size_t slot = hashCorner(c[0], c[1], c[2]) & mask;
+		while (s.table[slot] != emptySlot) slot = (slot + 1) & mask;
+		s.table[slot] = w;
+	}
+}
+
+/* The welded vertex for a face corner, added the first time the corner is seen. The corners
+   grow by half when the first pass's guess was short, counting the copy that makes */
+static unsigned int weldCorner(ObjStream &s, int v, int vt, int vn)
+{
+	size_t mask = s.table.size() - 1;
+	size_t slot = hashCorner(v, vt, vn) & mask;
+	while (s.table[slot] != emptySlot)
+	{
+		unsigned int w = s.table[slot];
+		const int *c = &s.corners[w * 3];
+		if (c[0] == v && c[1] == vt && c[2] == vn) return w;
+		slot = (slot + 1) & mask;
+	}
+
+	if (s.corners.size() + 3 > s.corners.capacity())
+	{
+		size_t grown = s.corners.capacity() + s.corners.capacity() / 2 + 3;
+		notePeak(s, grown * sizeof(int));
+		s.corners.reserve(grown);
+	}
+	if (vn < 0) s.missingNormals = true;
+
+	unsigned int w = (unsigned int)(s.corners.size() / 3);
+	s.corners.push_back(v);
+	s.corners.push_back(vt);
+	s.corners.push_back(vn);
+	s.table[slot] = w;
+
+	// Keep the table at most half full
+	if ((w + 1) * 2 > s.table.size()) growTable(s);
+	return w;
+}
+
+/* Size the corners and the weld table for a little more welded vertices than the largest
+   attribute array has, which most meshes weld down to */
+static void startWeld(ObjStream &s, size_t largestAttribute)
+{
+	size_t expected = largestAttribute + largestAttribute / 4;
+	s.corners.reserve(expected * 3);
+	size_t tableSize = 16;
+	while (tableSize < expected * 2) tableSize *= 2;
+	s.table.assign(tableSize, emptySlot);
+}
+
+size_t weldCorners(const vector<int> &faceCorners, size_t largestAttribute, vector<unsigned int> &indices)
+{
+	ObjStream s;
+	s.peakBytes = 0;
+	s.missingNormals = false;
+	startWeld(s, largestAttribute);
+
+	indices.resize(faceCorners.size() / 3);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const int *c = &faceCorners[i * 3];
+		indices[i] = weldCorner(s, c[0], c[1], c[2]);
+	}
+	return s.corners.size() / 3;
+}
+
+static void vertexCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t)
+{
+	vector<float> &p = ((ObjStream*)user)->positions;
+	p.push_back((float)x); p.push_back((float)y); p.push_back((float)z);
+}
+
+static void normalCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z)
+{
+	vector<float> &n = ((ObjStream*)user)->normals;
+	n.push_back((float)x); n.push_back((float)y); n.push_back((float)z);
+}
+
+static void texcoordCallback(void *user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t)
+{
+	vector<float> &t = ((ObjStream*)user)->texcoords;
+	t.push_back((float)x); t.push_back((float)y);
+}
+
+/* Weld the corners of one face and triangulate it as a fan, like LoadObj does */
+static void faceCallback(void *user, tinyobj::index_t *face, int numCorners)
+{
+	ObjStream &s = *(ObjStream*)user;
+	if (s.runs.empty() || s.runs.back().material != s.material)
+	{
+		ObjRun run = { s.material, s.indices.size() };
+		s.runs.push_back(run);
+	}
+
+	unsigned int welded[3];
+	for (int i = 0; i < numCorners; i++)
+	{
+		int v = resolveIndex(face[i].vertex_index, s.positions.size() / 3);
+		if (v < 0)
+		{
+			// A face needs every position, drop it (along with any triangles already made from it)
+			s.indices.resize(s.indices.size() - 3 * (i > 2 ? i - 2 : 0));
+			s.skippedFaces++;
+			return;
+		}
+		int vt = resolveIndex(face[i].texcoord_index, s.texcoords.size() / 2);
+		int vn = resolveIndex(face[i].normal_index, s.normals.size() / 3);
+		unsigned int w = weldCorner(s, v, vt, vn);
+
+		if (i == 0) welded[0] = w;
+		else if (i == 1) welded[2] = w;
+		else
+		{
+			welded[1] = welded[2];
+			welded[2] = w;
+			s.indices.insert(s.indices.end(), welded, welded + 3);
+		}
+	}
+	if (numCorners > 2 && (s.smoothingRuns.empty() || s.smoothingRuns.back().second != s.smoothingGroup))
+	{
+		s.smoothingRuns.push_back(make_pair(s.indices.size() / 3 - (numCorners - 2), s.smoothingGroup));
+	}
+}
+
+static void materialsCallback(void *user, const tinyobj::material_t *materials, int numMaterials)
+{
+	vector<string> &names = ((ObjStream*)user)->textureNames;
+	names.resize(numMaterials);
+	for (int i = 0; i < numMaterials; i++) names[i] = materials[i].diffuse_texname;
+}
+
+static void useMaterialCallback(void *user, const char *, int material)
+{
+	((ObjStream*)user)->material = material;
+}
+
+static void smoothingGroupCallback(void *user, unsigned int group)
+{
+	ObjStream &s = *(ObjStream*)user;
+	s.smoothingGroup = group;
+	s.hasSmoothingGroups = true;
+}
+
+/* Give the corners that had no normal in the file smooth ones. Corners that were welded into one
+   vertex can get different normals, at a crease or between smoothing groups, so each different
+   normal after the first goes on a copy of the vertex. The indices are pointed at the vertex or
+   copy with their normal, and splits gets the normal of each. Returns how many copies there are */
+static size_t generateMissingNormals(ObjStream &s, float creaseAngle, vector<NormalSplit> &splits)
+{
+	size_t vertexCount = s.corners.size() / 3, triangles = s.indices.size() / 3;
+
+	// Smooth normals for every corner, found from the positions so that faces are smoothed across texture seams
+	vector<unsigned int> positionIndices(s.indices.size());
+	for (size_t i = 0; i < s.indices.size(); i++) positionIndices[i] = (unsigned int)s.corners[s.indices[i] * 3];
+	vector<unsigned int> groups;
+	if (s.hasSmoothingGroups)
+	{
+		groups.resize(triangles);
+		for (size_t r = 0; r < s.smoothingRuns.size(); r++)
+		{
+			size_t last = (r + 1 < s.smoothingRuns.size()) ? s.smoothingRuns[r + 1].first : triangles;
+			fill(groups.begin() + s.smoothingRuns[r].first, groups.begin() + last, s.smoothingRuns[r].second);
+		}
+	}
+	vector<float> cornerNormals(s.indices.size() * 3);
+	notePeak(s, (positionIndices.capacity() + groups.capacity()) * sizeof(unsigned int) + cornerNormals.capacity() * sizeof(float)
+		+ generateNormalsBytes(s.positions.size() / 3, s.indices.size()));
+	generateNormals(&s.positions[0], s.positions.size() / 3, &positionIndices[0], s.indices.size(),
+		groups.empty() ? NULL : &groups[0], creaseAngle, &cornerNormals[0]);
+	vector<unsigned int>().swap(positionIndices);
+	vector<unsigned int>().swap(groups);
+
+	// Sort the corners of each vertex without a normal by the normal they were given
+	size_t missing = 0;
+	for (size_t i = 0; i < s.indices.size(); i++) if (s.corners[s.indices[i] * 3 + 2] < 0) missing++;
+	vector<unsigned int> order;
+	order.reserve(missing);
+	for (size_t i = 0; i < s.indices.size(); i++) if (s.corners[s.indices[i] * 3 + 2] < 0) order.push_back((unsigned int)i);
+	const float *normals = &cornerNormals[0];
+	const unsigned int *indices = &s.indices[0];
+	sort(order.begin(), order.end(), [normals, indices](unsigned int a, unsigned int b)
+	{
+		return indices[a] != indices[b] ? indices[a] < indices[b]
+			: lexicographical_compare(normals + a * 3, normals + a * 3 + 3, normals + b * 3, normals + b * 3 + 3);
+	});
+
+	// Each different normal of a vertex is a split, on the vertex for its first normal and on a copy after that
+	size_t count = 0;
+	for (size_t k = 0; k < order.size(); k++)
+	{
+		const float *n = normals + order[k] * 3;
+		if (k == 0 || indices[order[k]] != indices[order[k - 1]] || !equal(n, n + 3, normals + order[k - 1] * 3)) count++;
+	}
+	splits.reserve(count);
+	notePeak(s, cornerNormals.capacity() * sizeof(float) + order.capacity() * sizeof(unsigned int) + splits.capacity() * sizeof(NormalSplit));
+
+	size_t copies = 0;
+	unsigned int previous = 0, vertex = 0;
+	for (size_t k = 0; k < order.size(); k++)
+	{
+		unsigned int i = order[k], w = s.indices[i];
+		const float *n = normals + i * 3;
+		bool newVertex = (k == 0 || w != previous);
+		if (newVertex || !equal(n, n + 3, normals + order[k - 1] * 3))
+		{
+			vertex = newVertex ? w : (unsigned int)(vertexCount + copies++);
+			NormalSplit split = { vertex, w, { n[0], n[1], n[2] } };
+			splits.push_back(split);
+		}
+		previous = w;
+		s.indices[i] = vertex;
+	}
+	return copies;
+}
+
+bool readObj(const string &inputfile, float creaseAngle, ObjMesh &mesh)
+{
+	// Size everything once from the first pass so that nothing is reallocated while streaming
+	ObjCounts counts;
+	ifstream file(inputfile.c_str());
+	if (!file || !countObj(inputfile, counts))
+	{
+		cerr << "Could not open " << inputfile << endl;
+		return false;
+	}
+
+	ObjStream s;
+	s.skippedFaces = 0;
+	s.peakBytes = 0;
+	s.material = -1;
+	s.smoothingGroup = 0;
+	s.hasSmoothingGroups = false;
+	s.missingNormals = false;
+	s.positions.reserve(counts.positions * 3);
+	s.normals.reserve(counts.normals * 3);
+	s.texcoords.reserve(counts.texcoords * 2);
+	s.indices.reserve(counts.triangles * 3);
+
+	startWeld(s, std::max(counts.positions, std::max(counts.normals, counts.texcoords)));
+
+	tinyobj::callback_t callbacks;
+	callbacks.vertex_cb = vertexCallback;
+	callbacks.normal_cb = normalCallback;
+	callbacks.texcoord_cb = texcoordCallback;
+	callbacks.index_cb = faceCallback;
+	callbacks.mtllib_cb = materialsCallback;
+	callbacks.usemtl_cb = useMaterialCallback;
+	callbacks.smoothing_group_cb = smoothingGroupCallback;
+
+	// Material files are found relative to the obj file
+	string baseDir = inputfile.substr(0, inputfile.find_last_of("/\\") + 1);
+	tinyobj::MaterialFileReader materialReader(baseDir);
+
+	string err, warn;
+	bool ret = tinyobj::LoadObjWithCallback(file, callbacks, &s, &materialReader, &warn, &err);
+
+	if (!err.empty()) { // `err` may contain error messages.
+		cerr << err << endl;
+	}
+
+	if (!warn.empty()) { // `warn` may contain warning messages.
+		cerr << warn << endl;
+	}
+
+	if (!ret) {
+		return false;
+	}
+
+	if (s.skippedFaces > 0)
+	{
+		cerr << inputfile << ": skipped " << s.skippedFaces << " faces with a missing vertex" << endl;
+	}
+
+	// The weld table is done with, and the corners are cut to size while that is less than the vertices will take
+	notePeak(s, 0);
+	vector<unsigned int>().swap(s.table);
+	notePeak(s, s.corners.size() * sizeof(int));
+	vector<int>(s.corners).swap(s.corners);
+	size_t vertexCount = s.corners.size() / 3;
+
+	vector<NormalSplit> splits;
+	size_t copies = s.missingNormals ? generateMissingNormals(s, creaseAngle, splits) : 0;
+
+	// Make the vertices, at their final size. Corners without a normal or texture coordinate get zeros
+	vector<ObjVertex> vertices(vertexCount + copies);
+	notePeak(s, vertices.capacity() * sizeof(ObjVertex) + splits.capacity() * sizeof(NormalSplit));
+	for (size_t w = 0; w < vertexCount; w++)
+	{
+		const int *c = &s.corners[w * 3];
+		ObjVertex &vertex = vertices[w];
+		for (int i = 0; i < 3; i++) vertex.position[i] = s.positions[c[0] * 3 + i];
+		if (c[2] >= 0) for (int i = 0; i < 3; i++) vertex.normal[i] = s.normals[c[2] * 3 + i];
+		if (c[1] >= 0) for (int i = 0; i < 2; i++) vertex.texcoord[i] = s.texcoords[c[1] * 2 + i];
+	}
+	for (size_t k = 0; k < splits.size(); k++)
+	{
+		ObjVertex &vertex = vertices[splits[k].vertex];
+		if (splits[k].vertex != splits[k].source) vertex = vertices[splits[k].source];
+		for (int i = 0; i < 3; i++) vertex.normal[i] = splits[k].normal[i];
+	}
+
+	mesh.positions = s.positions.size() / 3;
+	mesh.normals = s.normals.size() / 3;
+	mesh.texcoords = s.texcoords.size() / 2;
+	mesh.skippedFaces = s.skippedFaces;
+	mesh.weldedVertices = vertexCount;
+	mesh.normalCopies = copies;
+	mesh.peakBytes = s.peakBytes;
+
+	// The raw attributes and the corners go with the stream
+	mesh.vertices.swap(vertices);
+	mesh.indices.swap(s.indices);
+	mesh.runs.swap(s.runs);
+	mesh.textureNames.swap(s.textureNames);
+	return true;
+}
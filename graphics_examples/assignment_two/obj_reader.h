@@ -0,0 +1,57 @@
+/* obj_reader.h
+Reads an obj (WaveFront) file into welded vertices and triangle indices on the CPU. This is the
+part of TinyObjLoader::load_obj that doesn't need OpenGL, kept apart so that the benchmarks can
+time it and measure its memory without a context.
+A quick first pass counts the vertices and faces so that every array can be sized once, then the
+file is streamed through tinyobj's LoadObjWithCallback and each face is welded into shared
+vertices as it is read. Corners without a normal in the file get smooth ones (see mesh_normals.h),
+split at the smoothing groups and at edges sharper than the crease angle.
+The tinyobj implementation isn't compiled in here, so link tiny_obj_loader.cc, or another file
+that defines TINYOBJLOADER_IMPLEMENTATION, with this.
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+/* One welded vertex as it is stored in the vertex buffer */
+struct ObjVertex
+{
+	float position[3];
+	float normal[3];
+	float texcoord[2];
+};
+
+/* Consecutive faces with the same material, starting at firstIndex in the indices */
+struct ObjRun
+{
+	int material;
+	size_t firstIndex;
+};
+
+struct ObjMesh
+{
+	std::vector<ObjVertex> vertices;
+	std::vector<unsigned int> indices;			// triangles, in the order of the file
+	std::vector<ObjRun> runs;
+	std::vector<std::string> textureNames;		// map_Kd of each material, as the mtl file has it
+
+	// What was read, for reports
+	size_t positions, normals, texcoords;
+	size_t weldedVertices;		// before any were split by generated normals
+	size_t normalCopies;		// vertices split by generated normals
+	size_t skippedFaces;		// faces with a missing position
+	size_t peakBytes;			// the most held at once while reading, every temporary included
+};
+
+/* Returns false, after printing why, if the file can't be read. The raw attributes and the weld
+   table are freed before it returns, so only the mesh is left */
+bool readObj(const std::string &inputfile, float creaseAngle, ObjMesh &mesh);
+
+/* Weld face corners, given as the position, texcoord and normal array index of each (-1 when it
+   has none), into shared vertices the way readObj does, with the table sized from the largest
+   attribute array. indices gets the welded vertex of each corner. Returns the number of vertices.
+   This is readObj's weld on its own, for the benchmarks to time apart from the parse */
+size_t weldCorners(const std::vector<int> &faceCorners, size_t largestAttribute, std::vector<unsigned int> &indices);
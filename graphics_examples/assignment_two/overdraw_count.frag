@@ -0,0 +1,10 @@
+#version 400
+
+// Adds one to the pixel's count for every fragment, with additive blending
+
+out vec4 outputColor;
+
+void main()
+{
+	outputColor = vec4(1.0);
+}
@@ -5,10 +5,14 @@ layout(location = 2) in vec3 normal;
 
 out vec4 fcolour;
 
-uniform mat4 model, view, projection;
+// The shadow projection is folded into the model matrix
+#include "../../shaders/transforms.glsl"
+
+// The depth pre-pass in depth_only.vert must give exactly the same depths
+invariant gl_Position;
 
 void main()
 {
 	fcolour = vec4(0.1, 0.1, 0.13, 1.0);		
-	gl_Position = projection * view * model * vec4(position, 1.0);
+	gl_Position = mvp * vec4(position, 1.0);
 }
\ No newline at end of file
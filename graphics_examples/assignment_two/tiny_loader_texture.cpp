@@ -9,26 +9,112 @@ constructor:
 	attribute_v_normal = 1;
 	attribute_v_texcoord = 2;
 
+The obj file is read and welded into shared vertices by readObj (see obj_reader.h), which doesn't
+use OpenGL. Only the raw attributes, the welded vertices and the indices are ever held, instead
+of LoadObj's copy, a de-indexed copy and the copy handed to OpenGL.
+
+Faces are sorted by material into contiguous ranges of the element buffer. Materials that have
+a map_Kd texture get it from a cache shared by every loaded object, and drawObject binds each
+texture once for all of the submeshes that use it. Submeshes without a texture are drawn first
+with whatever texture the application has bound.
+
+Once loaded, each submesh's triangles are reordered for the post-transform vertex cache and
+for overdraw (see mesh_optimiser.h), and the vertices are quantised if a quantised VertexFormat
+was asked for. Then each submesh is split into meshlets, with bounds in the space of the vertex
+buffer so that cull() can take the same model-view matrix as the shaders, and last of all the
+vertices are put in the order that the triangles first use them.
+
 Iain Martin November 2018
 */
 
 #include "tiny_loader_texture.h"
+#include "texture_cache.h"
+#include "mesh_optimiser.h"
+#include "obj_reader.h"
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
 #include <stdio.h>
-
-//Tinyobjloader library used to import models
-#ifndef TINYOBJLOADER_IMPLEMENTATION
-	#define TINYOBJLOADER_IMPLEMENTATION // define this in only *one* .cc
-	#include "tiny_obj_loader.h"
-#endif
+#include <glm/gtc/matrix_transform.hpp>
 
 using namespace std;
 using namespace glm;
 
-// Debig print method to print out the attributres loaded from the obj file
-static  void PrintInfo(const tinyobj::attrib_t& attrib,
-	const vector<tinyobj::shape_t>& shapes,
-	const vector<tinyobj::material_t>& materials); 
+/* Textures for the materials of every object loaded */
+static TextureCache materialTextures;
+
+/* Find a material's map_Kd image. Exporters often write absolute paths from the machine the
+   model was made on, so if the path doesn't work try the file name next to the obj file */
+static string findTexture(const string &baseDir, string name)
+{
+	if (name.empty()) return name;
+
+	replace(name.begin(), name.end(), '\\', '/');
+	size_t doubled;
+	while ((doubled = name.find("//")) != string::npos) name.erase(doubled, 1);
+
+	string candidates[2] = { baseDir + name, baseDir + name.substr(name.find_last_of('/') + 1) };
+	for (int i = 0; i < 2; i++)
+	{
+		FILE *file = fopen(candidates[i].c_str(), "rb");
+		if (file)
+		{
+			fclose(file);
+			return candidates[i];
+		}
+	}
+	cerr << "Could not find texture " << name << endl;
+	return "";
+}
+
+static bool textureOrder(const TinyObjLoader::Submesh &a, const TinyObjLoader::Submesh &b)
+{
+	return a.texture != b.texture ? a.texture < b.texture : a.material < b.material;
+}
+
+/* Make a submesh for each material, ordered by texture, and move each material's runs of
+   faces together to match. This is done after the raw attributes have been freed so that
+   the reordered copy of the indices doesn't raise the peak memory use */
+static void sortSubmeshes(ObjMesh &s, const string &baseDir, vector<TinyObjLoader::Submesh> &submeshes)
+{
+	// The materials that are used and their textures
+	vector<TinyObjLoader::Submesh> used;
+	for (size_t r = 0; r < s.runs.size(); r++)
+	{
+		bool found = false;
+		for (size_t i = 0; i < used.size() && !found; i++) found = (used[i].material == s.runs[r].material);
+		if (found) continue;
+
+		int material = s.runs[r].material;
+		TinyObjLoader::Submesh submesh = { material, 0, 0, 0, 0, 0 };
+		if (material >= 0 && material < (int)s.textureNames.size())
+		{
+			string texture = findTexture(baseDir, s.textureNames[material]);
+			if (!texture.empty()) submesh.texture = materialTextures.load(texture);
+		}
+		used.push_back(submesh);
+	}
+	sort(used.begin(), used.end(), textureOrder);
+
+	// Gather the runs of each material in turn
+	vector<GLuint> sorted;
+	if (used.size() > 1) sorted.reserve(s.indices.size());
+	submeshes.clear();
+	for (size_t i = 0; i < used.size(); i++)
+	{
+		TinyObjLoader::Submesh submesh = used[i];
+		submesh.firstIndex = (GLuint)(used.size() > 1 ? sorted.size() : 0);
+		for (size_t r = 0; r < s.runs.size(); r++)
+		{
+			if (s.runs[r].material != submesh.material) continue;
+			size_t end = (r + 1 < s.runs.size()) ? s.runs[r + 1].firstIndex : s.indices.size();
+			if (used.size() > 1) sorted.insert(sorted.end(), s.indices.begin() + s.runs[r].firstIndex, s.indices.begin() + end);
+			submesh.indexCount += (GLuint)(end - s.runs[r].firstIndex);
+		}
+		if (submesh.indexCount > 0) submeshes.push_back(submesh);
+	}
+	if (used.size() > 1) s.indices.swap(sorted);
+}
 
 TinyObjLoader::TinyObjLoader()
 {
@@ -37,8 +123,18 @@ TinyObjLoader::TinyObjLoader()
 	attribute_v_texcoord = 2;
 
 	numVertices = 0;
-	numNormals = 0;
-	numTexCoords = 0;
+	numPIndexes = 0;
+
+	vertexFormat = VERTEX_FLOAT;
+	vertexSize = sizeof(ObjVertex);
+	normalOffset = offsetof(ObjVertex, normal);
+	texcoordOffset = offsetof(ObjVertex, texcoord);
+	normalType = texcoordType = GL_FLOAT;
+	dequantise = mat4(1.0f);
+	bounds = vec4(0.f);
+	boxLower = boxUpper = vec3(0.f);
+	creaseAngle = 60.f;
+	culled = false;
 }
 
 TinyObjLoader::~TinyObjLoader()
@@ -46,110 +142,166 @@ TinyObjLoader::~TinyObjLoader()
 }
 
 
-void TinyObjLoader::load_obj(string inputfile, bool debugPrint)
+void TinyObjLoader::load_obj(string inputfile, bool debugPrint, VertexFormat format)
 {
-	tinyobj::attrib_t attrib;
-	vector<tinyobj::shape_t> shapes;
-	vector<tinyobj::material_t> materials;
-
+	ObjMesh s;
+	if (!readObj(inputfile, creaseAngle, s)) exit(1);
 
-	string err, warn;
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &warn, inputfile.c_str());
+	numVertices = (GLuint)s.vertices.size();
+	numPIndexes = (GLuint)s.indices.size();
 
-	if (!err.empty()) { // `err` may contain error messages.
-		cerr << err << endl;
-	}
-	
-	if (!err.empty()) { // `warn` may contain warning messages.
-		cerr << err << endl;
+	if (debugPrint)
+	{
+		size_t meshBytes = numVertices * sizeof(ObjVertex) + numPIndexes * sizeof(GLuint);
+		cout << inputfile << endl;
+		cout << "# of positions : " << s.positions << endl;
+		cout << "# of normals   : " << s.normals << endl;
+		cout << "# of texcoords : " << s.texcoords << endl;
+		cout << "# of vertices  : " << s.weldedVertices << " welded from " << numPIndexes << " corners" << endl;
+		if (s.normalCopies > 0) cout << "                 + " << s.normalCopies << " split by generated normals" << endl;
+		cout << "# of triangles : " << numPIndexes / 3 << endl;
+		cout << "# of materials : " << s.textureNames.size() << " in " << s.runs.size() << " runs of faces" << endl;
+		cout << "buffers        : " << meshBytes / 1024 << " KB, " << s.peakBytes / 1024 << " KB while loading" << endl;
 	}
 
-	if (!ret) {
-		exit(1);
-	}
+	// Material textures are found relative to the obj file
+	string baseDir = inputfile.substr(0, inputfile.find_last_of("/\\") + 1);
+	sortSubmeshes(s, baseDir, submeshes);
 
-	// Calculate the number of vertices from the shapes
-	numVertices = 0;
-	for (size_t s = 0; s < shapes.size(); s++) {
-		numVertices += shapes[s].mesh.num_face_vertices.size() * 3;//3 vertexes for each face
+	// Reorder the triangles of each submesh for the vertex cache and overdraw
+	VertexCacheStats before = {};
+	if (!s.indices.empty())
+	{
+		before = analyseVertexCache(&s.indices[0], s.indices.size(), s.vertices.size());
+		for (size_t i = 0; i < submeshes.size(); i++)
+		{
+			GLuint *first = &s.indices[submeshes[i].firstIndex];
+			optimiseVertexCache(first, submeshes[i].indexCount, s.vertices.size());
+			optimiseOverdraw(first, submeshes[i].indexCount, s.vertices[0].position, sizeof(ObjVertex), s.vertices.size());
+		}
 	}
 
-	numNormals = numTexCoords = numVertices;
-
-	//have to duplicate vertices (glDrawElements not possible) because of texture
-	std::vector<tinyobj::real_t> pVertices(numVertices * 3);
-	std::vector<tinyobj::real_t> pTextureCoords(numVertices * 2);
-	std::vector<tinyobj::real_t> pNormals(numVertices * 3);
-
-	GLuint ind = 0;
-	for (size_t s = 0; s < shapes.size(); s++) {
+	// A sphere around the bounding box, for culling whole objects
+	bounds = vec4(0.f);
+	boxLower = boxUpper = vec3(0.f);
+	if (!s.vertices.empty())
+	{
+		vec3 lower(s.vertices[0].position[0], s.vertices[0].position[1], s.vertices[0].position[2]), upper = lower;
+		for (size_t v = 1; v < s.vertices.size(); v++)
+		{
+			vec3 p(s.vertices[v].position[0], s.vertices[v].position[1], s.vertices[v].position[2]);
+			lower = glm::min(lower, p);
+			upper = glm::max(upper, p);
+		}
+		bounds = vec4((lower + upper) * 0.5f, length(upper - lower) * 0.5f);
+		boxLower = lower;
+		boxUpper = upper;
+	}
 
-		// Loop over faces(polygon)
-		size_t index_offset = 0;
+	// Pack the vertices if asked to, the float vertices are freed before the upload
+	vertexFormat = VERTEX_FLOAT;
+	vertexSize = sizeof(ObjVertex);
+	normalOffset = offsetof(ObjVertex, normal);
+	texcoordOffset = offsetof(ObjVertex, texcoord);
+	normalType = texcoordType = GL_FLOAT;
+	dequantise = mat4(1.0f);
+
+	QuantisedVertices quantised;
+	vector<float> unitPositions;
+	if (format != VERTEX_FLOAT && !s.vertices.empty())
+	{
+		const ObjVertex &first = s.vertices[0];
+		quantiseVertices(first.position, first.normal, first.texcoord, sizeof(ObjVertex), s.vertices.size(), format, quantised);
 
-		//number of faces; vert, text, norm
-		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) 
+		if (debugPrint)
 		{
-			int fv = shapes[s].mesh.num_face_vertices[f];//number of vertices per face (3)
-
-			// Loop over vertices in the face.
-			for (size_t v = 0; v < fv; v++) 
-			{
-				// access to vertex
-				tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+			QuantisationError error = measureQuantisation(first.position, first.normal, first.texcoord, sizeof(ObjVertex),
+				s.vertices.size(), quantised);
+			cout << "quantised      : " << quantised.vertexSize << " bytes per vertex, was " << sizeof(ObjVertex) << endl;
+			cout << "  position     : " << error.positionMax << " max, " << error.positionMean << " mean, "
+				<< error.positionRelative * 100.f << "% of the bounding box" << endl;
+			cout << "  normal       : " << error.normalMaxDegrees << " degrees max, " << error.normalMeanDegrees << " mean" << endl;
+			cout << "  texcoord     : " << error.texcoordMax << " max" << (quantised.texcoordsHalf ? " (half floats)" : "") << endl;
+		}
 
-				pVertices[ind * 3 + 0] = attrib.vertices[3 * idx.vertex_index + 0];
-				pVertices[ind * 3 + 1] = attrib.vertices[3 * idx.vertex_index + 1];
-				pVertices[ind * 3 + 2] = attrib.vertices[3 * idx.vertex_index + 2];
+		vertexFormat = format;
+		vertexSize = (GLsizei)quantised.vertexSize;
+		normalOffset = (GLuint)quantised.normalOffset;
+		texcoordOffset = (GLuint)quantised.texcoordOffset;
+		normalType = (quantised.normalBits == 16) ? GL_SHORT : GL_BYTE;
+		texcoordType = quantised.texcoordsHalf ? GL_HALF_FLOAT : GL_UNSIGNED_SHORT;
+		dequantise = scale(translate(mat4(1.0f), vec3(quantised.positionMin[0], quantised.positionMin[1], quantised.positionMin[2])),
+			vec3(quantised.positionScale));
+		vector<ObjVertex>().swap(s.vertices);
+
+		// The meshlet bounds are made from the positions the vertex shader sees before positionTransform(), in the unit cube
+		unitPositions.resize(numVertices * 3);
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			const unsigned short *q = (const unsigned short*)&quantised.data[v * quantised.vertexSize];
+			for (int c = 0; c < 3; c++) unitPositions[v * 3 + c] = q[c] / 65535.f;
+		}
+	}
 
-				pTextureCoords[ind * 2 + 0] = attrib.texcoords[2 * idx.texcoord_index + 0];
-				pTextureCoords[ind * 2 + 1] = attrib.texcoords[2 * idx.texcoord_index + 1];
+	// Split each submesh into meshlets, which moves each meshlet's triangles together
+	meshlets.clear();
+	if (!s.indices.empty())
+	{
+		const float *positions = unitPositions.empty() ? s.vertices[0].position : &unitPositions[0];
+		size_t positionStride = unitPositions.empty() ? sizeof(ObjVertex) : 3 * sizeof(float);
+		for (size_t i = 0; i < submeshes.size(); i++)
+		{
+			submeshes[i].firstMeshlet = (GLuint)meshlets.size();
+			submeshes[i].meshletCount = (GLuint)buildMeshlets(meshlets, &s.indices[submeshes[i].firstIndex], submeshes[i].indexCount,
+				submeshes[i].firstIndex, positions, positionStride, numVertices);
+		}
+	}
+	meshletVisible.assign(meshlets.size(), 1);
+	culled = false;
+	vector<float>().swap(unitPositions);
 
-				pNormals[ind * 3 + 0] = attrib.normals[3 * idx.normal_index + 0];
-				pNormals[ind * 3 + 1] = attrib.normals[3 * idx.normal_index + 1];
-				pNormals[ind * 3 + 2] = attrib.normals[3 * idx.normal_index + 2];
+	// Then put the vertices that will be uploaded in the order the triangles use them
+	void *vertexData = (vertexFormat != VERTEX_FLOAT) ? (void*)&quantised.data[0] : (s.vertices.empty() ? NULL : (void*)&s.vertices[0]);
+	if (!s.indices.empty())
+	{
+		optimiseVertexFetch(vertexData, vertexSize, numVertices, &s.indices[0], s.indices.size());
 
-				ind++;
-			}
-			index_offset += fv;
+		if (debugPrint)
+		{
+			VertexCacheStats after = analyseVertexCache(&s.indices[0], s.indices.size(), numVertices);
+			cout << "ACMR           : " << before.acmr << " -> " << after.acmr << endl;
+			cout << "ATVR           : " << before.atvr << " -> " << after.atvr << endl;
+			cout << "# of meshlets  : " << meshlets.size() << ", " << numPIndexes / 3.f / meshlets.size() << " triangles each" << endl;
 		}
 	}
 
-	// Copy the vertix, normal and textcoord data into OpenGL buffers
-	glGenBuffers(1, &positionBufferObject);
-	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, pVertices.size() * sizeof(tinyobj::real_t), &pVertices.front(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenBuffers(1, &normalBufferObject);
-	glBindBuffer(GL_ARRAY_BUFFER, normalBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, pNormals.size() * sizeof(tinyobj::real_t), &pNormals.front(), GL_STATIC_DRAW);
+	// Copy the vertices and the indices into OpenGL buffers
+	glGenBuffers(1, &vertexBufferObject);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)numVertices * vertexSize, vertexData, GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	glGenBuffers(1, &texCoordsObject);
-	glBindBuffer(GL_ARRAY_BUFFER, texCoordsObject);
-	glBufferData(GL_ARRAY_BUFFER, pTextureCoords.size() * sizeof(tinyobj::real_t), &pTextureCoords.front(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glGenBuffers(1, &elementBufferObject);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObject);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, s.indices.size() * sizeof(GLuint), s.indices.empty() ? NULL : &s.indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 
 void TinyObjLoader::drawObject(int drawmode)
 {
-
-	/* Draw the object as GL_POINTS */
-	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
-	glVertexAttribPointer(attribute_v_coord, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	/* Bind the interleaved vertices: position, normal and texture coords. Quantised ones are
+	   normalised integers, with a two component octahedral normal */
+	bool quantised = (vertexFormat != VERTEX_FLOAT);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObject);
+	glVertexAttribPointer(attribute_v_coord, 3, quantised ? GL_UNSIGNED_SHORT : GL_FLOAT, quantised, vertexSize, (void*)0);
 	glEnableVertexAttribArray(attribute_v_coord);
 
-	/* Bind the object normals */
-	glBindBuffer(GL_ARRAY_BUFFER, normalBufferObject);
-	glVertexAttribPointer(attribute_v_normal, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glVertexAttribPointer(attribute_v_normal, quantised ? 2 : 3, normalType, quantised, vertexSize, (void*)(size_t)normalOffset);
 	glEnableVertexAttribArray(attribute_v_normal);
 
-	/* Bind the object texture coords if they exist */
+	glVertexAttribPointer(attribute_v_texcoord, 2, texcoordType, texcoordType == GL_UNSIGNED_SHORT, vertexSize, (void*)(size_t)texcoordOffset);
 	glEnableVertexAttribArray(attribute_v_texcoord);
-	glBindBuffer(GL_ARRAY_BUFFER, texCoordsObject);
-	glVertexAttribPointer(attribute_v_texcoord, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
 
 	glPointSize(3.f);
 
@@ -165,179 +317,67 @@ void TinyObjLoader::drawObject(int drawmode)
 	}
 	else
 	{
-		glDrawArrays(GL_TRIANGLES, 0, numVertices);
-	}
-}
-
-static void PrintInfo(const tinyobj::attrib_t& attrib,
-	const vector<tinyobj::shape_t>& shapes,
-	const vector<tinyobj::material_t>& materials) {
-	cout << "# of vertices  : " << (attrib.vertices.size() / 3) << endl;
-	cout << "# of normals   : " << (attrib.normals.size() / 3) << endl;
-	cout << "# of texcoords : " << (attrib.texcoords.size() / 2)
-		<< endl;
-
-	cout << "# of shapes    : " << shapes.size() << endl;
-	cout << "# of materials : " << materials.size() << endl;
-
-	for (size_t v = 0; v < attrib.vertices.size() / 3; v++) {
-		printf("  v[%ld] = (%f, %f, %f)\n", static_cast<long>(v),
-			static_cast<const double>(attrib.vertices[3 * v + 0]),
-			static_cast<const double>(attrib.vertices[3 * v + 1]),
-			static_cast<const double>(attrib.vertices[3 * v + 2]));
-	}
-
-	for (size_t v = 0; v < attrib.normals.size() / 3; v++) {
-		printf("  n[%ld] = (%f, %f, %f)\n", static_cast<long>(v),
-			static_cast<const double>(attrib.normals[3 * v + 0]),
-			static_cast<const double>(attrib.normals[3 * v + 1]),
-			static_cast<const double>(attrib.normals[3 * v + 2]));
-	}
-
-	for (size_t v = 0; v < attrib.texcoords.size() / 2; v++) {
-		printf("  uv[%ld] = (%f, %f)\n", static_cast<long>(v),
-			static_cast<const double>(attrib.texcoords[2 * v + 0]),
-			static_cast<const double>(attrib.texcoords[2 * v + 1]));
-	}
-
-	// For each shape
-	for (size_t i = 0; i < shapes.size(); i++) {
-		printf("shape[%ld].name = %s\n", static_cast<long>(i),
-			shapes[i].name.c_str());
-		printf("Size of shape[%ld].mesh.indices: %lu\n", static_cast<long>(i),
-			static_cast<unsigned long>(shapes[i].mesh.indices.size()));
-		printf("Size of shape[%ld].path.indices: %lu\n", static_cast<long>(i),
-			static_cast<unsigned long>(shapes[i].path.indices.size()));
-
-		size_t index_offset = 0;
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferObject);
 
-		assert(shapes[i].mesh.num_face_vertices.size() ==
-			shapes[i].mesh.material_ids.size());
-
-		assert(shapes[i].mesh.num_face_vertices.size() ==
-			shapes[i].mesh.smoothing_group_ids.size());
-
-		printf("shape[%ld].num_faces: %lu\n", static_cast<long>(i),
-			static_cast<unsigned long>(shapes[i].mesh.num_face_vertices.size()));
-
-		// For each face
-		for (size_t f = 0; f < shapes[i].mesh.num_face_vertices.size(); f++) {
-			size_t fnum = shapes[i].mesh.num_face_vertices[f];
-
-			printf("  face[%ld].fnum = %ld\n", static_cast<long>(f),
-				static_cast<unsigned long>(fnum));
-
-			// For each vertex in the face
-			for (size_t v = 0; v < fnum; v++) {
-				tinyobj::index_t idx = shapes[i].mesh.indices[index_offset + v];
-				printf("    face[%ld].v[%ld].idx = %d/%d/%d\n", static_cast<long>(f),
-					static_cast<long>(v), idx.vertex_index, idx.normal_index,
-					idx.texcoord_index);
+		// Neighbouring submeshes with the same texture are drawn together
+		for (size_t i = 0; i < submeshes.size();)
+		{
+			GLuint texture = submeshes[i].texture;
+			GLuint first = submeshes[i].firstIndex, count = 0;
+			GLuint firstMeshlet = submeshes[i].firstMeshlet, meshletCount = 0;
+			for (; i < submeshes.size() && submeshes[i].texture == texture; i++)
+			{
+				count += submeshes[i].indexCount;
+				meshletCount += submeshes[i].meshletCount;
 			}
 
-			printf("  face[%ld].material_id = %d\n", static_cast<long>(f),
-				shapes[i].mesh.material_ids[f]);
-			printf("  face[%ld].smoothing_group_id = %d\n", static_cast<long>(f),
-				shapes[i].mesh.smoothing_group_ids[f]);
-
-			index_offset += fnum;
-		}
-
-		printf("shape[%ld].num_tags: %lu\n", static_cast<long>(i),
-			static_cast<unsigned long>(shapes[i].mesh.tags.size()));
-		for (size_t t = 0; t < shapes[i].mesh.tags.size(); t++) {
-			printf("  tag[%ld] = %s ", static_cast<long>(t),
-				shapes[i].mesh.tags[t].name.c_str());
-			printf(" ints: [");
-			for (size_t j = 0; j < shapes[i].mesh.tags[t].intValues.size(); ++j) {
-				printf("%ld", static_cast<long>(shapes[i].mesh.tags[t].intValues[j]));
-				if (j < (shapes[i].mesh.tags[t].intValues.size() - 1)) {
-					printf(", ");
-				}
-			}
-			printf("]");
-
-			printf(" floats: [");
-			for (size_t j = 0; j < shapes[i].mesh.tags[t].floatValues.size(); ++j) {
-				printf("%f", static_cast<const double>(
-					shapes[i].mesh.tags[t].floatValues[j]));
-				if (j < (shapes[i].mesh.tags[t].floatValues.size() - 1)) {
-					printf(", ");
-				}
+			if (!culled)
+			{
+				if (texture) glBindTexture(GL_TEXTURE_2D, texture);
+				glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(first * sizeof(GLuint)));
+				continue;
 			}
-			printf("]");
 
-			printf(" strings: [");
-			for (size_t j = 0; j < shapes[i].mesh.tags[t].stringValues.size(); ++j) {
-				printf("%s", shapes[i].mesh.tags[t].stringValues[j].c_str());
-				if (j < (shapes[i].mesh.tags[t].stringValues.size() - 1)) {
-					printf(", ");
+			// Visible meshlets that follow each other in the element buffer are drawn as one range
+			drawCounts.clear();
+			drawOffsets.clear();
+			for (GLuint m = firstMeshlet; m < firstMeshlet + meshletCount; m++)
+			{
+				if (!meshletVisible[m]) continue;
+				if (m > firstMeshlet && meshletVisible[m - 1])
+				{
+					drawCounts.back() += meshlets.indexCount[m];
+					continue;
 				}
+				drawCounts.push_back(meshlets.indexCount[m]);
+				drawOffsets.push_back((const GLvoid*)(meshlets.firstIndex[m] * sizeof(GLuint)));
 			}
-			printf("]");
-			printf("\n");
+			if (drawCounts.empty()) continue;
+
+			if (texture) glBindTexture(GL_TEXTURE_2D, texture);
+			glMultiDrawElements(GL_TRIANGLES, &drawCounts[0], GL_UNSIGNED_INT, &drawOffsets[0], (GLsizei)drawCounts.size());
 		}
 	}
 
-	for (size_t i = 0; i < materials.size(); i++) {
-		printf("material[%ld].name = %s\n", static_cast<long>(i),
-			materials[i].name.c_str());
-		printf("  material.Ka = (%f, %f ,%f)\n",
-			static_cast<const double>(materials[i].ambient[0]),
-			static_cast<const double>(materials[i].ambient[1]),
-			static_cast<const double>(materials[i].ambient[2]));
-		printf("  material.Kd = (%f, %f ,%f)\n",
-			static_cast<const double>(materials[i].diffuse[0]),
-			static_cast<const double>(materials[i].diffuse[1]),
-			static_cast<const double>(materials[i].diffuse[2]));
-		printf("  material.Ks = (%f, %f ,%f)\n",
-			static_cast<const double>(materials[i].specular[0]),
-			static_cast<const double>(materials[i].specular[1]),
-			static_cast<const double>(materials[i].specular[2]));
-		printf("  material.Tr = (%f, %f ,%f)\n",
-			static_cast<const double>(materials[i].transmittance[0]),
-			static_cast<const double>(materials[i].transmittance[1]),
-			static_cast<const double>(materials[i].transmittance[2]));
-		printf("  material.Ke = (%f, %f ,%f)\n",
-			static_cast<const double>(materials[i].emission[0]),
-			static_cast<const double>(materials[i].emission[1]),
-			static_cast<const double>(materials[i].emission[2]));
-		printf("  material.Ns = %f\n",
-			static_cast<const double>(materials[i].shininess));
-		printf("  material.Ni = %f\n", static_cast<const double>(materials[i].ior));
-		printf("  material.dissolve = %f\n",
-			static_cast<const double>(materials[i].dissolve));
-		printf("  material.illum = %d\n", materials[i].illum);
-		printf("  material.map_Ka = %s\n", materials[i].ambient_texname.c_str());
-		printf("  material.map_Kd = %s\n", materials[i].diffuse_texname.c_str());
-		printf("  material.map_Ks = %s\n", materials[i].specular_texname.c_str());
-		printf("  material.map_Ns = %s\n",
-			materials[i].specular_highlight_texname.c_str());
-		printf("  material.map_bump = %s\n", materials[i].bump_texname.c_str());
-		printf("    bump_multiplier = %f\n", static_cast<const double>(materials[i].bump_texopt.bump_multiplier));
-		printf("  material.map_d = %s\n", materials[i].alpha_texname.c_str());
-		printf("  material.disp = %s\n", materials[i].displacement_texname.c_str());
-		printf("  <<PBR>>\n");
-		printf("  material.Pr     = %f\n", static_cast<const double>(materials[i].roughness));
-		printf("  material.Pm     = %f\n", static_cast<const double>(materials[i].metallic));
-		printf("  material.Ps     = %f\n", static_cast<const double>(materials[i].sheen));
-		printf("  material.Pc     = %f\n", static_cast<const double>(materials[i].clearcoat_thickness));
-		printf("  material.Pcr    = %f\n", static_cast<const double>(materials[i].clearcoat_thickness));
-		printf("  material.aniso  = %f\n", static_cast<const double>(materials[i].anisotropy));
-		printf("  material.anisor = %f\n", static_cast<const double>(materials[i].anisotropy_rotation));
-		printf("  material.map_Ke = %s\n", materials[i].emissive_texname.c_str());
-		printf("  material.map_Pr = %s\n", materials[i].roughness_texname.c_str());
-		printf("  material.map_Pm = %s\n", materials[i].metallic_texname.c_str());
-		printf("  material.map_Ps = %s\n", materials[i].sheen_texname.c_str());
-		printf("  material.norm   = %s\n", materials[i].normal_texname.c_str());
-		map<string, string>::const_iterator it(
-			materials[i].unknown_parameter.begin());
-		map<string, string>::const_iterator itEnd(
-			materials[i].unknown_parameter.end());
-
-		for (; it != itEnd; it++) {
-			printf("  material.%s = %s\n", it->first.c_str(), it->second.c_str());
-		}
-		printf("\n");
+	// A cull only applies to the draw after it
+	culled = false;
+}
+
+/* Work out which meshlets the next drawObject() needs to draw, and return how many triangles
+   that is. modelView is the matrix that the shaders get, including positionTransform(). Only
+   cull back faces if the application has GL_CULL_FACE on, with counter-clockwise front faces */
+GLuint TinyObjLoader::cull(const mat4 &modelView, const mat4 &projection, bool backfaces)
+{
+	if (meshlets.size() == 0) return numPIndexes / 3;
+
+	MeshletCullView view = makeCullView(modelView, projection, backfaces);
+	cullMeshlets(meshlets, view, &meshletVisible[0]);
+	culled = true;
+
+	GLuint triangles = 0;
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		if (meshletVisible[m]) triangles += meshlets.indexCount[m] / 3;
 	}
+	return triangles;
 }
\ No newline at end of file
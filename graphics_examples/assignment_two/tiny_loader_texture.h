@@ -1,6 +1,18 @@
 /* tiny_loader_texture.h
 Example class to demonstrate the use of TinyObjectLoader to load an obj (WaveFront)
 object file with normals and texture coordinates, and copy the data into vertex, normal texture coordinate buffers.
+The file is streamed: faces are welded into shared vertices as they are read, so the mesh is only
+held once in memory before it is uploaded to a single interleaved vertex buffer and an element buffer.
+Faces are grouped by material into submeshes, and each material's map_Kd texture is loaded through
+a texture cache that all of the loaded objects share.
+The vertices can be quantised (see vertex_quantiser.h). Quantised positions are relative to the
+mesh's bounding box, so the model matrix must be multiplied by positionTransform(), and the normals
+are octahedral, so the vertex shader must decode them when octahedralNormals() is true.
+Each submesh is split into meshlets (see meshlets.h). Calling cull() before drawObject() makes
+that draw skip the meshlets that can't be seen.
+Faces without normals in the file get smooth ones (see mesh_normals.h), split at the obj file's
+smoothing groups and at edges sharper than the crease angle. A crease angle of 180 degrees
+leaves it to the smoothing groups.
 
 Iain Martin November 2018
 */
@@ -8,6 +20,8 @@ Iain Martin November 2018
 #pragma once
 
 #include "wrapper_glfw.h"
+#include "vertex_quantiser.h"
+#include "meshlets.h"
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -17,22 +31,57 @@ public:
 	TinyObjLoader();
 	~TinyObjLoader();
 
-	void load_obj(std::string inputfile, bool debugPrint = false);
+	void load_obj(std::string inputfile, bool debugPrint = false, VertexFormat format = VERTEX_FLOAT);
 	void drawObject(int drawmode);
+	GLuint cull(const glm::mat4 &modelView, const glm::mat4 &projection, bool backfaces);
+
+	glm::mat4 positionTransform() const { return dequantise; }
+	glm::vec4 boundingSphere() const { return bounds; }		// centre and radius, in the obj file's space
+	glm::vec3 boundsLower() const { return boxLower; }		// corners of the bounding box, in the obj file's space
+	glm::vec3 boundsUpper() const { return boxUpper; }
+	bool octahedralNormals() const { return vertexFormat != VERTEX_FLOAT; }
+	void setCreaseAngle(GLfloat degrees) { creaseAngle = degrees; }		// for files without normals, before load_obj
+
+	/* A range of the element buffer with one material */
+	struct Submesh
+	{
+		int material;			// index in the obj file's materials, -1 for faces without one
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLuint texture;			// the material's map_Kd, 0 to use the texture that is already bound
+		GLuint firstMeshlet;
+		GLuint meshletCount;
+	};
 
 private:
 	// Define vertex buffer object names (e.g as globals)
-	GLuint positionBufferObject;
-	GLuint normalBufferObject;
-	GLuint texCoordsObject;
+	GLuint vertexBufferObject;		// interleaved position, normal and texture coordinate
+	GLuint elementBufferObject;
 
 	GLuint attribute_v_coord;
 	GLuint attribute_v_normal;
 	GLuint attribute_v_texcoord;
 
+	// Layout of the vertex buffer
+	VertexFormat vertexFormat;
+	GLsizei vertexSize;
+	GLuint normalOffset, texcoordOffset;
+	GLenum normalType, texcoordType;
+	glm::mat4 dequantise;
+	glm::vec4 bounds;
+	glm::vec3 boxLower, boxUpper;
+	GLfloat creaseAngle;
+
 	int drawmode;
 	GLuint numVertices;
-	GLuint numNormals;
-	GLint  numTexCoords;
 	GLuint numPIndexes;
+
+	std::vector<Submesh> submeshes;		// ordered by texture, untextured first
+
+	// Meshlets, in the space of the vertex buffer, and the result of the last cull()
+	MeshletSet meshlets;
+	std::vector<unsigned char> meshletVisible;
+	bool culled;
+	std::vector<GLsizei> drawCounts;
+	std::vector<const GLvoid*> drawOffsets;
 };
@@ -0,0 +1,93 @@
+/* bench_drawlists.cpp
+ Records a grid of instances into draw lists the way assignment_two records its scene: the
+ batch kernels transform each run of instances, a bounding sphere test culls them and the
+ rest become draw packets, which are then merged and sorted. Reports the time with 1, 2, 4
+ and all of the hardware threads, and checks that each gives the same packets in the same order.
+*/
+
+#include "benchmarks.h"
+#include "draw_lists.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+static const int repeats = 5;
+
+void benchDrawRecording(size_t instances)
+{
+	cout << "Draw recording: " << instances << " instances, transformed, culled, merged and sorted" << endl;
+
+	// A square grid of instances on the ground, seen from above one corner
+	TransformBatch batch;
+	size_t side = 1;
+	while (side * side < instances) side++;
+	for (size_t i = 0; i < instances; i++)
+	{
+		batch.add(vec3((float)(i % side), 0.f, -(float)(i / side)), vec3(0.f, (float)(i % 360), 0.f), vec3(0.5f));
+	}
+
+	DrawView view;
+	view.set(lookAt(vec3(-2.f, 10.f, 5.f), vec3(side * 0.5f, 0.f, -(float)side * 0.5f), vec3(0, 1, 0)),
+		perspective(radians(60.f), 4.f / 3.f, 0.1f, 1000.f));
+	vec4 sphere(0.f, 0.f, 0.f, 1.f);
+
+	DrawRecorder::Visit visit = [&](size_t first, size_t last, DrawList &list)
+	{
+		size_t count = last - first;
+		list.scratch.resize(count);
+		batchTransform(batch, first, count, view.view, view.projection, &list.scratch[0], sizeof(ObjectTransforms),
+			batchTransformBestPath());
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!view.visible(list.scratch[i].model, sphere)) continue;
+			unsigned int item = (unsigned int)(first + i);
+			list.add(item, item % 16, item % 4, item % 8, list.scratch[i]);
+		}
+	};
+
+	unsigned int hardware = thread::hardware_concurrency();
+	unsigned int counts[4] = { 1, 2, 4, hardware ? hardware : 1 };
+	vector<DrawPacket> reference;
+	double single = 0;
+
+	cout << fixed << setprecision(3);
+	for (int c = 0; c < 4; c++)
+	{
+		if (c == 3 && counts[3] <= 4) break;
+
+		DrawRecorder recorder;
+		recorder.makeRecorder(counts[c]);
+		double best = 1e30;
+		for (int r = 0; r < repeats; r++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			recorder.record(instances, 256, visit);
+			double time = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+			if (time < best) best = time;
+		}
+
+		bool same = true;
+		if (c == 0)
+		{
+			reference = recorder.packets;
+			single = best;
+		}
+		else
+		{
+			same = (recorder.packets.size() == reference.size());
+			for (size_t p = 0; same && p < reference.size(); p++)
+			{
+				same = (recorder.packets[p].key == reference[p].key && recorder.packets[p].item == reference[p].item);
+			}
+		}
+
+		cout << "  " << setw(2) << counts[c] << " threads " << setw(9) << best << " ms, " << setw(6) << setprecision(2)
+			<< single / best << "x, " << recorder.packets.size() << " packets" << (same ? "" : ", DIFFERENT ORDER")
+			<< setprecision(3) << endl;
+	}
+}
@@ -0,0 +1,82 @@
+/* bench_lightclusters.cpp
+ Sorts 256, 1024 and 4096 point lights into a 16 x 9 x 24 cluster grid, one cluster test at
+ a time and four at a time with SSE2, on one thread and on all of them. Also reports how
+ many lights each lit cluster has to loop over, against the lights a forward shader without
+ clusters would loop over for every pixel.
+*/
+
+#include "benchmarks.h"
+#include "light_clusters.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+static const int repeats = 5;
+
+static double timeBuild(LightClusterGrid &grid, const vector<PointLight> &lights, const mat4 &view, const mat4 &projection,
+	JobPool *pool, bool simd)
+{
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		grid.build(&lights[0], lights.size(), view, projection, pool, simd);
+		double time = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		if (time < best) best = time;
+	}
+	return best;
+}
+
+void benchLightClustering()
+{
+	cout << "Light clustering: 16 x 9 x 24 clusters" << endl;
+
+	// The ground of assignment_two, seen from where its camera starts
+	mat4 view = lookAt(vec3(0.f, 4.f, 12.f), vec3(0.f, 0.f, 0.f), vec3(0, 1, 0));
+	mat4 projection = perspective(radians(30.f), 4.f / 3.f, 0.1f, 100.f);
+
+	JobPool pool;
+	pool.makePool();
+
+	const size_t counts[3] = { 256, 1024, 4096 };
+	cout << fixed << setprecision(3);
+	for (int c = 0; c < 3; c++)
+	{
+		mt19937 random(1);
+		uniform_real_distribution<float> unit(0.f, 1.f);
+		vector<PointLight> lights(counts[c]);
+		for (size_t i = 0; i < lights.size(); i++)
+		{
+			lights[i].position = vec3(unit(random) * 60.f - 30.f, 0.2f + unit(random) * 0.6f, unit(random) * 50.f - 20.f);
+			lights[i].radius = 1.f + unit(random) * 1.5f;
+			lights[i].colour = vec3(unit(random), unit(random), unit(random));
+			lights[i].intensity = 1.f;
+		}
+
+		LightClusterGrid scalar, simd, threaded;
+		double scalarTime = timeBuild(scalar, lights, view, projection, NULL, false);
+		double simdTime = timeBuild(simd, lights, view, projection, NULL, true);
+		double threadedTime = timeBuild(threaded, lights, view, projection, &pool, true);
+
+		bool same = (scalar.cells == simd.cells && scalar.indices == simd.indices
+			&& scalar.cells == threaded.cells && scalar.indices == threaded.indices);
+
+		size_t lit = 0;
+		for (unsigned int cell = 0; cell < scalar.clusterCount(); cell++)
+		{
+			if (scalar.cells[cell * 2 + 1]) lit++;
+		}
+
+		cout << "  " << setw(4) << lights.size() << " lights: scalar " << setw(7) << scalarTime << " ms, SSE2 "
+			<< setw(7) << simdTime << " ms, SSE2 on " << pool.size() << " threads " << setw(7) << threadedTime << " ms"
+			<< (same ? "" : ", DIFFERENT LISTS") << endl;
+		cout << "        " << setprecision(1) << (lit ? (double)scalar.indices.size() / lit : 0.0)
+			<< " lights a lit cluster against " << lights.size() << " without clusters, " << lit << " of "
+			<< scalar.clusterCount() << " clusters lit" << setprecision(3) << endl;
+	}
+}
@@ -0,0 +1,438 @@
+/* bench_meshbuild.cpp
+ Builds a mix of spheres, cubes, cylinders and tetrahedra three ways, with each buffer object's
+ glBufferData stood in for by copying the data into storage of the buffer's own, which is what
+ the driver does with it:
+  - the shape classes before they used MeshBuilder: the code of their make functions, with new[]
+    and stack temporaries and three to five buffers for each object
+  - the shape classes now: one builder shared by every object of a class, reset for each, and one
+    buffer for each object as MeshBatch uploads it
+  - every object in one builder, reset and reused, and one buffer for them all. The first build
+    reserves the totals up front, so what it takes over a reused build is the memory being touched
+    for the first time
+ The cylinders have the 100 steps around that the Cylinder class has always used.
+*/
+
+#include "benchmarks.h"
+#include "mesh_builder.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+static const int repeats = 5;
+static const unsigned int numlats = 20, numlongs = 20, definition = 100;
+
+typedef vector<vector<unsigned char> > Buffers;
+
+static double milliseconds(chrono::high_resolution_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+/* What glBufferData does with the data it is given */
+static void bufferData(Buffers &buffers, const void *data, size_t bytes)
+{
+	buffers.push_back(vector<unsigned char>((const unsigned char*)data, (const unsigned char*)data + bytes));
+}
+
+/* Sphere::makeSphere and makeUnitSphere as they were */
+static void oldSphere(Buffers &buffers)
+{
+	unsigned int i, j;
+	unsigned int numvertices = 2 + ((numlats - 1) * numlongs);
+	float* pVertices = new float[numvertices * 3];
+	float* pColours = new float[numvertices * 4];
+
+	float DEG_TO_RADIANS = 3.141592f / 180.f;
+	unsigned int vnum = 0;
+	pVertices[0] = 0; pVertices[1] = 0; pVertices[2] = 1.f;
+	vnum++;
+	float latstep = 180.f / numlats;
+	float longstep = 360.f / numlongs;
+	for (int ring = 1; ring < (int)numlats; ring++)
+	{
+		float lat_radians = (90.f - ring * latstep) * DEG_TO_RADIANS;
+		for (int step = 0; step < (int)numlongs; step++)
+		{
+			float lon_radians = (-180.f + step * longstep) * DEG_TO_RADIANS;
+			pVertices[vnum * 3] = cos(lat_radians) * cos(lon_radians);
+			pVertices[vnum * 3 + 1] = cos(lat_radians) * sin(lon_radians);
+			pVertices[vnum * 3 + 2] = sin(lat_radians);
+			vnum++;
+		}
+	}
+	pVertices[vnum * 3] = 0; pVertices[vnum * 3 + 1] = 0; pVertices[vnum * 3 + 2] = -1.f;
+
+	for (i = 0; i < numvertices; i++)
+	{
+		pColours[i * 4] = pVertices[i * 3];
+		pColours[i * 4 + 1] = pVertices[i * 3 + 1];
+		pColours[i * 4 + 2] = pVertices[i * 3 + 2];
+		pColours[i * 4 + 3] = 1.f;
+	}
+	bufferData(buffers, pVertices, sizeof(float) * numvertices * 3);
+	bufferData(buffers, pVertices, sizeof(float) * numvertices * 3);
+	bufferData(buffers, pColours, sizeof(float) * numvertices * 4);
+
+	unsigned int numindices = ((numlongs * 2) + 2) * (numlats - 1) + ((numlongs + 2) * 2);
+	unsigned int* pindices = new unsigned int[numindices];
+	unsigned int index = 0;
+	for (i = 0; i < numlongs + 1; i++) pindices[index++] = i;
+	pindices[index++] = 1;
+	unsigned int start = 1;
+	for (j = 0; j < numlats - 2; j++)
+	{
+		for (i = 0; i < numlongs; i++)
+		{
+			pindices[index++] = start + i;
+			pindices[index++] = start + i + numlongs;
+		}
+		pindices[index++] = start;
+		pindices[index++] = start + numlongs;
+		start += numlongs;
+	}
+	for (i = numvertices - 1; i > (numvertices - numlongs - 2); i--) pindices[index++] = i;
+	pindices[index] = numvertices - 2;
+	bufferData(buffers, pindices, numindices * sizeof(unsigned int));
+
+	delete[] pindices;
+	delete[] pColours;
+	delete[] pVertices;
+}
+
+/* Cube::makeCube as it was */
+static void oldCube(Buffers &buffers)
+{
+	/* Define vertices for a cube in 12 triangles */
+	float vertexPositions[] =
+	{
+		-0.25f, 0.25f, -0.25f,
+		-0.25f, -0.25f, -0.25f,
+		0.25f, -0.25f, -0.25f,
+
+		0.25f, -0.25f, -0.25f,
+		0.25f, 0.25f, -0.25f,
+		-0.25f, 0.25f, -0.25f,
+
+		0.25f, -0.25f, -0.25f,
+		0.25f, -0.25f, 0.25f,
+		0.25f, 0.25f, -0.25f,
+
+		0.25f, -0.25f, 0.25f,
+		0.25f, 0.25f, 0.25f,
+		0.25f, 0.25f, -0.25f,
+
+		0.25f, -0.25f, 0.25f,
+		-0.25f, -0.25f, 0.25f,
+		0.25f, 0.25f, 0.25f,
+
+		-0.25f, -0.25f, 0.25f,
+		-0.25f, 0.25f, 0.25f,
+		0.25f, 0.25f, 0.25f,
+
+		-0.25f, -0.25f, 0.25f,
+		-0.25f, -0.25f, -0.25f,
+		-0.25f, 0.25f, 0.25f,
+
+		-0.25f, -0.25f, -0.25f,
+		-0.25f, 0.25f, -0.25f,
+		-0.25f, 0.25f, 0.25f,
+
+		-0.25f, -0.25f, 0.25f,
+		0.25f, -0.25f, 0.25f,
+		0.25f, -0.25f, -0.25f,
+
+		0.25f, -0.25f, -0.25f,
+		-0.25f, -0.25f, -0.25f,
+		-0.25f, -0.25f, 0.25f,
+
+		-0.25f, 0.25f, -0.25f,
+		0.25f, 0.25f, -0.25f,
+		0.25f, 0.25f, 0.25f,
+
+		0.25f, 0.25f, 0.25f,
+		-0.25f, 0.25f, 0.25f,
+		-0.25f, 0.25f, -0.25f,
+	};
+
+	/* Manually specified colours for our cube */
+	float vertexColours[] = {
+		0.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+
+		1.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f,
+
+		1.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 0.0f, 1.0f,
+
+		1.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+
+		0.0f, 1.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 1.0f, 1.0f,
+	};
+
+	/* Manually specified normals for our cube */
+	float normals[] =
+	{
+		0, 0, -1.f, 0, 0, -1.f, 0, 0, -1.f,
+		0, 0, -1.f, 0, 0, -1.f, 0, 0, -1.f,
+		1.f, 0, 0, 1.f, 0, 0, 1.f, 0, 0,
+		1.f, 0, 0, 1.f, 0, 0, 1.f, 0, 0,
+		0, 0, 1.f, 0, 0, 1.f, 0, 0, 1.f,
+		0, 0, 1.f, 0, 0, 1.f, 0, 0, 1.f,
+		-1.f, 0, 0, -1.f, 0, 0, -1.f, 0, 0,
+		-1.f, 0, 0, -1.f, 0, 0, -1.f, 0, 0,
+		0, -1.f, 0, 0, -1.f, 0, 0, -1.f, 0,
+		0, -1.f, 0, 0, -1.f, 0, 0, -1.f, 0,
+		0, 1.f, 0, 0, 1.f, 0, 0, 1.f, 0,
+		0, 1.f, 0, 0, 1.f, 0, 0, 1.f, 0,
+	};
+
+	bufferData(buffers, vertexPositions, sizeof(vertexPositions));
+	bufferData(buffers, vertexColours, sizeof(vertexColours));
+	bufferData(buffers, normals, sizeof(normals));
+}
+
+/* Cylinder::makeCylinder and defineVertices as they were */
+static void oldCylinder(Buffers &buffers, glm::vec3 colour)
+{
+	const float PI = 3.141592653589f;
+	const float radius = 1.0f, length = 1.0f;
+	const unsigned int numberOfvertices = definition * 4 + 2;
+	glm::vec3 vertices[402];
+	glm::vec3 normals[402];
+	glm::vec3 colours[402];
+
+	float halfLength = length / 2;
+	vertices[0] = glm::vec3(0, halfLength, 0);
+	normals[0] = glm::vec3(0.0, 1.0, 0.0);
+	colours[0] = colour;
+	for (int i = 1; i < (int)definition + 1; i++)
+	{
+		float theta = (2 * PI) / definition * i;
+		vertices[i] = glm::vec3(radius * cos(theta), halfLength, radius * sin(theta));
+		normals[i] = glm::vec3(0.0, 1.0, 0.0);
+		colours[i] = colour;
+	}
+	vertices[101] = glm::vec3(0, -halfLength, 0);
+	normals[101] = glm::vec3(0.0, -1.0, 0.0);
+	colours[101] = colour;
+	for (int i = 102; i < (int)(definition * 2) + 2; i++)
+	{
+		float theta = (2 * PI) / definition * (i - 102);
+		vertices[i] = glm::vec3(radius * cos(theta), -halfLength, radius * sin(theta));
+		normals[i] = glm::vec3(0.0, -1.0, 0.0);
+		colours[i] = colour;
+	}
+	int top = 1;
+	int bottom = 102;
+	for (int i = ((definition * 2) + 2); i < (int)numberOfvertices; i += 2)
+	{
+		vertices[i] = vertices[top];
+		normals[i] = glm::vec3(vertices[top].x, 0.0, vertices[top].z);
+		colours[i] = colour;
+		vertices[i + 1] = vertices[bottom];
+		normals[i + 1] = glm::vec3(vertices[bottom].x, 0.0, vertices[bottom].z);
+		colours[i + 1] = colour;
+		top++;
+		bottom++;
+	}
+	bufferData(buffers, &vertices[0], sizeof(glm::vec3) * numberOfvertices);
+	bufferData(buffers, &normals[0], sizeof(glm::vec3) * numberOfvertices);
+	bufferData(buffers, &colours[0], sizeof(glm::vec3) * numberOfvertices);
+
+	unsigned int pindices[406];
+	for (int i = 0; i < 101; i++) pindices[i] = i;
+	pindices[101] = 1;
+	for (int i = 102; i < 203; i++) pindices[i] = i - 1;
+	pindices[203] = 102;
+	for (int i = 204; i < 404; i++) pindices[i] = i - 2;
+	pindices[404] = 202;
+	pindices[405] = 203;
+	bufferData(buffers, pindices, sizeof(pindices));
+}
+
+/* Tetrahedron::defineTetrahedron as it was */
+static void oldTetrahedron(Buffers &buffers)
+{
+	const int numvertices = 12;
+	glm::vec3 tetra_normals[12];
+
+	// Define vertices as glm:vec3 type to make it easier to calculate normals
+	glm::vec3 tetra_vertices[] = {
+		glm::vec3(0, 0.577f, 0), glm::vec3(-0.5f, 0, 0.289f), glm::vec3(0.5f, 0, 0.289f),
+		glm::vec3(0, 0.577f, 0), glm::vec3(0.5f, 0, 0.289f), glm::vec3(0, 0, -0.289f),
+		glm::vec3(0.5f, 0, 0.289f), glm::vec3(-0.5f, 0, 0.289f), glm::vec3(0, 0, -0.289f),
+		glm::vec3(0, 0.577f, 0), glm::vec3(0, 0, -0.289f), glm::vec3(-0.5f, 0, 0.289f)
+	};
+	bufferData(buffers, &tetra_vertices[0], numvertices * sizeof(glm::vec3));
+
+	/* Define twelve colours for the four flat shaded object */
+	float tetra_colours[] = {
+		0.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 1.0f, 0.0f, 1.0f };
+	bufferData(buffers, &tetra_colours[0], numvertices * sizeof(float) * 4);
+
+	for (int v = 0; v < numvertices; v += 3)
+	{
+		glm::vec3 normal = glm::cross(tetra_vertices[v + 1] - tetra_vertices[v], tetra_vertices[v + 2] - tetra_vertices[v]);
+		tetra_normals[v] = tetra_normals[v + 1] = tetra_normals[v + 2] = normal;
+	}
+	bufferData(buffers, &tetra_normals[0], numvertices * sizeof(glm::vec3));
+}
+
+/* Add the i'th object of the mix: spheres, cubes, cylinders and tetrahedra in turn */
+static unsigned int addShape(MeshBuilder &builder, size_t i)
+{
+	switch (i % 4)
+	{
+	case 0: return builder.addSphere(numlats, numlongs);
+	case 1: return builder.addCube();
+	case 2: return builder.addCylinder(definition, glm::vec3(1.f));
+	default: return builder.addTetrahedron();
+	}
+}
+
+/* What MeshBatch::upload does: one buffer, the vertices followed by the indices */
+static void uploadBatch(Buffers &buffers, const MeshBuilder &builder)
+{
+	size_t vertexBytes = builder.vertices.size() * sizeof(MeshVertex);
+	size_t indexBytes = builder.indices.size() * sizeof(unsigned int);
+	const unsigned char *vertices = (const unsigned char*)&builder.vertices[0], *indices = (const unsigned char*)&builder.indices[0];
+	buffers.push_back(vector<unsigned char>());
+	buffers.back().reserve(vertexBytes + indexBytes);
+	buffers.back().insert(buffers.back().end(), vertices, vertices + vertexBytes);
+	buffers.back().insert(buffers.back().end(), indices, indices + indexBytes);
+}
+
+static size_t bufferBytes(const Buffers &buffers)
+{
+	size_t bytes = 0;
+	for (size_t b = 0; b < buffers.size(); b++) bytes += buffers[b].size();
+	return bytes;
+}
+
+void benchMeshBuilding(size_t objects)
+{
+	cout << "Mesh building: " << objects << " spheres, cubes, cylinders and tetrahedra, with their buffers' data copied"
+		<< " as glBufferData would" << endl;
+
+	Buffers buffers;
+	buffers.reserve(objects * 5);
+
+	// The classes before, each object making its own temporaries and buffers
+	double before = 1e30;
+	size_t beforeBuffers = 0, beforeBytes = 0;
+	for (int r = 0; r < repeats; r++)
+	{
+		buffers.clear();
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < objects; i++)
+		{
+			switch (i % 4)
+			{
+			case 0: oldSphere(buffers); break;
+			case 1: oldCube(buffers); break;
+			case 2: oldCylinder(buffers, glm::vec3(1.f)); break;
+			default: oldTetrahedron(buffers);
+			}
+		}
+		before = std::min(before, milliseconds(start));
+		beforeBuffers = buffers.size();
+		beforeBytes = bufferBytes(buffers);
+	}
+
+	// The classes now, with a builder for each class that every object of it resets and reuses
+	double now = 1e30;
+	size_t nowBytes = 0, vertexTotal = 0, indexTotal = 0;
+	MeshBuilder classBuilders[4];
+	for (int r = 0; r < repeats; r++)
+	{
+		buffers.clear();
+		vertexTotal = indexTotal = 0;
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < objects; i++)
+		{
+			MeshBuilder &builder = classBuilders[i % 4];
+			builder.reset();
+			addShape(builder, i);
+			uploadBatch(buffers, builder);
+			vertexTotal += builder.vertices.size();
+			indexTotal += builder.indices.size();
+		}
+		now = std::min(now, milliseconds(start));
+		nowBytes = bufferBytes(buffers);
+	}
+
+	// Every object in one builder and one buffer. The totals are known, so the first build reserves
+	// them all at once rather than growing the arrays as it goes
+	MeshBuilder shared;
+	double first = 0, reused = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		buffers.clear();
+		shared.reset();
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		if (r == 0) shared.reserve(vertexTotal, indexTotal);
+		for (size_t i = 0; i < objects; i++) addShape(shared, i);
+		uploadBatch(buffers, shared);
+		double time = milliseconds(start);
+		if (r == 0) first = time;
+		else if (time < reused) reused = time;
+	}
+	size_t sharedBytes = bufferBytes(buffers);
+
+	cout << fixed << setprecision(3);
+	cout << "  classes before   " << setw(9) << before << " ms, " << setw(6) << beforeBuffers << " buffer objects, "
+		<< beforeBytes / 1024 << " KB" << endl;
+	cout << "  classes now      " << setw(9) << now << " ms, " << setw(6) << objects << " buffer objects, "
+		<< nowBytes / 1024 << " KB" << endl;
+	cout << "  one builder      " << setw(9) << first << " ms the first time, " << setw(9) << reused << " ms reused, "
+		<< "1 buffer object, " << sharedBytes / 1024 << " KB" << endl;
+	recordResult("meshbuild/classes_before", repeats, before, (double)objects, 0, beforeBytes);
+	recordResult("meshbuild/classes_now", repeats, now, (double)objects, 0, nowBytes);
+	recordResult("meshbuild/builder_first", 1, first, (double)objects, 0, sharedBytes);
+	recordResult("meshbuild/builder_reused", repeats - 1, reused, (double)objects, 0, sharedBytes);
+}
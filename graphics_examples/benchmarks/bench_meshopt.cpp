@@ -0,0 +1,380 @@
+/* bench_meshopt.cpp
+ Runs the mesh optimiser over each model the way TinyObjLoader does at load time and
+ reports what it did: ACMR and ATVR for a 16 entry FIFO post-transform cache, and the
+ vertex memory read per vertex used, for the face order in the file, after the vertex
+ cache optimisation, after the overdraw clustering and after the vertex fetch reorder.
+ Then quantises each model's vertices in both compact formats and reports the error
+ against the float vertices, and splits each model into meshlets to see how many of its
+ triangles the meshlet culling drops and how long the culling takes. Last of all the
+ normals are generated again from the positions, with one thread and with every core, and
+ compared with the normals in the file, and tangents are made for the welded vertices.
+*/
+
+#include "../assignment_two/tiny_obj_loader.h"
+#include "benchmarks.h"
+#include "mesh_optimiser.h"
+#include "vertex_quantiser.h"
+#include "meshlets.h"
+#include "mesh_normals.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+
+/* The same vertex layout as TinyObjLoader */
+struct BenchVertex
+{
+	float position[3];
+	float normal[3];
+	float texcoord[2];
+};
+
+/* Weld the corners of a loaded obj into shared vertices and triangle indices */
+static void weldMesh(const tinyobj::attrib_t &attrib, const vector<tinyobj::shape_t> &shapes,
+	vector<BenchVertex> &vertices, vector<unsigned int> &indices)
+{
+	map<unsigned long long, unsigned int> welded;
+	for (size_t s = 0; s < shapes.size(); s++)
+	{
+		for (size_t i = 0; i < shapes[s].mesh.indices.size(); i++)
+		{
+			tinyobj::index_t idx = shapes[s].mesh.indices[i];
+			unsigned long long key = ((unsigned long long)idx.vertex_index << 42) |
+				((unsigned long long)(idx.texcoord_index + 1) << 21) | (unsigned long long)(idx.normal_index + 1);
+
+			map<unsigned long long, unsigned int>::iterator found = welded.find(key);
+			if (found != welded.end())
+			{
+				indices.push_back(found->second);
+				continue;
+			}
+
+			BenchVertex vertex = {};
+			for (int c = 0; c < 3; c++) vertex.position[c] = attrib.vertices[idx.vertex_index * 3 + c];
+			if (idx.normal_index >= 0) for (int c = 0; c < 3; c++) vertex.normal[c] = attrib.normals[idx.normal_index * 3 + c];
+			if (idx.texcoord_index >= 0) for (int c = 0; c < 2; c++) vertex.texcoord[c] = attrib.texcoords[idx.texcoord_index * 2 + c];
+
+			unsigned int v = (unsigned int)vertices.size();
+			vertices.push_back(vertex);
+			welded[key] = v;
+			indices.push_back(v);
+		}
+	}
+}
+
+static double milliseconds(chrono::high_resolution_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+static void printStage(const char *stage, const vector<unsigned int> &indices, size_t vertexCount, double time)
+{
+	VertexCacheStats stats = analyseVertexCache(&indices[0], indices.size(), vertexCount);
+	float fetch = analyseVertexFetch(&indices[0], indices.size(), vertexCount, sizeof(BenchVertex));
+	cout << "    " << setw(10) << left << stage << right << "  ACMR " << setw(5) << stats.acmr << "  ATVR " << setw(5) << stats.atvr
+		<< "  fetch " << setw(5) << fetch;
+	if (time >= 0) cout << "  " << setw(7) << time << " ms";
+	cout << endl;
+}
+
+/* Load a model and weld it like TinyObjLoader does, false if it can't be loaded */
+static bool loadWelded(const string &file, vector<BenchVertex> &vertices, vector<unsigned int> &indices)
+{
+	tinyobj::attrib_t attrib;
+	vector<tinyobj::shape_t> shapes;
+	vector<tinyobj::material_t> materials;
+	string warn, err;
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, file.c_str())) return false;
+
+	weldMesh(attrib, shapes, vertices, indices);
+	return !indices.empty();
+}
+
+void benchMeshOptimisation(const vector<string> &models)
+{
+	cout << "Mesh optimisation: ACMR (transformed vertices per triangle), ATVR (per vertex) and vertex bytes read per byte used" << endl;
+	cout << fixed << setprecision(3);
+
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		vector<BenchVertex> vertices;
+		vector<unsigned int> indices;
+		if (!loadWelded(models[m], vertices, indices))
+		{
+			cout << "  can't open " << models[m] << endl;
+			continue;
+		}
+
+		string name = models[m].substr(models[m].find_last_of("/\\") + 1);
+		cout << "  " << name << ": " << indices.size() / 3 << " triangles, " << vertices.size() << " vertices" << endl;
+		printStage("file", indices, vertices.size(), -1);
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		optimiseVertexCache(&indices[0], indices.size(), vertices.size());
+		printStage("cache", indices, vertices.size(), milliseconds(start));
+
+		start = chrono::high_resolution_clock::now();
+		optimiseOverdraw(&indices[0], indices.size(), vertices[0].position, sizeof(BenchVertex), vertices.size());
+		printStage("overdraw", indices, vertices.size(), milliseconds(start));
+
+		start = chrono::high_resolution_clock::now();
+		optimiseVertexFetch(&vertices[0], sizeof(BenchVertex), vertices.size(), &indices[0], indices.size());
+		printStage("fetch", indices, vertices.size(), milliseconds(start));
+	}
+}
+
+void benchVertexQuantisation(const vector<string> &models)
+{
+	cout << "Vertex quantisation: error against the float vertices, " << sizeof(BenchVertex) << " bytes per float vertex" << endl;
+
+	VertexFormat formats[] = { VERTEX_QUANTISED, VERTEX_QUANTISED_FINE };
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		vector<BenchVertex> vertices;
+		vector<unsigned int> indices;
+		if (!loadWelded(models[m], vertices, indices)) continue;
+
+		string name = models[m].substr(models[m].find_last_of("/\\") + 1);
+		cout << "  " << name << ": " << vertices.size() << " vertices" << endl;
+		const BenchVertex &first = vertices[0];
+
+		for (int f = 0; f < 2; f++)
+		{
+			QuantisedVertices quantised;
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			quantiseVertices(first.position, first.normal, first.texcoord, sizeof(BenchVertex), vertices.size(), formats[f], quantised);
+			double time = milliseconds(start);
+			QuantisationError error = measureQuantisation(first.position, first.normal, first.texcoord, sizeof(BenchVertex),
+				vertices.size(), quantised);
+
+			cout << "    " << setw(2) << quantised.vertexSize << " bytes"
+				<< "  position " << scientific << setprecision(2) << error.positionRelative << fixed << " of bounds"
+				<< "  normal " << setprecision(3) << setw(6) << error.normalMaxDegrees << " max " << setw(6) << error.normalMeanDegrees << " mean degrees"
+				<< "  texcoord " << scientific << setprecision(2) << error.texcoordMax << fixed << (quantised.texcoordsHalf ? " half" : " unorm")
+				<< "  " << setprecision(3) << time << " ms" << endl;
+		}
+	}
+}
+
+/* Copy a meshlet set moved by offset */
+static void appendMeshlets(MeshletSet &to, const MeshletSet &from, glm::vec3 offset)
+{
+	for (size_t m = 0; m < from.size(); m++)
+	{
+		to.firstIndex.push_back(from.firstIndex[m]); to.indexCount.push_back(from.indexCount[m]);
+		to.centreX.push_back(from.centreX[m] + offset.x); to.centreY.push_back(from.centreY[m] + offset.y);
+		to.centreZ.push_back(from.centreZ[m] + offset.z); to.radius.push_back(from.radius[m]);
+		to.axisX.push_back(from.axisX[m]); to.axisY.push_back(from.axisY[m]); to.axisZ.push_back(from.axisZ[m]);
+		to.coneCos.push_back(from.coneCos[m]); to.coneSin.push_back(from.coneSin[m]);
+	}
+}
+
+static size_t visibleTriangles(const MeshletSet &meshlets, const vector<unsigned char> &visible)
+{
+	size_t triangles = 0;
+	for (size_t m = 0; m < meshlets.size(); m++) triangles += visible[m] ? meshlets.indexCount[m] / 3 : 0;
+	return triangles;
+}
+
+void benchMeshletCulling(const vector<string> &models)
+{
+	const int views = 64;
+	glm::mat4 projection = glm::perspective(glm::radians(30.0f), 1.3333f, 0.1f, 100.0f);
+
+	cout << "Meshlet culling: triangles drawn over " << views << " views from close to each model, frustum only and with back faces" << endl;
+
+	MeshletSet unit;		// every model's meshlets scaled to the same size, for the timing
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		vector<BenchVertex> vertices;
+		vector<unsigned int> indices;
+		if (!loadWelded(models[m], vertices, indices)) continue;
+
+		// In the order that TinyObjLoader leaves the triangles
+		optimiseVertexCache(&indices[0], indices.size(), vertices.size());
+		optimiseOverdraw(&indices[0], indices.size(), vertices[0].position, sizeof(BenchVertex), vertices.size());
+
+		MeshletSet meshlets;
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		buildMeshlets(meshlets, &indices[0], indices.size(), 0, vertices[0].position, sizeof(BenchVertex), vertices.size());
+		double buildTime = milliseconds(start);
+
+		glm::vec3 lo(1e30f), hi(-1e30f);
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			glm::vec3 p(vertices[v].position[0], vertices[v].position[1], vertices[v].position[2]);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+		glm::vec3 centre = (lo + hi) * 0.5f;
+		float size = glm::length(hi - lo) + 1e-6f;
+
+		// Circle the model close enough that only part of it is in view
+		glm::mat4 modelProjection = glm::perspective(glm::radians(30.0f), 1.3333f, size * 0.01f, size * 10.f);
+		vector<unsigned char> visible(meshlets.size());
+		size_t frustumTriangles = 0, backfaceTriangles = 0;
+		for (int v = 0; v < views; v++)
+		{
+			float angle = v * 6.2831853f / views;
+			glm::vec3 eye = centre + glm::vec3(sin(angle), 0.3f * cos(angle * 3.f), cos(angle)) * size * 0.6f;
+			glm::mat4 view = glm::lookAt(eye, centre + glm::vec3(0.f, 0.2f * size * sin(angle * 2.f), 0.f), glm::vec3(0, 1, 0));
+
+			cullMeshlets(meshlets, makeCullView(view, modelProjection, false), &visible[0]);
+			frustumTriangles += visibleTriangles(meshlets, visible);
+			cullMeshlets(meshlets, makeCullView(view, modelProjection, true), &visible[0]);
+			backfaceTriangles += visibleTriangles(meshlets, visible);
+		}
+
+		string name = models[m].substr(models[m].find_last_of("/\\") + 1);
+		double triangles = (double)indices.size() / 3 * views;
+		cout << "  " << setw(20) << left << name << right << setw(6) << meshlets.size() << " meshlets, "
+			<< setw(5) << setprecision(1) << indices.size() / 3.0 / meshlets.size() << " triangles each  drawn "
+			<< setw(5) << 100.0 * frustumTriangles / triangles << "% / " << setw(5) << 100.0 * backfaceTriangles / triangles << "%  build "
+			<< setprecision(3) << buildTime << " ms" << endl;
+
+		glm::vec3 scale(1.f / size);
+		for (size_t i = 0; i < meshlets.size(); i++)
+		{
+			meshlets.centreX[i] = (meshlets.centreX[i] - centre.x) * scale.x;
+			meshlets.centreY[i] = (meshlets.centreY[i] - centre.y) * scale.y;
+			meshlets.centreZ[i] = (meshlets.centreZ[i] - centre.z) * scale.z;
+			meshlets.radius[i] *= scale.x;
+		}
+		appendMeshlets(unit, meshlets, glm::vec3(0.f));
+	}
+	if (unit.size() == 0) return;
+
+	// A large scene: copies of every model on a grid around the camera
+	MeshletSet scene;
+	for (int x = -8; x < 8; x++)
+		for (int z = -8; z < 8; z++) appendMeshlets(scene, unit, glm::vec3(x * 1.5f, 0.f, z * 1.5f));
+
+	vector<unsigned char> visible(scene.size());
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f, 1.f, 0.f), glm::vec3(3.f, 0.f, -6.f), glm::vec3(0, 1, 0));
+	MeshletCullView cullView = makeCullView(view, projection, true);
+	unsigned int hardware = thread::hardware_concurrency();
+
+	cout << "  " << scene.size() << " meshlets in a grid of copies:" << endl;
+	for (int path = 0; path < 3; path++)
+	{
+		bool simd = (path > 0);
+		unsigned int threads = (path == 2) ? hardware : 1;
+		double best = 1e30;
+		size_t count = 0;
+		for (int r = 0; r < 20; r++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			count = cullMeshlets(scene, cullView, &visible[0], threads, simd);
+			double t = milliseconds(start);
+			if (t < best) best = t;
+		}
+		cout << "    " << (simd ? "SSE2  " : "scalar") << " " << setw(2) << threads << " thread" << (threads > 1 ? "s" : " ")
+			<< setw(8) << setprecision(3) << best << " ms  " << setw(6) << setprecision(2) << best * 1e6 / scene.size() << " ns/meshlet  "
+			<< count << " visible" << endl;
+	}
+}
+
+void benchNormalGeneration(const vector<string> &models)
+{
+	unsigned int cores = thread::hardware_concurrency();
+	if (cores < 1) cores = 1;
+	cout << "Normal generation: angle weighted with a 60 degree crease, and the error against the normals in the file at the" << endl
+		<< "crease the exporter used, leaving out triangles with no area" << endl;
+
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		tinyobj::attrib_t attrib;
+		vector<tinyobj::shape_t> shapes;
+		vector<tinyobj::material_t> materials;
+		string warn, err;
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, models[m].c_str())) continue;
+
+		// The position of every corner and the smoothing group of every triangle
+		vector<unsigned int> positionIndices, groups;
+		vector<int> normalIndices;
+		for (size_t s = 0; s < shapes.size(); s++)
+		{
+			for (size_t i = 0; i < shapes[s].mesh.indices.size(); i++)
+			{
+				positionIndices.push_back(shapes[s].mesh.indices[i].vertex_index);
+				normalIndices.push_back(shapes[s].mesh.indices[i].normal_index);
+			}
+			groups.insert(groups.end(), shapes[s].mesh.smoothing_group_ids.begin(), shapes[s].mesh.smoothing_group_ids.end());
+		}
+		if (positionIndices.empty()) continue;
+
+		vector<float> normals(positionIndices.size() * 3);
+		double times[2];
+		unsigned int threads[2] = { 1, cores };
+		for (int t = 0; t < 2; t++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			generateNormals(&attrib.vertices[0], attrib.vertices.size() / 3, &positionIndices[0], positionIndices.size(),
+				&groups[0], 60.f, &normals[0], WEIGHT_ANGLE, threads[t]);
+			times[t] = milliseconds(start);
+		}
+
+		// Exporters split smoothing groups at their own crease angle (Blender's auto smooth), so
+		// the error is taken at the crease that matches best. Triangles with no area have no normal
+		vector<bool> flat(positionIndices.size() / 3);
+		size_t flatCount = 0;
+		for (size_t f = 0; f < flat.size(); f++)
+		{
+			const float *p[3];
+			for (int c = 0; c < 3; c++) p[c] = &attrib.vertices[positionIndices[f * 3 + c] * 3];
+			glm::vec3 e1(p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]), e2(p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]);
+			flat[f] = (glm::length(glm::cross(e1, e2)) <= 1e-12f);
+			if (flat[f]) flatCount++;
+		}
+
+		const float creases[] = { 20.f, 30.f, 45.f, 60.f, 90.f, 180.f };
+		double sum = 0, worst = 0;
+		float bestCrease = 0.f;
+		size_t compared = 0;
+		for (size_t c = 0; c < sizeof(creases) / sizeof(creases[0]); c++)
+		{
+			generateNormals(&attrib.vertices[0], attrib.vertices.size() / 3, &positionIndices[0], positionIndices.size(),
+				&groups[0], creases[c], &normals[0], WEIGHT_ANGLE, cores);
+			double creaseSum = 0, creaseWorst = 0;
+			size_t creaseCompared = 0;
+			for (size_t i = 0; i < normalIndices.size(); i++)
+			{
+				if (normalIndices[i] < 0 || flat[i / 3]) continue;
+				glm::vec3 file = glm::normalize(glm::vec3(attrib.normals[normalIndices[i] * 3], attrib.normals[normalIndices[i] * 3 + 1],
+					attrib.normals[normalIndices[i] * 3 + 2]));
+				double angle = glm::degrees(acos(glm::clamp(glm::dot(file, glm::vec3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2])), -1.f, 1.f)));
+				creaseSum += angle;
+				if (angle > creaseWorst) creaseWorst = angle;
+				creaseCompared++;
+			}
+			if (creaseCompared > 0 && (compared == 0 || creaseSum / creaseCompared < sum / compared))
+			{
+				sum = creaseSum;
+				worst = creaseWorst;
+				compared = creaseCompared;
+				bestCrease = creases[c];
+			}
+		}
+
+		// Tangents for the vertices as they are welded for drawing
+		vector<BenchVertex> vertices;
+		vector<unsigned int> indices;
+		weldMesh(attrib, shapes, vertices, indices);
+		vector<float> tangents(vertices.size() * 4);
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		generateTangents(vertices[0].position, vertices[0].normal, vertices[0].texcoord, sizeof(BenchVertex), vertices.size(),
+			&indices[0], indices.size(), &tangents[0], cores);
+		double tangentTime = milliseconds(start);
+
+		string name = models[m].substr(models[m].find_last_of("/\\") + 1);
+		cout << "  " << setw(18) << left << name << right << setw(7) << positionIndices.size() / 3 << " triangles  "
+			<< setprecision(3) << setw(7) << times[0] << " ms  " << setw(7) << times[1] << " ms on " << cores << " threads";
+		if (compared > 0) cout << "  error " << setw(6) << sum / compared << " mean " << setw(7) << worst << " max degrees at " << bestCrease;
+		if (flatCount > 0) cout << ", " << flatCount << " triangles with no area";
+		cout << "  tangents " << setw(7) << tangentTime << " ms" << endl;
+	}
+}
@@ -0,0 +1,186 @@
+/* bench_objload.cpp
+ The CPU side of TinyObjLoader::load_obj, which is readObj from obj_reader.h: the first pass
+ that counts the lines, the parse, welding the corners into shared vertices and any normals
+ it has to make. The parse alone is timed by streaming the file with no callbacks, so the
+ rest of the time is the counting pass, the welding and the normals.
+ The memory is the most the arrays take while the file is read, which is what is recorded,
+ against the welded mesh that is left to upload.
+ The welding is also timed on its own, with weldCorners on the corners of every face gathered
+ by one parse beforehand.
+*/
+
+#include "../assignment_two/tiny_obj_loader.h"
+#include "../assignment_two/obj_reader.h"
+#include "benchmarks.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+static const int repeats = 5;
+
+static double milliseconds(chrono::high_resolution_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+/* Parse the file with tinyobj and nothing done with what it finds */
+static double parseOnly(const string &model)
+{
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		ifstream file(model.c_str());
+		tinyobj::callback_t callbacks;
+		string baseDir = model.substr(0, model.find_last_of("/\\") + 1);
+		tinyobj::MaterialFileReader materialReader(baseDir);
+		string warn, err;
+		tinyobj::LoadObjWithCallback(file, callbacks, NULL, &materialReader, &warn, &err);
+		best = std::min(best, milliseconds(start));
+	}
+	return best;
+}
+
+/* The attribute counts and the face corners of a file, as array indices */
+struct CornerStream
+{
+	size_t positions, normals, texcoords;
+	vector<int> corners;
+};
+
+static int arrayIndex(int index, size_t count)
+{
+	long long i = (index > 0) ? (long long)index - 1 : (long long)count + index;
+	return (index == 0 || i < 0 || i >= (long long)count) ? -1 : (int)i;
+}
+
+static void countVertex(void *user, tinyobj::real_t, tinyobj::real_t, tinyobj::real_t, tinyobj::real_t) { ((CornerStream*)user)->positions++; }
+static void countNormal(void *user, tinyobj::real_t, tinyobj::real_t, tinyobj::real_t) { ((CornerStream*)user)->normals++; }
+static void countTexcoord(void *user, tinyobj::real_t, tinyobj::real_t, tinyobj::real_t) { ((CornerStream*)user)->texcoords++; }
+
+static void gatherFace(void *user, tinyobj::index_t *face, int numCorners)
+{
+	CornerStream &s = *(CornerStream*)user;
+	for (int i = 0; i < numCorners; i++)
+	{
+		int v = arrayIndex(face[i].vertex_index, s.positions);
+		if (v < 0) continue;
+		s.corners.push_back(v);
+		s.corners.push_back(arrayIndex(face[i].texcoord_index, s.texcoords));
+		s.corners.push_back(arrayIndex(face[i].normal_index, s.normals));
+	}
+}
+
+/* Time welding the corners of each model into shared vertices, without the parse */
+void benchVertexWelding(const vector<string> &models)
+{
+	cout << "Vertex welding on its own: ms to weld the face corners of each model, million corners a second,"
+		<< " corners welded to vertices" << endl;
+	cout << fixed;
+
+	double totalTime = 0;
+	size_t totalCorners = 0;
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		ifstream file(models[m].c_str());
+		if (!file)
+		{
+			cout << "  can't open " << models[m] << endl;
+			continue;
+		}
+		CornerStream stream;
+		stream.positions = stream.normals = stream.texcoords = 0;
+		tinyobj::callback_t callbacks;
+		callbacks.vertex_cb = countVertex;
+		callbacks.normal_cb = countNormal;
+		callbacks.texcoord_cb = countTexcoord;
+		callbacks.index_cb = gatherFace;
+		string warn, err;
+		if (!tinyobj::LoadObjWithCallback(file, callbacks, &stream, NULL, &warn, &err)) continue;
+
+		size_t corners = stream.corners.size() / 3;
+		size_t largest = std::max(stream.positions, std::max(stream.normals, stream.texcoords));
+		vector<unsigned int> indices;
+		size_t vertices = 0;
+		double best = 1e30;
+		for (int r = 0; r < repeats; r++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			vertices = weldCorners(stream.corners, largest, indices);
+			best = std::min(best, milliseconds(start));
+		}
+
+		string name = models[m].substr(models[m].find_last_of("/\\") + 1);
+		cout << "  " << setw(20) << left << name << right << setw(8) << setprecision(3) << best << " ms "
+			<< setw(7) << setprecision(1) << corners / best / 1000.0 << "  " << setw(7) << corners << " -> " << setw(6) << vertices << endl;
+		recordResult("weld/" + name, repeats, best, (double)corners);
+
+		totalTime += best;
+		totalCorners += corners;
+	}
+	if (totalTime > 0)
+	{
+		cout << "  all models: " << setprecision(3) << totalTime << " ms, " << setprecision(1) << totalCorners / totalTime / 1000.0
+			<< " million corners a second" << endl;
+	}
+}
+
+void benchObjLoading(const vector<string> &models)
+{
+	cout << "OBJ loading on the CPU: parse only and read with welding in ms, MB/s of the file, corners welded"
+		<< " to vertices, KB while reading and of the mesh" << endl;
+	cout << fixed;
+
+	double totalParse = 0, totalRead = 0;
+	size_t totalFileBytes = 0;
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		ifstream in(models[m].c_str(), ios::in | ios::binary | ios::ate);
+		if (!in)
+		{
+			cout << "  can't open " << models[m] << endl;
+			continue;
+		}
+		size_t fileBytes = (size_t)in.tellg();
+		in.close();
+
+		double parse = parseOnly(models[m]);
+		double read = 1e30;
+		ObjMesh mesh;
+		for (int r = 0; r < repeats; r++)
+		{
+			ObjMesh fresh;
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			if (!readObj(models[m], 60.f, fresh)) break;
+			read = std::min(read, milliseconds(start));
+			if (r == 0) mesh = fresh;
+		}
+		if (read >= 1e30) continue;
+
+		size_t meshBytes = mesh.vertices.size() * sizeof(ObjVertex) + mesh.indices.size() * sizeof(unsigned int);
+		string name = models[m].substr(models[m].find_last_of("/\\") + 1);
+		cout << "  " << setw(20) << left << name << right
+			<< " parse " << setw(8) << setprecision(2) << parse << " ms " << setw(6) << setprecision(1) << fileBytes / parse / 1024.0 / 1024.0 * 1000.0
+			<< "  read " << setw(8) << setprecision(2) << read << " ms " << setw(6) << setprecision(1) << fileBytes / read / 1024.0 / 1024.0 * 1000.0
+			<< "  " << setw(7) << mesh.indices.size() << " -> " << setw(6) << mesh.vertices.size()
+			<< "  " << setw(7) << mesh.peakBytes / 1024 << " KB -> " << setw(6) << meshBytes / 1024 << " KB" << endl;
+
+		recordResult("objload/parse/" + name, repeats, parse, 0, (double)fileBytes);
+		recordResult("objload/read/" + name, repeats, read, (double)mesh.indices.size(), (double)fileBytes, mesh.peakBytes);
+
+		totalParse += parse;
+		totalRead += read;
+		totalFileBytes += fileBytes;
+	}
+
+	if (totalRead > 0)
+	{
+		cout << "  all models: parse " << setprecision(1) << totalFileBytes / totalParse / 1024.0 / 1024.0 * 1000.0
+			<< " MB/s, read " << totalFileBytes / totalRead / 1024.0 / 1024.0 * 1000.0 << " MB/s, welding and the rest "
+			<< setprecision(0) << (totalRead - totalParse) / totalRead * 100.0 << "% of the time" << endl;
+	}
+}
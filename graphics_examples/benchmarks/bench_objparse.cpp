@@ -0,0 +1,270 @@
+/* bench_objparse.cpp
+ OBJ parsing throughput in MB/s. For each model the v, vn and vt lines are parsed with
+ the old number parser (strspn/strcspn and tryParseDouble) and the new parseReal, and
+ the f lines with the old atoi() based triple parser and the new parseTriple. Every
+ result is checked to be bit-identical. Then the whole file is loaded with LoadObj
+ from memory.
+*/
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../assignment_two/tiny_obj_loader.h"
+#include "benchmarks.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+
+using namespace std;
+
+static const int repeats = 10;
+
+/* The number and face index parsers from before the fast path, kept here to compare against */
+static tinyobj::real_t legacyParseReal(const char **token)
+{
+	*token += strspn(*token, " \t");
+	const char *end = *token + strcspn(*token, " \t\r");
+	double value = 0.0;
+	tinyobj::tryParseDouble(*token, end, &value);
+	*token = end;
+	return static_cast<tinyobj::real_t>(value);
+}
+
+static bool legacyFixIndex(int idx, int n, int *ret)
+{
+	if (idx > 0) { *ret = idx - 1; return true; }
+	if (idx < 0) { *ret = n + idx; return true; }
+	return false;
+}
+
+static bool legacyTriple(const char **token, int vsize, int vnsize, int vtsize, tinyobj::vertex_index_t *ret)
+{
+	tinyobj::vertex_index_t vi(-1);
+	if (!legacyFixIndex(atoi(*token), vsize, &vi.v_idx)) return false;
+
+	*token += strcspn(*token, "/ \t\r");
+	if ((*token)[0] != '/') { *ret = vi; return true; }
+	(*token)++;
+
+	if ((*token)[0] == '/')
+	{
+		(*token)++;
+		if (!legacyFixIndex(atoi(*token), vnsize, &vi.vn_idx)) return false;
+		*token += strcspn(*token, "/ \t\r");
+		*ret = vi;
+		return true;
+	}
+
+	if (!legacyFixIndex(atoi(*token), vtsize, &vi.vt_idx)) return false;
+	*token += strcspn(*token, "/ \t\r");
+	if ((*token)[0] != '/') { *ret = vi; return true; }
+
+	(*token)++;
+	if (!legacyFixIndex(atoi(*token), vnsize, &vi.vn_idx)) return false;
+	*token += strcspn(*token, "/ \t\r");
+	*ret = vi;
+	return true;
+}
+
+/* The part of a v, vn, vt or f line after the tag, as offsets so it can be parsed in place */
+struct Line
+{
+	size_t start, end;
+	int values;		// numbers on a vertex line
+};
+
+/* Find the vertex and face lines. The file text has '\0' written over each line ending,
+   so that the parsers stop at the end of the line like they do in LoadObj */
+static void findLines(string &text, vector<Line> &vertices, vector<Line> &faces)
+{
+	size_t pos = 0;
+	while (pos < text.size())
+	{
+		size_t eol = text.find('\n', pos);
+		if (eol == string::npos) eol = text.size();
+		else text[eol] = '\0';
+
+		const char *line = &text[pos];
+		Line found = { pos + 2, eol, 3 };
+		if (line[0] == 'v' && line[1] == ' ') vertices.push_back(found);
+		else if (line[0] == 'v' && line[1] == 'n' && line[2] == ' ') { found.start++; vertices.push_back(found); }
+		else if (line[0] == 'v' && line[1] == 't' && line[2] == ' ') { found.start++; found.values = 2; vertices.push_back(found); }
+		else if (line[0] == 'f' && line[1] == ' ') faces.push_back(found);
+		pos = eol + 1;
+	}
+}
+
+static size_t lineBytes(const vector<Line> &lines)
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < lines.size(); i++) bytes += lines[i].end - lines[i].start;
+	return bytes;
+}
+
+static double seconds(chrono::high_resolution_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+static double megabytesPerSecond(size_t bytes, double time)
+{
+	return bytes / time / (1024.0 * 1024.0);
+}
+
+/* Parse every vertex line with the old and new code. Returns the number of results that differ */
+static size_t benchNumbers(const string &text, const vector<Line> &lines, double &oldTime, double &newTime)
+{
+	vector<tinyobj::real_t> before(lines.size() * 3), after(lines.size() * 3);
+	oldTime = newTime = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			const char *token = &text[lines[i].start];
+			for (int v = 0; v < lines[i].values; v++) before[i * 3 + v] = legacyParseReal(&token);
+		}
+		double t = seconds(start);
+		if (t < oldTime) oldTime = t;
+
+		start = chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			const char *token = &text[lines[i].start];
+			for (int v = 0; v < lines[i].values; v++) after[i * 3 + v] = tinyobj::parseReal(&token);
+		}
+		t = seconds(start);
+		if (t < newTime) newTime = t;
+	}
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		if (memcmp(&before[i * 3], &after[i * 3], lines[i].values * sizeof(tinyobj::real_t)) != 0) mismatches++;
+	}
+	return mismatches;
+}
+
+/* Parse every corner of every face line the way LoadObj does, with the old and new
+   triple parsers. Returns the number of corners that differ */
+static size_t parseFaces(const string &text, const vector<Line> &lines, bool legacy, vector<tinyobj::vertex_index_t> &corners)
+{
+	const int size = 1 << 30;	// large enough that relative indices are always valid
+	size_t failures = 0;
+	corners.clear();
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		const char *token = &text[lines[i].start];
+		token += strspn(token, " \t");
+		while (!IS_NEW_LINE(token[0]))
+		{
+			tinyobj::vertex_index_t vi(-1);
+			bool ok = legacy ? legacyTriple(&token, size, size, size, &vi) : tinyobj::parseTriple(&token, size, size, size, &vi);
+			if (!ok) { failures++; break; }
+			corners.push_back(vi);
+			token += strspn(token, " \t\r");
+		}
+	}
+	return failures;
+}
+
+static size_t benchCorners(const string &text, const vector<Line> &lines, double &oldTime, double &newTime)
+{
+	vector<tinyobj::vertex_index_t> before, after;
+	size_t failedBefore = 0, failedAfter = 0;
+	oldTime = newTime = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		failedBefore = parseFaces(text, lines, true, before);
+		double t = seconds(start);
+		if (t < oldTime) oldTime = t;
+
+		start = chrono::high_resolution_clock::now();
+		failedAfter = parseFaces(text, lines, false, after);
+		t = seconds(start);
+		if (t < newTime) newTime = t;
+	}
+
+	size_t mismatches = (failedBefore != failedAfter || before.size() != after.size()) ? 1 : 0;
+	for (size_t i = 0; i < before.size() && i < after.size(); i++)
+	{
+		if (before[i].v_idx != after[i].v_idx || before[i].vt_idx != after[i].vt_idx || before[i].vn_idx != after[i].vn_idx) mismatches++;
+	}
+	return mismatches;
+}
+
+/* The whole of LoadObj, from a copy of the file in memory */
+static double benchLoadObj(const string &file)
+{
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		istringstream stream(file);
+		tinyobj::attrib_t attrib;
+		vector<tinyobj::shape_t> shapes;
+		vector<tinyobj::material_t> materials;
+		string warn, err;
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream);
+		double t = seconds(start);
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+void benchObjParsing(const vector<string> &models)
+{
+	cout << "OBJ parsing, MB/s of the parsed text (old -> new)" << endl;
+	cout << fixed << setprecision(1);
+
+	double totalOld = 0, totalNew = 0, totalLoad = 0;
+	size_t totalNumberBytes = 0, totalCornerBytes = 0, totalFileBytes = 0, totalMismatches = 0;
+	double numbersOld, numbersNew, cornersOld, cornersNew;
+
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		ifstream in(models[m].c_str(), ios::in | ios::binary);
+		if (!in)
+		{
+			cout << "  can't open " << models[m] << endl;
+			continue;
+		}
+		stringstream contents;
+		contents << in.rdbuf();
+		string file = contents.str();
+
+		string text = file;
+		vector<Line> vertices, faces;
+		findLines(text, vertices, faces);
+		size_t numberBytes = lineBytes(vertices), cornerBytes = lineBytes(faces);
+
+		size_t mismatches = benchNumbers(text, vertices, numbersOld, numbersNew);
+		mismatches += benchCorners(text, faces, cornersOld, cornersNew);
+		double load = benchLoadObj(file);
+
+		string name = models[m].substr(models[m].find_last_of("/\\") + 1);
+		cout << "  " << setw(20) << left << name << right
+			<< " numbers " << setw(7) << megabytesPerSecond(numberBytes, numbersOld) << " -> " << setw(7) << megabytesPerSecond(numberBytes, numbersNew)
+			<< "  faces " << setw(7) << megabytesPerSecond(cornerBytes, cornersOld) << " -> " << setw(7) << megabytesPerSecond(cornerBytes, cornersNew)
+			<< "  LoadObj " << setw(6) << megabytesPerSecond(file.size(), load)
+			<< "  mismatches " << mismatches << endl;
+		recordResult("objparse/numbers/" + name, repeats, numbersNew * 1000.0, 0, (double)numberBytes);
+		recordResult("objparse/faces/" + name, repeats, cornersNew * 1000.0, 0, (double)cornerBytes);
+		recordResult("objparse/LoadObj/" + name, repeats, load * 1000.0, 0, (double)file.size());
+
+		totalOld += numbersOld + cornersOld;
+		totalNew += numbersNew + cornersNew;
+		totalLoad += load;
+		totalNumberBytes += numberBytes;
+		totalCornerBytes += cornerBytes;
+		totalFileBytes += file.size();
+		totalMismatches += mismatches;
+	}
+
+	cout << "  all models: numbers and faces " << megabytesPerSecond(totalNumberBytes + totalCornerBytes, totalOld)
+		<< " -> " << megabytesPerSecond(totalNumberBytes + totalCornerBytes, totalNew) << " MB/s, LoadObj "
+		<< megabytesPerSecond(totalFileBytes, totalLoad) << " MB/s, " << totalMismatches << " mismatches" << endl;
+}
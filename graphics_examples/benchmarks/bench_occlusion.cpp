@@ -0,0 +1,152 @@
+/* bench_occlusion.cpp
+ Software occlusion culling of an interior: a 40 x 40 grid of floor tiles with rows of walls
+ across it, seen from one end at eye height. Times rasterising the walls into the 256 x 128
+ occlusion buffer one pixel at a time, four at a time with SSE2 and on all of the threads,
+ and testing the tiles' boxes against it, and reports how many tiles are left to draw. Every
+ tile that is culled is then checked by casting rays from the eye to points on its top and
+ seeing whether any of them gets past the walls into the view, which would mean the culling
+ hid a tile that can be seen.
+*/
+
+#include "benchmarks.h"
+#include "occlusion_buffer.h"
+#include "draw_lists.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+static const int repeats = 5;
+
+/* Whether the segment from a to b passes through the box */
+static bool segmentHitsBox(const vec3 &a, const vec3 &b, const vec3 &lower, const vec3 &upper)
+{
+	float enter = 0.f, leave = 1.f;
+	vec3 direction = b - a;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (direction[axis] == 0.f)
+		{
+			if (a[axis] < lower[axis] || a[axis] > upper[axis]) return false;
+			continue;
+		}
+		float t0 = (lower[axis] - a[axis]) / direction[axis];
+		float t1 = (upper[axis] - a[axis]) / direction[axis];
+		if (t0 > t1) std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		leave = std::min(leave, t1);
+		if (enter > leave) return false;
+	}
+	return true;
+}
+
+/* Whether any of a grid of points on the top of a tile is in the view with no wall in the way */
+static bool tileSeen(const vec3 &eye, const mat4 &viewProjection, const mat4 &tile, const vec3 &tileLower, const vec3 &tileUpper,
+	const vector<vec3> &wallLowers, const vector<vec3> &wallUppers)
+{
+	const int steps = 8;
+	for (int i = 0; i <= steps; i++)
+		for (int j = 0; j <= steps; j++)
+		{
+			vec3 local(mix(tileLower.x, tileUpper.x, i / (float)steps), tileUpper.y, mix(tileLower.z, tileUpper.z, j / (float)steps));
+			vec3 point = vec3(tile * vec4(local, 1.f));
+
+			vec4 clip = viewProjection * vec4(point, 1.f);
+			if (clip.w <= 0.f || fabs(clip.x) > clip.w || fabs(clip.y) > clip.w || fabs(clip.z) > clip.w) continue;
+
+			bool blocked = false;
+			for (size_t w = 0; w < wallLowers.size() && !blocked; w++) blocked = segmentHitsBox(eye, point, wallLowers[w], wallUppers[w]);
+			if (!blocked) return true;
+		}
+	return false;
+}
+
+void benchOcclusionCulling()
+{
+	cout << "Occlusion culling: 1600 floor tiles, 256 x 128 occlusion buffer" << endl;
+
+	vec3 eye(0.f, 1.7f, 38.f);
+	DrawView view;
+	view.set(lookAt(eye, vec3(0.f, 1.f, 0.f), vec3(0, 1, 0)), perspective(radians(60.f), 16.f / 9.f, 0.1f, 200.f));
+
+	// Tiles 2 units across from -40 to 40, and walls across the floor every 10 units with a doorway in each
+	vector<mat4> tiles;
+	for (int z = 0; z < 40; z++)
+		for (int x = 0; x < 40; x++) tiles.push_back(translate(mat4(1.0f), vec3(x * 2.f - 39.f, 0.f, z * 2.f - 39.f)));
+	vec3 tileLower(-1.f, -0.05f, -1.f), tileUpper(1.f, 0.05f, 1.f);
+
+	vector<mat4> walls;
+	for (int row = 0; row < 7; row++)
+		for (int segment = 0; segment < 8; segment++)
+		{
+			if (segment == (row * 3) % 8) continue;
+			walls.push_back(translate(mat4(1.0f), vec3(segment * 10.f - 35.f, 1.5f, row * 10.f - 30.f)));
+		}
+	vec3 wallLower(-5.f, -1.5f, -0.01f), wallUpper(5.f, 1.5f, 0.01f);
+
+	JobPool pool;
+	pool.makePool();
+
+	OcclusionBuffer buffers[3];
+	const char *names[3] = { "scalar", "SSE2", "SSE2 on all threads" };
+	double times[3];
+	cout << fixed << setprecision(3);
+	for (int b = 0; b < 3; b++)
+	{
+		double best = 1e30;
+		for (int r = 0; r < repeats; r++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			buffers[b].beginFrame(view.viewProjection);
+			for (size_t w = 0; w < walls.size(); w++) buffers[b].addOccluder(walls[w], wallLower, wallUpper);
+			buffers[b].rasterise(b == 2 ? &pool : NULL, b > 0);
+			double time = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+			if (time < best) best = time;
+		}
+		times[b] = best;
+		cout << "  rasterise " << setw(20) << left << names[b] << right << setw(8) << best << " ms, " << setprecision(2)
+			<< times[0] / best << "x" << setprecision(3) << endl;
+	}
+	bool same = (buffers[0].depth == buffers[1].depth && buffers[0].depth == buffers[2].depth);
+	cout << "  " << buffers[0].triangleCount() << " occluder triangles from " << walls.size() << " walls"
+		<< (same ? "" : ", DIFFERENT DEPTHS") << endl;
+
+	size_t inFrustum = 0, drawn = 0;
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		inFrustum = drawn = 0;
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (size_t t = 0; t < tiles.size(); t++)
+		{
+			if (!view.visible(tiles[t], vec4(0.f, 0.f, 0.f, 1.42f))) continue;
+			inFrustum++;
+			if (buffers[1].visible(tiles[t], tileLower, tileUpper)) drawn++;
+		}
+		double time = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		if (time < best) best = time;
+	}
+	cout << "  test " << tiles.size() << " tiles " << setw(8) << best << " ms: " << inFrustum << " in view, " << drawn
+		<< " drawn after occlusion culling" << endl;
+
+	// Check the culled tiles by brute force
+	vector<vec3> wallLowers, wallUppers;
+	for (size_t w = 0; w < walls.size(); w++)
+	{
+		wallLowers.push_back(vec3(walls[w] * vec4(wallLower, 1.f)));
+		wallUppers.push_back(vec3(walls[w] * vec4(wallUpper, 1.f)));
+	}
+	size_t culled = 0, wronglyHidden = 0;
+	for (size_t t = 0; t < tiles.size(); t++)
+	{
+		if (!view.visible(tiles[t], vec4(0.f, 0.f, 0.f, 1.42f)) || buffers[1].visible(tiles[t], tileLower, tileUpper)) continue;
+		culled++;
+		if (tileSeen(eye, view.viewProjection, tiles[t], tileLower, tileUpper, wallLowers, wallUppers)) wronglyHidden++;
+	}
+	cout << "  ray check of the " << culled << " culled tiles: " << wronglyHidden << " can be seen" << endl;
+}
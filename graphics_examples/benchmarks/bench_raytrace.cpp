@@ -0,0 +1,78 @@
+/* bench_raytrace.cpp
+ The ray tracer on the same field of shapes as bench_softraster.cpp, standing on a floor that
+ their shadows fall on. Times building the hierarchy, then a pass of camera and shadow rays one
+ ray at a time, in SSE2 packets of four and in packets on all of the threads, in millions of rays
+ a second, and checks that all three give the same image.
+*/
+
+#include "benchmarks.h"
+#include "ray_tracer.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+static const int repeats = 3;
+
+void benchRayTracing()
+{
+	const unsigned int width = 1280, height = 720;
+	cout << "Ray tracer: 1000 shapes and a floor at " << width << " x " << height << endl;
+
+	MeshBuilder builder;
+	unsigned int shapes[3] = { builder.addSphere(40, 40), builder.addCube(), builder.addCylinder(32, vec3(0.8f, 0.6f, 0.4f)) };
+	SoftMesh meshes[3];
+	for (int m = 0; m < 3; m++) meshes[m].fromBuilder(builder, shapes[m]);
+
+	SoftMaterial material;
+	material.specular = true;
+
+	RayTracer tracers[3];
+	double buildTime = 1e30;
+	for (int r = 0; r < 3; r++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (int z = 0; z < 10; z++)
+			for (int y = 0; y < 10; y++)
+				for (int x = 0; x < 10; x++)
+				{
+					mat4 model = translate(mat4(1.0f), vec3(x * 1.5f - 6.75f, y * 1.5f - 6.75f, -z * 3.f));
+					model = rotate(scale(model, vec3(0.6f)), radians(x * 20.f + y * 7.f), vec3(0.3f, 1.f, 0.2f));
+					tracers[r].addMesh(meshes[(z * 100 + y * 10 + x) % 3], model, material);
+				}
+		tracers[r].addMesh(meshes[1], scale(translate(mat4(1.0f), vec3(0.f, -8.f, -12.f)), vec3(20.f, 0.1f, 20.f)), material);
+		tracers[r].buildBVH();
+		buildTime = std::min(buildTime, chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count());
+
+		tracers[r].makeFramebuffer(width, height, r == 2 ? 0 : 1);
+		tracers[r].setCamera(lookAt(vec3(0.f, 0.f, 12.f), vec3(0.f, 0.f, 0.f), vec3(0, 1, 0)),
+			perspective(radians(50.f), (float)width / height, 0.1f, 100.f));
+		tracers[r].setLight(vec4(2.f, 4.f, 8.f, 1.f), 0.05f);
+	}
+	cout << fixed << setprecision(3);
+	cout << "  " << tracers[0].triangleCount() << " triangles, " << tracers[0].nodeCount() << " nodes built in "
+		<< buildTime << " ms" << endl;
+
+	const char *names[3] = { "one ray at a time", "SSE2 packets", "packets on all threads" };
+	double rates[3];
+	for (int r = 0; r < 3; r++)
+	{
+		double best = 1e30;
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			tracers[r].resetAccumulation();
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			tracers[r].trace(r > 0);
+			best = std::min(best, chrono::duration<double>(chrono::high_resolution_clock::now() - start).count());
+		}
+		rates[r] = tracers[r].raysTraced() / best / 1e6;
+		cout << "  pass " << setw(24) << left << names[r] << right << setw(9) << best * 1000.0 << " ms, " << setw(7)
+			<< rates[r] << " million rays a second, " << setprecision(2) << rates[r] / rates[0] << "x" << setprecision(3) << endl;
+	}
+
+	bool same = (tracers[0].colour == tracers[1].colour && tracers[0].colour == tracers[2].colour);
+	cout << "  " << tracers[0].raysTraced() << " camera and shadow rays a pass" << (same ? "" : ", DIFFERENT IMAGES") << endl;
+}
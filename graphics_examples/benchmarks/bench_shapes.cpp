@@ -0,0 +1,111 @@
+/* bench_shapes.cpp
+ Time and memory to make each of the example shapes, across the sizes they can be made at.
+ MeshBuilder makes the same shapes as Sphere::makeSphere, Cylinder::makeCylinder and
+ Cube::makeCube without the upload, so this is the CPU side of those. The memory is that of
+ the builder's vertices and indices, and for the lat/long sphere also what the Sphere class
+ puts in its four buffer objects, which hold separate positions, normals and colours and
+ draw with triangle strips and fans.
+*/
+
+#include "benchmarks.h"
+#include "mesh_builder.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+static const int repeats = 5;
+
+/* Enough builds of each shape to time, about a million triangles */
+static const size_t trianglesPerRepeat = 1000000;
+
+enum ShapeKind { SHAPE_SPHERE, SHAPE_CYLINDER, SHAPE_CUBE, SHAPE_TETRAHEDRON };
+
+struct ShapeSize
+{
+	ShapeKind kind;
+	unsigned int a, b;		// latitudes and longitudes, or the cylinder's definition
+};
+
+static const ShapeSize shapes[] = {
+	{ SHAPE_SPHERE, 8, 8 }, { SHAPE_SPHERE, 16, 16 }, { SHAPE_SPHERE, 20, 20 }, { SHAPE_SPHERE, 32, 32 },
+	{ SHAPE_SPHERE, 64, 64 }, { SHAPE_SPHERE, 128, 128 }, { SHAPE_SPHERE, 256, 256 },
+	{ SHAPE_SPHERE, 20, 80 }, { SHAPE_SPHERE, 80, 20 },
+	{ SHAPE_CYLINDER, 16, 0 }, { SHAPE_CYLINDER, 32, 0 }, { SHAPE_CYLINDER, 64, 0 }, { SHAPE_CYLINDER, 256, 0 },
+	{ SHAPE_CUBE, 0, 0 }, { SHAPE_TETRAHEDRON, 0, 0 }
+};
+
+static void addShape(MeshBuilder &builder, const ShapeSize &shape)
+{
+	switch (shape.kind)
+	{
+	case SHAPE_SPHERE: builder.addSphere(shape.a, shape.b); break;
+	case SHAPE_CYLINDER: builder.addCylinder(shape.a, glm::vec3(1.f)); break;
+	case SHAPE_CUBE: builder.addCube(); break;
+	default: builder.addTetrahedron(); break;
+	}
+}
+
+/* The bytes that Sphere::makeSphere uploads: positions, normals and RGBA colours for each
+   vertex and its strip and fan indices */
+static size_t sphereClassBytes(unsigned int numlats, unsigned int numlongs)
+{
+	size_t vertices = 2 + (numlats - 1) * numlongs;
+	size_t indices = ((numlongs * 2) + 2) * (numlats - 1) + ((numlongs + 2) * 2);
+	return vertices * (3 + 3 + 4) * sizeof(float) + indices * sizeof(unsigned int);
+}
+
+void benchShapeGeneration()
+{
+	cout << "Shape generation: triangles, vertices, build time, KB in the builder (and in the Sphere class's buffers)" << endl;
+	cout << fixed;
+
+	MeshBuilder builder;
+	for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+	{
+		const ShapeSize &shape = shapes[s];
+		builder.reset();
+		addShape(builder, shape);
+		const MeshRange &range = builder.meshes.back();
+		size_t triangles = range.indexCount / 3;
+		size_t bytes = range.vertexCount * sizeof(MeshVertex) + range.indexCount * sizeof(unsigned int);
+		size_t builds = std::max<size_t>(1, trianglesPerRepeat / triangles);
+
+		// Reset before each one so that it is the generating that is timed, not the arrays growing
+		double best = 1e30;
+		for (int r = 0; r < repeats; r++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			for (size_t b = 0; b < builds; b++)
+			{
+				builder.reset();
+				addShape(builder, shape);
+			}
+			best = std::min(best, chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / builds);
+		}
+
+		string name, resultName;
+		switch (shape.kind)
+		{
+		case SHAPE_SPHERE:
+			name = "sphere " + to_string(shape.a) + " x " + to_string(shape.b);
+			resultName = "shapes/sphere/" + to_string(shape.a) + "x" + to_string(shape.b);
+			break;
+		case SHAPE_CYLINDER:
+			name = "cylinder " + to_string(shape.a);
+			resultName = "shapes/cylinder/" + to_string(shape.a);
+			break;
+		case SHAPE_CUBE: name = "cube"; resultName = "shapes/cube"; break;
+		default: name = "tetrahedron"; resultName = "shapes/tetrahedron"; break;
+		}
+
+		cout << "  " << left << setw(20) << name << right << setw(8) << triangles << setw(8) << range.vertexCount
+			<< setw(11) << setprecision(2) << best * 1000.0 << " us" << setw(9) << setprecision(1) << bytes / 1024.0 << " KB";
+		if (shape.kind == SHAPE_SPHERE) cout << setw(9) << sphereClassBytes(shape.a, shape.b) / 1024.0 << " KB";
+		cout << endl;
+
+		recordResult(resultName, repeats, best, (double)triangles, 0, bytes);
+	}
+}
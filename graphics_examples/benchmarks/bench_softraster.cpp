@@ -0,0 +1,93 @@
+/* bench_softraster.cpp
+ The software rasteriser drawing the example shapes, spheres, cubes and cylinders with a checked
+ texture: a field of them, one behind another so that the hierarchical Z has plenty to throw
+ away, where most triangles are a pixel or two and the frame is bound by setting them up, and a
+ few near the eye, where the triangles are big and the frame is bound by shading pixels. Times
+ each frame drawn a pixel at a time, four pixels at a time with SSE2 and with SSE2 on all of the
+ threads, and checks that all three give exactly the same image.
+*/
+
+#include "benchmarks.h"
+#include "soft_raster.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+static const int repeats = 5;
+
+void benchSoftRasteriser()
+{
+	const unsigned int width = 1280, height = 720;
+	cout << "Software rasteriser: 1000 shapes, then 12 near the eye, at " << width << " x " << height << endl;
+
+	MeshBuilder builder;
+	unsigned int shapes[3] = { builder.addSphere(40, 40), builder.addCube(), builder.addCylinder(32, vec3(0.8f, 0.6f, 0.4f)) };
+	SoftMesh meshes[3];
+	for (int m = 0; m < 3; m++) meshes[m].fromBuilder(builder, shapes[m]);
+
+	// A grey and white check, 8 texels a square
+	vector<unsigned char> checks(64 * 64 * 3);
+	for (int y = 0; y < 64; y++)
+		for (int x = 0; x < 64; x++)
+			for (int c = 0; c < 3; c++) checks[(y * 64 + x) * 3 + c] = (((x / 8) ^ (y / 8)) & 1) ? 255 : 128;
+	SoftTexture texture;
+	texture.makeTexture(64, 64, 3, &checks[0]);
+
+	vector<mat4> field, near;
+	for (int z = 0; z < 10; z++)
+		for (int y = 0; y < 10; y++)
+			for (int x = 0; x < 10; x++)
+			{
+				mat4 model = translate(mat4(1.0f), vec3(x * 1.5f - 6.75f, y * 1.5f - 6.75f, -z * 3.f));
+				field.push_back(rotate(scale(model, vec3(0.6f)), radians(x * 20.f + y * 7.f), vec3(0.3f, 1.f, 0.2f)));
+			}
+	for (int i = 0; i < 12; i++)
+	{
+		mat4 model = translate(mat4(1.0f), vec3((i % 4) * 5.f - 7.5f, (i / 4) * 5.f - 5.f, 2.f));
+		near.push_back(rotate(scale(model, vec3(2.5f)), i * 0.5f, vec3(0.3f, 1.f, 0.2f)));
+	}
+	mat4 view = lookAt(vec3(0.f, 0.f, 12.f), vec3(0.f, 0.f, 0.f), vec3(0, 1, 0));
+	mat4 projection = perspective(radians(50.f), (float)width / height, 0.1f, 100.f);
+
+	SoftMaterial material;
+	material.texture = &texture;
+	material.specular = true;
+
+	cout << fixed << setprecision(3);
+	const char *sceneNames[2] = { "field", "near" };
+	for (int scene = 0; scene < 2; scene++)
+	{
+		const vector<mat4> &models = scene ? near : field;
+		SoftRasteriser rasterisers[3];
+		const char *names[3] = { "scalar", "SSE2", "SSE2 on all threads" };
+		double times[3];
+		for (int r = 0; r < 3; r++)
+		{
+			rasterisers[r].makeFramebuffer(width, height, r == 2 ? 0 : 1);
+			double best = 1e30;
+			for (int repeat = 0; repeat < repeats; repeat++)
+			{
+				chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+				rasterisers[r].clear(vec4(0.f, 0.f, 0.f, 1.f));
+				rasterisers[r].setCamera(view, projection);
+				rasterisers[r].setLight(vec4(2.f, 4.f, 8.f, 1.f), 0.05f);
+				for (size_t i = 0; i < models.size(); i++) rasterisers[r].draw(meshes[i % 3], models[i], material);
+				rasterisers[r].finish(r > 0);
+				double time = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+				if (time < best) best = time;
+			}
+			times[r] = best;
+			string name = string(sceneNames[scene]) + ", " + names[r];
+			cout << "  frame " << setw(27) << left << name << right << setw(9) << best << " ms, " << setprecision(2)
+				<< times[0] / best << "x" << setprecision(3) << endl;
+		}
+
+		bool same = (rasterisers[0].colour == rasterisers[1].colour && rasterisers[0].colour == rasterisers[2].colour);
+		cout << "  " << rasterisers[0].triangleCount() << " triangles, " << rasterisers[0].blocksSkipped()
+			<< " 8 x 8 blocks skipped by the hierarchical Z" << (same ? "" : ", DIFFERENT IMAGES") << endl;
+	}
+}
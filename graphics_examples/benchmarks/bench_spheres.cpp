@@ -0,0 +1,109 @@
+/* bench_spheres.cpp
+ Compares the latitude and longitude sphere with the icosphere and cube sphere: triangles,
+ vertices, the furthest any triangle sits inside the unit sphere (the error that decides how
+ round it looks), the ratio of the largest triangle to the smallest and the time to build.
+ Also finds the smallest latitude and longitude sphere as round as each of the others.
+*/
+
+#include "benchmarks.h"
+#include "mesh_builder.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+static const int repeats = 5;
+
+struct SphereStats
+{
+	size_t triangles, vertices;
+	double maxError, areaRatio;
+};
+
+/* Measure the mesh, which is the last one in the builder */
+static SphereStats measure(const MeshBuilder &builder)
+{
+	const MeshRange &range = builder.meshes.back();
+	const MeshVertex *v = &builder.vertices[range.firstVertex];
+	SphereStats stats = { range.indexCount / 3, range.vertexCount, 0.0, 0.0 };
+	double smallest = 1e30, largest = 0;
+	for (unsigned int i = 0; i < range.indexCount; i += 3)
+	{
+		const unsigned int *tri = &builder.indices[range.firstIndex + i];
+		dvec3 a(v[tri[0]].position[0], v[tri[0]].position[1], v[tri[0]].position[2]);
+		dvec3 b(v[tri[1]].position[0], v[tri[1]].position[1], v[tri[1]].position[2]);
+		dvec3 c(v[tri[2]].position[0], v[tri[2]].position[1], v[tri[2]].position[2]);
+		dvec3 n = cross(b - a, c - a);
+		double area = length(n) * 0.5;
+		if (area <= 0) continue;
+		smallest = std::min(smallest, area);
+		largest = std::max(largest, area);
+
+		// The triangle's plane is nearest the centre at its middle, so that is where it is furthest inside
+		stats.maxError = std::max(stats.maxError, 1.0 - fabs(dot(normalize(n), a)));
+	}
+	stats.areaRatio = largest / smallest;
+	return stats;
+}
+
+static double buildTime(MeshBuilder &builder, int kind, unsigned int size)
+{
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		builder.reset();
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		if (kind == 0) builder.addSphere(size, size);
+		else if (kind == 1) builder.addIcosphere(size);
+		else builder.addCubeSphere(size);
+		best = std::min(best, chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count());
+	}
+	return best;
+}
+
+static void report(const char *name, const SphereStats &stats, double time)
+{
+	cout << "  " << left << setw(22) << name << right << setw(8) << stats.triangles << setw(8) << stats.vertices
+		<< setw(12) << setprecision(6) << stats.maxError << setw(9) << setprecision(2) << stats.areaRatio
+		<< setw(9) << setprecision(3) << time << " ms" << endl;
+}
+
+void benchSphereGenerators()
+{
+	cout << "Sphere generators: triangles, vertices, max error, largest / smallest triangle, build time" << endl;
+	cout << fixed;
+
+	MeshBuilder builder;
+	const char *names[3] = { "lat/long", "icosphere level", "cube sphere" };
+	const char *resultNames[3] = { "spheres/latlong/", "spheres/icosphere/", "spheres/cubesphere/" };
+	unsigned int sizes[3][3] = { { 20, 40, 60 }, { 2, 3, 4 }, { 6, 12, 20 } };
+	for (int kind = 0; kind < 3; kind++)
+	{
+		for (int s = 0; s < 3; s++)
+		{
+			double time = buildTime(builder, kind, sizes[kind][s]);
+			SphereStats stats = measure(builder);
+			string name = string(names[kind]) + " " + to_string(sizes[kind][s]);
+			report(name.c_str(), stats, time);
+			recordResult(resultNames[kind] + to_string(sizes[kind][s]), repeats, time, (double)stats.triangles, 0,
+				stats.vertices * sizeof(MeshVertex) + stats.triangles * 3 * sizeof(unsigned int));
+
+			// The smallest lat/long sphere, with as many longitudes as latitudes, that is as round
+			if (kind == 0) continue;
+			for (unsigned int n = 4; n < 1000; n++)
+			{
+				builder.reset();
+				builder.addSphere(n, n);
+				SphereStats uv = measure(builder);
+				if (uv.maxError > stats.maxError) continue;
+				cout << "    as round as lat/long " << n << ": " << uv.triangles << " triangles, "
+					<< setprecision(2) << (double)stats.triangles / uv.triangles << " times as many here" << endl;
+				break;
+			}
+		}
+	}
+}
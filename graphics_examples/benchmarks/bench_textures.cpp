@@ -0,0 +1,79 @@
+/* bench_textures.cpp
+ Decoding the example textures with stb_image, the way the examples load them before the
+ upload. Each file is read into memory first so that the disk isn't timed, and decoded with
+ the channels it has, as the examples ask for. Reports the time, the rate in megapixels per
+ second and the memory the decoded pixels take against the size of the file.
+*/
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "benchmarks.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+static const int repeats = 3;
+
+void benchTextureDecoding(const vector<string> &images)
+{
+	cout << "Texture decoding with stb_image: size, channels, KB of file -> KB decoded, time, Mpixels/s" << endl;
+	cout << fixed;
+
+	double totalTime = 0, totalPixels = 0;
+	size_t totalFileBytes = 0, totalDecodedBytes = 0;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		ifstream in(images[i].c_str(), ios::in | ios::binary);
+		if (!in)
+		{
+			cout << "  can't open " << images[i] << endl;
+			continue;
+		}
+		stringstream contents;
+		contents << in.rdbuf();
+		string file = contents.str();
+
+		int width = 0, height = 0, channels = 0;
+		double best = 1e30;
+		for (int r = 0; r < repeats; r++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			unsigned char *data = stbi_load_from_memory((const stbi_uc*)file.data(), (int)file.size(), &width, &height, &channels, 0);
+			double time = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+			if (!data) break;
+			stbi_image_free(data);
+			best = std::min(best, time);
+		}
+		string name = images[i].substr(images[i].find_last_of("/\\") + 1);
+		if (best >= 1e30)
+		{
+			cout << "  can't decode " << name << ": " << stbi_failure_reason() << endl;
+			continue;
+		}
+
+		double pixels = (double)width * height;
+		size_t decodedBytes = (size_t)width * height * channels;
+		string size = to_string(width) + " x " + to_string(height);
+		cout << "  " << left << setw(20) << name << " " << setw(12) << size << right << setw(2) << channels
+			<< setw(8) << file.size() / 1024 << " KB -> " << setw(6) << decodedBytes / 1024 << " KB"
+			<< setw(9) << setprecision(2) << best << " ms" << setw(8) << setprecision(1) << pixels / best / 1000.0 << endl;
+
+		recordResult("textures/decode/" + name, repeats, best, pixels, (double)file.size(), decodedBytes);
+
+		totalTime += best;
+		totalPixels += pixels;
+		totalFileBytes += file.size();
+		totalDecodedBytes += decodedBytes;
+	}
+
+	if (totalTime > 0)
+	{
+		cout << "  all textures: " << setprecision(1) << totalTime << " ms, " << totalPixels / totalTime / 1000.0 << " Mpixels/s, "
+			<< totalFileBytes / 1024 << " KB of files -> " << totalDecodedBytes / 1024 << " KB decoded" << endl;
+	}
+}
@@ -0,0 +1,212 @@
+/* bench_transform.cpp
+ Compares the per-object glm path that the examples used (translate, three rotates and
+ a scale, then view * model, projection * view * model and transpose(inverse()) for
+ the normal matrix) with the batch transform kernels.
+ Then the world matrices of a tree of objects, made with the matrix stack that the labs
+ draw with and with SceneHierarchy, all of them and when only one has moved.
+*/
+
+#include "benchmarks.h"
+#include "batch_transform.h"
+#include "scene_hierarchy.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <stack>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+static const int repeats = 20;
+
+/* The matrices for one object, done the way DrawModel and poslight.cpp did them */
+static void glmTransform(vec3 position, vec3 rotation, vec3 size, const mat4 &view, const mat4 &projection, ObjectTransforms &out)
+{
+	mat4 model = translate(mat4(1.0f), position);
+	model = rotate(model, -radians(rotation.x), vec3(1, 0, 0));
+	model = rotate(model, -radians(rotation.y), vec3(0, 1, 0));
+	model = rotate(model, -radians(rotation.z), vec3(0, 0, 1));
+	model = scale(model, size);
+
+	out.model = model;
+	out.modelview = view * model;
+	out.mvp = projection * view * model;
+	mat3 normalmatrix = transpose(inverse(mat3(out.modelview)));
+	for (int c = 0; c < 3; c++) out.normalmatrix[c] = vec4(normalmatrix[c], 0);
+}
+
+/* Largest difference between any two matching floats */
+static float maxError(const vector<ObjectTransforms> &a, const vector<ObjectTransforms> &b)
+{
+	float worst = 0;
+	const float *fa = (const float*)&a[0], *fb = (const float*)&b[0];
+	size_t n = a.size() * sizeof(ObjectTransforms) / sizeof(float);
+	for (size_t i = 0; i < n; i++)
+	{
+		float d = fabs(fa[i] - fb[i]);
+		if (d > worst) worst = d;
+	}
+	return worst;
+}
+
+static double seconds(chrono::high_resolution_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void benchTransforms(size_t instances)
+{
+	// A spread of instances like the ground and wall tiles, with a few large angles
+	TransformBatch batch;
+	srand(1);
+	for (size_t i = 0; i < instances; i++)
+	{
+		vec3 position((rand() % 2000) / 100.f - 10.f, (rand() % 2000) / 100.f - 10.f, (rand() % 2000) / 100.f - 30.f);
+		vec3 rotation((float)(rand() % 3600 - 1800), (float)(rand() % 720), (float)(rand() % 360));
+		float s = 0.1f + (rand() % 100) / 50.f;
+		batch.add(position, rotation, vec3(s, s * 0.5f, s));
+	}
+
+	mat4 projection = perspective(radians(30.0f), 1.3333f, 0.1f, 100.0f);
+	mat4 view = lookAt(vec3(0.f, 0.8f, 5.f), vec3(0, 1, 0), vec3(0, 1, 0));
+
+	vector<ObjectTransforms> reference(instances), result(instances);
+
+	cout << "Transforms: " << instances << " instances, best path " << batchTransformPathName(batchTransformBestPath()) << endl;
+
+	// Per-object glm
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < instances; i++)
+		{
+			glmTransform(vec3(batch.px[i], batch.py[i], batch.pz[i]), vec3(batch.rx[i], batch.ry[i], batch.rz[i]),
+				vec3(batch.sx[i], batch.sy[i], batch.sz[i]), view, projection, reference[i]);
+		}
+		double t = seconds(start);
+		if (t < best) best = t;
+	}
+	double glmTime = best;
+	cout << fixed << setprecision(1);
+	cout << "  glm per object  " << setw(8) << glmTime * 1e9 / instances << " ns/instance" << endl;
+	recordResult("transforms/glm", repeats, glmTime * 1000.0, (double)instances);
+
+	// Each batch kernel that this CPU can run
+	for (int path = BATCH_SCALAR; path <= batchTransformBestPath(); path++)
+	{
+		best = 1e30;
+		for (int r = 0; r < repeats; r++)
+		{
+			chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+			batchTransform(batch, 0, instances, view, projection, &result[0], sizeof(ObjectTransforms), (BatchTransformPath)path);
+			double t = seconds(start);
+			if (t < best) best = t;
+		}
+
+		cout << "  batch " << setw(6) << left << batchTransformPathName((BatchTransformPath)path) << right << "    "
+			<< setw(8) << best * 1e9 / instances << " ns/instance  "
+			<< setw(5) << glmTime / best << "x  max error " << scientific << setprecision(2) << maxError(reference, result)
+			<< fixed << setprecision(1) << endl;
+		recordResult(string("transforms/batch_") + batchTransformPathName((BatchTransformPath)path), repeats, best * 1000.0, (double)instances);
+	}
+}
+
+/* The local transform of each node of the tree, whose children are the nodes 4n + 1 to 4n + 4 */
+struct TreeNodes
+{
+	vector<vec3> translation, rotation, scale;
+};
+
+/* Walk the tree with a matrix stack the way poslight.cpp draws its objects: push a copy of
+   the top, transform it, use it, do the children and pop */
+static void walkTree(const TreeNodes &tree, size_t node, stack<mat4> &model, vector<mat4> &world)
+{
+	model.push(model.top());
+	model.top() = translate(model.top(), tree.translation[node]);
+	model.top() = rotate(model.top(), -radians(tree.rotation[node].x), vec3(1, 0, 0));
+	model.top() = rotate(model.top(), -radians(tree.rotation[node].y), vec3(0, 1, 0));
+	model.top() = rotate(model.top(), -radians(tree.rotation[node].z), vec3(0, 0, 1));
+	model.top() = scale(model.top(), tree.scale[node]);
+	world[node] = model.top();
+
+	for (size_t child = node * 4 + 1; child <= node * 4 + 4 && child < world.size(); child++) walkTree(tree, child, model, world);
+	model.pop();
+}
+
+void benchMatrixStack(size_t nodes)
+{
+	if (nodes == 0) return;
+
+	TreeNodes tree;
+	SceneHierarchy hierarchy;
+	srand(2);
+	for (size_t i = 0; i < nodes; i++)
+	{
+		vec3 position((rand() % 200) / 100.f - 1.f, (rand() % 200) / 100.f, (rand() % 200) / 100.f - 1.f);
+		vec3 rotation((float)(rand() % 360), (float)(rand() % 360), (float)(rand() % 360));
+		float s = 0.5f + (rand() % 100) / 100.f;
+		tree.translation.push_back(position);
+		tree.rotation.push_back(rotation);
+		tree.scale.push_back(vec3(s));
+		hierarchy.addNode(i > 0 ? (int)(i - 1) / 4 : -1, position, rotation, vec3(0), vec3(s));
+	}
+
+	cout << "Matrix stack: world matrices of a tree of " << nodes << " nodes" << endl;
+	cout << fixed << setprecision(1);
+
+	// The whole tree with the stack, as it is drawn every frame
+	vector<mat4> world(nodes);
+	double stackTime = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		stack<mat4> model;
+		model.push(mat4(1.0f));
+		walkTree(tree, 0, model, world);
+		stackTime = std::min(stackTime, seconds(start));
+	}
+
+	// The whole tree with the hierarchy, by moving the root
+	double allTime = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		hierarchy.setRotation(0, tree.rotation[0] + vec3(r % 2 ? 0.f : 1.f, 0, 0));
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		hierarchy.update();
+		allTime = std::min(allTime, seconds(start));
+	}
+	hierarchy.setRotation(0, tree.rotation[0]);
+	hierarchy.update();
+
+	float worst = 0;
+	for (size_t i = 0; i < nodes; i++)
+	{
+		const float *a = &world[i][0][0], *b = &hierarchy.world((int)i)[0][0];
+		for (int k = 0; k < 16; k++) worst = std::max(worst, fabs(a[k] - b[k]));
+	}
+
+	// Only the last leaf moved, which the hierarchy skips straight to
+	double oneTime = 1e30;
+	int leaf = (int)nodes - 1;
+	for (int r = 0; r < repeats; r++)
+	{
+		hierarchy.setRotation(leaf, tree.rotation[leaf] + vec3(r % 2 ? 0.f : 1.f, 0, 0));
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		hierarchy.update();
+		oneTime = std::min(oneTime, seconds(start));
+	}
+
+	cout << "  matrix stack            " << setw(8) << stackTime * 1e9 / nodes << " ns/node" << endl;
+	cout << "  hierarchy, all moved    " << setw(8) << allTime * 1e9 / nodes << " ns/node  max difference "
+		<< scientific << setprecision(2) << worst << fixed << setprecision(1) << endl;
+	cout << "  hierarchy, one moved    " << setw(8) << oneTime * 1e9 << " ns in all" << endl;
+
+	recordResult("matrixstack/stack", repeats, stackTime * 1000.0, (double)nodes);
+	recordResult("matrixstack/hierarchy_all", repeats, allTime * 1000.0, (double)nodes);
+	recordResult("matrixstack/hierarchy_one", repeats, oneTime * 1000.0, 1.0);
+}
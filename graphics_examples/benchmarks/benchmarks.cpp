@@ -0,0 +1,203 @@
+/* benchmarks.cpp
+ Runs the micro-benchmarks and prints the results.
+ Usage: benchmarks [-json file] [-only name,name...] [instances] [model.obj ...]
+ With no models given, the OBJ benchmarks use the models from assignment_two. -only runs just
+ the benchmarks named, by the names in main. -json also writes the results to
+ file in the layout of Google Benchmark's --benchmark_out, so its compare.py and the tools that
+ read that can track them from run to run.
+*/
+
+#include "benchmarks.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+using namespace std;
+
+/* The models that assignment_two loads, relative to the benchmarks project folder */
+static const char* defaultModels[] = {
+	"../assignment_two/Models/monkey.obj",
+	"../assignment_two/Models/monkey_normals.obj",
+	"../assignment_two/Models/rock.obj",
+	"../assignment_two/Models/tree.obj",
+	"../assignment_two/Models/Books/books.obj",
+	"../assignment_two/Models/Ground/ground.obj",
+	"../assignment_two/Models/Katana/katana.obj",
+	"../assignment_two/Models/Squirrel/squirrel.obj",
+	"../assignment_two/Models/Turtle/turtle.obj"
+};
+
+/* The textures in the images folder and with the models */
+static const char* defaultImages[] = {
+	"../../images/asteroid.png",
+	"../../images/bark1.png",
+	"../../images/earth.png",
+	"../../images/earth_no_clouds.jpg",
+	"../../images/grass.jpg",
+	"../../images/gravel.jpg",
+	"../../images/ground1.jpg",
+	"../../images/ground2.jpg",
+	"../../images/ground3.jpg",
+	"../../images/img.png",
+	"../../images/jupiter.png",
+	"../../images/wood.jpg",
+	"../assignment_two/Models/Buddha/buddha.jpg",
+	"../assignment_two/Models/Buddha/buddha.png",
+	"../assignment_two/Models/Ground/ground.jpg",
+	"../assignment_two/Models/Ground/ground-2.jpg",
+	"../assignment_two/Models/Rock Wall/Maps/1.jpg",
+	"../assignment_two/Models/Rock Wall/Maps/2.jpg",
+	"../assignment_two/Models/Squirrel/squirrel.png",
+	"../assignment_two/Models/Squirrel/squirrel-ud.png"
+};
+
+struct BenchResult
+{
+	string name;
+	int iterations;
+	double milliseconds;
+	double items, bytes;
+	size_t memory;
+};
+
+static vector<BenchResult> results;
+
+void recordResult(const string &name, int iterations, double milliseconds, double items, double bytes, size_t memory)
+{
+	BenchResult result = { name, iterations, milliseconds, items, bytes, memory };
+	results.push_back(result);
+}
+
+static string jsonString(const string &text)
+{
+	string quoted = "\"";
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '"' || text[i] == '\\') quoted += '\\';
+		quoted += text[i];
+	}
+	return quoted + "\"";
+}
+
+static bool writeJson(const string &file, const char *executable, size_t instances)
+{
+	ofstream out(file.c_str());
+	if (!out) return false;
+
+	char date[32];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	out << "{" << endl;
+	out << "  \"context\": {" << endl;
+	out << "    \"date\": " << jsonString(date) << "," << endl;
+	out << "    \"executable\": " << jsonString(executable) << "," << endl;
+	out << "    \"num_cpus\": " << thread::hardware_concurrency() << "," << endl;
+	out << "    \"instances\": " << instances << "," << endl;
+#ifdef NDEBUG
+	out << "    \"library_build_type\": \"release\"" << endl;
+#else
+	out << "    \"library_build_type\": \"debug\"" << endl;
+#endif
+	out << "  }," << endl;
+	out << "  \"benchmarks\": [";
+
+	out << setprecision(10);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		double seconds = r.milliseconds / 1000.0;
+		out << (i > 0 ? "," : "") << endl << "    {" << endl;
+		out << "      \"name\": " << jsonString(r.name) << "," << endl;
+		out << "      \"run_name\": " << jsonString(r.name) << "," << endl;
+		out << "      \"run_type\": \"iteration\"," << endl;
+		out << "      \"iterations\": " << r.iterations << "," << endl;
+		out << "      \"real_time\": " << r.milliseconds << "," << endl;
+		out << "      \"cpu_time\": " << r.milliseconds << "," << endl;
+		out << "      \"time_unit\": \"ms\"";
+		if (r.bytes > 0 && seconds > 0) out << "," << endl << "      \"bytes_per_second\": " << r.bytes / seconds;
+		if (r.items > 0 && seconds > 0) out << "," << endl << "      \"items_per_second\": " << r.items / seconds;
+		if (r.memory > 0) out << "," << endl << "      \"memory_bytes\": " << r.memory;
+		out << endl << "    }";
+	}
+	out << endl << "  ]" << endl << "}" << endl;
+	return out.good();
+}
+
+static int usage(const char *executable)
+{
+	cerr << "Usage: " << executable << " [-json file] [-only name,name...] [instances] [model.obj ...]" << endl;
+	cerr << "instances must be a whole number above 0" << endl;
+	return 1;
+}
+
+/* Whether to run the benchmark called name, with a blank line between the ones that run */
+static bool selected(const string &only, const char *name)
+{
+	static bool first = true;
+	if (!only.empty() && only.find("," + string(name) + ",") == string::npos) return false;
+	if (!first) cout << endl;
+	first = false;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t instances = 10000;
+	string jsonFile, only;
+
+	int arg = 1;
+	for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if (strcmp(argv[arg], "-json") == 0) jsonFile = argv[arg + 1];
+		else if (strcmp(argv[arg], "-only") == 0) only = "," + string(argv[arg + 1]) + ",";
+		else return usage(argv[0]);
+	}
+	if (arg < argc)
+	{
+		// A count that isn't a number would run nothing and divide by 0 in the rates
+		char *end;
+		unsigned long count = strtoul(argv[arg], &end, 10);
+		if (end == argv[arg] || *end != 0 || count == 0 || argv[arg][0] == '-') return usage(argv[0]);
+		instances = (size_t)count;
+		arg++;
+	}
+
+	vector<string> models(argv + arg, argv + argc);
+	if (models.empty()) models.assign(defaultModels, defaultModels + sizeof(defaultModels) / sizeof(defaultModels[0]));
+	vector<string> images(defaultImages, defaultImages + sizeof(defaultImages) / sizeof(defaultImages[0]));
+
+	if (selected(only, "transforms")) benchTransforms(instances);
+	if (selected(only, "matrixstack")) benchMatrixStack(instances);
+	if (selected(only, "objparse")) benchObjParsing(models);
+	if (selected(only, "objload")) benchObjLoading(models);
+	if (selected(only, "weld")) benchVertexWelding(models);
+	if (selected(only, "meshopt")) benchMeshOptimisation(models);
+	if (selected(only, "quantise")) benchVertexQuantisation(models);
+	if (selected(only, "meshlets")) benchMeshletCulling(models);
+	if (selected(only, "normals")) benchNormalGeneration(models);
+	if (selected(only, "meshbuild")) benchMeshBuilding(instances);
+	if (selected(only, "shapes")) benchShapeGeneration();
+	if (selected(only, "spheres")) benchSphereGenerators();
+	if (selected(only, "textures")) benchTextureDecoding(images);
+	if (selected(only, "drawlists")) benchDrawRecording(instances);
+	if (selected(only, "lightclusters")) benchLightClustering();
+	if (selected(only, "occlusion")) benchOcclusionCulling();
+	if (selected(only, "softraster")) benchSoftRasteriser();
+	if (selected(only, "raytrace")) benchRayTracing();
+
+	if (!jsonFile.empty())
+	{
+		if (!writeJson(jsonFile, argv[0], instances))
+		{
+			cerr << "Could not write " << jsonFile << endl;
+			return 1;
+		}
+		cout << endl << "Wrote " << results.size() << " results to " << jsonFile << endl;
+	}
+	return 0;
+}
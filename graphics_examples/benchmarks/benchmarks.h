@@ -0,0 +1,36 @@
+/* benchmarks.h
+ Micro-benchmarks for the CPU side of the examples. None of them need a window or an
+ OpenGL context. Each prints a table and records its main figures with recordResult(),
+ which main can write out as JSON.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* A result for the JSON output. name is "group/case", milliseconds is the best of the
+   iterations, items and bytes are what one iteration processed, for the rates, and memory is
+   the bytes its output takes. Leave any of those 0 when they don't apply */
+void recordResult(const std::string &name, int iterations, double milliseconds, double items = 0, double bytes = 0,
+	size_t memory = 0);
+
+void benchTransforms(size_t instances);
+void benchMatrixStack(size_t nodes);
+void benchObjParsing(const std::vector<std::string> &models);
+void benchObjLoading(const std::vector<std::string> &models);
+void benchVertexWelding(const std::vector<std::string> &models);
+void benchMeshOptimisation(const std::vector<std::string> &models);
+void benchVertexQuantisation(const std::vector<std::string> &models);
+void benchMeshletCulling(const std::vector<std::string> &models);
+void benchNormalGeneration(const std::vector<std::string> &models);
+void benchMeshBuilding(size_t objects);
+void benchShapeGeneration();
+void benchSphereGenerators();
+void benchTextureDecoding(const std::vector<std::string> &images);
+void benchDrawRecording(size_t instances);
+void benchLightClustering();
+void benchOcclusionCulling();
+void benchSoftRasteriser();
+void benchRayTracing();
@@ -38,9 +38,11 @@ also includes the OpenGL extension initialisation*/
 // Include headers for our objects
 #include "sphere.h"
 #include "cube.h"
+#include "transform_pipeline.h"
 
 
 GLuint program;		/* Identifier for the shader program */
+TransformPipeline transforms;	/* Per-object matrices, computed on the CPU */
 GLuint vao;			/* Vertex array (Container) object. This is the index of the VAO that will be the container for
 					our buffer objects */
 
@@ -55,7 +57,6 @@ GLuint drawmode;			// Defines drawing mode of sphere as points, lines or filled
 GLuint numlats, numlongs;	//Define the resolution of the sphere object
 
 /* Uniforms*/
-GLuint modelID, viewID, projectionID;
 GLuint colourmodeID;
 GLuint lightPosID;
 
@@ -106,12 +107,13 @@ void init(GLWrapper* glw)
 	}
 
 	/* Define uniforms to send to vertex shader */
-	modelID = glGetUniformLocation(program, "model");
 	colourmodeID = glGetUniformLocation(program, "colourmode");
-	viewID = glGetUniformLocation(program, "view");
-	projectionID = glGetUniformLocation(program, "projection");
 	lightPosID = glGetUniformLocation(program, "lightPos");
 
+	/* The model, model-view and normal matrices come from the transform pipeline */
+	transforms.makePipeline();
+	transforms.bindProgram(program);
+
 	/* create our sphere and cube objects */
 	aSphere.makeSphere(numlats, numlongs);
 	aCube.makeCube();
@@ -146,12 +148,11 @@ void display()
 		vec3(0, 1, 0)  // Head is up (set to 0,-1,0 to look upside-down)
 	);
 
-	// Send our projection and view uniforms to the currently bound shader
+	// Send our projection and view to the transform pipeline and our uniforms to the currently bound shader
 	// I do that here because they are the same for all objects
 	glUniform1ui(colourmodeID, colourmode);
 	glUniform3f(lightPosID, lightPosition.x, lightPosition.y, lightPosition.z);
-	glUniformMatrix4fv(viewID, 1, GL_FALSE, &view[0][0]);
-	glUniformMatrix4fv(projectionID, 1, GL_FALSE, &projection[0][0]);
+	transforms.beginFrame(view, projection);
 
 	// Define our model transformation in a stack and 
 	// push the identity matrix onto the stack
@@ -173,8 +174,8 @@ void display()
 		// Define the model transformations for the cube
 		model.top() = translate(model.top(), vec3(x + 0.5f, y, z));
 
-		// Send the model uniform to the currently bound shader,
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
+		// Send the model transforms to the currently bound shader,
+		transforms.setModel(model.top());
 
 		/* Draw our cube*/
 		aCube.drawCube(drawmode);
@@ -187,7 +188,7 @@ void display()
 		model.top() = translate(model.top(), vec3(-x - 0.5f, 0, 0));
 		model.top() = scale(model.top(), vec3(model_scale / 3.f, model_scale / 3.f, model_scale / 3.f));//scale equally in all axis
 
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
+		transforms.setModel(model.top());
 
 		/* Draw our sphere */
 		aSphere.drawSphere(drawmode);
@@ -200,7 +201,7 @@ void display()
 		model.top() = translate(model.top(), lightPosition);
 		model.top() = scale(model.top(), vec3(model_scale / 6.f, model_scale / 6.f, model_scale / 6.f));//scale equally in all axis
 
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
+		transforms.setModel(model.top());
 
 		/* Draw our sphere */
 		aSphere.drawSphere(drawmode);
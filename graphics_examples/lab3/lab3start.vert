@@ -10,7 +10,7 @@ layout(location = 1) in vec4 colour;
 layout(location = 2) in vec3 normal;
 
 // Uniform variables are passed in from the application
-uniform mat4 model, view, projection;
+#include "../../shaders/transforms.glsl"
 uniform uint colourmode;
 
 // Output the vertex colour - to be rasterized into pixel fragments
@@ -25,13 +25,9 @@ void main()
 
 	vec3 lightDirection = vec3(0, 1, 1);
 
-	mat4 model_view = model * view;
-
 	vec4 vertexPosition = vec4(position, 1.0);
 
-	mat3 normal_matrix = transpose(inverse(mat3(model_view)));
-
-	vec3 normalVector = normal_matrix * normal;
+	vec3 normalVector = normalmatrix * normal;
 
 	lightDirection = normalize(lightDirection);
 	normalVector = normalize(normalVector);
@@ -53,7 +49,7 @@ void main()
 	// P is the vertex position transformed by the model-view matrix.
 	// R is the reflected light beam of the plane defined by the vertex normal
 	// Specular colour is an RGB colour (e.g. white)
-	vec3 V = normalize(-(vertexPosition * model_view).xyz);
+	vec3 V = normalize(-(modelview * vertexPosition).xyz);
 	vec3 R = reflect(lightDirection, normal);
 	vec3 specular = pow(max(dot(R, V), 0.0), 8) * vec3(1, 0, 0);
 
@@ -65,6 +61,6 @@ void main()
 	fcolour = diffuse_colour * dotProduct + ambient + vec4(specular, 1.0);
 
 	// Define the vertex position
-	gl_Position = projection * view * model * position_h;
+	gl_Position = mvp * position_h;
 }
 
@@ -32,11 +32,15 @@ if you prefer */
 // Include headers for our objects
 #include "sphere.h"
 #include "cube.h"
+#include "shader_variants.h"
+#include "transform_pipeline.h"
 
 /* Define buffer object indices */
 GLuint elementbuffer;
 
-GLuint program;		/* Identifier for the shader prgoram */
+ShaderVariants shaders;	/* Compile-time variants of the shader program */
+TransformPipeline transforms;	/* Per-object matrices, computed on the CPU */
+GLuint emitFeature, attenuationFeature, colourFeature;
 GLuint vao;			/* Vertex array (Containor) object. This is the index of the VAO that will be the container for
 					   our buffer objects */
 
@@ -56,8 +60,7 @@ GLfloat speed;				// movement increment
 GLfloat light_x, light_y, light_z;
 
 /* Uniforms*/
-GLuint modelID, viewID, projectionID, lightposID, normalmatrixID;
-GLuint colourmodeID, emitmodeID, attenuationmodeID;
+GLuint lightposID;
 
 GLfloat aspect_ratio;		/* Aspect ratio of the window defined in the reshape callback*/
 GLuint numspherevertices;
@@ -69,6 +72,9 @@ Cube aCube;
 using namespace std;
 using namespace glm;
 
+/* Per-frame uniforms, sent to each shader variant the first time it is used in a frame */
+vec4 frameLight;
+
 /*
 This function is called before entering the main rendering loop.
 Use it for all your initialisation stuff
@@ -97,10 +103,29 @@ void init(GLWrapper* glw)
 	// Create the vertex array object and make it current
 	glBindVertexArray(vao);
 
-	/* Load and build the vertex and fragment shaders */
+	/* Load and build the vertex and fragment shaders. The colour, emit and attenuation modes
+	   select compile-time variants of the program */
+	shaders.load(glw, "poslight.vert", "poslight.frag");
+	emitFeature = shaders.addFeature("EMIT");
+	attenuationFeature = shaders.addFeature("ATTENUATION");
+	colourFeature = shaders.addFeature("COLOURMODE");
+
+	/* The model, model-view and normal matrices come from the transform pipeline */
+	transforms.makePipeline();
+	shaders.bindUniformBlock("Transforms", transforms.bindingPoint);
+
+	/* Define uniforms to send to vertex shader */
+	shaders.bindUniform("lightpos", &lightposID);
+
+	/* Build every variant now, so that one that fails to compile is caught here rather than
+	   when a key first selects it in the middle of drawing */
 	try
 	{
-		program = glw->LoadShader("poslight.vert", "poslight.frag");
+		GLuint allFeatures = emitFeature | attenuationFeature | colourFeature;
+		for (GLuint features = 0; features <= allFeatures; features++)
+		{
+			if ((features & ~allFeatures) == 0) shaders.program(features);
+		}
 	}
 	catch (exception& e)
 	{
@@ -109,21 +134,20 @@ void init(GLWrapper* glw)
 		exit(0);
 	}
 
-	/* Define uniforms to send to vertex shader */
-	modelID = glGetUniformLocation(program, "model");
-	colourmodeID = glGetUniformLocation(program, "colourmode");
-	emitmodeID = glGetUniformLocation(program, "emitmode");
-	attenuationmodeID = glGetUniformLocation(program, "attenuationmode");
-	viewID = glGetUniformLocation(program, "view");
-	projectionID = glGetUniformLocation(program, "projection");
-	lightposID = glGetUniformLocation(program, "lightpos");
-	normalmatrixID = glGetUniformLocation(program, "normalmatrix");
-
 	/* create our sphere and cube objects */
 	aSphere.makeSphere(numlats, numlongs);
 	aCube.makeCube();
 }
 
+/* Make a variant of the shader current, sending it the per-frame uniforms if it hasn't had them yet */
+void useVariant(GLuint features)
+{
+	if (shaders.use(features))
+	{
+		glUniform4fv(lightposID, 1, value_ptr(frameLight));
+	}
+}
+
 /* Called to update the display. Note that this function is called in the event loop in the wrapper
    class because we registered display as a callback function */
 void display()
@@ -137,17 +161,14 @@ void display()
 	/* Enable depth test  */
 	glEnable(GL_DEPTH_TEST);
 
-	/* Make the compiled shader program current */
-	glUseProgram(program);
+	/* Start a new frame of shader variant use */
+	shaders.beginFrame();
 
 	// Define our model transformation in a stack and 
 	// push the identity matrix onto the stack
 	stack<mat4> model;
 	model.push(mat4(1.0f));
 
-	// Define the normal matrix
-	mat3 normalmatrix;
-
 	// Projection matrix : 45 Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
 	mat4 projection = perspective(radians(30.0f), aspect_ratio, 0.1f, 100.0f);
 
@@ -166,33 +187,31 @@ void display()
 	// Define the light position and transform by the view matrix
 	vec4 lightpos = view * vec4(light_x, light_y, light_z, 1.0);
 
-	// Send our projection and view uniforms to the currently bound shader
-	// I do that here because they are the same for all objects
-	glUniform1ui(colourmodeID, colourmode);
-	glUniform1ui(attenuationmodeID, attenuationmode);
-	glUniformMatrix4fv(viewID, 1, GL_FALSE, &view[0][0]);
-	glUniformMatrix4fv(projectionID, 1, GL_FALSE, &projection[0][0]);
-	glUniform4fv(lightposID, 1, value_ptr(lightpos));
+	// Keep the light position for the shader variants and give the view and projection
+	// to the transform pipeline. I do that here because they are the same for all objects
+	frameLight = lightpos;
+	transforms.beginFrame(view, projection);
+
+	// Select the variant for the current colour and attenuation modes
+	GLuint features = (colourmode ? colourFeature : 0) | (attenuationmode ? attenuationFeature : 0);
 
 	/* Draw a small sphere in the lightsource position to visually represent the light source */
 	model.push(model.top());
 	{
+		useVariant(features | emitFeature);
+
 		model.top() = translate(model.top(), vec3(light_x, light_y, light_z));
 		model.top() = scale(model.top(), vec3(0.05f, 0.05f, 0.05f)); // make a small sphere
-		// Recalculate the normal matrix and send the model and normal matrices to the vertex shader
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-		normalmatrix = transpose(inverse(mat3(view * model.top())));
-		glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+		// Send the model, model-view and normal matrices to the vertex shader
+		transforms.setModel(model.top());
 
 		/* Draw our lightposition sphere  with emit mode on*/
-		emitmode = 1;
-		glUniform1ui(emitmodeID, emitmode);
 		aSphere.drawSphere(drawmode);
-		emitmode = 0;
-		glUniform1ui(emitmodeID, emitmode);
 	}
 	model.pop();
 
+	useVariant(features);
+
 	// Define the global model transformations (rotate and scale). Note, we're not modifying thel ight source position
 	model.top() = scale(model.top(), vec3(model_scale, model_scale, model_scale));//scale equally in all axis
 	model.top() = rotate(model.top(), -radians(angle_x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
@@ -205,12 +224,8 @@ void display()
 		// Define the model transformations for the cube
 		model.top() = translate(model.top(), vec3(x + 0.5f, y, z));
 
-		// Send the model uniform and normal matrix to the currently bound shader,
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-
-		// Recalculate the normal matrix and send to the vertex shader
-		normalmatrix = transpose(inverse(mat3(view * model.top())));
-		glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+		// Send the model transforms to the currently bound shader
+		transforms.setModel(model.top());
 
 		/* Draw our cube*/
 		aCube.drawCube(drawmode);
@@ -223,10 +238,8 @@ void display()
 		model.top() = translate(model.top(), vec3(-x - 0.5f, 0, 0));
 		model.top() = scale(model.top(), vec3(model_scale / 3.f, model_scale / 3.f, model_scale / 3.f));//scale equally in all axis
 
-		// Recalculate the normal matrix and send the model and normal matrices to the vertex shader																							// Recalculate the normal matrix and send to the vertex shader																								// Recalculate the normal matrix and send to the vertex shader																								// Recalculate the normal matrix and send to the vertex shader																						// Recalculate the normal matrix and send to the vertex shader
-		glUniformMatrix4fv(modelID, 1, GL_FALSE, &(model.top()[0][0]));
-		normalmatrix = transpose(inverse(mat3(view * model.top())));
-		glUniformMatrix3fv(normalmatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+		// Send the model, model-view and normal matrices to the vertex shader
+		transforms.setModel(model.top());
 
 		aSphere.drawSphere(drawmode); // Draw our sphere
 	}
@@ -18,13 +18,9 @@ out vec3 lightDirection;
 out vec3 vertexNormal;
 
 // These are the uniforms that are defined in the application
-uniform mat4 model, view, projection;
-uniform mat3 normalmatrix;
-uniform uint colourmode, emitmode;
+#include "../../shaders/transforms.glsl"
 uniform vec4 lightpos;
 
-uniform uint attenuationmode;
-
 // Global constants (for this vertex shader)
 vec3 specular_albedo = vec3(1.0, 0.8, 0.6);
 vec3 global_ambient = vec3(0.05, 0.05, 0.05);
@@ -37,17 +33,17 @@ void main()
 	vec4 diffuse_albedo;					// This is the vertex colour, used to handle the colourmode change
 	vec3 light_pos3 = lightpos.xyz;			
 
-	// Switch the vertex colour based on the colourmode
-	if (colourmode == 1)
-		diffuse_albedo = colour;
-	else
-		diffuse_albedo = vec4(1.0, 0, 0, 1.0);
+	// Switch the vertex colour based on the colourmode, which is compiled in as the COLOURMODE variant
+#ifdef COLOURMODE
+	diffuse_albedo = colour;
+#else
+	diffuse_albedo = vec4(1.0, 0, 0, 1.0);
+#endif
 
 	vec3 ambient = diffuse_albedo.xyz * 0.2;
 
 	// Define our vectors to calculate diffuse and specular lighting
-	mat4 mv_matrix = view * model;		// Calculate the model-view transformation
-	vec4 P = mv_matrix * position_h;	// Modify the vertex position (x, y, z, w) by the model-view transformation
+	vec4 P = modelview * position_h;	// Modify the vertex position (x, y, z, w) by the model-view transformation
 	vec3 N = normalize(normalmatrix * normal);		// Modify the normals by the normal-matrix (i.e. to model-view (or eye) coordinates )
 	vec3 L = light_pos3 - P.xyz;		// Calculate the vector from the light position to the vertex in eye space
 	float distanceToLight = length(L);	// For attenuation
@@ -100,7 +96,7 @@ void main()
 
 	lightDirection = L;
 
-	gl_Position = (projection * view * model) * position_h;
+	gl_Position = mvp * position_h;
 }
 
 
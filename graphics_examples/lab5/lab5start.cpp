@@ -67,7 +67,6 @@ bool load_texture(char* filename, GLuint& texID, bool bGenMipmaps);
 
 bool load_texture(const char* filename, GLuint& texID, bool bGenMipmaps)
 {
-	glGenTextures(1, &texID);
 	// local image parameters
 	int width, height, nrChannels;
 
@@ -84,6 +83,9 @@ bool load_texture(const char* filename, GLuint& texID, bool bGenMipmaps)
 		else
 			pixel_format = GL_RGBA;
 
+		// Only make the texture once the image has loaded, so a failed load doesn't leave one behind
+		glGenTextures(1, &texID);
+
 		// Bind the texture ID before the call to create the texture.
 			// texID[i] will now be the identifier for this specific texture
 		glBindTexture(GL_TEXTURE_2D, texID);
@@ -105,6 +107,7 @@ bool load_texture(const char* filename, GLuint& texID, bool bGenMipmaps)
 	else
 	{
 		printf("stb_image  loading error: filename=%s", filename);
+		texID = 0;
 		return false;
 	}
 	stbi_image_free(data);
@@ -7,6 +7,7 @@ Iain Martin November 2018
 */
 
 #include "tiny_loader.h"
+#include "mesh_normals.h"
 #include <iostream>
 #include <stdio.h>
 
@@ -33,6 +34,7 @@ TinyObjLoader::TinyObjLoader()
 	numVertices = 0;
 	numNormals = 0;
 	numTexCoords = 0;
+	materialColours = false;
 }
 
 TinyObjLoader::~TinyObjLoader()
@@ -47,8 +49,11 @@ void TinyObjLoader::load_obj(string inputfile, bool debugPrint)
 	vector<tinyobj::material_t> materials;
 
 
+	// Material files are found relative to the obj file
+	string baseDir = inputfile.substr(0, inputfile.find_last_of("/\\") + 1);
+
 	string err, warn;
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &warn, inputfile.c_str());
+	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &warn, inputfile.c_str(), baseDir.c_str());
 
 	if (!err.empty()) { // `err` may contain error messages.
 		cerr << err << endl;
@@ -72,14 +77,37 @@ void TinyObjLoader::load_obj(string inputfile, bool debugPrint)
 		cout << "Warning: there were no vertices in this Obj file." << endl;
 	}
 
-	if (numNormals <= 0)
-	{
-		cout << "Warning: there were no normals in this Obj file. " << endl;
-		cout << "\tEither create an Obj file with normals or add code to calculate the normals. " << endl;
-	}
-
 	vector<tinyobj::real_t> pVertices = attrib.vertices;
 	vector<tinyobj::real_t> pNormals = attrib.normals;
+
+	if (numNormals <= 0 && numVertices > 0)
+	{
+		cout << "There were no normals in this Obj file, so smooth normals have been calculated." << endl;
+
+		/* The normal buffer has one normal for each position, so every face around a position
+		   is smoothed together and there are no creases */
+		vector<GLuint> positionIndices;
+		for (size_t s = 0; s < shapes.size(); s++) {
+			size_t index_offset = 0;
+			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
+				int fv = shapes[s].mesh.num_face_vertices[f];
+				for (int v = 0; v < fv; v++) {
+					positionIndices.push_back(shapes[s].mesh.indices[index_offset + v].vertex_index);
+				}
+				index_offset += fv;
+			}
+		}
+
+		vector<float> cornerNormals(positionIndices.size() * 3);
+		if (!positionIndices.empty())
+			generateNormals(&pVertices[0], numVertices, &positionIndices[0], positionIndices.size(), NULL, 180.f, &cornerNormals[0]);
+
+		pNormals.assign(numVertices * 3, 0.f);
+		for (size_t i = 0; i < positionIndices.size(); i++) {
+			for (int c = 0; c < 3; c++) pNormals[positionIndices[i] * 3 + c] = cornerNormals[i * 3 + c];
+		}
+		numNormals = numVertices;
+	}
 	vector<tinyobj::real_t> pColors = attrib.colors;
 	vector<tinyobj::real_t> pTexCoords = attrib.texcoords;
 
@@ -94,7 +122,38 @@ void TinyObjLoader::load_obj(string inputfile, bool debugPrint)
 
 	cout << shapes.size() << endl;
 	cout << attrib.vertices.size() << endl;
-	int ind = 0;
+
+	// Count the faces of each material, -1 (no material) goes in slot 0
+	vector<GLuint> materialStart(materials.size() + 2, 0);
+	for (size_t s = 0; s < shapes.size(); s++) {
+		for (size_t f = 0; f < shapes[s].mesh.material_ids.size(); f++) {
+			int m = shapes[s].mesh.material_ids[f];
+			if (m < -1 || m >= (int)materials.size()) m = -1;
+			materialStart[m + 2] += 3;
+		}
+	}
+
+	// Each material's faces start where the previous material's end
+	for (size_t m = 1; m < materialStart.size(); m++) {
+		materialStart[m] += materialStart[m - 1];
+	}
+
+	submeshes.clear();
+	for (size_t m = 0; m + 1 < materialStart.size(); m++) {
+		if (materialStart[m + 1] == materialStart[m]) continue;
+
+		Submesh submesh;
+		submesh.material = (int)m - 1;
+		submesh.firstIndex = materialStart[m];
+		submesh.indexCount = materialStart[m + 1] - materialStart[m];
+		submesh.colour = vec4(1.f);
+		if (submesh.material >= 0) {
+			const tinyobj::real_t *kd = materials[submesh.material].diffuse;
+			submesh.colour = vec4(kd[0], kd[1], kd[2], 1.f);
+		}
+		submeshes.push_back(submesh);
+	}
+	materialColours = !materials.empty();
 
 	// Loop over shapes
 	for (size_t s = 0; s < shapes.size(); s++) {
@@ -105,6 +164,11 @@ void TinyObjLoader::load_obj(string inputfile, bool debugPrint)
 	
 			int fv = shapes[s].mesh.num_face_vertices[f];//number of vertices per face
 
+			// per-face material, which decides where in the element buffer the face goes
+			int m = shapes[s].mesh.material_ids[f];
+			if (m < -1 || m >= (int)materials.size()) m = -1;
+			GLuint &ind = materialStart[m + 1];
+
 			// Loop over vertices in the face.
 			for (size_t v = 0; v < fv; v++) {
 				
@@ -115,9 +179,6 @@ void TinyObjLoader::load_obj(string inputfile, bool debugPrint)
 
 			}
 			index_offset += fv;
-
-			// per-face material
-			shapes[s].mesh.material_ids[f];
 		}
 	}
 
@@ -150,7 +211,7 @@ void TinyObjLoader::load_obj(string inputfile, bool debugPrint)
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-	delete pIndices;
+	delete[] pIndices;
 }
 
 
@@ -167,10 +228,17 @@ void TinyObjLoader::drawObject(int drawmode)
 	glVertexAttribPointer(attribute_v_normal, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 	glEnableVertexAttribArray(attribute_v_normal);
 
-	/* Bind the object colours */
-	glBindBuffer(GL_ARRAY_BUFFER, colourBufferObject);
-	glVertexAttribPointer(attribute_v_colours, 4, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(attribute_v_colours);
+	/* Bind the object colours, unless each material's colour is set for its submesh */
+	if (materialColours)
+	{
+		glDisableVertexAttribArray(attribute_v_colours);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, colourBufferObject);
+		glVertexAttribPointer(attribute_v_colours, 4, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(attribute_v_colours);
+	}
 
 	if (numTexCoords > 0)
 	{
@@ -194,6 +262,15 @@ void TinyObjLoader::drawObject(int drawmode)
 	{
 		glDrawArrays(GL_POINTS, 0, numVertices);
 	}
+	else if (materialColours)
+	{
+		// One draw per material, with its colour as a constant vertex attribute
+		for (size_t i = 0; i < submeshes.size(); i++)
+		{
+			glVertexAttrib4fv(attribute_v_colours, &submeshes[i].colour[0]);
+			glDrawElements(GL_TRIANGLES, submeshes[i].indexCount, GL_UNSIGNED_INT, (GLvoid*)(submeshes[i].firstIndex * sizeof(GLuint)));
+		}
+	}
 	else
 	{
 		glDrawElements(GL_TRIANGLES, numPIndexes, GL_UNSIGNED_INT, (GLvoid*)(0));
@@ -217,6 +294,9 @@ void TinyObjLoader::overrideColour(glm::vec4 c)
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vec4) * numVertices, pColours, GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+	delete[] pColours;
+	materialColours = false;
+
 }
 
 
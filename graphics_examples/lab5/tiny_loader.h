@@ -3,6 +3,8 @@ Example class to demonstrate the use of TinyObjectLoader to load an obj (WaveFro
 object file and copy the date into vertex, normal and element buffers.
 This is incomplete: I've tested it with vertices, normals and elements but not
 with texture coordinates.
+Faces are sorted by material into submeshes, which are drawn with the material's diffuse
+colour unless overrideColour has been called.
 Iain Martin November 2018
 */
 
@@ -22,6 +24,15 @@ public:
 	void drawObject(int drawmode);
 	void overrideColour(glm::vec4 c);
 
+	/* A range of the element buffer with one material */
+	struct Submesh
+	{
+		int material;			// index in the obj file's materials, -1 for faces without one
+		GLuint firstIndex;
+		GLuint indexCount;
+		glm::vec4 colour;		// the material's Kd
+	};
+
 private:
 	// Define vertex buffer object names (e.g as globals)
 	GLuint positionBufferObject;
@@ -40,6 +51,8 @@ private:
 	GLuint numNormals;
 	GLint  numTexCoords;
 	GLuint numPIndexes;
-	
+
+	std::vector<Submesh> submeshes;
+	bool materialColours;		// draw with the submesh colours rather than the colour buffer
 
 };
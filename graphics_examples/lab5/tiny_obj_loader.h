@@ -292,6 +292,8 @@ typedef struct callback_t_ {
   // There may be multiple group names
   void (*group_cb)(void *user_data, const char **names, int num_names);
   void (*object_cb)(void *user_data, const char *name);
+  // `smoothing_group_id` = 0 for "s off"
+  void (*smoothing_group_cb)(void *user_data, unsigned int smoothing_group_id);
 
   callback_t_()
       : vertex_cb(NULL),
@@ -301,7 +303,8 @@ typedef struct callback_t_ {
         usemtl_cb(NULL),
         mtllib_cb(NULL),
         group_cb(NULL),
-        object_cb(NULL) {}
+        object_cb(NULL),
+        smoothing_group_cb(NULL) {}
 } callback_t;
 
 class MaterialReader {
@@ -412,6 +415,11 @@ bool ParseTextureNameAndOption(std::string *texname,
 #include <cstring>
 #include <limits>
 #include <utility>
+#include <stdint.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
 
 #include <fstream>
 #include <sstream>
@@ -499,27 +507,51 @@ static std::istream &safeGetline(std::istream &is, std::string &t) {
 #define IS_NEW_LINE(x) (((x) == '\r') || ((x) == '\n') || ((x) == '\0'))
 
 // Make index zero-base, and also support relative index.
+// Zero is not allowed according to the spec.
 static inline bool fixIndex(int idx, int n, int *ret) {
   if (!ret) {
     return false;
   }
 
-  if (idx > 0) {
-    (*ret) = idx - 1;
-    return true;
-  }
-
   if (idx == 0) {
-    // zero is not allowed according to the spec.
     return false;
   }
 
-  if (idx < 0) {
-    (*ret) = n + idx;  // negative value = relative
-    return true;
+  (*ret) = (idx > 0) ? idx - 1 : n + idx;  // negative value = relative
+  return true;
+}
+
+// Reads one index of a face corner and moves the token to the next '/', space,
+// tab or CR, with the same result as atoi() followed by strcspn(token, "/ \t\r").
+// Plain [sign]digits indices are read directly, anything else goes to atoi().
+static inline int parseIndex(const char **token) {
+  const char *p = (*token);
+  int sign = 1;
+  if (*p == '-') {
+    sign = -1;
+    p++;
+  } else if (*p == '+') {
+    p++;
+  }
+
+  int value = 0, digits = 0;
+  while (IS_DIGIT(*p) && digits < 9) {
+    value = value * 10 + (*p - '0');
+    p++;
+    digits++;
   }
 
-  return false;  // never reach here.
+  if (digits == 0 || IS_DIGIT(*p)) {
+    value = atoi((*token));
+    sign = 1;
+    p = (*token);
+  }
+
+  if (*p != '/' && !IS_SPACE(*p) && *p != '\r' && *p != '\0') {
+    p += strcspn(p, "/ \t\r");
+  }
+  (*token) = p;
+  return sign * value;
 }
 
 static inline std::string parseString(const char **token) {
@@ -680,25 +712,245 @@ fail:
   return false;
 }
 
+// Fast path for the common case of tryParseDouble, used when real_t is float.
+//
+// Numbers of the form [sign] digits [. digits] [(e|E) [sign] digits] with at
+// most 18 significant digits are read into a 64 bit integer mantissa, with
+// runs of eight digits tested and converted together in one 64 bit word
+// (SWAR). The value is then the mantissa times a power of ten, within about an
+// ulp of exact.
+//
+// The result must be bit-identical to narrowing tryParseDouble's result to
+// float. tryParseDouble accumulates a few ulps of error in double, which only
+// matters if the value is that close to halfway between two floats. Those values,
+// and anything outside the simple grammar above, are handed back to
+// tryParseDouble.
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+    defined(__x86_64__) || defined(__aarch64__) ||                \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define TINYOBJ_FAST_PARSE
+#endif
+
+#if defined(TINYOBJ_FAST_PARSE) && !defined(TINYOBJLOADER_USE_DOUBLE)
+
+// True if all eight bytes of the chunk are digits. The top bit of each byte
+// is set if the character is below '0' or above '9'.
+static inline bool isEightDigits(uint64_t chunk) {
+  return (((chunk + 0x4646464646464646ULL) | (chunk - 0x3030303030303030ULL)) &
+          0x8080808080808080ULL) == 0;
+}
+
+// Value of eight digits, the first character in the lowest byte.
+static inline uint64_t convertEightDigits(uint64_t chunk) {
+  uint64_t val = chunk - 0x3030303030303030ULL;
+  val = (val * 10) + (val >> 8);  // pairs of digits
+  val = (((val & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+         (((val >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >>
+        32;
+  return val;
+}
+
+// Reads the run of digits at p into *mantissa and returns the end of the run.
+// *digits counts every digit read, the mantissa is only meaningful while it is
+// 18 or less. Whole blocks of eight digits are tested and converted together;
+// what is left, like the six decimals that most exporters write, is quicker one
+// digit at a time than shifting a partial block into place.
+static inline const char *scanDigits(const char *p, const char *end,
+                                     uint64_t *mantissa, int *digits) {
+  const char *start = p;
+  uint64_t m = (*mantissa);
+  uint64_t chunk;
+  while (end - p >= 8) {
+    memcpy(&chunk, p, sizeof(chunk));
+    if (!isEightDigits(chunk)) break;
+    m = m * 100000000ULL + convertEightDigits(chunk);
+    p += 8;
+  }
+
+  while (p < end && IS_DIGIT(*p)) {
+    m = m * 10 + static_cast<uint64_t>(*p - '0');
+    p++;
+  }
+  (*mantissa) = m;
+  (*digits) += static_cast<int>(p - start);
+  return p;
+}
+
+// Byte mask covering the lowest count bytes of a word, count 0 to 7.
+static inline uint64_t lowBytes(int count) {
+  return (1ULL << (8 * count)) - 1;
+}
+
+// The most common number in an OBJ file is a sign followed by at most eight
+// characters of digits and one decimal point, like "-0.779362". When the token
+// is at least eight characters long, its last eight bytes are loaded as one
+// word (so nothing outside the token is read), the point is found and squeezed
+// out, and all the digits are checked and converted together without a branch
+// per character. Returns false if the body isn't of that form.
+static inline bool parseShortDecimal(const char *s, const char *body,
+                                     const char *end, uint64_t *mantissa,
+                                     int *exponent) {
+  int n = static_cast<int>(end - body);
+  if (n < 2 || n > 8 || end - s < 8) return false;
+
+  uint64_t word;
+  memcpy(&word, end - 8, sizeof(word));
+  word >>= 8 * (8 - n);  // the body in the low n bytes, zeros above
+
+  // First '.', or n if there isn't one
+  uint64_t x = word ^ 0x2E2E2E2E2E2E2E2EULL;
+  uint64_t dots = (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL &
+                  (~0ULL >> (8 * (8 - n)));
+  int dot = n;
+  if (dots) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long bit;
+    _BitScanForward64(&bit, dots);
+    dot = static_cast<int>(bit >> 3);
+#elif defined(__GNUC__)
+    dot = __builtin_ctzll(dots) >> 3;
+#else
+    dot = 0;
+    while (((dots >> (8 * dot)) & 0x80) == 0) dot++;
+#endif
+  }
+  if (dot == 0) return false;  // tryParseDouble needs a digit before the point
+
+  // Drop the point, then pad the unused top bytes with '0'
+  int digits = n;
+  if (dot < n) {
+    uint64_t below = lowBytes(dot);
+    word = (word & below) | ((word >> 8) & ~below);
+    digits = n - 1;
+  }
+  if (digits < 8) word |= 0x3030303030303030ULL << (8 * digits);
+  if (!isEightDigits(word)) return false;
+
+  // The padding zeros scale the value by 10^(8 - digits)
+  (*mantissa) = convertEightDigits(word);
+  (*exponent) = -(digits - dot) - (8 - digits);
+  return true;
+}
+
+// True if the bits of a double are within a few thousand ulps of halfway
+// between two floats, where tryParseDouble's rounding error could change the
+// float.
+static inline bool nearFloatTie(uint64_t bits) {
+  const uint64_t half = 1ULL << 28;  // half a float ulp, in double ulps
+  uint64_t low = bits & ((half << 1) - 1);
+  uint64_t distance = low > half ? low - half : half - low;
+  return distance < 4096;
+}
+
+// Returns false if the number isn't one the fast path can do exactly like
+// tryParseDouble, in which case *result is untouched.
+static bool tryParseFloatFast(const char *s, const char *s_end,
+                              double *result) {
+  // Powers of ten from 1e-22 to 1e22. The negative ones are rounded, so
+  // multiplying by them is within an ulp of dividing, which the tie check
+  // allows for.
+  static const double pow10[] = {
+      1e-22, 1e-21, 1e-20, 1e-19, 1e-18, 1e-17, 1e-16, 1e-15, 1e-14,
+      1e-13, 1e-12, 1e-11, 1e-10, 1e-9,  1e-8,  1e-7,  1e-6,  1e-5,
+      1e-4,  1e-3,  1e-2,  1e-1,  1e0,   1e1,   1e2,   1e3,   1e4,
+      1e5,   1e6,   1e7,   1e8,   1e9,   1e10,  1e11,  1e12,  1e13,
+      1e14,  1e15,  1e16,  1e17,  1e18,  1e19,  1e20,  1e21,  1e22};
+  if (s >= s_end) return false;
+
+  // Coordinates are about half negative, so the sign is read without branching
+  const char *curr = s;
+  uint64_t negative = (*curr == '-');
+  curr += (*curr == '-') | (*curr == '+');
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  if (parseShortDecimal(s, curr, s_end, &mantissa, &exponent)) {
+    curr = s_end;
+  } else {
+    int digits = 0;
+    curr = scanDigits(curr, s_end, &mantissa, &digits);
+    if (digits == 0) return false;
+
+    if (curr < s_end && *curr == '.') {
+      const char *fraction = curr + 1;
+      curr = scanDigits(fraction, s_end, &mantissa, &digits);
+      exponent = -static_cast<int>(curr - fraction);
+    }
+    if (digits > 18) return false;
+  }
+
+  if (curr < s_end && (*curr == 'e' || *curr == 'E')) {
+    curr++;
+    bool negative_exponent = false;
+    if (curr < s_end && (*curr == '+' || *curr == '-')) {
+      negative_exponent = (*curr == '-');
+      curr++;
+    }
+    int e = 0, read = 0;
+    while (curr < s_end && IS_DIGIT(*curr) && read < 4) {
+      e = e * 10 + (*curr - '0');
+      curr++;
+      read++;
+    }
+    if (read == 0) return false;
+    exponent += negative_exponent ? -e : e;
+  }
+
+  // Anything left over (a bad character, a very long exponent) goes the slow way
+  if (curr != s_end) return false;
+  if (exponent < -22 || exponent > 22) return false;
+
+  double value = static_cast<double>(static_cast<int64_t>(mantissa)) *
+                 pow10[exponent + 22];
+  if (value != 0.0 && (value < 1e-37 || value > 1e37)) return false;
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if (nearFloatTie(bits)) return false;
+
+  bits |= negative << 63;
+  memcpy(result, &bits, sizeof(bits));
+  return true;
+}
+
+#endif
+
+// Parses a number into real_t, bit-identical to tryParseDouble followed by
+// static_cast<real_t>.
+static inline bool tryParseReal(const char *s, const char *s_end,
+                                real_t *result) {
+  double val;
+#if defined(TINYOBJ_FAST_PARSE) && !defined(TINYOBJLOADER_USE_DOUBLE)
+  if (tryParseFloatFast(s, s_end, &val)) {
+    (*result) = static_cast<real_t>(val);
+    return true;
+  }
+#endif
+  if (!tryParseDouble(s, s_end, &val)) return false;
+  (*result) = static_cast<real_t>(val);
+  return true;
+}
+
+// The token is the run of characters up to a space, tab, CR or the end of the
+// line, like strcspn(token, " \t\r").
+static inline const char *tokenEnd(const char *token) {
+  while (!IS_SPACE(*token) && *token != '\r' && *token != '\0') token++;
+  return token;
+}
+
 static inline real_t parseReal(const char **token, double default_value = 0.0) {
-  (*token) += strspn((*token), " \t");
-  const char *end = (*token) + strcspn((*token), " \t\r");
-  double val = default_value;
-  tryParseDouble((*token), end, &val);
-  real_t f = static_cast<real_t>(val);
+  while (IS_SPACE(**token)) (*token)++;
+  const char *end = tokenEnd(*token);
+  real_t f;
+  if (!tryParseReal((*token), end, &f)) f = static_cast<real_t>(default_value);
   (*token) = end;
   return f;
 }
 
 static inline bool parseReal(const char **token, real_t *out) {
-  (*token) += strspn((*token), " \t");
-  const char *end = (*token) + strcspn((*token), " \t\r");
-  double val;
-  bool ret = tryParseDouble((*token), end, &val);
-  if (ret) {
-    real_t f = static_cast<real_t>(val);
-    (*out) = f;
-  }
+  while (IS_SPACE(**token)) (*token)++;
+  const char *end = tokenEnd(*token);
+  bool ret = tryParseReal((*token), end, out);
   (*token) = end;
   return ret;
 }
@@ -826,48 +1078,29 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 
   vertex_index_t vi(-1);
 
-  if (!fixIndex(atoi((*token)), vsize, &(vi.v_idx))) {
+  if (!fixIndex(parseIndex(token), vsize, &(vi.v_idx))) {
     return false;
   }
 
-  (*token) += strcspn((*token), "/ \t\r");
-  if ((*token)[0] != '/') {
-    (*ret) = vi;
-    return true;
-  }
-  (*token)++;
-
-  // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
+
+    // i/j/k or i/j, no texcoord for i//k
+    if ((*token)[0] != '/' &&
+        !fixIndex(parseIndex(token), vtsize, &(vi.vt_idx))) {
       return false;
     }
-    (*token) += strcspn((*token), "/ \t\r");
-    (*ret) = vi;
-    return true;
-  }
 
-  // i/j/k or i/j
-  if (!fixIndex(atoi((*token)), vtsize, &(vi.vt_idx))) {
-    return false;
-  }
-
-  (*token) += strcspn((*token), "/ \t\r");
-  if ((*token)[0] != '/') {
-    (*ret) = vi;
-    return true;
-  }
-
-  // i/j/k
-  (*token)++;  // skip '/'
-  if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
-    return false;
+    // i/j/k or i//k
+    if ((*token)[0] == '/') {
+      (*token)++;
+      if (!fixIndex(parseIndex(token), vnsize, &(vi.vn_idx))) {
+        return false;
+      }
+    }
   }
-  (*token) += strcspn((*token), "/ \t\r");
 
   (*ret) = vi;
-
   return true;
 }
 
@@ -875,32 +1108,23 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
 static vertex_index_t parseRawTriple(const char **token) {
   vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
 
-  vi.v_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
-  if ((*token)[0] != '/') {
-    return vi;
-  }
-  (*token)++;
+  vi.v_idx = parseIndex(token);
 
-  // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    vi.vn_idx = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
-    return vi;
-  }
 
-  // i/j/k or i/j
-  vi.vt_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
-  if ((*token)[0] != '/') {
-    return vi;
+    // i/j/k or i/j, no texcoord for i//k
+    if ((*token)[0] != '/') {
+      vi.vt_idx = parseIndex(token);
+    }
+
+    // i/j/k or i//k
+    if ((*token)[0] == '/') {
+      (*token)++;
+      vi.vn_idx = parseIndex(token);
+    }
   }
 
-  // i/j/k
-  (*token)++;  // skip '/'
-  vi.vn_idx = atoi((*token));
-  (*token) += strcspn((*token), "/ \t\r");
   return vi;
 }
 
@@ -2491,6 +2715,24 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
       continue;
     }
 
+    // smoothing group id
+    if (token[0] == 's' && IS_SPACE(token[1])) {
+      token += 2;
+      token += strspn(token, " \t");
+
+      unsigned int smoothing_group_id = 0;
+      if (token[0] != 'o') {
+        int id = parseInt(&token);
+        smoothing_group_id = id < 0 ? 0 : static_cast<unsigned int>(id);
+      }
+
+      if (callback.smoothing_group_cb) {
+        callback.smoothing_group_cb(user_data, smoothing_group_id);
+      }
+
+      continue;
+    }
+
 #if 0  // @todo
     if (token[0] == 't' && IS_SPACE(token[1])) {
       tag_t tag;
@@ -0,0 +1,656 @@
+/* soft_render.cpp
+ Renders the assignment_two scene with no GPU, using the software rasteriser (see soft_raster.h),
+ and writes it to a PNG. The meshes, textures, light and camera are those of the first frame of
+ assignment.cpp, with the same model matrices, so the image can be checked against the OpenGL one.
+ TinyObjLoader puts the obj files straight into OpenGL buffers, so here they are read with
+ tinyobj on the CPU, welded and given normals the same way. The sphere that marks the light is
+ the icosphere that the Sphere class makes, from sphere_mesh.h.
+ With -raytrace the same scene is ray traced instead (see ray_tracer.h), with the models' shadows
+ cast by the light rather than drawn with shadow_matrix, and frames is the number of samples a
+ pixel to accumulate. Each pass reports how many rays a second it traced.
+ Usage: soft_render [-raytrace] [output.png] [width] [height] [threads] [frames]
+ The files are found relative to the soft_render project folder. The frames are timed and the
+ fastest is reported; the image is the same every time and with any number of threads.
+
+ It is also the regression check for the example scenes. assignment_two, the space station of
+ assignment_one/poslight, built from the same parts that poslight draws (see station_model.h),
+ and the textured cube and sphere of lab5 are each rendered at a few fixed camera and animation
+ states, lit with the software rasteriser's Phong lighting. Each image is compared with a
+ reference by perceptual difference (see image_compare.h) and its frame time with the reference's.
+ Usage: soft_render -update [folder]		to render the references, the default folder is references
+        soft_render -check [folder] [different %] [slower %]
+ Next to each reference, name.png, is name.txt with the frame time, draws and triangles it took.
+ -check fails, returning 1, if more than different % of an image's pixels (default 0.1) look
+ different, or if a frame takes more than slower % (default 25) and 2 ms longer than its
+ reference. The image and a map of the differences of a failed state are left as name_result.png
+ and name_diff.png. The references aren't kept in the repository: make them with -update on a
+ known good build, with all of the models in place, which makes the folder if it isn't there.
+*/
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "../assignment_two/tiny_obj_loader.h"
+#include "soft_raster.h"
+#include "ray_tracer.h"
+#include "image_compare.h"
+#include "png_writer.h"
+#include "station_model.h"
+#include "mesh_normals.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <fstream>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+#define GROUND_OFFSET 3.33
+#define ROCK_WALL_OFFSET_X 5.85
+#define ROCK_WALL_OFFSET_Y 3.3
+
+const string modelFolder = "../assignment_two/Models/";
+const string imageFolder = "../../images/";
+
+/* A draw of the scene */
+struct SceneDraw
+{
+	const SoftMesh *mesh;
+	mat4 model;
+	SoftMaterial material;
+	bool planarShadow;		// a shadow_matrix draw, which ray tracing has no use for
+};
+
+/* A scene at one state: its draws, camera and light */
+struct Scene
+{
+	vector<SceneDraw> draws;
+	mat4 view;
+	vec4 lightPosition;			// world space
+	float sunPower;
+};
+
+SoftMesh buddhaObject, blockObject, rockWall, katana, bookshelf, lightSphere;
+SoftMesh stationCylinder, stationCube, stationClaw, stationLight;
+StationModel station;
+SoftMesh texturedCube, earthSphere;
+SoftTexture groundTexture, rockTexture, bookshelfTexture, grassTexture, earthTexture;
+
+/* Read an obj file into a mesh, welding the corners that share a position, texture coordinate and
+   normal, and giving the faces without normals smooth ones with a crease angle of 60 degrees */
+bool LoadObjMesh(const string &file, SoftMesh &mesh)
+{
+	tinyobj::attrib_t attrib;
+	vector<tinyobj::shape_t> shapes;
+	vector<tinyobj::material_t> materials;
+	string warn, err;
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, file.c_str(), NULL, true))
+	{
+		cout << "Could not load " << file << endl;
+		return false;
+	}
+
+	vector<unsigned int> positionIndices;
+	vector<unsigned int> smoothingGroups;
+	vector<tinyobj::index_t> corners;
+	bool hasSmoothingGroups = false;
+	for (size_t s = 0; s < shapes.size(); s++)
+	{
+		const tinyobj::mesh_t &m = shapes[s].mesh;
+		for (size_t i = 0; i < m.indices.size(); i++)
+		{
+			corners.push_back(m.indices[i]);
+			positionIndices.push_back((unsigned int)m.indices[i].vertex_index);
+		}
+		for (size_t f = 0; f < m.num_face_vertices.size(); f++)
+		{
+			smoothingGroups.push_back(f < m.smoothing_group_ids.size() ? m.smoothing_group_ids[f] : 0);
+			hasSmoothingGroups = hasSmoothingGroups || smoothingGroups.back() != 0;
+		}
+	}
+	if (corners.empty()) return false;
+
+	vector<float> cornerNormals(corners.size() * 3);
+	generateNormals(&attrib.vertices[0], attrib.vertices.size() / 3, &positionIndices[0], positionIndices.size(),
+		hasSmoothingGroups ? &smoothingGroups[0] : NULL, 60.f, &cornerNormals[0]);
+
+	// A corner without a normal in the file is welded by its generated normal's position in cornerNormals
+	map<vector<int>, unsigned int> welded;
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	for (size_t c = 0; c < corners.size(); c++)
+	{
+		const tinyobj::index_t &corner = corners[c];
+		vector<int> key(3);
+		key[0] = corner.vertex_index;
+		key[1] = corner.texcoord_index;
+		key[2] = (corner.normal_index >= 0) ? corner.normal_index : -1 - (int)c;
+
+		map<vector<int>, unsigned int>::iterator found = welded.find(key);
+		if (found != welded.end())
+		{
+			mesh.indices.push_back(found->second);
+			continue;
+		}
+
+		SoftVertex vertex;
+		vertex.position = vec3(attrib.vertices[corner.vertex_index * 3], attrib.vertices[corner.vertex_index * 3 + 1],
+			attrib.vertices[corner.vertex_index * 3 + 2]);
+		if (corner.normal_index >= 0)
+		{
+			vertex.normal = vec3(attrib.normals[corner.normal_index * 3], attrib.normals[corner.normal_index * 3 + 1],
+				attrib.normals[corner.normal_index * 3 + 2]);
+		}
+		else vertex.normal = vec3(cornerNormals[c * 3], cornerNormals[c * 3 + 1], cornerNormals[c * 3 + 2]);
+		vertex.texcoord = (corner.texcoord_index >= 0)
+			? vec2(attrib.texcoords[corner.texcoord_index * 2], attrib.texcoords[corner.texcoord_index * 2 + 1]) : vec2(0.f);
+		vertex.colour = vec4(1.f);
+
+		unsigned int index = (unsigned int)mesh.vertices.size();
+		welded[key] = index;
+		mesh.vertices.push_back(vertex);
+		mesh.indices.push_back(index);
+	}
+	return true;
+}
+
+/* Load a texture with stb_image, as LoadTexture does, or flipped as lab5 loads them */
+bool LoadTexture(const string &filename, SoftTexture &texture, bool flip = false)
+{
+	int width, height, nrChannels;
+	stbi_set_flip_vertically_on_load(flip);
+	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
+	if (!data)
+	{
+		cout << "Could not load " << filename << endl;
+		return false;
+	}
+	texture.makeTexture(width, height, nrChannels, data);
+	stbi_image_free(data);
+	return true;
+}
+
+/* Placement of a model, as in assignment.cpp */
+mat4 ModelMatrix(vec3 position, vec3 rotation, float size)
+{
+	mat4 m = translate(mat4(1.0f), position);
+	m = scale(m, vec3(size / 3.f, size / 3.f, size / 3.f));
+	m = rotate(m, -radians(rotation.x), vec3(1, 0, 0));
+	m = rotate(m, -radians(rotation.y), vec3(0, 1, 0));
+	m = rotate(m, -radians(rotation.z), vec3(0, 0, 1));
+	return m;
+}
+
+/* The planar shadow projection of assignment.cpp */
+mat4 shadow_matrix(vec4 L, vec4 P)
+{
+	float rdotl = P.x * L.x + P.y * L.y + P.z * L.z + P.w * L.w;
+	return mat4(-P.x * L.x + rdotl, -P.x * L.y, -P.x * L.z, -P.x * L.w,
+		-P.y * L.x, -P.y * L.y + rdotl, -P.y * L.z, -P.y * L.w,
+		-P.z * L.x, -P.z * L.y, -P.z * L.z + rdotl, -P.z * L.w,
+		-P.w * L.x, -P.w * L.y, -P.w * L.z, -P.w * L.w + rdotl);
+}
+
+void AddDraw(Scene &scene, const SoftMesh &mesh, const mat4 &model, const SoftMaterial &material, bool planarShadow = false)
+{
+	if (mesh.vertices.empty()) return;
+	SceneDraw draw = { &mesh, model, material, planarShadow };
+	scene.draws.push_back(draw);
+}
+
+/* A lit, textured material. Textures that didn't load leave the model white */
+SoftMaterial Textured(const SoftTexture &texture, bool shiny)
+{
+	SoftMaterial material;
+	material.texture = texture.width ? &texture : NULL;
+	material.specular = shiny;
+	return material;
+}
+
+/* The cube of the Cube class with texture coordinates, each face showing the whole texture */
+void MakeTexturedCube(SoftMesh &mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int side = -1; side <= 1; side += 2)
+		{
+			vec3 normal(0.f), u(0.f), v(0.f);
+			normal[axis] = (float)side;
+			u[(axis + 1) % 3] = (float)side;
+			v[(axis + 2) % 3] = 1.f;
+
+			unsigned int first = (unsigned int)mesh.vertices.size();
+			for (int corner = 0; corner < 4; corner++)
+			{
+				vec2 uv((corner == 1 || corner == 2) ? 1.f : 0.f, (corner >= 2) ? 1.f : 0.f);
+				SoftVertex vertex;
+				vertex.position = (normal + u * (uv.x * 2.f - 1.f) + v * (uv.y * 2.f - 1.f)) * 0.5f;
+				vertex.normal = normal;
+				vertex.texcoord = uv;
+				vertex.colour = vec4(1.f);
+				mesh.vertices.push_back(vertex);
+			}
+			unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+			for (int i = 0; i < 6; i++) mesh.indices.push_back(first + quad[i]);
+		}
+	}
+}
+
+/* A mesh from the builder, white so that the material gives its colour as partColor does */
+void FromBuilder(const MeshBuilder &builder, unsigned int shape, SoftMesh &mesh)
+{
+	mesh.fromBuilder(builder, shape);
+	for (size_t v = 0; v < mesh.vertices.size(); v++) mesh.vertices[v].colour = vec4(1.f);
+}
+
+/* Load the models and textures of all of the scenes. Any that are missing are left out */
+void init()
+{
+	LoadObjMesh(modelFolder + "Buddha/buddha.obj", buddhaObject);
+	LoadObjMesh(modelFolder + "Ground/ground.obj", blockObject);
+	LoadObjMesh(modelFolder + "Rock Wall/rock-wall.obj", rockWall);
+	LoadObjMesh(modelFolder + "Katana/katana.obj", katana);
+	LoadObjMesh(modelFolder + "Books/books.obj", bookshelf);
+
+	SphereMesh icosphere;
+	makeIcosphere(4, SPHERE_NO_TEXCOORDS, icosphere);
+	lightSphere.fromSphere(icosphere);
+
+	LoadTexture(modelFolder + "Ground/ground-2.jpg", groundTexture);
+	LoadTexture(modelFolder + "Rock Wall/Maps/2.jpg", rockTexture);
+	LoadTexture(modelFolder + "Books/uv.png", bookshelfTexture);
+
+	// The station and its shapes, made as poslight makes them
+	MeshBuilder builder;
+	FromBuilder(builder, builder.addSphere(60, 60), stationLight);
+	FromBuilder(builder, builder.addCube(), stationCube);
+	FromBuilder(builder, builder.addCylinder(100, vec3(1.f)), stationCylinder);
+	FromBuilder(builder, addClaw(builder), stationClaw);
+	station.makeStation();
+
+	// lab5's cube and sphere, with its textures flipped the way it loads them
+	MakeTexturedCube(texturedCube);
+	SphereMesh earth;
+	makeIcosphere(5, SPHERE_LONGLAT_TEXCOORDS, earth);
+	earthSphere.fromSphere(earth);
+	LoadTexture(imageFolder + "grass.jpg", grassTexture, true);
+	LoadTexture(imageFolder + "earth_no_clouds.jpg", earthTexture, true);
+}
+
+/* The draws of a frame of assignment_two, with the buddha bobbing at frame */
+void AssignmentTwoScene(Scene &scene, vec3 cameraPosition, vec4 lightPosition, float frame)
+{
+	scene.draws.clear();
+	scene.view = lookAt(cameraPosition, vec3(0, 1, 0), vec3(0, 1, 0));
+	scene.lightPosition = lightPosition;
+	scene.sunPower = 0.05f;
+
+	for (int x = -9; x < 9; x++)
+		for (int y = -6; y < 10; y++)
+			AddDraw(scene, blockObject, ModelMatrix(vec3(GROUND_OFFSET * x, -0.2f, GROUND_OFFSET * y), vec3(0, 0, 0), 0.5f),
+				Textured(groundTexture, false));
+
+	for (int x = -3; x <= 3; x++)
+		for (int y = -1; y < 5; y++)
+			AddDraw(scene, rockWall, ModelMatrix(vec3(ROCK_WALL_OFFSET_X * x, ROCK_WALL_OFFSET_Y * y, -20), vec3(0, 180, 0), 1.f),
+				Textured(rockTexture, false));
+
+	for (int z = -3; z <= 3; z++)
+		for (int y = -1; y < 5; y++)
+		{
+			AddDraw(scene, rockWall, ModelMatrix(vec3(ROCK_WALL_OFFSET_X * 3, ROCK_WALL_OFFSET_Y * y, ROCK_WALL_OFFSET_X * z), vec3(0, -90, 0), 1.f),
+				Textured(rockTexture, false));
+			AddDraw(scene, rockWall, ModelMatrix(vec3(ROCK_WALL_OFFSET_X * -3, ROCK_WALL_OFFSET_Y * y, ROCK_WALL_OFFSET_X * z), vec3(0, 90, 0), 1.f),
+				Textured(rockTexture, false));
+		}
+
+	// The shadowed models
+	struct ShadowedModel
+	{
+		const SoftMesh *mesh;
+		const SoftTexture *texture;
+		vec3 position;
+		float size;
+	};
+	ShadowedModel models[] = {
+		{ &buddhaObject, &rockTexture, vec3(0, 0.1 * sin(frame * 3.14 / 180), 0), 2 },
+		{ &bookshelf, &bookshelfTexture, vec3(-3, -0.08, -6.2), 3 },
+		{ &bookshelf, &bookshelfTexture, vec3(3, -0.08, -6.2), 3 },
+		{ &katana, &rockTexture, vec3(0, -0.05, -6.2), 3 }
+	};
+	SoftMaterial shadowMaterial;
+	shadowMaterial.lit = false;
+	shadowMaterial.colour = vec4(0.1f, 0.1f, 0.13f, 1.f);
+	for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+	{
+		const ShadowedModel &m = models[i];
+		mat4 shadow = translate(mat4(1.0f), vec3(0, -0.19f, 0));
+		shadow = shadow * shadow_matrix(lightPosition - vec4(m.position, 1.0), vec4(0, 1.0, 0, 0.0));
+		shadow = translate(shadow, vec3(m.position.x, m.position.y + 0.19f, m.position.z));
+		AddDraw(scene, *m.mesh, shadow, shadowMaterial, true);
+		AddDraw(scene, *m.mesh, ModelMatrix(m.position, vec3(0, 0, 0), m.size), Textured(*m.texture, true));
+	}
+
+	SoftMaterial emissive;
+	emissive.emissive = true;
+	mat4 light = translate(mat4(1.0f), vec3(lightPosition));
+	AddDraw(scene, lightSphere, scale(light, vec3(0.01f, 0.01f, 0.01f)), emissive);
+}
+
+/* The station of poslight, with the view turned by viewAngles as its 7 to = keys do, the arm's
+   joints turned by armRotation each and its solar panels by panelRotation */
+void PoslightScene(Scene &scene, vec3 viewAngles, vec3 armRotation, float panelRotation)
+{
+	scene.draws.clear();
+	mat4 view = lookAt(vec3(0, 2, 6), vec3(0, 0, 0), vec3(0, 1, 0));
+	view = rotate(view, -radians(viewAngles.x), vec3(1, 0, 0));
+	view = rotate(view, -radians(viewAngles.y), vec3(0, 1, 0));
+	scene.view = rotate(view, -radians(viewAngles.z), vec3(0, 0, 1));
+	scene.lightPosition = vec4(1, 0, 2, 1);
+	scene.sunPower = 0.05f;
+
+	SoftMaterial emissive;
+	emissive.emissive = true;
+	emissive.colour = vec4(0.5f, 0.5f, 0.5f, 1.f);
+	AddDraw(scene, stationLight, scale(translate(mat4(1.0f), vec3(scene.lightPosition)), vec3(0.05f)), emissive);
+
+	// The parts of the station that poslight draws, each in its colour
+	station.setPanels(panelRotation, -panelRotation);
+	station.setArm(armRotation, armRotation, armRotation);
+	station.update();
+	const SoftMesh *shapes[] = { &stationCylinder, &stationCube, &stationClaw };
+	for (size_t i = 0; i < station.parts.size(); i++)
+	{
+		const StationPart &part = station.parts[i];
+		SoftMaterial material;
+		material.colour = vec4(part.colour, 1.f);
+		AddDraw(scene, *shapes[part.shape], station.world(part), material);
+	}
+}
+
+/* lab5's textured cube and sphere, turned by angles. Its light is the light_dir of lab5start.vert,
+   a direction along the view axis, which with a sun power of 1 isn't attenuated. The lighting is
+   still the Phong lighting of the rasteriser, per pixel, rather than lab5's per vertex */
+void Lab5Scene(Scene &scene, vec3 angles)
+{
+	scene.draws.clear();
+	scene.view = lookAt(vec3(0, 0, 4), vec3(0, 0, 0), vec3(0, 1, 0));
+	scene.lightPosition = vec4(0, 0, 1, 0);
+	scene.sunPower = 1.f;
+
+	mat4 spin = rotate(mat4(1.0f), -radians(angles.x), vec3(1, 0, 0));
+	spin = rotate(spin, -radians(angles.y), vec3(0, 1, 0));
+	spin = rotate(spin, -radians(angles.z), vec3(0, 0, 1));
+
+	SoftMaterial material;
+	material.specular = true;
+	material.texture = grassTexture.width ? &grassTexture : NULL;
+	AddDraw(scene, texturedCube, translate(mat4(1.0f), vec3(0.55f, 0, 0)) * spin, material);
+
+	material.texture = earthTexture.width ? &earthTexture : NULL;
+	AddDraw(scene, earthSphere, scale(translate(mat4(1.0f), vec3(-0.55f, 0, 0)), vec3(1.f / 3.f)) * spin, material);
+}
+
+void render(SoftRasteriser &raster, const Scene &scene, bool simd)
+{
+	float aspect_ratio = (float)raster.width / raster.height;
+	mat4 projection = perspective(radians(30.0f), aspect_ratio, 0.1f, 100.0f);
+
+	raster.clear(vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	raster.setCamera(scene.view, projection);
+	raster.setLight(scene.lightPosition, scene.sunPower);
+	for (size_t d = 0; d < scene.draws.size(); d++) raster.draw(*scene.draws[d].mesh, scene.draws[d].model, scene.draws[d].material);
+	raster.finish(simd);
+}
+
+/* Render a scene frames times and return the fastest, in milliseconds */
+double timeFrames(SoftRasteriser &raster, const Scene &scene, int frames)
+{
+	double best = 1e30;
+	for (int f = 0; f < frames; f++)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		render(raster, scene, true);
+		best = std::min(best, chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count());
+	}
+	return best;
+}
+
+/* The fixed states the regression check renders */
+struct CheckState
+{
+	const char *name;
+	void(*build)(Scene &scene);
+};
+
+void AssignmentTwoStart(Scene &scene) { AssignmentTwoScene(scene, vec3(0.f, 0.8f, 5.f), vec4(0.6f, 2.f, 3.f, 1.f), 1.f); }
+void AssignmentTwoMoved(Scene &scene) { AssignmentTwoScene(scene, vec3(3.f, 0.8f, 9.f), vec4(-1.f, 2.5f, 2.f, 1.f), 90.f); }
+void PoslightStart(Scene &scene) { PoslightScene(scene, vec3(0.f, 140.f, 4.f), vec3(0.f), 0.f); }
+void PoslightArm(Scene &scene) { PoslightScene(scene, vec3(10.f, 200.f, 0.f), vec3(-30.f, 25.f, 0.f), 40.f); }
+void Lab5Start(Scene &scene) { Lab5Scene(scene, vec3(0.f)); }
+void Lab5Turned(Scene &scene) { Lab5Scene(scene, vec3(30.f, 60.f, 10.f)); }
+
+const CheckState checkStates[] = {
+	{ "assignment_two_start", AssignmentTwoStart },
+	{ "assignment_two_moved", AssignmentTwoMoved },
+	{ "poslight_start", PoslightStart },
+	{ "poslight_arm", PoslightArm },
+	{ "lab5_start", Lab5Start },
+	{ "lab5_turned", Lab5Turned }
+};
+const unsigned int checkWidth = 640, checkHeight = 480;
+const int checkFrames = 9;
+const double checkTimeSlack = 2.0;		// ms a frame can always be slower by, for the noise in timing small frames
+
+/* Make a folder and any of the folders above it that aren't there yet. Returns whether it is there now */
+bool makeFolder(const string &folder)
+{
+	for (size_t end = folder.find_first_of("/\\", 1); ; end = folder.find_first_of("/\\", end + 1))
+	{
+		string part = folder.substr(0, end);
+#ifdef _WIN32
+		_mkdir(part.c_str());
+#else
+		mkdir(part.c_str(), 0755);
+#endif
+		if (end == string::npos) break;
+	}
+
+	struct stat info;
+	return stat(folder.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+/* Render every state. With update, write the images and their stats as the new references;
+   otherwise compare with the references and return whether they all passed */
+bool check(const string &folder, bool update, float maxDifferent, float maxSlower)
+{
+	if (update && !makeFolder(folder))
+	{
+		cout << "Could not make the folder " << folder << endl;
+		return false;
+	}
+
+	SoftRasteriser raster;
+	raster.makeFramebuffer(checkWidth, checkHeight);
+
+	bool passed = true;
+	cout << fixed << setprecision(2);
+	for (size_t s = 0; s < sizeof(checkStates) / sizeof(checkStates[0]); s++)
+	{
+		Scene scene;
+		checkStates[s].build(scene);
+		double time = timeFrames(raster, scene, checkFrames);
+		string base = folder + "/" + checkStates[s].name;
+
+		if (update)
+		{
+			ofstream stats((base + ".txt").c_str());
+			stats << "frame_ms " << time << "\ndraws " << scene.draws.size() << "\ntriangles " << raster.triangleCount() << "\n";
+			if (!stats || !raster.writePNG(base + ".png"))
+			{
+				cout << "Could not write " << base << ".png or .txt" << endl;
+				return false;
+			}
+			cout << setw(22) << left << checkStates[s].name << right << setw(9) << time << " ms, " << scene.draws.size()
+				<< " draws, " << raster.triangleCount() << " triangles" << endl;
+			continue;
+		}
+
+		// The reference image and the stats that were recorded with it
+		int width, height, channels;
+		stbi_set_flip_vertically_on_load(false);
+		unsigned char *reference = stbi_load((base + ".png").c_str(), &width, &height, &channels, 4);
+		double referenceTime = 0.0;
+		size_t referenceDraws = 0, referenceTriangles = 0;
+		ifstream stats((base + ".txt").c_str());
+		string key;
+		double value;
+		while (stats >> key >> value)
+		{
+			if (key == "frame_ms") referenceTime = value;
+			else if (key == "draws") referenceDraws = (size_t)value;
+			else if (key == "triangles") referenceTriangles = (size_t)value;
+		}
+		if (!reference || (unsigned int)width != checkWidth || (unsigned int)height != checkHeight)
+		{
+			cout << setw(22) << left << checkStates[s].name << right << " FAILED: no " << checkWidth << " x " << checkHeight
+				<< " reference, run soft_render -update" << endl;
+			if (reference) stbi_image_free(reference);
+			passed = false;
+			continue;
+		}
+
+		vector<unsigned char> heatMap;
+		ImageDifference difference = compareImages(&raster.colour[0], reference, checkWidth, checkHeight, 4, 2.3f, &heatMap);
+		stbi_image_free(reference);
+
+		bool different = difference.fractionOver * 100.f > maxDifferent;
+		bool slower = referenceTime > 0.0 && time > std::max(referenceTime * (1.0 + maxSlower / 100.0), referenceTime + checkTimeSlack);
+		cout << setw(22) << left << checkStates[s].name << right << setw(7) << difference.fractionOver * 100.f << "% different (mean dE "
+			<< difference.meanDeltaE << ", max " << difference.maxDeltaE << "), " << setw(8) << time << " ms against " << setw(8)
+			<< referenceTime << ", " << scene.draws.size() << " draws, " << raster.triangleCount() << " triangles";
+		if (referenceDraws != scene.draws.size() || referenceTriangles != raster.triangleCount())
+		{
+			cout << " (reference " << referenceDraws << " and " << referenceTriangles << ")";
+		}
+		cout << ((different || slower) ? (different ? " FAILED: image" : " FAILED: time") : " passed") << endl;
+
+		if (different)
+		{
+			raster.writePNG(base + "_result.png");
+			writePNG(base + "_diff.png", checkWidth, checkHeight, 3, &heatMap[0]);
+		}
+		passed = passed && !different && !slower;
+	}
+	return passed;
+}
+
+/* Ray trace the scene, one sample a pixel a pass */
+bool raytrace(const Scene &scene, const string &output, unsigned int width, unsigned int height, unsigned int threads, int samples)
+{
+	RayTracer tracer;
+	tracer.makeFramebuffer(width, height, threads);
+
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+	for (size_t d = 0; d < scene.draws.size(); d++)
+	{
+		if (!scene.draws[d].planarShadow) tracer.addMesh(*scene.draws[d].mesh, scene.draws[d].model, scene.draws[d].material);
+	}
+	tracer.buildBVH();
+	double buildTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	float aspect_ratio = (float)width / height;
+	tracer.setCamera(scene.view, perspective(radians(30.0f), aspect_ratio, 0.1f, 100.0f));
+	tracer.setLight(scene.lightPosition, scene.sunPower);
+
+	cout << fixed << setprecision(2);
+	cout << width << " x " << height << ", " << tracer.triangleCount() << " triangles, " << tracer.nodeCount()
+		<< " nodes built in " << buildTime << " ms" << endl;
+
+	double totalTime = 0.0;
+	unsigned long long totalRays = 0;
+	for (int s = 0; s < samples; s++)
+	{
+		start = chrono::high_resolution_clock::now();
+		tracer.trace(true);
+		double time = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		totalTime += time;
+		totalRays += tracer.raysTraced();
+		cout << "  pass " << setw(3) << tracer.samples() << ": " << setw(9) << time * 1000.0 << " ms, "
+			<< tracer.raysTraced() / time / 1e6 << " million rays a second" << endl;
+	}
+	cout << totalRays << " rays in " << totalTime * 1000.0 << " ms, " << totalRays / totalTime / 1e6
+		<< " million rays a second" << endl;
+
+	if (!tracer.writePNG(output))
+	{
+		cout << "Could not write " << output << endl;
+		return false;
+	}
+	cout << "Wrote " << output << endl;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	string mode = (argc > 1) ? argv[1] : "";
+	if (mode == "-check" || mode == "-update")
+	{
+		string folder = (argc > 2) ? argv[2] : "references";
+		float maxDifferent = (argc > 3) ? (float)atof(argv[3]) : 0.1f;
+		float maxSlower = (argc > 4) ? (float)atof(argv[4]) : 25.f;
+		init();
+		bool passed = check(folder, mode == "-update", maxDifferent, maxSlower);
+		if (mode == "-check") cout << (passed ? "All states passed" : "Some states FAILED") << endl;
+		return passed ? 0 : 1;
+	}
+
+	bool rayTraced = (argc > 1 && string(argv[1]) == "-raytrace");
+	if (rayTraced)
+	{
+		argc--;
+		argv++;
+	}
+	string output = (argc > 1) ? argv[1] : "soft_render.png";
+	unsigned int width = (argc > 2) ? atoi(argv[2]) : 1024;
+	unsigned int height = (argc > 3) ? atoi(argv[3]) : 768;
+	unsigned int threads = (argc > 4) ? atoi(argv[4]) : 0;
+	int frames = (argc > 5) ? atoi(argv[5]) : 5;
+	if (width == 0 || height == 0 || frames < 1)
+	{
+		cout << "Usage: soft_render [-raytrace] [output.png] [width] [height] [threads] [frames]" << endl;
+		return 1;
+	}
+
+	init();
+	Scene scene;
+	AssignmentTwoStart(scene);
+	if (rayTraced) return raytrace(scene, output, width, height, threads, frames) ? 0 : 1;
+
+	SoftRasteriser raster;
+	raster.makeFramebuffer(width, height, threads);
+
+	double best = timeFrames(raster, scene, frames);
+
+	cout << fixed << setprecision(2);
+	cout << width << " x " << height << ", " << scene.draws.size() << " draws, " << raster.triangleCount() << " triangles: "
+		<< best << " ms a frame, " << raster.blocksSkipped() << " blocks skipped by the hierarchical Z" << endl;
+
+	if (!raster.writePNG(output))
+	{
+		cout << "Could not write " << output << endl;
+		return 1;
+	}
+	cout << "Wrote " << output << endl;
+	return 0;
+}
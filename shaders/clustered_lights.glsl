@@ -0,0 +1,43 @@
+// Many point lights, sorted into clusters of the view frustum by ClusteredLights on the CPU
+// Include with #include "../../shaders/clustered_lights.glsl" from an example project folder,
+// after lighting.glsl
+
+uniform samplerBuffer clusterLights;		// two texels a light: eye space position and radius, then colour
+uniform usamplerBuffer clusterCells;		// first index and count of each cluster's lights
+uniform usamplerBuffer clusterIndices;		// the lights of each cluster, one cluster after another
+uniform uvec3 clusterCount;					// tiles across, tiles up and depth slices
+uniform vec2 clusterScreenScale;			// tiles per pixel, across and up
+uniform vec2 clusterDepthScale;				// slice = log(depth) * x + y
+
+// Diffuse and specular light from the lights of this fragment's cluster. P is the eye space
+// position, N the normalised normal, and a shininess of 0 leaves out the specular
+vec3 clustered_lighting(vec3 P, vec3 N, vec3 albedo, float shininess, vec3 specular_albedo)
+{
+	uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterScreenScale), clusterCount.xy - 1u);
+	int slice = clamp(int(log(-P.z) * clusterDepthScale.x + clusterDepthScale.y), 0, int(clusterCount.z) - 1);
+	int cluster = (slice * int(clusterCount.y) + int(tile.y)) * int(clusterCount.x) + int(tile.x);
+	uvec2 cell = texelFetch(clusterCells, cluster).xy;
+
+	vec3 total = vec3(0.0);
+	for (uint i = 0u; i < cell.y; i++)
+	{
+		int light = int(texelFetch(clusterIndices, int(cell.x + i)).x);
+		vec4 positionRadius = texelFetch(clusterLights, light * 2);
+		vec3 colour = texelFetch(clusterLights, light * 2 + 1).rgb;
+
+		vec3 toLight = positionRadius.xyz - P;
+		float distanceSquared = dot(toLight, toLight);
+		float radiusSquared = positionRadius.w * positionRadius.w;
+		if (distanceSquared >= radiusSquared) continue;
+
+		// Inverse square falloff, windowed so that it reaches 0 at the radius
+		float window = 1.0 - distanceSquared / radiusSquared;
+		float falloff = window * window / (1.0 + distanceSquared);
+
+		vec3 L = toLight * inversesqrt(distanceSquared);
+		vec3 light_colour = diffuse_term(N, L) * albedo;
+		if (shininess > 0.0) light_colour += specular_term(N, L, P, shininess, specular_albedo);
+		total += falloff * colour * light_colour;
+	}
+	return total;
+}
@@ -0,0 +1,13 @@
+#version 400
+
+// One triangle that covers the screen, made from the vertex number, for full-screen passes.
+// Draw it with glDrawArrays(GL_TRIANGLES, 0, 3) and no vertex attributes
+
+out vec2 screenPosition;
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	screenPosition = corner * 2.0 - 1.0;
+	gl_Position = vec4(screenPosition, 0.0, 1.0);
+}
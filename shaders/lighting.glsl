@@ -0,0 +1,24 @@
+// Lighting terms shared by the example shaders
+// Include with #include "../../shaders/lighting.glsl" from an example project folder
+
+const vec3 emissive_colour = vec3(1.0, 1.0, 0.8);
+
+// Lambert diffuse factor. N and L must be normalised
+float diffuse_term(vec3 N, vec3 L)
+{
+	return max(dot(N, L), 0.0);
+}
+
+// Phong specular reflection. N and L must be normalised, P is the eye space position
+vec3 specular_term(vec3 N, vec3 L, vec3 P, float shininess, vec3 specular_albedo)
+{
+	vec3 V = normalize(-P);
+	vec3 R = reflect(-L, N);
+	return pow(max(dot(R, V), 0.0), shininess) * specular_albedo;
+}
+
+// Constant, linear and quadratic distance attenuation
+float attenuation_term(float distanceToLight, float k1, float k2, float k3)
+{
+	return 1.0 / (k1 + k2 * distanceToLight + k3 * distanceToLight * distanceToLight);
+}
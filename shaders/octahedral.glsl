@@ -0,0 +1,24 @@
+// Octahedral normals, as packed by common/vertex_quantiser and into the deferred shading G-buffer
+// Include with #include "../../shaders/octahedral.glsl" from an example project folder
+
+// e is the signed normalised pair from the vertex attribute
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
+// The inverse of octDecode, n must be normalised
+vec2 octEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0)
+	{
+		e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return e;
+}
@@ -0,0 +1,17 @@
+#version 400
+
+// Shows the fragment counts of OverdrawCounter as a heat map: nothing is black, then one
+// fragment is blue, two green, three yellow, four red and five or more white.
+// Draw with fullscreen.vert
+
+uniform sampler2D overdrawCount;
+out vec4 outputColor;
+
+const vec3 heat[6] = vec3[6](vec3(0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0),
+	vec3(1.0, 0.0, 0.0), vec3(1.0));
+
+void main()
+{
+	float count = texelFetch(overdrawCount, ivec2(gl_FragCoord.xy), 0).r;
+	outputColor = vec4(heat[clamp(int(count + 0.5), 0, 5)], 1.0);
+}
@@ -0,0 +1,10 @@
+// Per-object transforms, computed once per object on the CPU by TransformPipeline
+// Include with #include "../../shaders/transforms.glsl" from an example project folder
+
+layout(std140) uniform Transforms
+{
+	mat4 model;
+	mat4 modelview;
+	mat4 mvp;
+	mat3 normalmatrix;
+};